@@ -15,6 +15,7 @@
 #include <string>
 #include <vector>
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/iterator/filter_iterator.hpp>
@@ -23,6 +24,7 @@
 #include <osquery/config/packs.h>
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
@@ -32,8 +34,10 @@
 #include <osquery/events/events.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
+#include <osquery/process/process.h>
 #include <osquery/registry/registry.h>
 
+#include <osquery/utils/conversions/join.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/system/time.h>
@@ -130,6 +134,9 @@ RecursiveMutex config_schedule_mutex_;
 RecursiveMutex config_files_mutex_;
 RecursiveMutex config_performance_mutex_;
 
+/// The scheduled query started on the current thread, if any.
+thread_local std::string kThreadExecutingQuery;
+
 using PackRef = std::unique_ptr<Pack>;
 
 /**
@@ -183,10 +190,42 @@ class Schedule : private boost::noncopyable {
 
   PackRef& last();
 
+  /// A scheduled query of any pack, with its synthetic name.
+  struct IndexedQuery {
+    Pack* pack;
+    std::string name;
+    ScheduledQuery* query;
+  };
+
+  /**
+   * @brief The queries due at a time step, in schedule order.
+   *
+   * Queries are indexed by the next step they are due at, so only the due
+   * ones are visited. The index is rebuilt when packs change or when the
+   * steps go backward. The packs are not checked for execution.
+   */
+  const std::vector<const IndexedQuery*>& due(uint64_t step);
+
+ private:
+  void buildIndex(uint64_t step);
+
  private:
   /// Underlying storage for the packs
   container packs_;
 
+  /// The scheduled queries of the packs, in schedule order.
+  std::vector<IndexedQuery> queries_;
+
+  /// The next step each query is due at and its index, the earliest first.
+  using DueStep = std::pair<uint64_t, size_t>;
+  std::priority_queue<DueStep, std::vector<DueStep>, std::greater<DueStep>>
+      due_steps_;
+
+  /// The queries due at the last step asked.
+  std::vector<const IndexedQuery*> due_;
+  uint64_t due_step_{0};
+  bool index_valid_{false};
+
   /**
    * @brief The schedule will check and record previously executing queries.
    *
@@ -215,6 +254,7 @@ bool Schedule::Step::operator()(const PackRef& pack) const {
 void Schedule::add(PackRef pack) {
   remove(pack->getName(), pack->getSource());
   packs_.push_back(std::move(pack));
+  index_valid_ = false;
 }
 
 void Schedule::remove(const std::string& pack) {
@@ -233,6 +273,7 @@ void Schedule::remove(const std::string& pack, const std::string& source) {
         return false;
       });
   packs_.erase(new_end, packs_.end());
+  index_valid_ = false;
 }
 
 void Schedule::removeAll(const std::string& source) {
@@ -246,6 +287,7 @@ void Schedule::removeAll(const std::string& source) {
         return false;
       });
   packs_.erase(new_end, packs_.end());
+  index_valid_ = false;
 }
 
 Schedule::iterator Schedule::begin() {
@@ -260,6 +302,65 @@ PackRef& Schedule::last() {
   return packs_.back();
 }
 
+void Schedule::buildIndex(uint64_t step) {
+  queries_.clear();
+  for (auto& pack : packs_) {
+    for (auto& it : pack->getSchedule()) {
+      if (it.second.splayed_interval == 0) {
+        continue;
+      }
+
+      // The query name may be synthetic.
+      std::string name = it.first;
+      if (pack->getName() != "main") {
+        name = "pack" + FLAGS_pack_delimiter + pack->getName() +
+               FLAGS_pack_delimiter + it.first;
+      }
+      queries_.push_back({pack.get(), std::move(name), &it.second});
+    }
+  }
+
+  decltype(due_steps_)().swap(due_steps_);
+  for (size_t i = 0; i < queries_.size(); i++) {
+    auto interval = queries_[i].query->splayed_interval;
+    due_steps_.push({(step + interval - 1) / interval * interval, i});
+  }
+  index_valid_ = true;
+}
+
+const std::vector<const Schedule::IndexedQuery*>& Schedule::due(
+    uint64_t step) {
+  if (index_valid_ && step == due_step_) {
+    return due_;
+  }
+
+  if (!index_valid_ || step < due_step_) {
+    buildIndex(step);
+  }
+  due_step_ = step;
+
+  // Steps may have been skipped, then a query is only due on a multiple of
+  // its interval.
+  std::vector<size_t> indexes;
+  while (!due_steps_.empty() && due_steps_.top().first <= step) {
+    auto index = due_steps_.top().second;
+    due_steps_.pop();
+
+    auto interval = queries_[index].query->splayed_interval;
+    if (step % interval == 0) {
+      indexes.push_back(index);
+    }
+    due_steps_.push({(step / interval + 1) * interval, index});
+  }
+  std::sort(indexes.begin(), indexes.end());
+
+  due_.clear();
+  for (auto index : indexes) {
+    due_.push_back(&queries_[index]);
+  }
+  return due_;
+}
+
 /**
  * @brief A thread that periodically reloads configuration state.
  *
@@ -324,10 +425,13 @@ Schedule::Schedule() {
   // Check if any queries were executing when the tool last stopped.
   getDatabaseValue(kPersistentSettings, kExecutingQuery, failed_query_);
   if (!failed_query_.empty()) {
-    LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
     setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
-    // Add this query name to the denylist and save the denylist.
-    denylist_[failed_query_] = getUnixTime() + 86400;
+    // Several queries may have been executing on scheduler workers.
+    for (const auto& query : osquery::split(failed_query_, "\n")) {
+      LOG(WARNING) << "Scheduled query may have failed: " << query;
+      // Add this query name to the denylist.
+      denylist_[query] = getUnixTime() + 86400;
+    }
     saveScheduleDenylist(denylist_);
   }
 }
@@ -431,6 +535,32 @@ static inline bool denylistExpired(uint64_t blt, const ScheduledQuery& query) {
   return false;
 }
 
+/**
+ * @brief Update and return the denylisted state of a scheduled query.
+ *
+ * They query may have failed and been added to the schedule's denylist.
+ */
+static bool checkDenylist(std::map<std::string, uint64_t>& denylist,
+                          const std::string& name,
+                          ScheduledQuery& query) {
+  auto denylisted_query = denylist.find(name);
+  if (denylisted_query == denylist.end()) {
+    return false;
+  }
+
+  if (denylistExpired(denylisted_query->second, query)) {
+    // The denylisted query passed the expiration time (remove).
+    denylist.erase(denylisted_query);
+    saveScheduleDenylist(denylist);
+    query.denylisted = false;
+    return false;
+  }
+
+  // The query is still denylisted.
+  query.denylisted = true;
+  return true;
+}
+
 void Config::scheduledQueries(
     std::function<void(std::string name, const ScheduledQuery& query)>
         predicate,
@@ -445,22 +575,10 @@ void Config::scheduledQueries(
                FLAGS_pack_delimiter + it.first;
       }
 
-      // They query may have failed and been added to the schedule's denylist.
-      auto denylisted_query = schedule_->denylist_.find(name);
-      if (denylisted_query != schedule_->denylist_.end()) {
-        if (denylistExpired(denylisted_query->second, it.second)) {
-          // The denylisted query passed the expiration time (remove).
-          schedule_->denylist_.erase(denylisted_query);
-          saveScheduleDenylist(schedule_->denylist_);
-          it.second.denylisted = false;
-        } else {
-          // The query is still denylisted.
-          it.second.denylisted = true;
-          if (!denylisted) {
-            // The caller does not want denylisted queries.
-            continue;
-          }
-        }
+      if (checkDenylist(schedule_->denylist_, name, it.second) &&
+          !denylisted) {
+        // The caller does not want denylisted queries.
+        continue;
       }
 
       // Call the predicate.
@@ -469,6 +587,23 @@ void Config::scheduledQueries(
   }
 }
 
+void Config::dueQueries(
+    uint64_t time_step,
+    std::function<void(const std::string& name, const ScheduledQuery& query)>
+        predicate) const {
+  RecursiveLock lock(config_schedule_mutex_);
+  for (const auto* due : schedule_->due(time_step)) {
+    if (!due->pack->shouldPackExecute()) {
+      continue;
+    }
+
+    if (checkDenylist(schedule_->denylist_, due->name, *due->query)) {
+      continue;
+    }
+    predicate(due->name, *due->query);
+  }
+}
+
 void Config::packs(std::function<void(const Pack& pack)> predicate) const {
   RecursiveLock lock(config_schedule_mutex_);
   for (PackRef& pack : schedule_->packs_) {
@@ -935,7 +1070,8 @@ void Config::purge() {
   RecursiveLock lock(config_schedule_mutex_);
   // Iterate over each result set in the database.
   for (const auto& saved_query : saved_queries) {
-    if (queryExists(saved_query)) {
+    if (queryExists(saved_query) ||
+        boost::algorithm::starts_with(saved_query, kQueryMetadataPrefix)) {
       continue;
     }
 
@@ -964,6 +1100,7 @@ void Config::purge() {
       // Query has not run in the last week, expire results and interval.
       deleteDatabaseValue(kQueries, saved_query);
       deleteDatabaseValue(kQueries, saved_query + "epoch");
+      deleteDatabaseValue(kQueries, kQueryMetadataPrefix + saved_query);
       deleteDatabaseValue(kPersistentSettings, "interval." + saved_query);
       deleteDatabaseValue(kPersistentSettings, "timestamp." + saved_query);
       VLOG(1) << "Expiring results for scheduled query: " << saved_query;
@@ -976,6 +1113,7 @@ void Config::reset() {
 
   schedule_ = std::make_unique<Schedule>();
   std::map<std::string, QueryPerformance>().swap(performance_);
+  executing_queries_.clear();
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
   valid_ = false;
@@ -1012,8 +1150,8 @@ void ConfigParserPlugin::reset() {
 void Config::recordQueryPerformance(const std::string& name,
                                     uint64_t delay_ms,
                                     uint64_t size,
-                                    const Row& r0,
-                                    const Row& r1) {
+                                    const ProcessResourceUsage& r0,
+                                    const ProcessResourceUsage& r1) {
   RecursiveLock lock(config_performance_mutex_);
   if (performance_.count(name) == 0) {
     performance_[name] = QueryPerformance();
@@ -1021,36 +1159,24 @@ void Config::recordQueryPerformance(const std::string& name,
 
   // Grab access to the non-const schedule item.
   auto& query = performance_.at(name);
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time += diff;
-      query.last_user_time = diff;
-    }
+  if (r1.user_time > r0.user_time) {
+    auto diff = r1.user_time - r0.user_time;
+    query.user_time += diff;
+    query.last_user_time = diff;
   }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time += diff;
-      query.last_system_time = diff;
-    }
+  if (r1.system_time > r0.system_time) {
+    auto diff = r1.system_time - r0.system_time;
+    query.system_time += diff;
+    query.last_system_time = diff;
   }
 
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-      query.last_memory = diff;
-    }
+  if (r1.resident_size > r0.resident_size) {
+    auto diff = r1.resident_size - r0.resident_size;
+    // Memory is stored as an average of RSS changes between query executions.
+    query.average_memory = (query.average_memory * query.executions) + diff;
+    query.average_memory = (query.average_memory / (query.executions + 1));
+    query.last_memory = diff;
   }
 
   query.last_wall_time_ms = delay_ms;
@@ -1061,18 +1187,36 @@ void Config::recordQueryPerformance(const std::string& name,
   query.last_executed = getUnixTime();
 
   // Clear the executing query (remove the dirty bit).
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
-}
+  executing_queries_.erase(name);
+  if (kThreadExecutingQuery == name) {
+    kThreadExecutingQuery.clear();
+  }
 
-void Config::recordQueryStart(const std::string& name) {
-  // There should only ever be a single executing query in the schedule.
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, name);
   // Store the time this query name last executed for later results eviction.
   // When configuration updates occur the previous schedule is searched for
   // 'stale' query names, aka those that have week-old or longer last execute
   // timestamps. Offending queries have their database results purged.
+  setDatabaseBatch(
+      kPersistentSettings,
+      {{kExecutingQuery, join(executing_queries_, "\n")},
+       {"timestamp." + name, std::to_string(query.last_executed)}});
+}
+
+void Config::recordQueryStart(const std::string& name) {
+  RecursiveLock lock(config_performance_mutex_);
+  // A thread only executes a single query, a previous query started on this
+  // thread did not have its performance recorded.
+  if (!kThreadExecutingQuery.empty()) {
+    executing_queries_.erase(kThreadExecutingQuery);
+  }
+  kThreadExecutingQuery = name;
+  executing_queries_.insert(name);
   setDatabaseValue(
-      kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
+      kPersistentSettings, kExecutingQuery, join(executing_queries_, "\n"));
+}
+
+const std::string& Config::getExecutingQuery() {
+  return kThreadExecutingQuery;
 }
 
 void Config::getPerformanceStats(
@@ -12,6 +12,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <osquery/core/plugins/plugin.h>
@@ -30,8 +31,9 @@ class Pack;
 class Schedule;
 class ConfigParserPlugin;
 class ConfigRefreshRunner;
+struct ProcessResourceUsage;
 
-/// The name of the executing query within the single-threaded schedule.
+/// The names of the executing scheduled queries, separated by newlines.
 extern const std::string kExecutingQuery;
 
 /**
@@ -87,14 +89,14 @@ class Config : private boost::noncopyable {
    * @param name The unique name of the scheduled item
    * @param delay_ms Number of milliseconds (wall time) taken by the query
    * @param size Number of characters generated by query
-   * @param r0 the process row before the query
-   * @param r1 the process row after the query
+   * @param r0 the resources used before the query
+   * @param r1 the resources used after the query
    */
   void recordQueryPerformance(const std::string& name,
                               uint64_t delay_ms,
                               uint64_t size,
-                              const Row& r0,
-                              const Row& r1);
+                              const ProcessResourceUsage& r0,
+                              const ProcessResourceUsage& r1);
 
   /**
    * @brief Record a query 'initialization', meaning the query will run.
@@ -105,10 +107,26 @@ class Config : private boost::noncopyable {
    * store. On process start, or worker state, if any dirty bit is set then
    * it is assumed that the current start is a result of a previous abort.
    *
+   * Queries may be started from several scheduler worker threads, each
+   * thread has at most one executing query and the backing store lists all
+   * of them.
+   *
+   * Only the dirty status is written here, the query execution timestamp is
+   * written in the same batch as its removal.
+   *
    * @param name THe unique name of the scheduled item
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief The scheduled query started on the calling thread.
+   *
+   * This is set by Config::recordQueryStart and cleared when the query's
+   * performance is recorded. Threads not executing scheduled queries will
+   * receive an empty name.
+   */
+  static const std::string& getExecutingQuery();
+
   /**
    * @brief Calculate the hash of the osquery config
    *
@@ -186,6 +204,21 @@ class Config : private boost::noncopyable {
           predicate,
       bool denylisted = false) const;
 
+  /**
+   * @brief Map a function across the scheduled queries due at a time step
+   *
+   * A query is due when the step is a multiple of its splayed interval. This
+   * gives the same queries, in the same order, as filtering the not
+   * denylisted scheduledQueries, but only visits the due ones.
+   *
+   * @param time_step the scheduler step, in seconds since the epoch.
+   * @param predicate is called on each due query.
+   */
+  void dueQueries(
+      uint64_t time_step,
+      std::function<void(const std::string& name, const ScheduledQuery& query)>
+          predicate) const;
+
   /**
    * @brief Map a function across the set of configured files
    *
@@ -334,6 +367,9 @@ class Config : private boost::noncopyable {
   /// A set of performance stats for each query in the schedule.
   std::map<std::string, QueryPerformance> performance_;
 
+  /// The names of scheduled queries started but not yet recorded.
+  std::set<std::string> executing_queries_;
+
   /// A set of named categories filled with filesystem globbing paths.
   using FileCategories = std::map<std::string, std::vector<std::string>>;
   std::map<std::string, FileCategories> files_;
@@ -501,6 +501,44 @@ TEST_F(ConfigTests, test_get_scheduled_queries) {
   EXPECT_TRUE(denylisted);
 }
 
+TEST_F(ConfigTests, test_due_queries) {
+  get().addPack("unrestricted_pack", "", getUnrestrictedPack().doc());
+
+  auto expectSameQueries = [this](uint64_t step) {
+    std::vector<std::string> expected;
+    get().scheduledQueries(
+        ([&expected, step](std::string name, const ScheduledQuery& query) {
+          if (query.splayed_interval > 0 &&
+              step % query.splayed_interval == 0) {
+            expected.push_back(std::move(name));
+          }
+        }));
+
+    std::vector<std::string> due;
+    get().dueQueries(step,
+                     ([&due](const std::string& name, const ScheduledQuery&) {
+                       due.push_back(name);
+                     }));
+    EXPECT_EQ(due, expected) << "At step " << step;
+  };
+
+  // Steps may repeat, skip or go backward.
+  auto now = getUnixTime();
+  for (uint64_t step = now; step < now + 7200; step++) {
+    expectSameQueries(step);
+  }
+  expectSameQueries(now + 7199);
+  expectSameQueries(now + 86400);
+  expectSameQueries(now);
+
+  // The index follows the schedule changes.
+  get().removePack("unrestricted_pack");
+  size_t count = 0;
+  get().dueQueries(
+      0, ([&count](const std::string&, const ScheduledQuery&) { count++; }));
+  EXPECT_EQ(count, 0U);
+}
+
 TEST_F(ConfigTests, test_nondenylist_query) {
   std::map<std::string, uint64_t> denylist;
 
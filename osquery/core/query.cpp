@@ -8,6 +8,8 @@
  */
 
 #include <algorithm>
+#include <cstdio>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -16,6 +18,9 @@
 #include <osquery/core/query.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/castvariant.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 
 #include <osquery/utils/json/json.h>
 
@@ -32,27 +37,173 @@ FLAG(bool,
      "Use numeric JSON syntax for numeric values");
 FLAG_ALIAS(bool, log_numerics_as_numbers, logger_numerics);
 
-uint64_t Query::getPreviousEpoch() const {
-  uint64_t epoch = 0;
-  std::string raw;
-  auto status = getDatabaseValue(kQueries, name_ + "epoch", raw);
-  if (status.ok()) {
-    epoch = std::stoull(raw);
+const std::string kQueryMetadataPrefix = "meta.";
+
+namespace {
+
+/// The version of the query metadata record format.
+const std::string kQueryMetadataVersion = "1";
+
+const unsigned int kQueryMetadataHasResults = 0x01;
+const unsigned int kQueryMetadataHasQuery = 0x02;
+const unsigned int kQueryMetadataHasCounter = 0x04;
+const unsigned int kQueryMetadataHasFingerprint = 0x08;
+
+inline std::string hashToHex(const RowHash& hash) {
+  char hex[33] = {0};
+  snprintf(hex,
+           sizeof(hex),
+           "%016llx%016llx",
+           static_cast<unsigned long long>(hash.high),
+           static_cast<unsigned long long>(hash.low));
+  return hex;
+}
+
+inline bool hexToHash(const std::string& hex, RowHash& hash) {
+  if (hex.size() != 32) {
+    return false;
+  }
+
+  auto high = tryTo<unsigned long long>(hex.substr(0, 16), 16);
+  auto low = tryTo<unsigned long long>(hex.substr(16), 16);
+  if (high.isError() || low.isError()) {
+    return false;
   }
-  return epoch;
+  hash.high = high.take();
+  hash.low = low.take();
+  return true;
 }
 
-uint64_t Query::getQueryCounter(bool new_query) const {
-  uint64_t counter = 0;
-  if (new_query) {
-    return counter;
+inline RowHash hashQuery(const std::string& query) {
+  return hashEncodedRow(query.data(), query.size());
+}
+
+} // namespace
+
+std::string serializeQueryMetadata(const QueryMetadata& metadata) {
+  unsigned int flags = 0;
+  flags |= (metadata.has_results) ? kQueryMetadataHasResults : 0;
+  flags |= (metadata.has_query) ? kQueryMetadataHasQuery : 0;
+  flags |= (metadata.has_counter) ? kQueryMetadataHasCounter : 0;
+  flags |= (metadata.has_fingerprint) ? kQueryMetadataHasFingerprint : 0;
+
+  return kQueryMetadataVersion + ':' + hashToHex(metadata.query_hash) + ':' +
+         std::to_string(metadata.epoch) + ':' +
+         std::to_string(metadata.counter) + ':' +
+         hashToHex(metadata.fingerprint) + ':' + std::to_string(flags);
+}
+
+Status deserializeQueryMetadata(const std::string& data,
+                                QueryMetadata& metadata) {
+  auto fields = split(data, ":");
+  if (fields.size() != 6 || fields[0] != kQueryMetadataVersion) {
+    return Status(1, "Unknown query metadata format");
   }
 
-  std::string raw;
-  auto status = getDatabaseValue(kQueries, name_ + "counter", raw);
+  auto epoch = tryTo<unsigned long long>(fields[2]);
+  auto counter = tryTo<unsigned long long>(fields[3]);
+  auto flags = tryTo<unsigned int>(fields[5]);
+  if (epoch.isError() || counter.isError() || flags.isError() ||
+      !hexToHash(fields[1], metadata.query_hash) ||
+      !hexToHash(fields[4], metadata.fingerprint)) {
+    return Status(1, "Invalid query metadata");
+  }
+
+  metadata.epoch = epoch.take();
+  metadata.counter = counter.take();
+  auto bits = flags.take();
+  metadata.has_results = (bits & kQueryMetadataHasResults) != 0;
+  metadata.has_query = (bits & kQueryMetadataHasQuery) != 0;
+  metadata.has_counter = (bits & kQueryMetadataHasCounter) != 0;
+  metadata.has_fingerprint = (bits & kQueryMetadataHasFingerprint) != 0;
+  return Status::success();
+}
+
+QueryMetadata& Query::getMetadata() const {
+  if (metadata_loaded_) {
+    return metadata_;
+  }
+  metadata_loaded_ = true;
+
+  auto key = kQueryMetadataPrefix + name_;
+  auto status = getDatabaseValue(kQueries, key, metadata_record_);
   if (status.ok()) {
-    counter = std::stoull(raw) + 1;
+    status = deserializeQueryMetadata(metadata_record_, metadata_);
+    if (status.ok()) {
+      return metadata_;
+    }
+    LOG(WARNING) << "Ignoring invalid metadata for scheduled query: " << name_;
+    metadata_ = QueryMetadata();
+  }
+  metadata_record_.clear();
+
+  // Fall back to the separate keys written by previous versions.
+  std::string raw;
+  if (getDatabaseValue(kQueries, name_ + "epoch", raw).ok()) {
+    metadata_.epoch = tryTo<unsigned long long>(raw).takeOr(0ULL);
+    metadata_legacy_ = true;
+  }
+
+  if (getDatabaseValue(kQueries, name_ + "counter", raw).ok()) {
+    auto counter = tryTo<unsigned long long>(raw);
+    if (counter) {
+      metadata_.counter = counter.take();
+      metadata_.has_counter = true;
+    }
+    metadata_legacy_ = true;
+  }
+
+  if (getDatabaseValue(kQueries, "query." + name_, raw).ok()) {
+    metadata_.query_hash = hashQuery(raw);
+    metadata_.has_query = true;
+    metadata_legacy_ = true;
+  }
+  return metadata_;
+}
+
+Status Query::saveMetadata(DatabaseStringValueList data) const {
+  auto record = serializeQueryMetadata(getMetadata());
+  if (record != metadata_record_) {
+    data.emplace_back(kQueryMetadataPrefix + name_, record);
+  }
+
+  if (data.empty()) {
+    return Status::success();
   }
+
+  auto status = setDatabaseBatch(kQueries, data);
+  if (!status.ok()) {
+    return status;
+  }
+  metadata_record_ = std::move(record);
+
+  if (metadata_legacy_) {
+    // The record replaces the keys written by previous versions.
+    deleteDatabaseValue(kQueries, name_ + "epoch");
+    deleteDatabaseValue(kQueries, name_ + "counter");
+    deleteDatabaseValue(kQueries, "query." + name_);
+    metadata_legacy_ = false;
+  }
+  return Status::success();
+}
+
+uint64_t Query::getPreviousEpoch() const {
+  return getMetadata().epoch;
+}
+
+uint64_t Query::getQueryCounter(bool new_query) const {
+  const auto& metadata = getMetadata();
+  if (new_query || !metadata.has_counter) {
+    return 0;
+  }
+  return metadata.counter + 1;
+}
+
+uint64_t Query::nextCounter(bool reset) const {
+  auto counter = getQueryCounter(reset);
+  auto& metadata = getMetadata();
+  metadata.counter = counter;
+  metadata.has_counter = true;
   return counter;
 }
 
@@ -63,7 +214,12 @@ Status Query::getPreviousQueryResults(QueryDataSet& results) const {
     return status;
   }
 
-  status = deserializeQueryDataJSON(raw, results);
+  if (isIndexedResults(raw)) {
+    status = deserializeIndexedResults(raw, results);
+  } else {
+    // Results stored as a JSON array by a previous version.
+    status = deserializeQueryDataJSON(raw, results);
+  }
   if (!status.ok()) {
     return status;
   }
@@ -77,44 +233,48 @@ std::vector<std::string> Query::getStoredQueryNames() {
 }
 
 bool Query::isQueryNameInDatabase() const {
-  auto names = Query::getStoredQueryNames();
-  return std::find(names.begin(), names.end(), name_) != names.end();
-}
-
-static inline void saveQuery(const std::string& name,
-                             const std::string& query) {
-  setDatabaseValue(kQueries, "query." + name, query);
+  auto& metadata = getMetadata();
+  if (!metadata.has_results) {
+    // Results may be stored without a metadata record by a previous version.
+    std::string raw;
+    metadata.has_results = getDatabaseValue(kQueries, name_, raw).ok();
+  }
+  return metadata.has_results;
 }
 
 bool Query::isNewQuery() const {
-  std::string query;
-  getDatabaseValue(kQueries, "query." + name_, query);
-  return (query != query_);
+  const auto& metadata = getMetadata();
+  return !metadata.has_query || metadata.query_hash != hashQuery(query_);
 }
 
 void Query::getQueryStatus(uint64_t epoch,
                            bool& fresh_results,
                            bool& new_query) const {
+  auto& metadata = getMetadata();
   if (!isQueryNameInDatabase()) {
     // This is the first encounter of the scheduled query.
     fresh_results = true;
     new_query = true;
     LOG(INFO) << "Storing initial results for new scheduled query: " << name_;
-    saveQuery(name_, query_);
-  } else if (getPreviousEpoch() != epoch) {
+  } else if (metadata.epoch != epoch) {
     fresh_results = true;
     LOG(INFO) << "New Epoch " << epoch << " for scheduled query " << name_;
   } else if (isNewQuery()) {
     // This query is 'new' in that the previous results may be invalid.
     new_query = true;
     LOG(INFO) << "Scheduled query has been updated: " + name_;
-    saveQuery(name_, query_);
+  }
+
+  // The query text is saved with the next metadata write.
+  if (new_query) {
+    metadata.query_hash = hashQuery(query_);
+    metadata.has_query = true;
   }
 }
 
 Status Query::incrementCounter(bool reset, uint64_t& counter) const {
-  counter = getQueryCounter(reset);
-  return setDatabaseValue(kQueries, name_ + "counter", std::to_string(counter));
+  counter = nextCounter(reset);
+  return saveMetadata({});
 }
 
 Status Query::addNewEvents(QueryDataTyped current_qd,
@@ -124,20 +284,19 @@ Status Query::addNewEvents(QueryDataTyped current_qd,
   bool fresh_results = false;
   bool new_query = false;
   getQueryStatus(current_epoch, fresh_results, new_query);
+
+  DatabaseStringValueList data;
   if (fresh_results) {
-    auto status = setDatabaseValue(kQueries, name_, "[]");
-    if (!status.ok()) {
-      return status;
-    }
+    data.emplace_back(name_, "[]");
+    auto& metadata = getMetadata();
+    metadata.has_results = true;
+    metadata.has_fingerprint = false;
   }
   dr.added = std::move(current_qd);
   if (!dr.added.empty()) {
-    auto status = incrementCounter(fresh_results || new_query, counter);
-    if (!status.ok()) {
-      return status;
-    }
+    counter = nextCounter(fresh_results || new_query);
   }
-  return Status::success();
+  return saveMetadata(std::move(data));
 }
 
 Status Query::addNewResults(QueryDataTyped qd,
@@ -156,56 +315,68 @@ Status Query::addNewResults(QueryDataTyped current_qd,
   bool fresh_results = !calculate_diff;
   bool new_query = false;
   getQueryStatus(current_epoch, fresh_results, new_query);
+  auto& metadata = getMetadata();
+
+  // Encode the results once for the fingerprint, differential and storage.
+  IndexedResults current(current_qd);
+  auto fingerprint = current.fingerprint();
 
-  // Use a 'target' avoid copying the query data when serializing and saving.
-  // If a differential is requested and needed the target remains the original
-  // query data, otherwise the content is moved to the differential's added set.
-  const auto* target_gd = &current_qd;
   bool update_db = true;
   if (!fresh_results && calculate_diff) {
-    // Get the rows from the last run of this query name.
-    QueryDataSet previous_qd;
-    auto status = getPreviousQueryResults(previous_qd);
-    if (!status.ok()) {
-      return status;
-    }
+    if (metadata.has_fingerprint && metadata.fingerprint == fingerprint) {
+      // The stored results are the same rows, there is no differential.
+      update_db = false;
+    } else {
+      // Get the rows from the last run of this query name.
+      std::string previous;
+      auto status = getDatabaseValue(kQueries, name_, previous);
+      if (!status.ok()) {
+        return status;
+      }
 
-    // Calculate the differential between previous and current query results.
-    dr = diff(previous_qd, current_qd);
+      // Calculate the differential between previous and current results.
+      if (isIndexedResults(previous)) {
+        // Only removed rows are decoded.
+        status = current.diff(previous, current_qd, dr);
+      } else {
+        // Results stored as a JSON array by a previous version.
+        QueryDataSet previous_qd;
+        status = deserializeQueryDataJSON(previous, previous_qd);
+        if (status.ok()) {
+          dr = diff(previous_qd, current_qd);
+        }
+      }
+      if (!status.ok()) {
+        return status;
+      }
 
-    update_db = (!dr.added.empty() || !dr.removed.empty());
+      update_db = (!dr.added.empty() || !dr.removed.empty());
+    }
   } else {
     dr.added = std::move(current_qd);
-    target_gd = &dr.added;
   }
 
+  DatabaseStringValueList data;
   if (update_db) {
     // Replace the "previous" query data with the current.
-    std::string json;
-    auto status = serializeQueryDataJSON(*target_gd, json, true);
-    if (!status.ok()) {
-      return status;
-    }
-
-    status = setDatabaseValue(kQueries, name_, json);
-    if (!status.ok()) {
-      return status;
-    }
-
-    status = setDatabaseValue(
-        kQueries, name_ + "epoch", std::to_string(current_epoch));
+    std::string current_index;
+    auto status = current.serialize(current_index);
     if (!status.ok()) {
       return status;
     }
+    data.emplace_back(name_, std::move(current_index));
+    metadata.epoch = current_epoch;
+    metadata.has_results = true;
   }
 
+  // Unchanged results from a previous version gain a fingerprint.
+  metadata.fingerprint = fingerprint;
+  metadata.has_fingerprint = true;
+
   if (update_db || fresh_results || new_query) {
-    auto status = incrementCounter(fresh_results || new_query, counter);
-    if (!status.ok()) {
-      return status;
-    }
+    counter = nextCounter(fresh_results || new_query);
   }
-  return Status::success();
+  return saveMetadata(std::move(data));
 }
 
 Status deserializeDiffResults(const rj::Value& doc, DiffResults& dr) {
@@ -346,32 +517,225 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& doc) {
   return Status::success();
 }
 
+namespace {
+
+/// A rapidjson output stream appending to a reusable string.
+class StringOutputStream {
+ public:
+  using Ch = char;
+
+  explicit StringOutputStream(std::string& output) : output_(output) {}
+
+  void Put(char c) {
+    output_.push_back(c);
+  }
+
+  void Flush() {}
+
+ private:
+  std::string& output_;
+};
+
+using LogItemWriter = rj::Writer<StringOutputStream>;
+
+/// Members written after the legacy fields and decorations of an event.
+const std::set<std::string> kEventMembers = {"columns", "action"};
+
+inline void writeString(LogItemWriter& writer, const std::string& value) {
+  writer.String(value.data(), static_cast<rj::SizeType>(value.size()));
+}
+
+inline void writeKey(LogItemWriter& writer, const std::string& key) {
+  writer.Key(key.data(), static_cast<rj::SizeType>(key.size()));
+}
+
+/// Write the columns of a row, in the order used by serializeRow.
+void writeRow(LogItemWriter& writer, const RowTyped& row, bool numerics) {
+  writer.StartObject();
+  for (const auto& column : row) {
+    writeKey(writer, column.first);
+    if (!numerics) {
+      writeString(writer, castVariant(column.second));
+    } else if (auto value = boost::get<long long>(&column.second)) {
+      writer.Int64(*value);
+    } else if (auto value = boost::get<double>(&column.second)) {
+      writer.Double(*value);
+    } else {
+      writeString(writer, boost::get<std::string>(column.second));
+    }
+  }
+  writer.EndObject();
+}
+
+void writeRows(LogItemWriter& writer,
+               const QueryDataTyped& rows,
+               bool numerics) {
+  writer.StartArray();
+  for (const auto& row : rows) {
+    writeRow(writer, row, numerics);
+  }
+  writer.EndArray();
+}
+
+/// Top-level decorations replace the log item members of the same name.
+inline bool isTopLevelDecoration(const QueryLogItem& item,
+                                 const std::string& key) {
+  return FLAGS_decorations_top_level && item.decorations.count(key) > 0;
+}
+
+/**
+ * @brief Write the legacy fields and decorations of a log item.
+ *
+ * This is the streaming equivalent of addLegacyFieldsAndDecorations, the
+ * decorations named by later_members are skipped since the members written
+ * after them replace them.
+ */
+void writeLegacyFieldsAndDecorations(
+    LogItemWriter& writer,
+    const QueryLogItem& item,
+    const std::set<std::string>& later_members) {
+  auto key = [&writer, &item](const std::string& name) {
+    if (isTopLevelDecoration(item, name)) {
+      return false;
+    }
+    writeKey(writer, name);
+    return true;
+  };
+
+  if (key("name")) {
+    writeString(writer, item.name);
+  }
+  if (key("hostIdentifier")) {
+    writeString(writer, item.identifier);
+  }
+  if (key("calendarTime")) {
+    writeString(writer, item.calendar_time);
+  }
+  if (key("unixTime")) {
+    writer.Uint64(item.time);
+  }
+  if (key("epoch")) {
+    writer.Uint64(item.epoch);
+  }
+  if (key("counter")) {
+    writer.Uint64(item.counter);
+  }
+  if (key("numerics")) {
+    writer.Bool(FLAGS_logger_numerics);
+  }
+
+  if (item.decorations.empty()) {
+    return;
+  }
+
+  if (!FLAGS_decorations_top_level) {
+    writer.Key("decorations");
+    writer.StartObject();
+  }
+  for (const auto& decoration : item.decorations) {
+    if (FLAGS_decorations_top_level &&
+        later_members.count(decoration.first) > 0) {
+      continue;
+    }
+    writeKey(writer, decoration.first);
+    writeString(writer, decoration.second);
+  }
+  if (!FLAGS_decorations_top_level) {
+    writer.EndObject();
+  }
+}
+
+} // namespace
+
 Status serializeQueryLogItemJSON(const QueryLogItem& item, std::string& json) {
-  auto doc = JSON::newObject();
-  auto status = serializeQueryLogItem(item, doc);
-  if (!status.ok()) {
-    return status;
+  json.clear();
+  StringOutputStream stream(json);
+  LogItemWriter writer(stream);
+
+  // Rows are written directly, in the member order of serializeQueryLogItem.
+  writer.StartObject();
+  if (item.results.added.size() > 0 || item.results.removed.size() > 0) {
+    if (!isTopLevelDecoration(item, "diffResults")) {
+      writer.Key("diffResults");
+      writer.StartObject();
+      writer.Key("removed");
+      writeRows(writer, item.results.removed, FLAGS_logger_numerics);
+      writer.Key("added");
+      writeRows(writer, item.results.added, FLAGS_logger_numerics);
+      writer.EndObject();
+    }
+  } else {
+    if (!isTopLevelDecoration(item, "snapshot")) {
+      writer.Key("snapshot");
+      writeRows(writer, item.snapshot_results, FLAGS_logger_numerics);
+    }
+    if (!isTopLevelDecoration(item, "action")) {
+      writer.Key("action");
+      writer.String("snapshot");
+    }
   }
 
-  return doc.toString(json);
+  writeLegacyFieldsAndDecorations(writer, item, {});
+  writer.EndObject();
+  return Status::success();
 }
 
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& item,
-                                         std::vector<std::string>& items) {
-  auto doc = JSON::newArray();
-  auto status = serializeQueryLogItemAsEvents(item, doc);
-  if (!status.ok()) {
-    return status;
+                                         const QueryLogEventVisitor& visitor) {
+  std::vector<std::pair<std::string, const QueryDataTyped*>> actions;
+  if (!item.results.added.empty() || !item.results.removed.empty()) {
+    actions.emplace_back("removed", &item.results.removed);
+    actions.emplace_back("added", &item.results.added);
+  } else if (!item.snapshot_results.empty()) {
+    actions.emplace_back("snapshot", &item.snapshot_results);
+  } else {
+    // This error case may also be represented in serializeQueryLogItem.
+    return Status(1, "No differential or snapshot results");
   }
 
-  // return doc.toString()
-  for (auto& event : doc.doc().GetArray()) {
-    rj::StringBuffer sb;
-    rj::Writer<rj::StringBuffer> writer(sb);
-    event.Accept(writer);
-    items.push_back(sb.GetString());
+  // Every event starts with the same members, they are rendered once.
+  std::string header;
+  {
+    StringOutputStream stream(header);
+    LogItemWriter writer(stream);
+    writer.StartObject();
+    writeLegacyFieldsAndDecorations(writer, item, kEventMembers);
+    writer.EndObject();
+  }
+  header.pop_back();
+  if (header.size() > 1) {
+    header.push_back(',');
+  }
+  header += "\"columns\":";
+
+  std::string event;
+  StringOutputStream stream(event);
+  LogItemWriter writer(stream);
+  for (const auto& action : actions) {
+    for (const auto& row : *action.second) {
+      event.assign(header);
+      writer.Reset(stream);
+      writeRow(writer, row, FLAGS_logger_numerics);
+      event += ",\"action\":\"";
+      event += action.first;
+      event += "\"}";
+
+      auto status = visitor(event);
+      if (!status.ok()) {
+        return status;
+      }
+    }
   }
   return Status::success();
 }
 
+Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& item,
+                                         std::vector<std::string>& items) {
+  return serializeQueryLogItemAsEventsJSON(
+      item, [&items](const std::string& event) {
+        items.push_back(event);
+        return Status::success();
+      });
+}
+
 } // namespace osquery
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -20,6 +21,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/sql/diff_results.h>
 #include <osquery/core/sql/scheduled_query.h>
+#include <osquery/database/database.h>
 #include <osquery/utils/json/json.h>
 
 namespace osquery {
@@ -86,6 +88,8 @@ Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc);
 /**
  * @brief Serialize a QueryLogItem object into a JSON string.
  *
+ * The rows are written directly into the string, without a JSON document.
+ *
  * @param item the QueryLogItem to serialize.
  * @param json [output] the output JSON string.
  *
@@ -116,6 +120,67 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& json);
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& i,
                                          std::vector<std::string>& items);
 
+/// Receives each serialized event of a QueryLogItem.
+using QueryLogEventVisitor = std::function<Status(const std::string& event)>;
+
+/**
+ * @brief Serialize a QueryLogItem object into JSON events, one at a time.
+ *
+ * Rows are written directly into a buffer that is reused for every event,
+ * the members shared by the events of the item are rendered once. The buffer
+ * passed to the visitor is overwritten by the next event.
+ *
+ * @param i the QueryLogItem to serialize
+ * @param visitor called with each event, an error stops the serialization
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& i,
+                                         const QueryLogEventVisitor& visitor);
+
+/// Database key prefix of the scheduled query metadata records.
+extern const std::string kQueryMetadataPrefix;
+
+/**
+ * @brief The state of a scheduled query kept between executions.
+ *
+ * Each scheduled query stores its metadata as a single kQueries value next to
+ * its results. The record replaces the separate epoch, counter and query text
+ * values so an execution reads one record and writes it with the results.
+ */
+struct QueryMetadata {
+  /// Hash of the query text the results were generated with.
+  RowHash query_hash;
+
+  /// The epoch associated with the stored results.
+  uint64_t epoch{0};
+
+  /// Query execution counter for the current epoch.
+  uint64_t counter{0};
+
+  /// Fingerprint of the stored results, see IndexedResults::fingerprint.
+  RowHash fingerprint;
+
+  /// Results are stored for the query.
+  bool has_results{false};
+
+  /// The query hash is set.
+  bool has_query{false};
+
+  /// The counter is set.
+  bool has_counter{false};
+
+  /// The fingerprint is set, it is unknown for results from older versions.
+  bool has_fingerprint{false};
+};
+
+/// Serialize query metadata into the stored record format.
+std::string serializeQueryMetadata(const QueryMetadata& metadata);
+
+/// Parse a stored query metadata record.
+Status deserializeQueryMetadata(const std::string& data,
+                                QueryMetadata& metadata);
+
 /**
  * @brief Interact with the historical on-disk storage for a given query.
  */
@@ -255,6 +320,25 @@ class Query {
    */
   static std::vector<std::string> getStoredQueryNames();
 
+ private:
+  /**
+   * @brief Access the metadata for this query.
+   *
+   * The record is read once per Query instance. Queries stored by a previous
+   * version are read from their separate epoch, counter and query text keys.
+   */
+  QueryMetadata& getMetadata() const;
+
+  /// Compute the next execution counter and record it in the metadata.
+  uint64_t nextCounter(bool reset) const;
+
+  /**
+   * @brief Write the metadata, and optional values, in one database batch.
+   *
+   * The metadata is only written if it changed since it was read.
+   */
+  Status saveMetadata(DatabaseStringValueList data) const;
+
  private:
   /// The scheduled query's query string.
   std::string query_;
@@ -262,6 +346,18 @@ class Query {
   /// The scheduled query name.
   std::string name_;
 
+  /// The metadata for this query, read on first use.
+  mutable QueryMetadata metadata_;
+
+  /// The stored metadata record, used to skip writing an unchanged record.
+  mutable std::string metadata_record_;
+
+  /// The metadata has been read.
+  mutable bool metadata_loaded_{false};
+
+  /// The metadata was read from the keys written by a previous version.
+  mutable bool metadata_legacy_{false};
+
  private:
   FRIEND_TEST(QueryTests, test_private_members);
   FRIEND_TEST(QueryTests, test_add_and_get_current_results);
@@ -270,6 +366,7 @@ class Query {
   FRIEND_TEST(QueryTests, test_get_executions);
   FRIEND_TEST(QueryTests, test_get_query_results);
   FRIEND_TEST(QueryTests, test_query_name_not_found_in_db);
+  FRIEND_TEST(QueryTests, test_legacy_query_metadata);
 };
 
 } // namespace osquery
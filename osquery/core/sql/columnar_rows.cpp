@@ -0,0 +1,347 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <type_traits>
+
+#include "columnar_rows.h"
+#include <osquery/utils/conversions/castvariant.h>
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+namespace {
+
+inline bool isNumericType(ColumnType type) {
+  return type == INTEGER_TYPE || type == BIGINT_TYPE ||
+         type == UNSIGNED_BIGINT_TYPE;
+}
+
+} // namespace
+
+ColumnarRows::ColumnarRows(const TableColumns& columns) {
+  columns_.reserve(columns.size());
+  for (const auto& column : columns) {
+    Column c;
+    c.name = std::get<0>(column);
+    c.type = std::get<1>(column);
+    columns_.push_back(std::move(c));
+  }
+
+  sorted_.resize(columns_.size());
+  for (size_t i = 0; i < sorted_.size(); i++) {
+    sorted_[i] = i;
+  }
+  std::sort(sorted_.begin(), sorted_.end(), [this](size_t a, size_t b) {
+    return columns_[a].name < columns_[b].name;
+  });
+}
+
+size_t ColumnarRows::columnIndex(const std::string& name) const {
+  for (size_t i = 0; i < columns_.size(); i++) {
+    if (columns_[i].name == name) {
+      return i;
+    }
+  }
+  return columns_.size();
+}
+
+void ColumnarRows::reserve(size_t rows) {
+  for (auto& column : columns_) {
+    if (column.type == DOUBLE_TYPE) {
+      column.doubles.reserve(rows);
+    } else {
+      column.integers.reserve(rows);
+    }
+    column.nulls.reserve(rows);
+  }
+}
+
+size_t ColumnarRows::append() {
+  for (auto& column : columns_) {
+    if (column.type == DOUBLE_TYPE) {
+      column.doubles.push_back(0);
+    } else {
+      column.integers.push_back(0);
+    }
+    column.nulls.push_back(true);
+  }
+  return rows_++;
+}
+
+void ColumnarRows::setInteger(size_t col, long long value) {
+  auto& column = columns_[col];
+  if (column.type == DOUBLE_TYPE) {
+    column.doubles.back() = static_cast<double>(value);
+  } else if (isNumericType(column.type)) {
+    column.integers.back() = value;
+  } else {
+    column.integers.back() = intern(std::to_string(value));
+  }
+  setNotNull(column);
+}
+
+void ColumnarRows::setUnsigned(size_t col, unsigned long long value) {
+  auto& column = columns_[col];
+  if (column.type == DOUBLE_TYPE) {
+    column.doubles.back() = static_cast<double>(value);
+  } else if (isNumericType(column.type)) {
+    // SQLite has no unsigned storage, keep the bits as the typed rows do.
+    column.integers.back() = static_cast<long long>(value);
+  } else {
+    column.integers.back() = intern(std::to_string(value));
+  }
+  setNotNull(column);
+}
+
+void ColumnarRows::setDouble(size_t col, double value) {
+  auto& column = columns_[col];
+  if (column.type == DOUBLE_TYPE) {
+    column.doubles.back() = value;
+  } else if (isNumericType(column.type)) {
+    column.integers.back() = static_cast<long long>(value);
+  } else {
+    column.integers.back() = intern(std::to_string(value));
+  }
+  setNotNull(column);
+}
+
+void ColumnarRows::setText(size_t col, const std::string& value) {
+  auto& column = columns_[col];
+  if (column.type == DOUBLE_TYPE || isNumericType(column.type)) {
+    setString(col, value);
+    return;
+  }
+  column.integers.back() = intern(value);
+  setNotNull(column);
+}
+
+void ColumnarRows::setString(size_t col, const std::string& value) {
+  auto& column = columns_[col];
+  if (!isNumericType(column.type) && column.type != DOUBLE_TYPE) {
+    setText(col, value);
+    return;
+  }
+
+  auto parsed = [&value](const char* end) {
+    return errno == 0 && end != nullptr && end != value.c_str() &&
+           *end == '\0';
+  };
+
+  char* end = nullptr;
+  errno = 0;
+  if (value.empty()) {
+    // Nothing to parse, the empty text is kept.
+  } else if (column.type == DOUBLE_TYPE) {
+    auto afinite = std::strtod(value.c_str(), &end);
+    if (parsed(end)) {
+      setDouble(col, afinite);
+      return;
+    }
+  } else if (column.type == UNSIGNED_BIGINT_TYPE) {
+    // strtoull would silently negate a leading minus sign.
+    if (value.find('-') == std::string::npos) {
+      auto afinite = std::strtoull(value.c_str(), &end, 10);
+      if (parsed(end)) {
+        setUnsigned(col, afinite);
+        return;
+      }
+    }
+  } else {
+    auto afinite = std::strtoll(value.c_str(), &end, 10);
+    if (parsed(end)) {
+      setInteger(col, afinite);
+      return;
+    }
+  }
+
+  // The cell stays NULL to SQLite, serialization emits the original text.
+  column.nulls.back() = true;
+  column.unparsed[rows_ - 1] = value;
+}
+
+void ColumnarRows::setNotNull(Column& column) {
+  column.nulls.back() = false;
+  if (!column.unparsed.empty()) {
+    column.unparsed.erase(rows_ - 1);
+  }
+}
+
+long long ColumnarRows::intern(const std::string& value) {
+  auto it = string_ids_.find(value);
+  if (it != string_ids_.end()) {
+    return it->second;
+  }
+
+  auto id = static_cast<long long>(pool_.size());
+  pool_.push_back(value);
+  string_ids_.emplace(pool_.back(), id);
+  return id;
+}
+
+const std::string* ColumnarRows::findUnparsed(size_t row, size_t col) const {
+  const auto& unparsed = columns_[col].unparsed;
+  if (unparsed.empty()) {
+    return nullptr;
+  }
+
+  auto it = unparsed.find(row);
+  return (it == unparsed.end()) ? nullptr : &it->second;
+}
+
+std::string ColumnarRows::getString(size_t row, size_t col) const {
+  const auto& column = columns_[col];
+  if (column.nulls[row]) {
+    const auto* unparsed = findUnparsed(row, col);
+    return (unparsed == nullptr) ? "" : *unparsed;
+  }
+
+  if (column.type == DOUBLE_TYPE) {
+    return std::to_string(column.doubles[row]);
+  } else if (column.type == UNSIGNED_BIGINT_TYPE) {
+    return std::to_string(
+        static_cast<unsigned long long>(column.integers[row]));
+  } else if (isNumericType(column.type)) {
+    return std::to_string(column.integers[row]);
+  }
+  return getText(row, col);
+}
+
+int ColumnarRows::result(sqlite3_context* ctx, size_t row, size_t col) const {
+  if (row >= rows_ || col >= columns_.size()) {
+    return SQLITE_ERROR;
+  }
+
+  const auto& column = columns_[col];
+  if (column.nulls[row]) {
+    sqlite3_result_null(ctx);
+    return SQLITE_OK;
+  }
+
+  switch (column.type) {
+  case INTEGER_TYPE:
+    sqlite3_result_int(ctx, static_cast<int>(column.integers[row]));
+    break;
+  case BIGINT_TYPE:
+  case UNSIGNED_BIGINT_TYPE:
+    sqlite3_result_int64(ctx, column.integers[row]);
+    break;
+  case DOUBLE_TYPE:
+    sqlite3_result_double(ctx, column.doubles[row]);
+    break;
+  default: {
+    const auto& value = getText(row, col);
+    sqlite3_result_text(ctx,
+                        value.c_str(),
+                        static_cast<int>(value.size()),
+                        transient_ ? SQLITE_TRANSIENT : SQLITE_STATIC);
+    break;
+  }
+  }
+  return SQLITE_OK;
+}
+
+Status ColumnarRows::serialize(size_t row,
+                               JSON& doc,
+                               rj::Value& obj) const {
+  for (size_t col = 0; col < columns_.size(); col++) {
+    const auto& column = columns_[col];
+    if (column.nulls[row]) {
+      const auto* unparsed = findUnparsed(row, col);
+      if (unparsed != nullptr) {
+        doc.addRef(column.name, *unparsed, obj);
+      }
+      continue;
+    }
+
+    if (column.type == DOUBLE_TYPE || isNumericType(column.type)) {
+      doc.addCopy(column.name, getString(row, col), obj);
+    } else {
+      doc.addRef(column.name, getText(row, col), obj);
+    }
+  }
+  return Status::success();
+}
+
+Row ColumnarRows::toRow(size_t row) const {
+  Row r;
+  for (size_t col = 0; col < columns_.size(); col++) {
+    if (!columns_[col].nulls[row] || findUnparsed(row, col) != nullptr) {
+      r[columns_[col].name] = getString(row, col);
+    }
+  }
+  return r;
+}
+
+template <typename Visitor>
+void ColumnarRows::visitTyped(size_t row, Visitor visitor) const {
+  for (auto col : sorted_) {
+    const auto& column = columns_[col];
+    if (column.nulls[row]) {
+      const auto* unparsed = findUnparsed(row, col);
+      if (unparsed != nullptr) {
+        visitor(column.name, *unparsed);
+      }
+    } else if (column.type == DOUBLE_TYPE) {
+      visitor(column.name, column.doubles[row]);
+    } else if (isNumericType(column.type)) {
+      visitor(column.name, column.integers[row]);
+    } else {
+      visitor(column.name, getText(row, col));
+    }
+  }
+}
+
+RowTyped ColumnarRows::toRowTyped(size_t row) const {
+  RowTyped r;
+  visitTyped(row, [&r](const std::string& name, const auto& value) {
+    r.emplace_hint(r.end(), name, value);
+  });
+  return r;
+}
+
+Status ColumnarRows::serializeTyped(size_t row,
+                                    JSON& doc,
+                                    rj::Value& obj,
+                                    bool asNumeric) const {
+  visitTyped(row,
+             [&doc, &obj, asNumeric](const std::string& name,
+                                     const auto& value) {
+               using Value = std::decay_t<decltype(value)>;
+               if (asNumeric) {
+                 doc.add(name, value, obj);
+               } else if constexpr (std::is_same_v<Value, std::string>) {
+                 doc.addRef(name, value, obj);
+               } else {
+                 doc.addCopy(name, castVariant(value), obj);
+               }
+             });
+  return Status::success();
+}
+
+void ColumnarRows::encode(size_t row,
+                          std::string& out,
+                          RowColumnDictionary* columns) const {
+  size_t count = 0;
+  for (size_t col = 0; col < columns_.size(); col++) {
+    if (!columns_[col].nulls[row] || findUnparsed(row, col) != nullptr) {
+      count++;
+    }
+  }
+
+  RowEncoder encoder(out, count, columns);
+  visitTyped(row, [&encoder](const std::string& name, const auto& value) {
+    encoder.add(name, value);
+  });
+}
+
+} // namespace osquery
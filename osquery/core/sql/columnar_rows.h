@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include <osquery/utils/json/json.h>
+#include <osquery/utils/status/status.h>
+
+#include "column.h"
+#include "row.h"
+
+namespace osquery {
+
+/**
+ * @brief A column-oriented batch of table rows.
+ *
+ * Tables that produce many rows may append them into a ColumnarRows batch
+ * instead of building one string map per row. Each column is stored as a
+ * vector of its SQLite affinity's native type together with a null bitmap,
+ * and TEXT/BLOB values are interned into a string pool owned by the batch.
+ *
+ * Values are read back without re-parsing: `result` calls the matching
+ * sqlite3_result_* function and `serialize`/`toRow` render the row in the
+ * same string representation a DynamicTableRow would have.
+ *
+ * Rows are appended with `append` and every column starts as NULL. The
+ * typed setters assign a value to the most recently appended row.
+ */
+class ColumnarRows {
+ public:
+  /// Create an empty batch with the given table column layout.
+  explicit ColumnarRows(const TableColumns& columns);
+
+  virtual ~ColumnarRows() = default;
+
+  ColumnarRows(const ColumnarRows&) = delete;
+  ColumnarRows& operator=(const ColumnarRows&) = delete;
+
+  /// Number of rows appended to the batch.
+  size_t size() const {
+    return rows_;
+  }
+
+  /// Number of columns in the batch layout.
+  size_t columnCount() const {
+    return columns_.size();
+  }
+
+  /// Column name at the given position in the layout.
+  const std::string& columnName(size_t col) const {
+    return columns_[col].name;
+  }
+
+  /// Column affinity at the given position in the layout.
+  ColumnType columnType(size_t col) const {
+    return columns_[col].type;
+  }
+
+  /// Position of a column name in the layout, or columnCount() if missing.
+  size_t columnIndex(const std::string& name) const;
+
+  /// Reserve storage for an expected number of rows.
+  void reserve(size_t rows);
+
+  /**
+   * @brief Hand TEXT values to SQLite as copies, the default.
+   *
+   * A batch yielded row by row from a table generator may be released while
+   * the statement still holds values read from it. Only a batch known to
+   * outlive every statement step that reads it may disable the copies.
+   */
+  void setTransient(bool transient) {
+    transient_ = transient;
+  }
+
+  /// Append a new row with every column set to NULL, return its index.
+  size_t append();
+
+  /// Set an INTEGER, BIGINT or UNSIGNED_BIGINT column of the last row.
+  void setInteger(size_t col, long long value);
+
+  /// Set an UNSIGNED_BIGINT column of the last row.
+  void setUnsigned(size_t col, unsigned long long value);
+
+  /// Set a DOUBLE column of the last row.
+  void setDouble(size_t col, double value);
+
+  /// Set a TEXT or BLOB column of the last row, the value is interned.
+  void setText(size_t col, const std::string& value);
+
+  /**
+   * @brief Set a column of the last row from its string representation.
+   *
+   * This is a migration helper for code that already holds string values.
+   * Numeric columns are parsed once here as base 10. Empty or malformed
+   * numeric values are NULL to SQLite but keep their text for serialization,
+   * matching the DynamicTableRow casting behavior.
+   */
+  void setString(size_t col, const std::string& value);
+
+  /// Check if a row's column is NULL.
+  bool isNull(size_t row, size_t col) const {
+    return columns_[col].nulls[row];
+  }
+
+  /// Read a numeric column (INTEGER, BIGINT, UNSIGNED_BIGINT) value.
+  long long getInteger(size_t row, size_t col) const {
+    return columns_[col].integers[row];
+  }
+
+  /// Read a DOUBLE column value.
+  double getDouble(size_t row, size_t col) const {
+    return columns_[col].doubles[row];
+  }
+
+  /// Read a TEXT or BLOB column value.
+  const std::string& getText(size_t row, size_t col) const {
+    return pool_[static_cast<size_t>(columns_[col].integers[row])];
+  }
+
+  /// Render a row's column as the string a Row would contain, "" if absent.
+  std::string getString(size_t row, size_t col) const;
+
+  /**
+   * @brief Invoke the appropriate sqlite3_result_xxx method for a cell.
+   *
+   * TEXT values are copied by SQLite, unless transient copies were disabled
+   * and the batch outlives the statement step that reads them.
+   */
+  int result(sqlite3_context* ctx, size_t row, size_t col) const;
+
+  /// Serialize a row as key, value pairs into the given JSON object.
+  Status serialize(size_t row, JSON& doc, rapidjson::Value& obj) const;
+
+  /// Convert a row to a string map, unset columns are omitted.
+  Row toRow(size_t row) const;
+
+  /// Convert a row to the RowTyped of a query result, see toRow.
+  RowTyped toRowTyped(size_t row) const;
+
+  /**
+   * @brief Serialize a row the way serializeRow serializes its RowTyped.
+   *
+   * Columns are added in name order, numeric values are added as numbers
+   * only if asNumeric is set.
+   */
+  Status serializeTyped(size_t row,
+                        JSON& doc,
+                        rapidjson::Value& obj,
+                        bool asNumeric) const;
+
+  /**
+   * @brief Append the encoding encodeRow writes for the row's RowTyped.
+   *
+   * @param row the row to encode.
+   * @param out [output] the string the encoding is appended to.
+   * @param columns the dictionary naming columns by index, or nullptr.
+   */
+  void encode(size_t row,
+              std::string& out,
+              RowColumnDictionary* columns = nullptr) const;
+
+  /// Number of distinct TEXT values held by the string pool.
+  size_t internedCount() const {
+    return pool_.size();
+  }
+
+ private:
+  struct Column {
+    std::string name;
+    ColumnType type{UNKNOWN_TYPE};
+
+    /// Numeric values, or string pool ids for TEXT and BLOB columns.
+    std::vector<long long> integers;
+
+    /// Values for DOUBLE columns.
+    std::vector<double> doubles;
+
+    /// One bit per row, set if the cell is NULL.
+    std::vector<bool> nulls;
+
+    /// Text of NULL numeric cells set from empty or malformed strings.
+    std::unordered_map<size_t, std::string> unparsed;
+  };
+
+  /// Mark the last row's cell as set, dropping any text it was set from.
+  void setNotNull(Column& column);
+
+  /// Find the text a NULL numeric cell was set from, if any.
+  const std::string* findUnparsed(size_t row, size_t col) const;
+
+  /// Return the pool id of a string, adding it if it is new.
+  long long intern(const std::string& value);
+
+  /**
+   * @brief Visit the set columns of a row in name order.
+   *
+   * The visitor is called with the column name and a long long, double or
+   * std::string value, as the column would be read from a query result.
+   */
+  template <typename Visitor>
+  void visitTyped(size_t row, Visitor visitor) const;
+
+ private:
+  /// Column storage, in table layout order.
+  std::vector<Column> columns_;
+
+  /// Column positions ordered by name, the key order of a RowTyped.
+  std::vector<size_t> sorted_;
+
+  /// Interned strings indexed by id, deque elements keep stable addresses.
+  std::deque<std::string> pool_;
+
+  /// Lookup of interned strings, keys view into pool_.
+  std::unordered_map<std::string_view, long long> string_ids_;
+
+  /// Number of rows appended.
+  size_t rows_{0};
+
+  /// Copy TEXT values into SQLite.
+  bool transient_{true};
+};
+
+using ColumnarRowsRef = std::shared_ptr<ColumnarRows>;
+
+} // namespace osquery
@@ -7,12 +7,143 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
+#include "columnar_rows.h"
 #include "diff_results.h"
 
 namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// The first byte of hash-indexed results, JSON results begin with '['.
+const char kIndexedResultsVersion = 0x02;
+
+/// Hash-indexed results without a column dictionary.
+const char kIndexedResultsVersionV1 = 0x01;
+
+/// Size of the format header: version byte and 32-bit row count.
+const size_t kIndexedHeaderSize = 5;
+
+/// Size of each index entry: 128-bit row hash and 32-bit row offset.
+const size_t kIndexedEntrySize = 20;
+
+inline void putFixed32(uint32_t value, std::string& out) {
+  for (size_t i = 0; i < 4; i++) {
+    out.push_back(static_cast<char>(value >> (i * 8)));
+  }
+}
+
+inline void putFixed64(uint64_t value, std::string& out) {
+  for (size_t i = 0; i < 8; i++) {
+    out.push_back(static_cast<char>(value >> (i * 8)));
+  }
+}
+
+inline uint64_t loadFixed(const char* data, size_t width) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < width; i++) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (i * 8);
+  }
+  return value;
+}
+
+/// A read-only view of hash-indexed results.
+class IndexedResultsView {
+ public:
+  Status parse(const std::string& data) {
+    if (!isIndexedResults(data)) {
+      return Status(1, "Results are not hash-indexed");
+    }
+
+    count_ = static_cast<size_t>(loadFixed(data.data() + 1, 4));
+    entries_ = data.data() + kIndexedHeaderSize;
+    const char* end = data.data() + data.size();
+    has_columns_ = (data[0] != kIndexedResultsVersionV1);
+    if (has_columns_) {
+      // The column dictionary follows the header.
+      auto status = parseColumns(entries_, end);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+
+    if (static_cast<size_t>(end - entries_) / kIndexedEntrySize < count_) {
+      return Status(1, "Truncated hash-indexed results");
+    }
+
+    rows_ = entries_ + count_ * kIndexedEntrySize;
+    rows_size_ = static_cast<size_t>(end - rows_);
+    return Status::success();
+  }
+
+  size_t size() const {
+    return count_;
+  }
+
+  RowHash hash(size_t i) const {
+    RowHash hash;
+    hash.high = loadFixed(entries_ + i * kIndexedEntrySize, 8);
+    hash.low = loadFixed(entries_ + i * kIndexedEntrySize + 8, 8);
+    return hash;
+  }
+
+  Status row(size_t i, RowTyped& r) const {
+    auto start = offset(i);
+    auto end = (i + 1 < count_) ? offset(i + 1) : rows_size_;
+    if (start > end || end > rows_size_) {
+      return Status(1, "Invalid hash-indexed row offset");
+    }
+
+    const char* data = rows_ + start;
+    if (has_columns_) {
+      return decodeRow(data, rows_ + end, columns_, r);
+    }
+    return decodeRow(data, rows_ + end, r);
+  }
+
+ private:
+  Status parseColumns(const char*& data, const char* end) {
+    if (end - data < 4) {
+      return Status(1, "Truncated hash-indexed column dictionary");
+    }
+    auto count = static_cast<size_t>(loadFixed(data, 4));
+    data += 4;
+
+    columns_.clear();
+    for (size_t i = 0; i < count; i++) {
+      if (end - data < 4) {
+        return Status(1, "Truncated hash-indexed column dictionary");
+      }
+      auto size = static_cast<size_t>(loadFixed(data, 4));
+      data += 4;
+      if (static_cast<size_t>(end - data) < size) {
+        return Status(1, "Truncated hash-indexed column dictionary");
+      }
+      columns_.emplace_back(data, size);
+      data += size;
+    }
+    return Status::success();
+  }
+
+  size_t offset(size_t i) const {
+    return static_cast<size_t>(
+        loadFixed(entries_ + i * kIndexedEntrySize + 16, 4));
+  }
+
+ private:
+  ColumnNames columns_;
+  bool has_columns_{false};
+  const char* entries_{nullptr};
+  const char* rows_{nullptr};
+  size_t rows_size_{0};
+  size_t count_{0};
+};
+
+} // namespace
+
 Status serializeDiffResults(const DiffResults& d,
                             JSON& doc,
                             rj::Document& obj,
@@ -69,4 +200,215 @@ DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
   return r;
 }
 
+bool isIndexedResults(const std::string& data) {
+  return data.size() >= kIndexedHeaderSize &&
+         (data[0] == kIndexedResultsVersion ||
+          data[0] == kIndexedResultsVersionV1);
+}
+
+bool IndexedResults::Entry::operator<(const Entry& other) const {
+  return (hash != other.hash) ? hash < other.hash : position < other.position;
+}
+
+IndexedResults::IndexedResults(const QueryDataTyped& q) {
+  entries_.reserve(q.size());
+  std::string encoded;
+  for (size_t i = 0; i < q.size(); i++) {
+    // Hashes use the self-contained encoding so they compare across results
+    // with different dictionaries, rows are kept with the dictionary.
+    encoded.clear();
+    encodeRow(q[i], encoded);
+    auto offset = rows_.size();
+    encodeRow(q[i], columns_, rows_);
+    addEntry(i, encoded, offset);
+  }
+
+  std::sort(entries_.begin(), entries_.end());
+}
+
+IndexedResults::IndexedResults(const ColumnarRows& rows) {
+  entries_.reserve(rows.size());
+  std::string encoded;
+  for (size_t i = 0; i < rows.size(); i++) {
+    encoded.clear();
+    rows.encode(i, encoded);
+    auto offset = rows_.size();
+    rows.encode(i, rows_, &columns_);
+    addEntry(i, encoded, offset);
+  }
+
+  std::sort(entries_.begin(), entries_.end());
+}
+
+void IndexedResults::addEntry(size_t position,
+                              const std::string& encoded,
+                              size_t offset) {
+  Entry entry;
+  entry.hash = hashEncodedRow(encoded.data(), encoded.size());
+  entry.offset = offset;
+  entry.size = rows_.size() - offset;
+  entry.position = position;
+  entries_.push_back(entry);
+}
+
+RowHash IndexedResults::fingerprint() const {
+  std::string hashes;
+  hashes.reserve(entries_.size() * 16);
+  for (const auto& entry : entries_) {
+    putFixed64(entry.hash.high, hashes);
+    putFixed64(entry.hash.low, hashes);
+  }
+  return hashEncodedRow(hashes.data(), hashes.size());
+}
+
+Status IndexedResults::serialize(std::string& out) const {
+  if (entries_.size() > UINT32_MAX || rows_.size() > UINT32_MAX) {
+    return Status(1, "Query results are too large to index");
+  }
+
+  out.clear();
+  out.reserve(kIndexedHeaderSize + entries_.size() * kIndexedEntrySize +
+              rows_.size());
+  out.push_back(kIndexedResultsVersion);
+  putFixed32(static_cast<uint32_t>(entries_.size()), out);
+
+  const auto& columns = columns_.names();
+  putFixed32(static_cast<uint32_t>(columns.size()), out);
+  for (const auto& column : columns) {
+    putFixed32(static_cast<uint32_t>(column.size()), out);
+    out.append(column);
+  }
+
+  // Rows are written in hash order, so each row ends at the next offset.
+  uint32_t offset = 0;
+  for (const auto& entry : entries_) {
+    putFixed64(entry.hash.high, out);
+    putFixed64(entry.hash.low, out);
+    putFixed32(offset, out);
+    offset += static_cast<uint32_t>(entry.size);
+  }
+
+  for (const auto& entry : entries_) {
+    out.append(rows_, entry.offset, entry.size);
+  }
+  return Status::success();
+}
+
+Status IndexedResults::merge(const std::string& previous,
+                             std::vector<size_t>& added,
+                             DiffResults& dr) const {
+  IndexedResultsView view;
+  auto status = view.parse(previous);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Merge the sorted hash arrays, equal hashes pair one previous row with one
+  // current row so duplicate rows are accounted for like a multiset.
+  size_t i = 0;
+  size_t j = 0;
+  while (i < view.size() || j < entries_.size()) {
+    if (i < view.size() && j < entries_.size() &&
+        view.hash(i) == entries_[j].hash) {
+      i++;
+      j++;
+    } else if (j == entries_.size() ||
+               (i < view.size() && view.hash(i) < entries_[j].hash)) {
+      RowTyped r;
+      status = view.row(i++, r);
+      if (!status.ok()) {
+        return status;
+      }
+      dr.removed.push_back(std::move(r));
+    } else {
+      added.push_back(entries_[j++].position);
+    }
+  }
+
+  // Match the ordering of diff: added rows in result order and removed rows
+  // in the order of a QueryDataSet.
+  std::sort(added.begin(), added.end());
+  std::sort(dr.removed.begin(), dr.removed.end());
+  return Status::success();
+}
+
+Status IndexedResults::diff(const std::string& previous,
+                            const QueryDataTyped& current,
+                            DiffResults& dr) const {
+  std::vector<size_t> added;
+  auto status = merge(previous, added, dr);
+  if (!status.ok()) {
+    return status;
+  }
+
+  dr.added.reserve(added.size());
+  for (auto position : added) {
+    dr.added.push_back(current[position]);
+  }
+  return Status::success();
+}
+
+Status IndexedResults::diff(const std::string& previous,
+                            const ColumnarRows& current,
+                            DiffResults& dr) const {
+  std::vector<size_t> added;
+  auto status = merge(previous, added, dr);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Only the added rows are converted out of the batch.
+  dr.added.reserve(added.size());
+  for (auto position : added) {
+    dr.added.push_back(current.toRowTyped(position));
+  }
+  return Status::success();
+}
+
+Status serializeIndexedResults(const QueryDataTyped& q, std::string& out) {
+  return IndexedResults(q).serialize(out);
+}
+
+Status deserializeIndexedResults(const std::string& data, QueryDataSet& qd) {
+  IndexedResultsView view;
+  auto status = view.parse(data);
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (size_t i = 0; i < view.size(); i++) {
+    RowTyped r;
+    status = view.row(i, r);
+    if (!status.ok()) {
+      return status;
+    }
+    qd.insert(std::move(r));
+  }
+  return Status::success();
+}
+
+Status diffIndexedResults(const std::string& previous,
+                          const QueryDataTyped& current,
+                          DiffResults& dr,
+                          std::string& current_index) {
+  IndexedResults indexed(current);
+  auto status = indexed.diff(previous, current, dr);
+  if (!status.ok() || dr.hasNoResults()) {
+    return status;
+  }
+  return indexed.serialize(current_index);
+}
+
+Status diffIndexedResults(const std::string& previous,
+                          const ColumnarRows& current,
+                          DiffResults& dr,
+                          std::string& current_index) {
+  IndexedResults indexed(current);
+  auto status = indexed.diff(previous, current, dr);
+  if (!status.ok() || dr.hasNoResults()) {
+    return status;
+  }
+  return indexed.serialize(current_index);
+}
+
 } // namespace osquery
@@ -96,4 +96,146 @@ Status serializeDiffResultsJSON(const DiffResults& d,
  */
 DiffResults diff(QueryDataSet& old_, QueryDataTyped& new_);
 
+/**
+ * @brief Check if stored results use the hash-indexed results format.
+ *
+ * Results stored by older versions are a JSON array, see
+ * serializeQueryDataJSON.
+ */
+bool isIndexedResults(const std::string& data);
+
+/**
+ * @brief Serialize query results into the hash-indexed results format.
+ *
+ * The format is a dictionary of the column names, a sorted array of 128-bit
+ * row hashes and the binary encoding of each row (see encodeRow) in the same
+ * order. A differential can then be computed by merging hash arrays, without
+ * parsing the stored rows.
+ *
+ * @param q the query results to serialize.
+ * @param out [output] the serialized results.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeIndexedResults(const QueryDataTyped& q, std::string& out);
+
+/**
+ * @brief Query results encoded for the hash-indexed results format.
+ *
+ * Each row is encoded and hashed once. The encoding can then be compared to
+ * stored results by fingerprint, diffed against them and written as the new
+ * stored results without encoding the rows again.
+ */
+class IndexedResults {
+ public:
+  /// Encode and hash each row of the query results.
+  explicit IndexedResults(const QueryDataTyped& q);
+
+  /**
+   * @brief Encode and hash each row of a batch.
+   *
+   * Rows are encoded from the typed columns, the results equal those of the
+   * batch converted to a QueryDataTyped.
+   */
+  explicit IndexedResults(const ColumnarRows& rows);
+
+  /// Hash of the sorted row hashes, equal for equal multisets of rows.
+  RowHash fingerprint() const;
+
+  /// Write the results in the hash-indexed format.
+  Status serialize(std::string& out) const;
+
+  /**
+   * @brief Diff hash-indexed previous results against these results.
+   *
+   * @param previous the previous results, in the hash-indexed format.
+   * @param current the query results these results were encoded from.
+   * @param dr [output] the differential from previous to current.
+   *
+   * @return Status indicating the success or failure of the operation.
+   */
+  Status diff(const std::string& previous,
+              const QueryDataTyped& current,
+              DiffResults& dr) const;
+
+  /// Diff previous results against the batch these results were encoded from.
+  Status diff(const std::string& previous,
+              const ColumnarRows& current,
+              DiffResults& dr) const;
+
+ private:
+  struct Entry {
+    RowHash hash;
+
+    /// Offset of the row encoding within the encoded rows.
+    size_t offset{0};
+
+    /// Size of the row encoding.
+    size_t size{0};
+
+    /// Position of the row within the query results.
+    size_t position{0};
+
+    bool operator<(const Entry& other) const;
+  };
+
+  /// Index a row whose dictionary encoding was appended at offset.
+  void addEntry(size_t position, const std::string& encoded, size_t offset);
+
+  /**
+   * @brief Merge the hash arrays of previous results and these results.
+   *
+   * Removed rows are decoded into the differential, the positions of added
+   * rows are returned in result order.
+   */
+  Status merge(const std::string& previous,
+               std::vector<size_t>& added,
+               DiffResults& dr) const;
+
+  /// Column names of the row encodings.
+  RowColumnDictionary columns_;
+
+  /// Row encodings in result order.
+  std::string rows_;
+
+  /// Index entries sorted by row hash.
+  std::vector<Entry> entries_;
+};
+
+/**
+ * @brief Deserialize hash-indexed results into a QueryDataSet.
+ *
+ * @param data the serialized results.
+ * @param qd [output] the output QueryDataSet.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status deserializeIndexedResults(const std::string& data, QueryDataSet& qd);
+
+/**
+ * @brief Diff hash-indexed previous results against current query results.
+ *
+ * This computes the same differential as diff, only the rows that were
+ * removed are decoded from the previous results and only the rows that were
+ * added are copied from the current results.
+ *
+ * @param previous the previous results, in the hash-indexed format.
+ * @param current the current query results.
+ * @param dr [output] the differential from previous to current.
+ * @param current_index [output] the current results in the hash-indexed
+ * format, only written if the differential is not empty.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status diffIndexedResults(const std::string& previous,
+                          const QueryDataTyped& current,
+                          DiffResults& dr,
+                          std::string& current_index);
+
+/// Diff hash-indexed previous results against a batch, see diffIndexedResults.
+Status diffIndexedResults(const std::string& previous,
+                          const ColumnarRows& current,
+                          DiffResults& dr,
+                          std::string& current_index);
+
 } // namespace osquery
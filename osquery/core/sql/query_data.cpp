@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include "columnar_rows.h"
 #include "query_data.h"
 
 namespace rj = rapidjson;
@@ -43,6 +44,21 @@ Status serializeQueryData(const QueryDataTyped& q,
   return Status::success();
 }
 
+Status serializeQueryData(const ColumnarRows& rows,
+                          JSON& doc,
+                          rj::Document& arr,
+                          bool asNumeric) {
+  for (size_t i = 0; i < rows.size(); i++) {
+    auto row_obj = doc.getObject();
+    auto status = rows.serializeTyped(i, doc, row_obj, asNumeric);
+    if (!status.ok()) {
+      return status;
+    }
+    doc.push(row_obj, arr);
+  }
+  return Status::success();
+}
+
 Status serializeQueryDataJSON(const QueryData& q, JSON& doc) {
   doc = JSON::newArray();
   ColumnNames cols;
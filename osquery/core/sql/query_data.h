@@ -16,6 +16,8 @@
 
 namespace osquery {
 
+class ColumnarRows;
+
 /**
  * @brief The result set returned from a osquery SQL query
  *
@@ -70,6 +72,24 @@ Status serializeQueryData(const QueryDataTyped& q,
                           rapidjson::Document& arr,
                           bool asNumeric);
 
+/**
+ * @brief Serialize a ColumnarRows batch into a JSON array.
+ *
+ * Each row is serialized from the batch's typed columns as serializeQueryData
+ * would serialize the batch converted to a QueryDataTyped.
+ *
+ * @param rows the batch to serialize.
+ * @param doc the managed JSON document.
+ * @param arr [output] the output JSON array.
+ * @param asNumeric true iff numeric values are serialized as such
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryData(const ColumnarRows& rows,
+                          JSON& doc,
+                          rapidjson::Document& arr,
+                          bool asNumeric);
+
 /**
  * @brief Serialize a QueryData object into a JSON document.
  *
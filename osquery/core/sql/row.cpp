@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstring>
+
 #include "row.h"
 #include <osquery/utils/conversions/castvariant.h>
 
@@ -14,6 +16,113 @@ namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// Type tags used by the binary row encoding.
+enum RowEncodingType : char {
+  kEncodedInteger = 'i',
+  kEncodedDouble = 'd',
+  kEncodedString = 's',
+};
+
+inline void putVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline bool getVarint(const char*& data, const char* end, uint64_t& value) {
+  value = 0;
+  for (size_t shift = 0; shift < 64 && data < end; shift += 7) {
+    auto byte = static_cast<uint8_t>(*data++);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void putFixed64(uint64_t value, std::string& out) {
+  for (size_t i = 0; i < 8; i++) {
+    out.push_back(static_cast<char>(value >> (i * 8)));
+  }
+}
+
+inline uint64_t loadFixed64(const char* data) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < 8; i++) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (i * 8);
+  }
+  return value;
+}
+
+inline bool getString(const char*& data, const char* end, std::string& s) {
+  uint64_t size = 0;
+  if (!getVarint(data, end, size) ||
+      size > static_cast<uint64_t>(end - data)) {
+    return false;
+  }
+  s.assign(data, static_cast<size_t>(size));
+  data += size;
+  return true;
+}
+
+/// Decode a value written by RowEncoder.
+inline Status decodeValue(const char*& data,
+                          const char* end,
+                          RowDataTyped& value) {
+  if (data == end) {
+    return Status(1, "Invalid row encoding value");
+  }
+
+  auto type = *data++;
+  if (type == kEncodedString) {
+    std::string s;
+    if (!getString(data, end, s)) {
+      return Status(1, "Invalid row encoding string value");
+    }
+    value = std::move(s);
+    return Status::success();
+  }
+
+  if (end - data < 8) {
+    return Status(1, "Invalid row encoding numeric value");
+  }
+  auto bits = loadFixed64(data);
+  data += 8;
+  if (type == kEncodedInteger) {
+    value = static_cast<long long>(bits);
+  } else if (type == kEncodedDouble) {
+    double d = 0;
+    std::memcpy(&d, &bits, sizeof(d));
+    value = d;
+  } else {
+    return Status(1, "Invalid row encoding value type");
+  }
+  return Status::success();
+}
+
+/// The first byte of a binary stored row, JSON rows begin with '{'.
+const char kBinaryRowVersion = 0x01;
+
+inline uint64_t rotl64(uint64_t x, int8_t r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+} // namespace
+
 Status serializeRow(const Row& r,
                     const ColumnNames& cols,
                     JSON& doc,
@@ -143,4 +252,293 @@ Status deserializeRowJSON(const std::string& json, RowTyped& r) {
   return deserializeRow(doc.doc(), r);
 }
 
+RowEncoder::RowEncoder(std::string& out,
+                       size_t count,
+                       RowColumnDictionary* columns)
+    : out_(out), columns_(columns) {
+  putVarint(count, out_);
+}
+
+void RowEncoder::addName(const std::string& name) {
+  if (columns_ != nullptr) {
+    putVarint(columns_->id(name), out_);
+  } else {
+    putVarint(name.size(), out_);
+    out_.append(name);
+  }
+}
+
+void RowEncoder::add(const std::string& name, long long value) {
+  addName(name);
+  out_.push_back(kEncodedInteger);
+  putFixed64(static_cast<uint64_t>(value), out_);
+}
+
+void RowEncoder::add(const std::string& name, double value) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  addName(name);
+  out_.push_back(kEncodedDouble);
+  putFixed64(bits, out_);
+}
+
+void RowEncoder::add(const std::string& name, const std::string& value) {
+  addName(name);
+  out_.push_back(kEncodedString);
+  putVarint(value.size(), out_);
+  out_.append(value);
+}
+
+void encodeRow(const RowTyped& r, std::string& out) {
+  RowEncoder encoder(out, r.size());
+  for (const auto& i : r) {
+    boost::apply_visitor(
+        [&encoder, &i](const auto& value) { encoder.add(i.first, value); },
+        i.second);
+  }
+}
+
+Status decodeRow(const char*& data, const char* end, RowTyped& r) {
+  uint64_t columns = 0;
+  if (!getVarint(data, end, columns)) {
+    return Status(1, "Invalid row encoding header");
+  }
+
+  for (uint64_t i = 0; i < columns; i++) {
+    std::string name;
+    if (!getString(data, end, name)) {
+      return Status(1, "Invalid row encoding column name");
+    }
+
+    auto status = decodeValue(data, end, r[name]);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
+}
+
+RowHash hashEncodedRow(const char* data, size_t size) {
+  // MurmurHash3 x64 128-bit, with a zero seed and little-endian block reads.
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+  uint64_t h1 = 0;
+  uint64_t h2 = 0;
+
+  const size_t blocks = size / 16;
+  for (size_t i = 0; i < blocks; i++) {
+    auto k1 = loadFixed64(data + i * 16);
+    auto k2 = loadFixed64(data + i * 16 + 8);
+
+    k1 *= c1;
+    k1 = rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+    h1 = rotl64(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    h2 = rotl64(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const auto* tail = reinterpret_cast<const uint8_t*>(data + blocks * 16);
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  auto remaining = size & 15;
+  for (size_t i = remaining; i > 8; i--) {
+    k2 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+  }
+  if (remaining > 8) {
+    k2 *= c2;
+    k2 = rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+  }
+  for (size_t i = std::min<size_t>(remaining, 8); i > 0; i--) {
+    k1 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+  }
+  if (remaining > 0) {
+    k1 *= c1;
+    k1 = rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= size;
+  h2 ^= size;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+
+  RowHash hash;
+  hash.high = h1;
+  hash.low = h2;
+  return hash;
+}
+
+uint64_t RowColumnDictionary::id(const std::string& name) {
+  auto it = ids_.find(name);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+
+  auto id = static_cast<uint64_t>(names_.size());
+  names_.push_back(name);
+  ids_.emplace(name, id);
+  return id;
+}
+
+void encodeRow(const RowTyped& r,
+               RowColumnDictionary& columns,
+               std::string& out) {
+  RowEncoder encoder(out, r.size(), &columns);
+  for (const auto& i : r) {
+    boost::apply_visitor(
+        [&encoder, &i](const auto& value) { encoder.add(i.first, value); },
+        i.second);
+  }
+}
+
+Status decodeRow(const char*& data,
+                 const char* end,
+                 const ColumnNames& columns,
+                 RowTyped& r) {
+  uint64_t count = 0;
+  if (!getVarint(data, end, count)) {
+    return Status(1, "Invalid row encoding header");
+  }
+
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t id = 0;
+    if (!getVarint(data, end, id) || id >= columns.size()) {
+      return Status(1, "Invalid row encoding column index");
+    }
+
+    auto status = decodeValue(data, end, r[columns[id]]);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
+}
+
+void encodeRow(const Row& r, std::string& out) {
+  RowEncoder encoder(out, r.size());
+  for (const auto& i : r) {
+    encoder.add(i.first, i.second);
+  }
+}
+
+Status decodeRow(const char*& data, const char* end, Row& r) {
+  uint64_t columns = 0;
+  if (!getVarint(data, end, columns)) {
+    return Status(1, "Invalid row encoding header");
+  }
+
+  for (uint64_t i = 0; i < columns; i++) {
+    std::string name;
+    if (!getString(data, end, name)) {
+      return Status(1, "Invalid row encoding column name");
+    }
+
+    if (data != end && *data == kEncodedString) {
+      data++;
+      if (!getString(data, end, r[name])) {
+        return Status(1, "Invalid row encoding string value");
+      }
+      continue;
+    }
+
+    RowDataTyped value;
+    auto status = decodeValue(data, end, value);
+    if (!status.ok()) {
+      return status;
+    }
+    r[name] = castVariant(value);
+  }
+  return Status::success();
+}
+
+void serializeRowBinary(const Row& r, std::string& out) {
+  out.clear();
+  out.push_back(kBinaryRowVersion);
+  encodeRow(r, out);
+}
+
+bool isBinaryRow(const std::string& data) {
+  return !data.empty() && data[0] == kBinaryRowVersion;
+}
+
+Status deserializeRowBinary(const std::string& data, Row& r) {
+  if (!isBinaryRow(data)) {
+    return Status(1, "Row is not in the binary format");
+  }
+
+  const char* start = data.data() + 1;
+  const char* end = data.data() + data.size();
+  auto status = decodeRow(start, end, r);
+  if (status.ok() && start != end) {
+    return Status(1, "Unexpected data after the binary row");
+  }
+  return status;
+}
+
+Status visitRowBinary(const std::string& data,
+                      const RowBinaryVisitor& visitor) {
+  if (!isBinaryRow(data)) {
+    return Status(1, "Row is not in the binary format");
+  }
+
+  const char* start = data.data() + 1;
+  const char* end = data.data() + data.size();
+  uint64_t columns = 0;
+  if (!getVarint(start, end, columns)) {
+    return Status(1, "Invalid row encoding header");
+  }
+
+  for (uint64_t i = 0; i < columns; i++) {
+    uint64_t size = 0;
+    if (!getVarint(start, end, size) ||
+        size > static_cast<uint64_t>(end - start)) {
+      return Status(1, "Invalid row encoding column name");
+    }
+    std::string_view name(start, static_cast<size_t>(size));
+    start += size;
+
+    if (start != end && *start == kEncodedString) {
+      start++;
+      if (!getVarint(start, end, size) ||
+          size > static_cast<uint64_t>(end - start)) {
+        return Status(1, "Invalid row encoding string value");
+      }
+      std::string_view value(start, static_cast<size_t>(size));
+      start += size;
+      if (!visitor(name, value)) {
+        break;
+      }
+      continue;
+    }
+
+    RowDataTyped typed_value;
+    auto status = decodeValue(start, end, typed_value);
+    if (!status.ok()) {
+      return status;
+    }
+    auto value = castVariant(typed_value);
+    if (!visitor(name, value)) {
+      break;
+    }
+  }
+  return Status::success();
+}
+
 } // namespace osquery
@@ -9,8 +9,12 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/lexical_cast.hpp>
@@ -145,4 +149,187 @@ Status deserializeRowJSON(const std::string& json, Row& r);
  */
 Status deserializeRowJSON(const std::string& json, RowTyped& r);
 
+/**
+ * @brief A 128-bit content hash of an encoded RowTyped.
+ *
+ * Equal rows, including the type of each value, have equal hashes.
+ */
+struct RowHash {
+  uint64_t high{0};
+  uint64_t low{0};
+
+  bool operator==(const RowHash& other) const {
+    return high == other.high && low == other.low;
+  }
+
+  bool operator!=(const RowHash& other) const {
+    return !(*this == other);
+  }
+
+  bool operator<(const RowHash& other) const {
+    return (high != other.high) ? high < other.high : low < other.low;
+  }
+};
+
+/**
+ * @brief Append a compact binary encoding of a RowTyped to a string.
+ *
+ * Columns are written in the row's key order together with the type of their
+ * value, so the encoding is canonical: equal rows have equal encodings.
+ *
+ * @param r the RowTyped to encode.
+ * @param out [output] the string the encoding is appended to.
+ */
+void encodeRow(const RowTyped& r, std::string& out);
+
+/**
+ * @brief Decode a single RowTyped written by encodeRow.
+ *
+ * @param data [input/output] the start of the encoding, advanced past it.
+ * @param end the end of the readable buffer.
+ * @param r [output] the output RowTyped structure.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status decodeRow(const char*& data, const char* end, RowTyped& r);
+
+/// Compute the 128-bit hash of a row encoding written by encodeRow.
+RowHash hashEncodedRow(const char* data, size_t size);
+
+/**
+ * @brief Column names shared by the row encodings of a result set.
+ *
+ * Rows encoded with a dictionary refer to each column by its index in the
+ * dictionary instead of repeating the column name in every row.
+ */
+class RowColumnDictionary {
+ public:
+  /// Get the index of a column name, adding the name if it is missing.
+  uint64_t id(const std::string& name);
+
+  /// The column names in index order.
+  const ColumnNames& names() const {
+    return names_;
+  }
+
+ private:
+  ColumnNames names_;
+  std::unordered_map<std::string, uint64_t> ids_;
+};
+
+/**
+ * @brief Append a row encoding one column at a time.
+ *
+ * Callers that do not hold a RowTyped, such as a ColumnarRows batch, write
+ * the same bytes as encodeRow by adding each column in name order.
+ */
+class RowEncoder {
+ public:
+  /**
+   * @brief Start the encoding of a row.
+   *
+   * @param out [output] the string the encoding is appended to.
+   * @param count the number of columns that will be added.
+   * @param columns the dictionary naming columns by index, or nullptr to
+   * write each column name.
+   */
+  RowEncoder(std::string& out,
+             size_t count,
+             RowColumnDictionary* columns = nullptr);
+
+  /// Append an integer column.
+  void add(const std::string& name, long long value);
+
+  /// Append a double column.
+  void add(const std::string& name, double value);
+
+  /// Append a string column.
+  void add(const std::string& name, const std::string& value);
+
+ private:
+  void addName(const std::string& name);
+
+ private:
+  std::string& out_;
+  RowColumnDictionary* columns_{nullptr};
+};
+
+/**
+ * @brief Append the binary encoding of a RowTyped using a column dictionary.
+ *
+ * @param r the RowTyped to encode.
+ * @param columns [input/output] the dictionary, new column names are added.
+ * @param out [output] the string the encoding is appended to.
+ */
+void encodeRow(const RowTyped& r,
+               RowColumnDictionary& columns,
+               std::string& out);
+
+/**
+ * @brief Decode a single RowTyped written with a column dictionary.
+ *
+ * @param data [input/output] the start of the encoding, advanced past it.
+ * @param end the end of the readable buffer.
+ * @param columns the column names of the dictionary, in index order.
+ * @param r [output] the output RowTyped structure.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status decodeRow(const char*& data,
+                 const char* end,
+                 const ColumnNames& columns,
+                 RowTyped& r);
+
+/**
+ * @brief Append the binary encoding of a Row.
+ *
+ * A Row is encoded as a RowTyped with only string values.
+ */
+void encodeRow(const Row& r, std::string& out);
+
+/// Decode a single Row, numeric values are converted to strings.
+Status decodeRow(const char*& data, const char* end, Row& r);
+
+/**
+ * @brief Serialize a Row into the versioned binary format for stored rows.
+ *
+ * Rows stored in the backing store by osquery itself do not need to be JSON,
+ * the binary format is smaller and avoids a JSON document per row.
+ *
+ * @param r the Row to serialize.
+ * @param out [output] the serialized row.
+ */
+void serializeRowBinary(const Row& r, std::string& out);
+
+/// Check if a stored row uses the binary format, otherwise it is JSON.
+bool isBinaryRow(const std::string& data);
+
+/**
+ * @brief Deserialize a Row written by serializeRowBinary.
+ *
+ * @param data the serialized row.
+ * @param r [output] the output Row structure.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status deserializeRowBinary(const std::string& data, Row& r);
+
+/// Called for each column of a binary row, return false to stop visiting.
+using RowBinaryVisitor =
+    std::function<bool(std::string_view column, std::string_view value)>;
+
+/**
+ * @brief Visit the columns of a row written by serializeRowBinary.
+ *
+ * The visitor reads names and values in place, a Row is not built. This
+ * lets callers inspect a few columns of a stored row before deciding to
+ * deserialize it.
+ *
+ * @param data the serialized row.
+ * @param visitor called with each column name and value.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status visitRowBinary(const std::string& data, const RowBinaryVisitor& visitor);
+
 } // namespace osquery
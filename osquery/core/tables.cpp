@@ -17,6 +17,7 @@
 #include <osquery/utils/conversions/tryto.h>
 
 #include <climits>
+#include <functional>
 
 namespace osquery {
 
@@ -160,6 +161,22 @@ Status TablePlugin::call(const PluginRequest& request,
   return Status::success();
 }
 
+TableRows TablePlugin::generate(QueryContext& context) {
+  TableRows results;
+  if (!usesGenerator()) {
+    return results;
+  }
+
+  // Collect every row the generator yields.
+  RowGenerator::pull_type rows(std::bind(
+      &TablePlugin::generator, this, std::placeholders::_1, std::ref(context)));
+  while (rows) {
+    results.push_back(rows.get());
+    rows();
+  }
+  return results;
+}
+
 std::string TablePlugin::columnDefinition(bool is_extension) const {
   return osquery::columnDefinition(columns(), is_extension);
 }
@@ -167,12 +184,19 @@ std::string TablePlugin::columnDefinition(bool is_extension) const {
 PluginResponse TablePlugin::routeInfo() const {
   // Route info consists of the serialized column information.
   PluginResponse response;
+  auto selectivity = columnSelectivity();
   for (const auto& column : columns()) {
     response.push_back(
         {{"id", "column"},
          {"name", std::get<0>(column)},
          {"type", columnTypeName(std::get<1>(column))},
          {"op", INTEGER(static_cast<size_t>(std::get<2>(column)))}});
+
+    // Planner hints are optional, tables without hints are planned by options.
+    auto hint = selectivity.find(std::get<0>(column));
+    if (hint != selectivity.end()) {
+      response.back()["selectivity"] = DOUBLE(hint->second);
+    }
   }
   // Each table name alias is provided such that the core may add the views.
   // These views need to be removed when the backing table is detached.
@@ -192,6 +216,11 @@ PluginResponse TablePlugin::routeInfo() const {
   response.push_back(
       {{"id", "attributes"},
        {"attributes", INTEGER(static_cast<size_t>(attributes()))}});
+
+  auto rows = estimatedRows();
+  if (rows > 0) {
+    response.push_back({{"id", "estimates"}, {"rows", INTEGER(rows)}});
+  }
   return response;
 }
 
@@ -217,6 +217,14 @@ using ColumnAliasSet = std::map<std::string, std::set<std::string>>;
 /// Alias for a map of alias to canonical column names
 using AliasColumnMap = std::unordered_map<std::string, std::string>;
 
+/**
+ * @brief Alias for a map of column names to planner selectivity hints.
+ *
+ * A column's selectivity is the fraction of a table scan expected to remain
+ * when the column is constrained by equality, between 0 and 1.
+ */
+using ColumnSelectivityMap = std::map<std::string, double>;
+
 /// Forward declaration of QueryContext for ConstraintList relationships.
 struct QueryContext;
 
@@ -414,6 +422,12 @@ struct VirtualTableContent {
    */
   std::map<std::string, size_t> aliases;
 
+  /// Expected number of rows in a full scan, 0 if the table did not declare.
+  size_t estimated_rows{0};
+
+  /// Selectivity hints indexed like columns, 0 if a column has none.
+  std::vector<double> selectivity;
+
   /// Transient set of virtual table access constraints.
   std::unordered_map<size_t, ConstraintSet> constraints;
 
@@ -423,6 +437,9 @@ struct VirtualTableContent {
   /// Transient set of virtual table used columns (as bitmasks)
   std::unordered_map<size_t, UsedColumnsBitset> colsUsedBitsets;
 
+  /// Indexes of constraint sets kept between queries for cached statements.
+  std::unordered_set<size_t> retained;
+
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -707,6 +724,22 @@ class TablePlugin : public Plugin {
     return TableAttributes::NONE;
   }
 
+  /**
+   * @brief Expected number of rows in a full scan of the table.
+   *
+   * Together with the column selectivity hints this is used by the SQLite
+   * planner to order scans within joins. Return 0 if unknown, and the table
+   * is planned using its column options only.
+   */
+  virtual size_t estimatedRows() const {
+    return 0;
+  }
+
+  /// Define a map of columns to their selectivity hints.
+  virtual ColumnSelectivityMap columnSelectivity() const {
+    return ColumnSelectivityMap();
+  }
+
   /**
    * @brief Generate a complete table representation.
    *
@@ -721,13 +754,15 @@ class TablePlugin : public Plugin {
    * virtual table APIs. In the best case this context include a limit or
    * constraints organized by each possible column.
    *
+   * Tables using a generator do not need to implement this method, the
+   * default collects every row the generator yields. This is used when the
+   * complete content is needed, such as for caching, shared scans, and
+   * Registry calls.
+   *
    * @param context A query context filled in by SQLite's virtual table API.
    * @return The result rows for this table, given the query context.
    */
-  virtual TableRows generate(QueryContext& context) {
-    (void)context;
-    return TableRows();
-  }
+  virtual TableRows generate(QueryContext& context);
 
   /// Callback for DELETE statements
   virtual QueryData delete_(QueryContext& context,
@@ -766,12 +801,14 @@ class TablePlugin : public Plugin {
    * but rather provided with some boilerplate syntax.
    *
    * This implementation uses nearly %5 more cycles than the generate method
-   * when the table content is small (less than 100 rows) and has a disadvantage
-   * of not being cachable since the entire contents are not available before
-   * post-filter aggregations. This implementation prevents the need for
-   * multiple representations of table content existing simultaneously and is
-   * always more memory efficient. It can be more compute efficient for tables
-   * with over 1000 rows.
+   * when the table content is small (less than 100 rows). This implementation
+   * prevents the need for multiple representations of table content existing
+   * simultaneously and is always more memory efficient. It can be more compute
+   * efficient for tables with over 1000 rows, and a scan that SQLite stops
+   * early, for a LIMIT or a join, never generates the remaining rows.
+   *
+   * Scans that are cached or shared between queries read the complete content
+   * through generate instead.
    *
    * @param yield a callable that takes a single Row as input.
    * @param context a query context filled in by SQLite's virtual table API.
@@ -910,7 +947,9 @@ class TablePlugin : public Plugin {
   FRIEND_TEST(VirtualTableTests, test_indexing_costs);
   FRIEND_TEST(VirtualTableTests, test_table_results_cache);
   FRIEND_TEST(VirtualTableTests, test_table_results_cache_colcheck);
+  FRIEND_TEST(VirtualTableTests, test_table_scan_cache);
   FRIEND_TEST(VirtualTableTests, test_yield_generator);
+  FRIEND_TEST(VirtualTableTests, test_yield_generator_limit);
 };
 
 /// Helper method to generate the virtual table CREATE statement.
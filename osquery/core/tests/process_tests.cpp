@@ -153,6 +153,25 @@ TEST_F(ProcessTests, test_getpid) {
   EXPECT_EQ(process->pid(), pid);
 }
 
+#if OSQUERY_LINUX
+TEST_F(ProcessTests, test_resourceUsage) {
+  ProcessResourceUsage usage;
+  auto status = platformGetProcessResourceUsage(getpid(), usage);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(usage.parent, getppid());
+  EXPECT_GT(usage.resident_size, 0U);
+  EXPECT_GE(usage.total_size, usage.resident_size);
+
+  ProcessResourceUsage thread_usage;
+  status = platformGetThreadResourceUsage(thread_usage);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_GT(thread_usage.resident_size, 0U);
+
+  // There is no such process.
+  EXPECT_FALSE(platformGetProcessResourceUsage(-1, usage).ok());
+}
+#endif
+
 TEST_F(ProcessTests, test_envVar) {
   auto val = getEnvVar("GTEST_OSQUERY");
   EXPECT_FALSE(val);
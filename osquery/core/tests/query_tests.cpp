@@ -216,6 +216,81 @@ TEST_F(QueryTests, test_get_stored_query_names) {
   EXPECT_NE(in_vector, names.end());
 }
 
+TEST_F(QueryTests, test_query_metadata) {
+  QueryMetadata metadata;
+  metadata.query_hash = RowHash{1, 2};
+  metadata.epoch = 100;
+  metadata.counter = 7;
+  metadata.fingerprint = RowHash{0xffffffffffffffffULL, 3};
+  metadata.has_results = true;
+  metadata.has_fingerprint = true;
+
+  QueryMetadata parsed;
+  auto status =
+      deserializeQueryMetadata(serializeQueryMetadata(metadata), parsed);
+  ASSERT_TRUE(status.ok()) << status.what();
+  EXPECT_EQ(parsed.query_hash, metadata.query_hash);
+  EXPECT_EQ(parsed.epoch, 100U);
+  EXPECT_EQ(parsed.counter, 7U);
+  EXPECT_EQ(parsed.fingerprint, metadata.fingerprint);
+  EXPECT_TRUE(parsed.has_results);
+  EXPECT_FALSE(parsed.has_query);
+  EXPECT_FALSE(parsed.has_counter);
+  EXPECT_TRUE(parsed.has_fingerprint);
+
+  EXPECT_FALSE(deserializeQueryMetadata("", parsed).ok());
+  EXPECT_FALSE(deserializeQueryMetadata("1:a:b:c:d:e", parsed).ok());
+}
+
+TEST_F(QueryTests, test_legacy_query_metadata) {
+  // Results, epoch, counter and query text stored by a previous version.
+  auto query = getOsqueryScheduledQuery();
+  auto encoded_qd = getSerializedQueryDataJSON();
+  setDatabaseValue(kQueries, "legacy_query", encoded_qd.first);
+  setDatabaseValue(kQueries, "legacy_queryepoch", "5");
+  setDatabaseValue(kQueries, "legacy_querycounter", "3");
+  setDatabaseValue(kQueries, "query.legacy_query", query.query);
+
+  auto cf = Query("legacy_query", query);
+  EXPECT_TRUE(cf.isQueryNameInDatabase());
+  EXPECT_FALSE(cf.isNewQuery());
+  EXPECT_EQ(cf.getPreviousEpoch(), 5U);
+  EXPECT_EQ(cf.getQueryCounter(false), 4U);
+
+  // The same results produce no differential.
+  DiffResults dr;
+  uint64_t counter = 0;
+  auto status = cf.addNewResults(encoded_qd.second, 5, counter, dr);
+  ASSERT_TRUE(status.ok()) << status.what();
+  EXPECT_TRUE(dr.hasNoResults());
+
+  // The metadata record replaces the legacy keys.
+  std::string raw;
+  EXPECT_FALSE(getDatabaseValue(kQueries, "legacy_queryepoch", raw).ok());
+  EXPECT_FALSE(getDatabaseValue(kQueries, "legacy_querycounter", raw).ok());
+  EXPECT_FALSE(getDatabaseValue(kQueries, "query.legacy_query", raw).ok());
+  ASSERT_TRUE(
+      getDatabaseValue(kQueries, kQueryMetadataPrefix + "legacy_query", raw)
+          .ok());
+
+  QueryMetadata metadata;
+  ASSERT_TRUE(deserializeQueryMetadata(raw, metadata).ok());
+  EXPECT_EQ(metadata.epoch, 5U);
+  EXPECT_EQ(metadata.counter, 3U);
+  EXPECT_TRUE(metadata.has_fingerprint);
+
+  // A new instance reads the record, changed results are diffed.
+  auto cf2 = Query("legacy_query", query);
+  EXPECT_FALSE(cf2.isNewQuery());
+  auto results = encoded_qd.second;
+  results.pop_back();
+  status = cf2.addNewResults(results, 5, counter, dr);
+  ASSERT_TRUE(status.ok()) << status.what();
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_EQ(dr.removed.size(), 1U);
+  EXPECT_EQ(counter, 4U);
+}
+
 TEST_F(QueryTests, test_is_snapshot_query) {
   auto sq = ScheduledQuery();
 
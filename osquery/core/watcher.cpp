@@ -541,6 +541,18 @@ Status WatcherRunner::isWatcherHealthy(const PlatformProcess& watcher,
 }
 
 QueryData WatcherRunner::getProcessRow(pid_t pid) const {
+  // Sampling the process directly avoids running a query at each interval.
+  ProcessResourceUsage usage;
+  if (platformGetProcessResourceUsage(pid, usage).ok()) {
+    Row r;
+    r["parent"] = std::to_string(usage.parent);
+    r["user_time"] = std::to_string(usage.user_time);
+    r["system_time"] = std::to_string(usage.system_time);
+    r["resident_size"] = std::to_string(usage.resident_size);
+    r["total_size"] = std::to_string(usage.total_size);
+    return {r};
+  }
+
   // On Windows, pid_t = DWORD, which is unsigned. However invalidity
   // of processes is denoted by a pid_t of -1. We check for this
   // by comparing the max value of DWORD, or ULONG_MAX, and then casting
@@ -268,7 +268,7 @@ class WatcherRunner : public InternalRunnable {
   virtual Status isWatcherHealthy(const PlatformProcess& watcher,
                                   PerformanceState& watcher_state) const;
 
-  /// Get row data from the processes table for a given pid.
+  /// Get the processes table columns for a pid, sampled directly if possible.
   virtual QueryData getProcessRow(pid_t pid) const;
 
  private:
@@ -7,9 +7,12 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <benchmark/benchmark.h>
 
 #include <osquery/core/query.h>
+#include <osquery/core/sql/diff_results.h>
 #include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 
@@ -48,6 +51,22 @@ QueryDataSet getExampleQueryDataSet(size_t x, size_t y) {
   return qds;
 }
 
+QueryDataTyped getExampleQueryDataTyped(size_t x, size_t y, size_t offset) {
+  QueryDataTyped qd;
+  qd.reserve(y);
+
+  // Fill in the vector with y distinct rows of x columns.
+  for (size_t i = 0; i < y; i++) {
+    RowTyped r;
+    r["id"] = static_cast<long long>(i + offset);
+    for (size_t j = 1; j < x; j++) {
+      r["key" + std::to_string(j)] = std::to_string(j) + "content";
+    }
+    qd.push_back(std::move(r));
+  }
+  return qd;
+}
+
 ColumnNames getExampleColumnNames(size_t x) {
   ColumnNames cn;
   for (size_t i = 0; i < x; i++) {
@@ -94,31 +113,126 @@ BENCHMARK(DATABASE_serialize_json)
     ->ArgPair(10, 10)
     ->ArgPair(10, 100);
 
+static void DATABASE_serialize_results_json(benchmark::State& state) {
+  auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), 0);
+  std::string content;
+  while (state.KeepRunning()) {
+    content.clear();
+    serializeQueryDataJSON(qd, content, false);
+  }
+  state.counters["stored_bytes"] = static_cast<double>(content.size());
+}
+
+BENCHMARK(DATABASE_serialize_results_json)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000);
+
+static void DATABASE_serialize_results_indexed(benchmark::State& state) {
+  auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), 0);
+  std::string content;
+  while (state.KeepRunning()) {
+    serializeIndexedResults(qd, content);
+  }
+  state.counters["stored_bytes"] = static_cast<double>(content.size());
+}
+
+BENCHMARK(DATABASE_serialize_results_indexed)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000);
+
+static void DATABASE_deserialize_results_json(benchmark::State& state) {
+  auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), 0);
+  std::string content;
+  serializeQueryDataJSON(qd, content, false);
+  while (state.KeepRunning()) {
+    QueryDataSet results;
+    deserializeQueryDataJSON(content, results);
+  }
+}
+
+BENCHMARK(DATABASE_deserialize_results_json)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000);
+
+static void DATABASE_deserialize_results_indexed(benchmark::State& state) {
+  auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), 0);
+  std::string content;
+  serializeIndexedResults(qd, content);
+  while (state.KeepRunning()) {
+    QueryDataSet results;
+    deserializeIndexedResults(content, results);
+  }
+}
+
+BENCHMARK(DATABASE_deserialize_results_indexed)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 10000);
+
 static void DATABASE_diff(benchmark::State& state) {
-  QueryData qd = getExampleQueryData(state.range(0), state.range(1));
-  QueryDataSet qds = getExampleQueryDataSet(state.range(0), state.range(1));
+  // The current results differ from the previous by 1% of their rows.
+  auto offset = std::max<size_t>(1, state.range(1) / 100);
+  auto previous = getExampleQueryDataTyped(state.range(0), state.range(1), 0);
+  QueryDataSet qds(previous.begin(), previous.end());
   while (state.KeepRunning()) {
+    auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), offset);
     auto d = diff(qds, qd);
   }
 }
 
-BENCHMARK(DATABASE_diff)->ArgPair(1, 1)->ArgPair(10, 10)->ArgPair(10, 100);
+BENCHMARK(DATABASE_diff)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 100000);
+
+static void DATABASE_diff_indexed(benchmark::State& state) {
+  auto offset = std::max<size_t>(1, state.range(1) / 100);
+  auto previous = getExampleQueryDataTyped(state.range(0), state.range(1), 0);
+  std::string index;
+  serializeIndexedResults(previous, index);
+  while (state.KeepRunning()) {
+    auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), offset);
+    DiffResults d;
+    std::string current_index;
+    diffIndexedResults(index, qd, d, current_index);
+  }
+}
+
+BENCHMARK(DATABASE_diff_indexed)
+    ->ArgPair(1, 1)
+    ->ArgPair(10, 10)
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 100000);
 
 static void DATABASE_query_results(benchmark::State& state) {
-  auto qd = getExampleQueryData(state.range(0), state.range(1));
   auto query = getOsqueryScheduledQuery();
+  auto dbq = Query("default", query);
+  size_t k = 0;
   while (state.KeepRunning()) {
+    // Alternate the result sets so every run stores a differential.
+    auto qd = getExampleQueryDataTyped(state.range(0), state.range(1), k++ % 2);
     DiffResults diff_results;
-    uint64_t counter;
-    auto dbq = Query("default", query);
+    uint64_t counter = 0;
     dbq.addNewResults(std::move(qd), 0, counter, diff_results);
   }
+  // All benchmarks will share a single database handle.
+  deleteDatabaseValue(kQueries, "default");
+  deleteDatabaseValue(kQueries, kQueryMetadataPrefix + "default");
 }
 
 BENCHMARK(DATABASE_query_results)
     ->ArgPair(1, 1)
     ->ArgPair(10, 10)
-    ->ArgPair(10, 100);
+    ->ArgPair(10, 100)
+    ->ArgPair(10, 100000);
 
 static void DATABASE_get(benchmark::State& state) {
   setDatabaseValue(kPersistentSettings, "benchmark", "1");
@@ -177,4 +291,110 @@ static void DATABASE_store_append(benchmark::State& state) {
 }
 
 BENCHMARK(DATABASE_store_append);
+
+/// Zero-pad indexes so the keys sort by their index, as event keys do.
+static std::string getOrderedKey(const std::string& prefix, size_t index) {
+  auto key = std::to_string(index);
+  return prefix + std::string(10 - std::min<size_t>(key.size(), 10), '0') +
+         key;
+}
+
+static void DATABASE_events_append_expire(benchmark::State& state) {
+  // Events are appended with time-ordered keys and expired as a range,
+  // keeping a window of the last few batches.
+  const std::string prefix = "data.benchmark.events.";
+  const size_t window = 4;
+  size_t batches = 0;
+  while (state.KeepRunning()) {
+    DatabaseStringValueList batch;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      batch.push_back(std::make_pair(
+          getOrderedKey(prefix, batches * state.range(0) + i), "content"));
+    }
+    setDatabaseBatch(kEvents, batch);
+
+    if (++batches > window) {
+      auto expired = (batches - window - 1) * state.range(0);
+      deleteDatabaseRange(kEvents,
+                          getOrderedKey(prefix, expired),
+                          getOrderedKey(prefix, expired + state.range(0) - 1));
+    }
+  }
+
+  // All benchmarks will share a single database handle.
+  deleteDatabaseRange(kEvents,
+                      getOrderedKey(prefix, 0),
+                      getOrderedKey(prefix, batches * state.range(0)));
+}
+
+BENCHMARK(DATABASE_events_append_expire)->Arg(10)->Arg(100)->Arg(1000);
+
+static void DATABASE_queries_overwrite(benchmark::State& state) {
+  // Each scheduled query overwrites its previous results.
+  std::string content;
+  auto qd = getExampleQueryDataTyped(10, state.range(1), 0);
+  serializeQueryDataJSON(qd, content, false);
+
+  size_t k = 0;
+  while (state.KeepRunning()) {
+    setDatabaseValue(
+        kQueries, "benchmark" + std::to_string(k++ % state.range(0)), content);
+  }
+
+  // All benchmarks will share a single database handle.
+  for (int64_t i = 0; i < state.range(0); i++) {
+    deleteDatabaseValue(kQueries, "benchmark" + std::to_string(i));
+  }
+}
+
+BENCHMARK(DATABASE_queries_overwrite)
+    ->ArgPair(1, 100)
+    ->ArgPair(100, 100)
+    ->ArgPair(100, 1000);
+
+static void DATABASE_logs_buffer(benchmark::State& state) {
+  // Buffered logs are written, scanned in order, then removed once sent.
+  const std::string prefix = "result.";
+  size_t index = 0;
+  while (state.KeepRunning()) {
+    for (int64_t i = 0; i < state.range(0); i++) {
+      setDatabaseValue(kLogs, getOrderedKey(prefix, index++), "content");
+    }
+
+    std::vector<std::string> keys;
+    scanDatabaseKeys(kLogs, keys, prefix, 0);
+    for (const auto& key : keys) {
+      deleteDatabaseValue(kLogs, key);
+    }
+  }
+}
+
+BENCHMARK(DATABASE_logs_buffer)->Arg(10)->Arg(100)->Arg(1000);
+
+static void DATABASE_scan_prefix(benchmark::State& state) {
+  // Only one of the key prefixes is scanned.
+  const std::vector<std::string> prefixes = {
+      "data.benchmark.", "eid.benchmark.", "indexes.benchmark.", "optimize."};
+  for (const auto& prefix : prefixes) {
+    DatabaseStringValueList batch;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      batch.push_back(std::make_pair(getOrderedKey(prefix, i), "content"));
+    }
+    setDatabaseBatch(kEvents, batch);
+  }
+
+  while (state.KeepRunning()) {
+    std::vector<std::string> keys;
+    scanDatabaseKeys(kEvents, keys, "indexes.", 0);
+  }
+
+  // All benchmarks will share a single database handle.
+  for (const auto& prefix : prefixes) {
+    deleteDatabaseRange(kEvents,
+                        getOrderedKey(prefix, 0),
+                        getOrderedKey(prefix, state.range(0)));
+  }
+}
+
+BENCHMARK(DATABASE_scan_prefix)->Arg(100)->Arg(10000);
 }
@@ -7,12 +7,15 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/io/quoted.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/diff_results.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
@@ -51,6 +54,9 @@ const std::string kDbCounterSuffix = "counter";
 
 const std::string kDbVersionKey = "results_version";
 
+/// Number of event rows converted per write batch by the V2 to V3 migration.
+const size_t kMigrationBatchSize = 1024;
+
 const std::vector<std::string> kDomains = {
     kPersistentSettings, kQueries, kEvents, kLogs, kCarves};
 
@@ -113,6 +119,69 @@ Status DatabasePlugin::scan(const std::string& domain,
   return Status::success();
 }
 
+namespace {
+
+/// Visit the keys found by a key scan, getting each value.
+Status visitScannedKeys(
+    std::vector<std::string>& keys,
+    const DatabaseScanOptions& options,
+    const std::function<Status(const std::string&, std::string&)>& get_value,
+    const DatabaseScanVisitor& visitor) {
+  std::sort(keys.begin(), keys.end());
+
+  size_t count = 0;
+  std::string value;
+  for (const auto& key : keys) {
+    if (!options.low.empty() && key < options.low) {
+      continue;
+    }
+
+    if (!options.high.empty() && key > options.high) {
+      break;
+    }
+
+    // The key may have been removed since the scan.
+    value.clear();
+    if (!options.keys_only && !get_value(key, value).ok()) {
+      continue;
+    }
+
+    if (!visitor(key, value)) {
+      break;
+    }
+
+    if (options.max > 0 && ++count >= options.max) {
+      break;
+    }
+  }
+
+  return Status::success();
+}
+
+} // namespace
+
+Status DatabasePlugin::scanValues(const std::string& domain,
+                                  const DatabaseScanOptions& options,
+                                  const DatabaseScanVisitor& visitor) const {
+  std::vector<std::string> keys;
+  auto status = scan(domain, keys, options.prefix, 0);
+  if (!status.ok()) {
+    return status;
+  }
+
+  return visitScannedKeys(
+      keys,
+      options,
+      [this, &domain](const std::string& key, std::string& value) {
+        return get(domain, key, value);
+      },
+      visitor);
+}
+
+Status DatabasePlugin::stats(PluginResponse& response) const {
+  return Status::success();
+}
+
 Status DatabasePlugin::call(const PluginRequest& request,
                             PluginResponse& response) {
   if (request.count("action") == 0) {
@@ -204,6 +273,8 @@ Status DatabasePlugin::call(const PluginRequest& request,
       response.push_back({{"k", k}});
     }
     return status;
+  } else if (request.at("action") == "stats") {
+    return this->stats(response);
   }
 
   return Status(1, "Unknown database plugin action");
@@ -437,6 +508,59 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status scanDatabaseValues(const std::string& domain,
+                          const DatabaseScanOptions& options,
+                          const DatabaseScanVisitor& visitor) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // Extensions only reach the database through key scans and lookups.
+    std::vector<std::string> keys;
+    auto status = scanDatabaseKeys(domain, keys, options.prefix, 0);
+    if (!status.ok()) {
+      return status;
+    }
+
+    return visitScannedKeys(
+        keys,
+        options,
+        [&domain](const std::string& key, std::string& value) {
+          return getDatabaseValue(domain, key, value);
+        },
+        visitor);
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot scan database values: " +
+                             options.prefix);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanValues(domain, options, visitor);
+  }
+}
+
+Status getDatabaseStats(PluginResponse& stats) {
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    PluginRequest request = {{"action", "stats"}};
+    return Registry::call("database", request, stats);
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status(1, "Database not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status(1, "No active database plugin");
+  }
+  return plugin->stats(stats);
+}
+
 void resetDatabase() {
   PluginRequest request = {{"action", "reset"}};
   Registry::call("database", request);
@@ -546,7 +670,8 @@ static Status migrateV0V1(void) {
     // Skip over epoch and counter entries, as 0 is parsed by ptree
     if (boost::algorithm::ends_with(key, kDbEpochSuffix) ||
         boost::algorithm::ends_with(key, kDbCounterSuffix) ||
-        boost::algorithm::starts_with(key, "query.")) {
+        boost::algorithm::starts_with(key, "query.") ||
+        boost::algorithm::starts_with(key, "meta.")) {
       continue;
     }
 
@@ -617,6 +742,176 @@ static Status migrateV1V2(void) {
   return Status::success();
 }
 
+static Status migrateV2V3(void) {
+  // Scheduled query results are converted from JSON arrays to the
+  // hash-indexed results format.
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kQueries, keys);
+  if (!s.ok()) {
+    return Status::failure("Failed to scan query keys from database: " +
+                           s.what());
+  }
+
+  for (const auto& key : keys) {
+    if (boost::algorithm::ends_with(key, kDbEpochSuffix) ||
+        boost::algorithm::ends_with(key, kDbCounterSuffix) ||
+        boost::algorithm::starts_with(key, "query.") ||
+        boost::algorithm::starts_with(key, "meta.")) {
+      continue;
+    }
+
+    std::string value;
+    s = getDatabaseValue(kQueries, key, value);
+    if (!s.ok() || isIndexedResults(value)) {
+      continue;
+    }
+
+    QueryDataSet previous;
+    s = deserializeQueryDataJSON(value, previous);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to parse query results for key '" << key
+                   << "'. Key will be kept but won't be migrated!";
+      continue;
+    }
+
+    QueryDataTyped results(previous.begin(), previous.end());
+    s = serializeIndexedResults(results, value);
+    if (s.ok()) {
+      s = setDatabaseValue(kQueries, key, value);
+    }
+    if (!s.ok()) {
+      LOG(ERROR) << "Failed to migrate query results for key '" << key
+                 << "': " << s.getMessage();
+    }
+  }
+
+  // Event rows are converted from JSON objects to the binary row format.
+  keys.clear();
+  s = scanDatabaseKeys(kEvents, keys, "data.", 0);
+  if (!s.ok()) {
+    return Status::failure("Failed to scan event keys from database: " +
+                           s.what());
+  }
+
+  DatabaseStringValueList batch;
+  for (const auto& key : keys) {
+    std::string value;
+    s = getDatabaseValue(kEvents, key, value);
+    if (!s.ok() || isBinaryRow(value)) {
+      continue;
+    }
+
+    // Rows that cannot be parsed are removed when the event index is built.
+    Row row;
+    if (!deserializeRowJSON(value, row).ok()) {
+      continue;
+    }
+
+    serializeRowBinary(row, value);
+    batch.emplace_back(key, std::move(value));
+    if (batch.size() == kMigrationBatchSize) {
+      s = setDatabaseBatch(kEvents, batch);
+      if (!s.ok()) {
+        return Status::failure("Failed to write migrated events: " +
+                               s.what());
+      }
+      batch.clear();
+    }
+  }
+
+  if (!batch.empty()) {
+    s = setDatabaseBatch(kEvents, batch);
+    if (!s.ok()) {
+      return Status::failure("Failed to write migrated events: " + s.what());
+    }
+  }
+
+  return Status::success();
+}
+
+static Status migrateV3V4(void) {
+  // Event keys move from "data.<type>.<name>.<eid>" to time-ordered keys
+  // "data.<type>.<name>.<time>.<eid>", the time is read from the stored row.
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kEvents, keys, "data.", 0);
+  if (!s.ok()) {
+    return Status::failure("Failed to scan event keys from database: " +
+                           s.what());
+  }
+
+  auto pad = [](std::string index) {
+    if (index.size() < 10) {
+      index.insert(index.begin(), 10 - index.size(), '0');
+    }
+    return index;
+  };
+
+  DatabaseStringValueList batch;
+  std::vector<std::string> legacy_keys;
+  auto flush = [&batch, &legacy_keys]() {
+    auto status = setDatabaseBatch(kEvents, batch);
+    if (!status.ok()) {
+      return Status::failure("Failed to write migrated events: " +
+                             status.what());
+    }
+    for (const auto& key : legacy_keys) {
+      status = deleteDatabaseValue(kEvents, key);
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to delete key '" << key
+                     << "' after migration. Original key will be kept but "
+                     << "data was migrated!";
+      }
+    }
+    batch.clear();
+    legacy_keys.clear();
+    return Status::success();
+  };
+
+  for (const auto& key : keys) {
+    // Keys already holding a time have an additional separator.
+    if (std::count(key.begin(), key.end(), '.') != 3) {
+      continue;
+    }
+
+    // Rows that cannot be parsed are removed when the event index is built.
+    std::string value;
+    s = getDatabaseValue(kEvents, key, value);
+    if (!s.ok()) {
+      continue;
+    }
+
+    Row row;
+    s = isBinaryRow(value) ? deserializeRowBinary(value, row)
+                           : deserializeRowJSON(value, row);
+    if (!s.ok() || row.count("time") == 0) {
+      continue;
+    }
+
+    auto time = tryTo<uint64_t>(row.at("time"));
+    if (time.isError()) {
+      continue;
+    }
+
+    auto pos = key.rfind('.') + 1;
+    batch.emplace_back(key.substr(0, pos) + pad(std::to_string(time.take())) +
+                           "." + key.substr(pos),
+                       std::move(value));
+    legacy_keys.push_back(key);
+    if (batch.size() == kMigrationBatchSize) {
+      s = flush();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+
+  if (!batch.empty()) {
+    return flush();
+  }
+
+  return Status::success();
+}
+
 Status upgradeDatabase(int to_version) {
   std::string value;
   Status st = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
@@ -648,6 +943,14 @@ Status upgradeDatabase(int to_version) {
       migrate_status = migrateV1V2();
       break;
 
+    case 2:
+      migrate_status = migrateV2V3();
+      break;
+
+    case 3:
+      migrate_status = migrateV3V4();
+      break;
+
     default:
       LOG(ERROR) << "Logic error: the migration code is broken!";
       migrate_status = Status::failure("Migration code broken.");
@@ -734,6 +1037,13 @@ class OsqueryDatabase final : public IDatabaseInterface {
                                   size_t max) const override {
     return osquery::scanDatabaseKeys(domain, keys, prefix, max);
   }
+
+  virtual Status scanDatabaseValues(
+      const std::string& domain,
+      const DatabaseScanOptions& options,
+      const DatabaseScanVisitor& visitor) const override {
+    return osquery::scanDatabaseValues(domain, options, visitor);
+  }
 };
 
 IDatabaseInterface& getOsqueryDatabase() {
@@ -53,7 +53,7 @@ extern const std::string kCarves;
 extern const std::string kDbVersionKey;
 
 /// The running version of our database schema
-const int kDbCurrentVersion = 2;
+const int kDbCurrentVersion = 4;
 
 /**
  * @brief The "domain" where buffered log results are stored.
@@ -139,6 +139,24 @@ class DatabasePlugin : public Plugin {
                       const std::string& prefix,
                       uint64_t max) const;
 
+  /**
+   * @brief Visit the keys and values within bounds, in ascending key order.
+   *
+   * Plugins should read the keys and values with a single iterator. The
+   * default implementation scans the keys then gets each value.
+   */
+  virtual Status scanValues(const std::string& domain,
+                            const DatabaseScanOptions& options,
+                            const DatabaseScanVisitor& visitor) const;
+
+  /**
+   * @brief Report backing store statistics, one row per domain.
+   *
+   * The columns are up to the plugin, backing stores without statistics
+   * return no rows.
+   */
+  virtual Status stats(PluginResponse& response) const;
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -239,6 +257,19 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         uint64_t max = 0);
 
+/**
+ * @brief Visit the keys and values of a domain in a single pass.
+ *
+ * This avoids a lookup per key after a scanDatabaseKeys. The visitor may not
+ * call back into the database.
+ */
+Status scanDatabaseValues(const std::string& domain,
+                          const DatabaseScanOptions& options,
+                          const DatabaseScanVisitor& visitor);
+
+/// Get the statistics of the active database plugin, one row per domain.
+Status getDatabaseStats(PluginResponse& stats);
+
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
@@ -65,6 +65,11 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key/value iteration method.
+  Status scanValues(const std::string& domain,
+                    const DatabaseScanOptions& options,
+                    const DatabaseScanVisitor& visitor) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override {
@@ -199,4 +204,47 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
   }
   return Status(0);
 }
+
+Status EphemeralDatabasePlugin::scanValues(
+    const std::string& domain,
+    const DatabaseScanOptions& options,
+    const DatabaseScanVisitor& visitor) const {
+  auto domainIterator = db_.find(domain);
+  if (domainIterator == db_.end()) {
+    return Status(0);
+  }
+
+  const auto& keys = domainIterator->second;
+  size_t count = 0;
+  std::string value;
+  for (auto it = keys.lower_bound(std::max(options.prefix, options.low));
+       it != keys.end();
+       ++it) {
+    const auto& key = it->first;
+    if (key.compare(0, options.prefix.size(), options.prefix) != 0 ||
+        (!options.high.empty() && key > options.high)) {
+      break;
+    }
+
+    value.clear();
+    if (!options.keys_only) {
+      // Integer values are visited as strings.
+      const auto* string_value = boost::get<std::string>(&it->second);
+      if (string_value != nullptr) {
+        value = *string_value;
+      } else {
+        value = std::to_string(boost::get<int>(it->second));
+      }
+    }
+
+    if (!visitor(key, value)) {
+      break;
+    }
+
+    if (options.max > 0 && ++count >= options.max) {
+      break;
+    }
+  }
+  return Status(0);
+}
 } // namespace osquery
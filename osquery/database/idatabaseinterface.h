@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -20,6 +22,29 @@ namespace osquery {
 using DatabaseStringValueList =
     std::vector<std::pair<std::string, std::string>>;
 
+/// Bounds of a key/value scan, keys are visited in ascending order.
+struct DatabaseScanOptions final {
+  /// Only visit the keys starting with this prefix.
+  std::string prefix;
+
+  /// Inclusive lower bound of the visited keys, unbounded when empty.
+  std::string low;
+
+  /// Inclusive upper bound of the visited keys, unbounded when empty.
+  std::string high;
+
+  /// Maximum number of visited keys, 0 for no limit.
+  std::size_t max{0U};
+
+  /// Skip reading the values, the visitor receives empty values.
+  bool keys_only{false};
+};
+
+/// Receives each key and value of a scan, returning false stops the scan.
+/// The references are only valid for the duration of the call.
+using DatabaseScanVisitor =
+    std::function<bool(const std::string& key, const std::string& value)>;
+
 class IDatabaseInterface {
  public:
   IDatabaseInterface() = default;
@@ -60,6 +85,11 @@ class IDatabaseInterface {
                                   const std::string& prefix,
                                   size_t max) const = 0;
 
+  virtual Status scanDatabaseValues(
+      const std::string& domain,
+      const DatabaseScanOptions& options,
+      const DatabaseScanVisitor& visitor) const = 0;
+
   IDatabaseInterface(const IDatabaseInterface&) = delete;
   IDatabaseInterface& operator=(const IDatabaseInterface&) = delete;
 };
@@ -8,6 +8,7 @@
  */
 
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/diff_results.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/registry/registry.h>
@@ -294,4 +295,81 @@ TEST_F(DatabaseTests, test_migration_v1v2) {
   EXPECT_EQ(value, "event_data");
 }
 
+TEST_F(DatabaseTests, test_migration_v2v3) {
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "2");
+  ASSERT_TRUE(status.ok());
+
+  status = setDatabaseValue(
+      kQueries, "json_results", "[{\"name\":\"a\"},{\"name\":\"b\"}]");
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kQueries, "json_resultsepoch", "10");
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kEvents,
+                            "data.type.name.0000000001",
+                            "{\"time\":\"1\",\"eid\":\"1\"}");
+  ASSERT_TRUE(status.ok());
+
+  status = upgradeDatabase(3);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  status = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "3");
+
+  status = getDatabaseValue(kQueries, "json_results", value);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(isIndexedResults(value));
+  QueryDataSet results;
+  ASSERT_TRUE(deserializeIndexedResults(value, results).ok());
+  EXPECT_EQ(results.size(), 2U);
+
+  status = getDatabaseValue(kQueries, "json_resultsepoch", value);
+  EXPECT_EQ(value, "10");
+
+  status = getDatabaseValue(kEvents, "data.type.name.0000000001", value);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(isBinaryRow(value));
+  Row row;
+  ASSERT_TRUE(deserializeRowBinary(value, row).ok());
+  EXPECT_EQ(row, (Row{{"time", "1"}, {"eid", "1"}}));
+}
+
+TEST_F(DatabaseTests, test_migration_v3v4) {
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "3");
+  ASSERT_TRUE(status.ok());
+
+  std::string binary_row;
+  serializeRowBinary(Row{{"time", "5"}, {"eid", "1"}}, binary_row);
+  status = setDatabaseValue(kEvents, "data.type.name.0000000001", binary_row);
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kEvents,
+                            "data.type.name.0000000002",
+                            "{\"time\":\"1500000000\",\"eid\":\"2\"}");
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(
+      kEvents, "data.type.name.0000000007.0000000003", binary_row);
+  ASSERT_TRUE(status.ok());
+
+  status = upgradeDatabase(4);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  status = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "4");
+
+  std::vector<std::string> keys;
+  status = scanDatabaseKeys(kEvents, keys, "data.type.name.", 0);
+  ASSERT_TRUE(status.ok());
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys,
+            (std::vector<std::string>{"data.type.name.0000000005.0000000001",
+                                      "data.type.name.0000000007.0000000003",
+                                      "data.type.name.1500000000.0000000002"}));
+
+  status =
+      getDatabaseValue(kEvents, "data.type.name.0000000005.0000000001", value);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(value, binary_row);
+}
+
 } // namespace osquery
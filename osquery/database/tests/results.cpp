@@ -9,7 +9,9 @@
 
 #include <osquery/database/database.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/core/query.h>
+#include <osquery/core/sql/columnar_rows.h>
 #include <osquery/core/sql/diff_results.h>
 #include <osquery/core/sql/query_data.h>
 #include <osquery/sql/tests/sql_test_utils.h>
@@ -20,7 +22,68 @@
 
 namespace osquery {
 
-class ResultsTests : public testing::Test {};
+DECLARE_bool(decorations_top_level);
+DECLARE_bool(logger_numerics);
+
+class ResultsTests : public testing::Test {
+ protected:
+  void TearDown() override {
+    FLAGS_decorations_top_level = false;
+    FLAGS_logger_numerics = false;
+  }
+
+ public:
+  QueryLogItem getDecoratedQueryLogItem() {
+    QueryLogItem item;
+    item.name = "decorated";
+    item.identifier = "host\"name";
+    item.calendar_time = "Mon Oct 12 00:00:00 2026 UTC";
+    item.time = 1760227200;
+    item.epoch = 2;
+    item.counter = 3;
+    item.decorations["load_average"] = "0.5";
+    item.decorations["username"] = "root";
+
+    RowTyped removed;
+    removed["path"] = "/bin/\u00e9";
+    removed["pid"] = 100LL;
+    item.results.removed.push_back(removed);
+
+    for (long long i = 0; i < 3; i++) {
+      RowTyped added;
+      added["path"] = "/bin/" + std::to_string(i);
+      added["pid"] = i;
+      added["user_time"] = 1.5 * i;
+      item.results.added.push_back(added);
+    }
+    return item;
+  }
+
+  /// Serialize events through a JSON document.
+  std::vector<std::string> getDocumentEvents(const QueryLogItem& item) {
+    auto doc = JSON::newArray();
+    EXPECT_TRUE(serializeQueryLogItemAsEvents(item, doc).ok());
+
+    std::vector<std::string> events;
+    for (const auto& event : doc.doc().GetArray()) {
+      rapidjson::StringBuffer sb;
+      rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+      event.Accept(writer);
+      events.push_back(sb.GetString());
+    }
+    return events;
+  }
+
+  /// Serialize a log item through a JSON document.
+  std::string getDocumentJSON(const QueryLogItem& item) {
+    auto doc = JSON::newObject();
+    EXPECT_TRUE(serializeQueryLogItem(item, doc).ok());
+
+    std::string json;
+    doc.toString(json);
+    return json;
+  }
+};
 
 TEST_F(ResultsTests, test_simple_diff) {
   QueryDataSet os;
@@ -36,6 +99,144 @@ TEST_F(ResultsTests, test_simple_diff) {
   EXPECT_EQ(results.removed, o);
 }
 
+TEST_F(ResultsTests, test_indexed_results) {
+  auto results = getSerializedQueryDataJSON();
+  QueryDataSet expected(results.second.begin(), results.second.end());
+
+  std::string index;
+  auto s = serializeIndexedResults(results.second, index);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(isIndexedResults(index));
+  EXPECT_FALSE(isIndexedResults(results.first));
+
+  QueryDataSet output;
+  s = deserializeIndexedResults(index, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, expected);
+
+  // Truncated results must not be read.
+  s = deserializeIndexedResults(index.substr(0, index.size() - 1), output);
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(ResultsTests, test_indexed_diff) {
+  RowTyped r1, r2, r3;
+  r1["foo"] = "bar";
+  r1["num"] = 1LL;
+  r2["foo"] = "bar";
+  r2["num"] = 2LL;
+  // Same column values as r2, but a different type.
+  r3["foo"] = "bar";
+  r3["num"] = "2";
+
+  QueryDataTyped previous{r1, r2, r2};
+  QueryDataTyped current{r3, r2, r1};
+  QueryDataSet previous_set(previous.begin(), previous.end());
+  auto expected = diff(previous_set, current);
+
+  std::string index;
+  EXPECT_TRUE(serializeIndexedResults(previous, index).ok());
+
+  DiffResults dr;
+  std::string current_index;
+  auto s = diffIndexedResults(index, current, dr, current_index);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(dr, expected);
+  EXPECT_EQ(dr.added, QueryDataTyped{r3});
+  EXPECT_EQ(dr.removed, QueryDataTyped{r2});
+
+  // The differential to the same results is empty and needs no new index.
+  DiffResults empty;
+  std::string unchanged;
+  s = diffIndexedResults(current_index, current, empty, unchanged);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(empty.added.empty());
+  EXPECT_TRUE(empty.removed.empty());
+  EXPECT_TRUE(unchanged.empty());
+}
+
+/// A batch layout whose columns are not in name order.
+static const TableColumns kColumnarLayout = {
+    std::make_tuple("num", BIGINT_TYPE, ColumnOptions::DEFAULT),
+    std::make_tuple("foo", TEXT_TYPE, ColumnOptions::DEFAULT),
+    std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+};
+
+/// Fill a batch and the QueryDataTyped a query over its rows would return.
+static void getColumnarQueryData(ColumnarRows& batch, QueryDataTyped& typed) {
+  RowTyped r1, r2;
+  batch.append();
+  batch.setText(1, "bar");
+  batch.setInteger(0, 1);
+  batch.setDouble(2, 0.5);
+  r1["foo"] = "bar";
+  r1["num"] = 1LL;
+  r1["ratio"] = 0.5;
+
+  // Unset columns are omitted and malformed numbers keep their text.
+  batch.append();
+  batch.setText(1, "baz");
+  batch.setString(0, "");
+  r2["foo"] = "baz";
+  r2["num"] = "";
+
+  batch.append();
+  batch.setText(1, "bar");
+  batch.setInteger(0, 1);
+  batch.setDouble(2, 0.5);
+  typed = {r1, r2, r1};
+}
+
+TEST_F(ResultsTests, test_columnar_indexed_results) {
+  ColumnarRows batch(kColumnarLayout);
+  QueryDataTyped typed;
+  getColumnarQueryData(batch, typed);
+
+  ASSERT_EQ(batch.size(), typed.size());
+  for (size_t i = 0; i < batch.size(); i++) {
+    EXPECT_EQ(batch.toRowTyped(i), typed[i]);
+
+    // A batch row encodes as the row it converts to.
+    std::string expected;
+    encodeRow(typed[i], expected);
+    std::string encoded;
+    batch.encode(i, encoded);
+    EXPECT_EQ(encoded, expected);
+  }
+
+  std::string expected;
+  IndexedResults(typed).serialize(expected);
+  std::string index;
+  IndexedResults(batch).serialize(index);
+  EXPECT_EQ(index, expected);
+}
+
+TEST_F(ResultsTests, test_columnar_indexed_diff) {
+  ColumnarRows batch(kColumnarLayout);
+  QueryDataTyped current;
+  getColumnarQueryData(batch, current);
+
+  RowTyped r3;
+  r3["foo"] = "qux";
+  QueryDataTyped previous{current[1], r3};
+  std::string index;
+  EXPECT_TRUE(serializeIndexedResults(previous, index).ok());
+
+  DiffResults expected;
+  std::string expected_index;
+  auto s = diffIndexedResults(index, current, expected, expected_index);
+  EXPECT_TRUE(s.ok());
+
+  DiffResults dr;
+  std::string current_index;
+  s = diffIndexedResults(index, batch, dr, current_index);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(dr, expected);
+  EXPECT_EQ(current_index, expected_index);
+  EXPECT_EQ(dr.added, (QueryDataTyped{current[0], current[0]}));
+  EXPECT_EQ(dr.removed, QueryDataTyped{r3});
+}
+
 TEST_F(ResultsTests, test_serialize_row) {
   auto results = getSerializedRow();
   auto doc = JSON::newObject();
@@ -59,6 +260,60 @@ TEST_F(ResultsTests, test_deserialize_row_json) {
   EXPECT_EQ(output, results.second);
 }
 
+TEST_F(ResultsTests, test_binary_row) {
+  Row input = {{"name", "value"}, {"empty", ""}, {"pid", "1"}};
+  std::string serialized;
+  serializeRowBinary(input, serialized);
+  EXPECT_TRUE(isBinaryRow(serialized));
+
+  std::string json;
+  serializeRowJSON(input, json);
+  EXPECT_FALSE(isBinaryRow(json));
+  EXPECT_LT(serialized.size(), json.size());
+
+  Row output;
+  auto s = deserializeRowBinary(serialized, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, input);
+
+  // Truncated rows must not be read.
+  output.clear();
+  s = deserializeRowBinary(serialized.substr(0, serialized.size() - 1), output);
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(ResultsTests, test_visit_binary_row) {
+  Row input = {{"name", "value"}, {"empty", ""}, {"pid", "1"}};
+  std::string serialized;
+  serializeRowBinary(input, serialized);
+
+  Row output;
+  auto s = visitRowBinary(serialized,
+                          [&output](std::string_view column,
+                                    std::string_view value) {
+                            output[std::string(column)] = std::string(value);
+                            return true;
+                          });
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, input);
+
+  // The visitor stops when it returns false.
+  size_t visited = 0;
+  auto stop = [&visited](std::string_view, std::string_view) {
+    return ++visited < 2;
+  };
+  s = visitRowBinary(serialized, stop);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(visited, 2U);
+
+  std::string json;
+  serializeRowJSON(input, json);
+  s = visitRowBinary(json, [](std::string_view, std::string_view) {
+    return true;
+  });
+  EXPECT_FALSE(s.ok());
+}
+
 TEST_F(ResultsTests, test_serialize_query_data) {
   auto results = getSerializedQueryData();
   auto doc = JSON::newArray();
@@ -68,6 +323,23 @@ TEST_F(ResultsTests, test_serialize_query_data) {
   EXPECT_EQ(results.first.doc(), doc.doc());
 }
 
+TEST_F(ResultsTests, test_serialize_columnar_query_data) {
+  ColumnarRows batch(kColumnarLayout);
+  QueryDataTyped typed;
+  getColumnarQueryData(batch, typed);
+
+  for (bool numeric : {false, true}) {
+    auto expected = JSON::newArray();
+    auto s = serializeQueryData(typed, expected, expected.doc(), numeric);
+    EXPECT_TRUE(s.ok());
+
+    auto doc = JSON::newArray();
+    s = serializeQueryData(batch, doc, doc.doc(), numeric);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(doc.doc(), expected.doc());
+  }
+}
+
 TEST_F(ResultsTests, test_serialize_query_data_json) {
   auto results = getSerializedQueryDataJSON();
   std::string json;
@@ -126,6 +398,71 @@ TEST_F(ResultsTests, test_serialize_query_log_item_json) {
   EXPECT_EQ(results.first, json);
 }
 
+TEST_F(ResultsTests, test_serialize_query_log_item_streaming) {
+  // The streaming serializers write the same JSON as the documents.
+  auto item = getDecoratedQueryLogItem();
+  for (auto top_level : {false, true}) {
+    for (auto numerics : {false, true}) {
+      FLAGS_decorations_top_level = top_level;
+      FLAGS_logger_numerics = numerics;
+
+      std::string json;
+      ASSERT_TRUE(serializeQueryLogItemJSON(item, json).ok());
+      EXPECT_EQ(getDocumentJSON(item), json);
+
+      std::vector<std::string> events;
+      ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+      EXPECT_EQ(getDocumentEvents(item), events);
+    }
+  }
+
+  // Snapshots use the same rows.
+  item.snapshot_results = item.results.added;
+  item.results = DiffResults();
+
+  std::string json;
+  ASSERT_TRUE(serializeQueryLogItemJSON(item, json).ok());
+  EXPECT_EQ(getDocumentJSON(item), json);
+
+  std::vector<std::string> events;
+  ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+  EXPECT_EQ(getDocumentEvents(item), events);
+
+  // Without results there are no events.
+  item.snapshot_results.clear();
+  events.clear();
+  EXPECT_FALSE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+  EXPECT_TRUE(events.empty());
+}
+
+TEST_F(ResultsTests, test_serialize_query_log_item_decoration_collisions) {
+  // Top-level decorations replace the fields they are named after.
+  FLAGS_decorations_top_level = true;
+  auto item = getDecoratedQueryLogItem();
+  item.decorations["name"] = "decoration";
+  item.decorations["action"] = "decoration";
+  item.decorations["columns"] = "decoration";
+
+  std::string json;
+  ASSERT_TRUE(serializeQueryLogItemJSON(item, json).ok());
+  JSON actual;
+  ASSERT_TRUE(actual.fromString(json).ok());
+  JSON expected;
+  ASSERT_TRUE(expected.fromString(getDocumentJSON(item)).ok());
+  EXPECT_EQ(expected.doc(), actual.doc());
+  EXPECT_EQ(std::string(actual.doc()["name"].GetString()), "decoration");
+
+  std::vector<std::string> events;
+  ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+  auto expected_events = getDocumentEvents(item);
+  ASSERT_EQ(expected_events.size(), events.size());
+  for (size_t i = 0; i < events.size(); i++) {
+    ASSERT_TRUE(actual.fromString(events[i]).ok());
+    ASSERT_TRUE(expected.fromString(expected_events[i]).ok());
+    EXPECT_EQ(expected.doc(), actual.doc());
+  }
+}
+
 TEST_F(ResultsTests, test_adding_duplicate_rows_to_query_data) {
   RowTyped r1, r2, r3;
   r1["foo"] = "bar";
@@ -269,4 +269,51 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testScanValues() {
+  getPlugin()->put(kQueries, "test_scan_foo1", "bar1");
+  getPlugin()->put(kQueries, "test_scan_foo2", "bar2");
+  getPlugin()->put(kQueries, "test_scan_foo3", "bar3");
+  getPlugin()->put(kQueries, "test_scan_other", "bar4");
+
+  DatabaseStringValueList values;
+  auto visitor = [&values](const std::string& key, const std::string& value) {
+    values.push_back(std::make_pair(key, value));
+    return true;
+  };
+
+  DatabaseScanOptions options;
+  options.prefix = "test_scan_foo";
+  auto s = getPlugin()->scanValues(kQueries, options, visitor);
+  EXPECT_TRUE(s.ok());
+  DatabaseStringValueList expected = {{"test_scan_foo1", "bar1"},
+                                      {"test_scan_foo2", "bar2"},
+                                      {"test_scan_foo3", "bar3"}};
+  EXPECT_EQ(values, expected);
+
+  // The bounds are inclusive.
+  values.clear();
+  options.low = "test_scan_foo2";
+  options.high = "test_scan_foo3";
+  getPlugin()->scanValues(kQueries, options, visitor);
+  expected = {{"test_scan_foo2", "bar2"}, {"test_scan_foo3", "bar3"}};
+  EXPECT_EQ(values, expected);
+
+  values.clear();
+  options.low = "";
+  options.high = "test_scan_foo2";
+  options.max = 1;
+  options.keys_only = true;
+  getPlugin()->scanValues(kQueries, options, visitor);
+  expected = {{"test_scan_foo1", ""}};
+  EXPECT_EQ(values, expected);
+
+  // The visitor stops the scan.
+  size_t count = 0;
+  getPlugin()->scanValues(
+      kQueries,
+      DatabaseScanOptions(),
+      [&count](const std::string&, const std::string&) { return ++count < 2; });
+  EXPECT_EQ(count, 2U);
+}
 } // namespace osquery
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/config/config.h>
+#include <osquery/core/query.h>
+#include <osquery/utils/system/time.h>
+
+namespace osquery {
+
+/// A schedule of packs with 100 queries each, most running hourly.
+static std::string getBenchmarkSchedule(size_t queries) {
+  std::string packs;
+  for (size_t i = 0; i < queries; i++) {
+    if (i % 100 == 0) {
+      if (i > 0) {
+        packs += "}},";
+      }
+      packs += "\"pack" + std::to_string(i / 100) + "\":{\"queries\":{";
+    } else {
+      packs += ",";
+    }
+
+    auto interval = (i % 10 == 0) ? "60" : "3600";
+    packs += "\"query" + std::to_string(i) +
+             "\":{\"query\":\"select * from time\",\"interval\":" + interval +
+             "}";
+  }
+
+  if (queries > 0) {
+    packs += "}}";
+  }
+  return "{\"packs\":{" + packs + "}}";
+}
+
+/// Each iteration is one scheduler step, and finds the queries due at it.
+template <typename Finder>
+static void benchmarkDueQueries(benchmark::State& state, Finder finder) {
+  Config::get().update(
+      {{"benchmark",
+        getBenchmarkSchedule(static_cast<size_t>(state.range(0)))}});
+
+  auto step = getUnixTime();
+  size_t due = 0;
+  while (state.KeepRunning()) {
+    due += finder(step++);
+  }
+
+  state.counters["due"] = static_cast<double>(due) / state.iterations();
+
+  // The packs of a source are removed with its content.
+  Config::get().update({{"benchmark", ""}});
+}
+
+static void SCHEDULER_scan_scheduled_queries(benchmark::State& state) {
+  benchmarkDueQueries(state, [](uint64_t step) {
+    size_t due = 0;
+    Config::get().scheduledQueries(
+        ([&due, step](const std::string&, const ScheduledQuery& query) {
+          if (query.splayed_interval > 0 &&
+              step % query.splayed_interval == 0) {
+            due++;
+          }
+        }));
+    return due;
+  });
+}
+
+BENCHMARK(SCHEDULER_scan_scheduled_queries)->Arg(100)->Arg(1500)->Arg(10000);
+
+static void SCHEDULER_due_queries(benchmark::State& state) {
+  benchmarkDueQueries(state, [](uint64_t step) {
+    size_t due = 0;
+    Config::get().dueQueries(
+        step,
+        ([&due](const std::string&, const ScheduledQuery&) { due++; }));
+    return due;
+  });
+}
+
+BENCHMARK(SCHEDULER_due_queries)->Arg(100)->Arg(1500)->Arg(10000);
+} // namespace osquery
@@ -9,9 +9,14 @@
 
 #include <algorithm>
 #include <ctime>
+#include <deque>
+#include <functional>
+#include <set>
+#include <thread>
 
 #include <boost/format.hpp>
 #include <boost/io/quoted.hpp>
+#include <boost/noncopyable.hpp>
 
 #include <osquery/carver/carver.h>
 #include <osquery/config/config.h>
@@ -25,10 +30,14 @@
 #include <osquery/process/process.h>
 #include <osquery/profiler/code_profiler.h>
 
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/time.h>
 
 #include "osquery/dispatcher/scheduler.h"
 #include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/table_scan_cache.h"
 #include "plugins/config/parsers/decorators.h"
 
 namespace osquery {
@@ -52,6 +61,21 @@ FLAG(bool,
      false,
      "Log the running scheduled query name at INFO level");
 
+FLAG(uint64,
+     schedule_workers,
+     0,
+     "Number of threads executing due scheduled queries, 0 runs serially");
+
+FLAG(bool,
+     schedule_scan_cache,
+     true,
+     "Share table scans between scheduled queries in the same step");
+
+FLAG(string,
+     schedule_table_concurrency,
+     "yara:1",
+     "Comma-separated table:limit pairs bounding parallel scheduled queries");
+
 HIDDEN_FLAG(bool,
             schedule_reload_sql,
             false,
@@ -59,9 +83,42 @@ HIDDEN_FLAG(bool,
 
 /// Used to bypass (optimize-out) the set-differential of query results.
 DECLARE_bool(events_optimize);
+DECLARE_bool(disable_caching);
 DECLARE_bool(enable_numeric_monitoring);
 DECLARE_bool(verbose);
 
+namespace {
+
+/**
+ * @brief Sample the resources used by the thread running the queries.
+ *
+ * The CPU times are the thread ones when the platform can sample them, so
+ * queries running on other scheduler workers are not accounted. Otherwise
+ * this falls back to the process-wide counters of the processes table.
+ */
+void sampleResourceUsage(ProcessResourceUsage& usage) {
+  if (platformGetThreadResourceUsage(usage).ok()) {
+    return;
+  }
+
+  auto rows = SQL::selectFrom({"resident_size", "user_time", "system_time"},
+                              "processes",
+                              "pid",
+                              EQUALS,
+                              std::to_string(PlatformProcess::getCurrentPid()));
+  if (rows.empty()) {
+    return;
+  }
+
+  const auto& row = rows[0];
+  usage.user_time = tryTo<unsigned long long>(row.at("user_time")).takeOr(0ULL);
+  usage.system_time =
+      tryTo<unsigned long long>(row.at("system_time")).takeOr(0ULL);
+  usage.resident_size =
+      tryTo<unsigned long long>(row.at("resident_size")).takeOr(0ULL);
+}
+} // namespace
+
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
   if (FLAGS_enable_numeric_monitoring) {
     CodeProfiler profiler(
@@ -80,12 +137,8 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
     return SQLInternal(query.query, true);
   } else {
     // Snapshot the performance and times for the worker before running.
-    auto pid = std::to_string(PlatformProcess::getCurrentPid());
-    auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
+    ProcessResourceUsage r0;
+    sampleResourceUsage(r0);
 
     using namespace std::chrono;
     auto t0 = steady_clock::now();
@@ -94,26 +147,210 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
 
     // Snapshot the performance after, and compare.
     auto t1 = steady_clock::now();
-    auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
-    if (r0.size() > 0 && r1.size() > 0) {
-      // Always called while processes table is working.
-      uint64_t size = sql.getSize();
-      Config::get().recordQueryPerformance(
-          name,
-          duration_cast<milliseconds>(t1 - t0).count(),
-          size,
-          r0[0],
-          r1[0]);
-    }
+    ProcessResourceUsage r1;
+    sampleResourceUsage(r1);
+
+    uint64_t size = sql.getSize();
+    Config::get().recordQueryPerformance(
+        name, duration_cast<milliseconds>(t1 - t0).count(), size, r0, r1);
     return sql;
   }
 }
 
-Status launchQuery(const std::string& name, const ScheduledQuery& query) {
+namespace {
+
+/// A due scheduled query, executed and then logged in schedule order.
+struct QueryRun {
+  QueryRun(std::string run_name, const ScheduledQuery& run_query)
+      : name(std::move(run_name)), query(run_query) {}
+
+  std::string name;
+  const ScheduledQuery& query;
+
+  /// Tables read by the query, bounded by schedule_table_concurrency.
+  std::vector<std::string> tables;
+
+  /// Results and metadata of the execution.
+  QueryLogItem item;
+
+  /// Status of the execution.
+  Status status;
+
+  /// Set if the query executed and its results may be logged.
+  bool executed{false};
+
+  /// Set by a scheduler worker when the run is finished.
+  bool done{false};
+};
+
+/**
+ * @brief Bounds the number of scheduled queries reading a table in parallel.
+ *
+ * Limits are configured as a comma-separated list of table:limit pairs. A
+ * query reserves every limited table it reads before executing, tables
+ * without a limit may be read by any number of queries.
+ */
+class TableConcurrency : private boost::noncopyable {
+ public:
+  explicit TableConcurrency(const std::string& limits) {
+    for (const auto& pair : osquery::split(limits, ",")) {
+      auto parts = osquery::split(pair, ":");
+      auto limit = (parts.size() == 2)
+                       ? tryTo<unsigned long long>(parts[1]).takeOr(0ull)
+                       : 0ull;
+      if (limit == 0) {
+        LOG(WARNING) << "Invalid scheduled query table limit: " << pair;
+        continue;
+      }
+      limits_[parts[0]] = static_cast<size_t>(limit);
+    }
+  }
+
+  /// Check if any table has a concurrency limit.
+  bool empty() const {
+    return limits_.empty();
+  }
+
+  /// Wait until every limited table may be read by one more query.
+  void acquire(const std::vector<std::string>& tables) {
+    WriteLock lock(mutex_);
+    cv_.wait(lock, [this, &tables]() { return available(tables); });
+    for (const auto& table : tables) {
+      if (limits_.count(table) > 0) {
+        running_[table]++;
+      }
+    }
+  }
+
+  /// Release the tables reserved by acquire.
+  void release(const std::vector<std::string>& tables) {
+    {
+      WriteLock lock(mutex_);
+      for (const auto& table : tables) {
+        if (limits_.count(table) > 0) {
+          running_[table]--;
+        }
+      }
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  bool available(const std::vector<std::string>& tables) const {
+    for (const auto& table : tables) {
+      auto limit = limits_.find(table);
+      if (limit == limits_.end()) {
+        continue;
+      }
+      auto running = running_.find(table);
+      if (running != running_.end() && running->second >= limit->second) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  /// Maximum number of queries reading each limited table.
+  std::map<std::string, size_t> limits_;
+
+  /// Number of executing queries reading each limited table.
+  std::map<std::string, size_t> running_;
+
+  Mutex mutex_;
+  ConditionVariable cv_;
+};
+
+} // namespace
+
+/**
+ * @brief A fixed set of threads executing scheduled queries.
+ *
+ * Tasks are started in the order they were queued. The threads live as long
+ * as the scheduler, so a step does not pay for creating them.
+ */
+class SchedulerWorkers : private boost::noncopyable {
+ public:
+  explicit SchedulerWorkers(size_t count) {
+    threads_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      threads_.emplace_back([this]() { run(); });
+    }
+  }
+
+  ~SchedulerWorkers() {
+    {
+      WriteLock lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  /// Number of worker threads.
+  size_t size() const {
+    return threads_.size();
+  }
+
+  /// Queue a task for the next idle worker.
+  void execute(std::function<void()> task) {
+    {
+      WriteLock lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_all();
+  }
+
+  /// Wait until every queued task returned.
+  void wait() {
+    WriteLock lock(mutex_);
+    cv_.wait(lock, [this]() { return tasks_.empty() && active_ == 0; });
+  }
+
+ private:
+  void run() {
+    WriteLock lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+
+      auto task = std::move(tasks_.front());
+      tasks_.pop_front();
+      active_++;
+      lock.unlock();
+      task();
+      lock.lock();
+      active_--;
+      cv_.notify_all();
+    }
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+
+  /// Queued tasks, in the order they are started.
+  std::deque<std::function<void()>> tasks_;
+
+  /// Number of tasks executing.
+  size_t active_{0};
+
+  /// Set when the threads must exit.
+  bool stopping_{false};
+
+  Mutex mutex_;
+  ConditionVariable cv_;
+};
+
+namespace {
+
+void executeQuery(QueryRun& run) {
+  const auto& name = run.name;
+  const auto& query = run.query;
+
   // Execute the scheduled query and create a named query object.
   if (FLAGS_verbose) {
     VLOG(1) << "Executing scheduled query " << name << ": " << query.query;
@@ -126,15 +363,17 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   if (!sql.getStatus().ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getStatus().toString();
-    return Status::failure("Error executing scheduled query");
+    run.status = Status::failure("Error executing scheduled query");
+    return;
   }
+  run.executed = true;
 
   // Fill in a host identifier fields based on configuration or availability.
   std::string ident = getHostIdentifier();
 
   // A query log item contains an optional set of differential results or
   // a copy of the most-recent execution alongside some query metadata.
-  QueryLogItem item;
+  QueryLogItem& item = run.item;
   item.name = name;
   item.identifier = ident;
   item.time = osquery::getUnixTime();
@@ -145,8 +384,7 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   if (query.isSnapshotQuery()) {
     // This is a snapshot query, emit results with a differential or state.
     item.snapshot_results = std::move(sql.rowsTyped());
-    logSnapshotQuery(item);
-    return Status::success();
+    return;
   }
 
   // Create a database-backed set of query results.
@@ -176,24 +414,55 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   if (!query.reportRemovedRows()) {
     diff_results.removed.clear();
   }
+  run.status = status;
+}
+
+Status logQueryRun(QueryRun& run) {
+  if (!run.executed) {
+    return run.status;
+  }
 
-  if (diff_results.hasNoResults()) {
+  auto& item = run.item;
+  if (run.query.isSnapshotQuery()) {
+    logSnapshotQuery(item);
+    return Status::success();
+  }
+
+  if (item.results.hasNoResults()) {
     // No diff results or events to emit.
-    return status;
+    return run.status;
   }
 
-  VLOG(1) << "Found results for query: " << name;
+  VLOG(1) << "Found results for query: " << run.name;
 
-  status = logQueryLogItem(item);
+  auto status = logQueryLogItem(item);
   if (!status.ok()) {
     // If log directory is not available, then the daemon shouldn't continue.
-    std::string message = "Error logging the results of query: " + name + ": " +
-                          status.toString();
+    std::string message = "Error logging the results of query: " + run.name +
+                          ": " + status.toString();
     requestShutdown(EXIT_CATASTROPHIC, message);
   }
   return status;
 }
 
+void recordQueryStatus(const ScheduledQuery& query, const Status& status) {
+  monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
+                      query.pack_name % query.name %
+                      (status.ok() ? "success" : "failure"))
+                         .str(),
+                     1,
+                     monitoring::PreAggregationType::Sum,
+                     true);
+}
+
+} // namespace
+
+Status launchQuery(const std::string& name, const ScheduledQuery& query) {
+  QueryRun run(name, query);
+  executeQuery(run);
+  return logQueryRun(run);
+}
+
 void SchedulerRunner::calculateTimeDriftAndMaybePause(
     std::chrono::milliseconds loop_step_duration) {
   if (loop_step_duration + time_drift_ < interval_) {
@@ -227,9 +496,148 @@ void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
       SQLiteDBManager::resetPrimary();
     }
     resetDatabase();
+    query_tables_.clear();
   }
 }
 
+const std::vector<std::string>& SchedulerRunner::getQueryTables(
+    const std::string& query) {
+  auto it = query_tables_.find(query);
+  if (it != query_tables_.end()) {
+    return it->second;
+  }
+
+  std::vector<std::string> tables;
+  if (!osquery::getQueryTables(query, tables)) {
+    VLOG(1) << "Cannot get tables from scheduled query: " << query;
+  }
+
+  // A query reserves each table once, even if it reads it several times.
+  std::set<std::string> unique(tables.begin(), tables.end());
+  auto& cached = query_tables_[query];
+  cached.assign(unique.begin(), unique.end());
+  return cached;
+}
+
+bool SchedulerRunner::scanCacheEnabled() const {
+  return FLAGS_schedule_scan_cache && !FLAGS_disable_caching;
+}
+
+void SchedulerRunner::beginScanCache(const std::vector<std::string>& queries) {
+  // Only tables read by more than one due query are worth keeping.
+  std::map<std::string, size_t> readers;
+  for (const auto& query : queries) {
+    for (const auto& table : getQueryTables(query)) {
+      readers[table]++;
+    }
+  }
+
+  std::set<std::string> shared;
+  for (const auto& table : readers) {
+    if (table.second > 1) {
+      shared.insert(table.first);
+    }
+  }
+  TableScanCache::get().begin(std::move(shared));
+}
+
+void SchedulerRunner::endScanCache() {
+  auto stats = TableScanCache::get().end();
+  if (stats.hits == 0 && stats.misses == 0) {
+    return;
+  }
+
+  monitoring::record("scheduler.scan_cache.hits",
+                     static_cast<monitoring::ValueType>(stats.hits),
+                     monitoring::PreAggregationType::Sum,
+                     true);
+  monitoring::record("scheduler.scan_cache.misses",
+                     static_cast<monitoring::ValueType>(stats.misses),
+                     monitoring::PreAggregationType::Sum,
+                     true);
+}
+
+void SchedulerRunner::launchQueriesParallel(uint64_t time_step) {
+  // Due queries are copied, the schedule is not locked while workers execute
+  // because tables such as osquery_schedule read it.
+  std::deque<ScheduledQuery> queries;
+  std::vector<std::unique_ptr<QueryRun>> runs;
+  uint64_t min_interval = 0;
+  Config::get().dueQueries(
+      time_step, ([&](const std::string& name, const ScheduledQuery& query) {
+        queries.emplace_back(query.pack_name, query.name, query.query);
+        auto& due = queries.back();
+        due.oncall = query.oncall;
+        due.interval = query.interval;
+        due.splayed_interval = query.splayed_interval;
+        due.denylisted = query.denylisted;
+        due.options = query.options;
+        runs.push_back(std::make_unique<QueryRun>(name, due));
+        if (min_interval == 0 || query.splayed_interval < min_interval) {
+          min_interval = query.splayed_interval;
+        }
+      }));
+  if (runs.empty()) {
+    return;
+  }
+
+  // Queries executing in the same step share the table cache settings, use
+  // the shortest interval so no query reads results older than it expects.
+  TablePlugin::kCacheInterval = min_interval;
+  TablePlugin::kCacheStep = time_step;
+
+  TableConcurrency limits(FLAGS_schedule_table_concurrency);
+  if (!limits.empty()) {
+    for (auto& run : runs) {
+      run->tables = getQueryTables(run->query.query);
+    }
+  }
+
+  if (scanCacheEnabled()) {
+    std::vector<std::string> due;
+    for (const auto& run : runs) {
+      due.push_back(run->query.query);
+    }
+    beginScanCache(due);
+  }
+
+  if (workers_ == nullptr) {
+    workers_ = std::make_unique<SchedulerWorkers>(
+        static_cast<size_t>(FLAGS_schedule_workers));
+  }
+
+  // Due queries are started in schedule order, the SQL manager hands workers
+  // that cannot lock the primary database their own instance.
+  Mutex done_mutex;
+  ConditionVariable done_cv;
+  for (auto& due : runs) {
+    auto& run = *due;
+    workers_->execute([&run, &limits, &done_mutex, &done_cv]() {
+      limits.acquire(run.tables);
+      executeQuery(run);
+      limits.release(run.tables);
+      {
+        WriteLock lock(done_mutex);
+        run.done = true;
+      }
+      done_cv.notify_all();
+    });
+  }
+
+  // Results are logged from the scheduler thread in schedule order, as each
+  // query finishes, regardless of the order the workers complete them.
+  for (auto& run : runs) {
+    {
+      WriteLock lock(done_mutex);
+      done_cv.wait(lock, [&run]() { return run->done; });
+    }
+    recordQueryStatus(run->query, logQueryRun(*run));
+  }
+
+  // The tasks reference this step's state until they return.
+  workers_->wait();
+}
+
 void SchedulerRunner::maybeFlushLogs(uint64_t time_step) {
   // GLog is not re-entrant, so logs must be flushed in a dedicated thread.
   if ((time_step % 3) == 0) {
@@ -245,21 +653,26 @@ void SchedulerRunner::start() {
 
   for (; (end == 0) || (i <= end); ++i) {
     auto start_time_point = std::chrono::steady_clock::now();
-    Config::get().scheduledQueries(([&i](const std::string& name,
-                                         const ScheduledQuery& query) {
-      if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-        TablePlugin::kCacheInterval = query.splayed_interval;
-        TablePlugin::kCacheStep = i;
-        const auto status = launchQuery(name, query);
-        monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
-                            query.pack_name % query.name %
-                            (status.ok() ? "success" : "failure"))
-                               .str(),
-                           1,
-                           monitoring::PreAggregationType::Sum,
-                           true);
+    if (FLAGS_schedule_workers > 0) {
+      launchQueriesParallel(i);
+    } else {
+      if (scanCacheEnabled()) {
+        std::vector<std::string> due;
+        Config::get().dueQueries(
+            i, ([&due](const std::string&, const ScheduledQuery& query) {
+              due.push_back(query.query);
+            }));
+        beginScanCache(due);
       }
-    }));
+
+      Config::get().dueQueries(
+          i, ([&i](const std::string& name, const ScheduledQuery& query) {
+            TablePlugin::kCacheInterval = query.splayed_interval;
+            TablePlugin::kCacheStep = i;
+            recordQueryStatus(query, launchQuery(name, query));
+          }));
+    }
+    endScanCache();
 
     maybeRunDecorators(i);
     maybeReloadSchedule(i);
@@ -282,6 +695,8 @@ void SchedulerRunner::start() {
   }
 }
 
+SchedulerRunner::~SchedulerRunner() = default;
+
 std::chrono::milliseconds SchedulerRunner::getCurrentTimeDrift() const
     noexcept {
   return time_drift_;
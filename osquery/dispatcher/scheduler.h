@@ -11,6 +11,9 @@
 
 #include <chrono>
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <osquery/dispatcher/dispatcher.h>
 
@@ -18,6 +21,8 @@
 
 namespace osquery {
 
+class SchedulerWorkers;
+
 /// A Dispatcher service thread that watches an ExtensionManagerHandler.
 class SchedulerRunner : public InternalRunnable {
  public:
@@ -31,6 +36,8 @@ class SchedulerRunner : public InternalRunnable {
         time_drift_{std::chrono::milliseconds::zero()},
         max_time_drift_{max_time_drift} {}
 
+  ~SchedulerRunner() override;
+
  public:
   /// The Dispatcher thread entry point.
   void start() override;
@@ -57,6 +64,26 @@ class SchedulerRunner : public InternalRunnable {
   /// Check if carve requests should be scheduled.
   void maybeScheduleCarves(uint64_t time_step);
 
+  /**
+   * @brief Execute the due queries on a pool of schedule_workers threads.
+   *
+   * The pool is started with the first parallel step and sized once, its
+   * threads are reused by every later step.
+   */
+  void launchQueriesParallel(uint64_t time_step);
+
+  /// Tables read by a scheduled query, cached until the schedule reloads.
+  const std::vector<std::string>& getQueryTables(const std::string& query);
+
+  /// Check if table scans may be shared between queries in a step.
+  bool scanCacheEnabled() const;
+
+  /// Share scans of tables read by more than one of the due queries.
+  void beginScanCache(const std::vector<std::string>& queries);
+
+  /// Release the step's shared scans and record the cache counters.
+  void endScanCache();
+
  private:
   /// Interval in seconds between schedule steps.
   const std::chrono::milliseconds interval_;
@@ -71,6 +98,12 @@ class SchedulerRunner : public InternalRunnable {
 
   const std::chrono::milliseconds max_time_drift_;
 
+  /// Tables read by each scheduled query, keyed by the query SQL.
+  std::map<std::string, std::vector<std::string>> query_tables_;
+
+  /// Threads executing due queries, see launchQueriesParallel.
+  std::unique_ptr<SchedulerWorkers> workers_;
+
   /// Tests should not always trigger a shutdown when the scheduler expires,
   /// so let tests decide when this should happen.
   FRIEND_TEST(TLSConfigTests, test_runner_and_scheduler);
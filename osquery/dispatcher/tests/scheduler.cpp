@@ -23,6 +23,7 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_uint64(schedule_reload);
+DECLARE_uint64(schedule_workers);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -282,6 +283,51 @@ TEST_F(SchedulerTests, test_scheduler_drift_accumulation) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_scheduler_workers) {
+  auto backup_step = TablePlugin::kCacheStep;
+  auto backup_interval = TablePlugin::kCacheInterval;
+  auto backup_workers = FLAGS_schedule_workers;
+  FLAGS_schedule_workers = 2;
+
+  std::string config = R"config(
+  {
+    "packs": {
+      "workers": {
+        "queries": {
+          "1": {"query": "select * from osquery_schedule", "interval": 1},
+          "2": {"query": "select * from osquery_info", "interval": 1},
+          "3": {"query": "select * from time", "interval": 1},
+          "4": {"query": "select 4 as number", "interval": 1}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  SchedulerRunner runner(static_cast<unsigned long int>(1), size_t{1});
+  runner.start();
+
+  // Every query was executed once by the workers and recorded.
+  for (const auto& name : {"1", "2", "3", "4"}) {
+    size_t executions = 0;
+    Config::get().getPerformanceStats(
+        "pack_workers_" + std::string(name),
+        [&executions](const QueryPerformance& r) {
+          executions = r.executions;
+        });
+    EXPECT_GT(executions, 0U);
+  }
+
+  // No query is left marked as executing.
+  std::string executing;
+  getDatabaseValue(kPersistentSettings, kExecutingQuery, executing);
+  EXPECT_TRUE(executing.empty());
+
+  FLAGS_schedule_workers = backup_workers;
+  TablePlugin::kCacheStep = backup_step;
+  TablePlugin::kCacheInterval = backup_interval;
+}
+
 TEST_F(SchedulerTests, test_scheduler_reload) {
   std::string config =
       "{\"schedule\":{\"1\":{"
@@ -10,11 +10,25 @@
 #include <benchmark/benchmark.h>
 
 #include <osquery/config/config.h>
+#include <osquery/core/sql/row.h>
 #include <osquery/core/tables.h>
+#include <osquery/database/database.h>
+#include <osquery/events/eventsubscriberplugin.h>
 #include <osquery/registry/registry_factory.h>
 
 #include "osquery/tests/test_util.h"
 
+#ifdef __linux__
+#include <cstring>
+#include <thread>
+
+#include <osquery/events/linux/auditdnetlink.h>
+#include <osquery/events/linux/auditeventpublisher.h>
+#include <osquery/events/linux/bpf/bpfeventpublisher.h>
+#include <osquery/events/linux/bpf/eventreorderbuffer.h>
+#include <osquery/events/linux/bpf/shardedsystemstatetracker.h>
+#endif
+
 namespace osquery {
 
 class BenchmarkEventPublisher
@@ -134,6 +148,67 @@ static void EVENTS_add_events(benchmark::State& state) {
 
 BENCHMARK(EVENTS_add_events);
 
+/// A row shaped like a process execution event.
+static Row getExampleEventRow() {
+  return {
+      {"pid", "12345"},
+      {"parent", "1"},
+      {"path", "/usr/bin/python3"},
+      {"cmdline", "python3 -m http.server 8080"},
+      {"cwd", "/home/user"},
+      {"uid", "1000"},
+      {"gid", "1000"},
+      {"auid", "1000"},
+      {"time", "1600000000"},
+      {"eid", "0000000001"},
+  };
+}
+
+static void EVENTS_serialize_row_json(benchmark::State& state) {
+  auto row = getExampleEventRow();
+  std::string serialized_row;
+  while (state.KeepRunning()) {
+    serialized_row.clear();
+    serializeRowJSON(row, serialized_row);
+  }
+  state.counters["stored_bytes"] = static_cast<double>(serialized_row.size());
+}
+
+BENCHMARK(EVENTS_serialize_row_json);
+
+static void EVENTS_serialize_row_binary(benchmark::State& state) {
+  auto row = getExampleEventRow();
+  std::string serialized_row;
+  while (state.KeepRunning()) {
+    serializeRowBinary(row, serialized_row);
+  }
+  state.counters["stored_bytes"] = static_cast<double>(serialized_row.size());
+}
+
+BENCHMARK(EVENTS_serialize_row_binary);
+
+static void EVENTS_deserialize_row_json(benchmark::State& state) {
+  std::string serialized_row;
+  serializeRowJSON(getExampleEventRow(), serialized_row);
+  while (state.KeepRunning()) {
+    Row row;
+    deserializeRowJSON(serialized_row, row);
+  }
+}
+
+BENCHMARK(EVENTS_deserialize_row_json);
+
+static void EVENTS_deserialize_row_binary(benchmark::State& state) {
+  std::string serialized_row;
+  serializeRowBinary(getExampleEventRow(), serialized_row);
+  while (state.KeepRunning()) {
+    Row row;
+    deserializeRowBinary(serialized_row, row);
+  }
+}
+
+BENCHMARK(EVENTS_deserialize_row_binary);
+
 static void EVENTS_retrieve_events(benchmark::State& state) {
   auto sub = std::make_shared<BenchmarkEventSubscriber>();
 
@@ -172,6 +247,77 @@ BENCHMARK(EVENTS_gentable)
     ->ArgPair(0, 1000)
     ->ArgPair(0, 10000);
 
+/// Store events at a rate of about 20k per minute, return the last time.
+static EventTime fillEventStorage(EventSubscriberPlugin::Context& context,
+                                  size_t count) {
+  const EventTime kFirstTime{1600000000U};
+  const size_t kEventsPerSecond{333U};
+
+  auto row = getExampleEventRow();
+  DatabaseStringValueList batch;
+  EventTime event_time = kFirstTime;
+  for (size_t i = 0; i < count; i++) {
+    event_time = kFirstTime + i / kEventsPerSecond;
+    auto event_id = EventSubscriberPlugin::generateEventIdentifier(context);
+    row["time"] = std::to_string(event_time);
+    row["eid"] = EventSubscriberPlugin::toIndex(event_id);
+
+    std::string serialized_row;
+    serializeRowBinary(row, serialized_row);
+    batch.emplace_back(EventSubscriberPlugin::databaseKeyForEventId(
+                           context, event_time, event_id),
+                       std::move(serialized_row));
+    if (batch.size() == 1024) {
+      setDatabaseBatch(kEvents, batch);
+      batch.clear();
+    }
+  }
+  setDatabaseBatch(kEvents, batch);
+  return event_time;
+}
+
+static void EVENTS_gentable_index(benchmark::State& state) {
+  RegistryFactory::get().setActive("database", "rocksdb");
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "benchmark", "index");
+  fillEventStorage(context, state.range(0));
+
+  // Rebuild the time index from the stored event keys.
+  while (state.KeepRunning()) {
+    EventSubscriberPlugin::generateEventDataIndex(context,
+                                                  getOsqueryDatabase());
+  }
+
+  EventSubscriberPlugin::removeEventsBefore(
+      context, getOsqueryDatabase(), static_cast<EventTime>(-1));
+}
+
+BENCHMARK(EVENTS_gentable_index)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+static void EVENTS_gentable_since(benchmark::State& state) {
+  RegistryFactory::get().setActive("database", "rocksdb");
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "benchmark", "since");
+  auto last_time = fillEventStorage(context, state.range(0));
+  EventSubscriberPlugin::generateEventDataIndex(context, getOsqueryDatabase());
+
+  // Select the last minute of events, as in "WHERE time > X".
+  size_t rows = 0;
+  auto callback = [&rows](Row) { rows++; };
+  while (state.KeepRunning()) {
+    EventSubscriberPlugin::generateRows(
+        context, getOsqueryDatabase(), callback, last_time - 60, 0);
+  }
+  state.counters["rows"] = static_cast<double>(rows) / state.iterations();
+
+  EventSubscriberPlugin::removeEventsBefore(
+      context, getOsqueryDatabase(), static_cast<EventTime>(-1));
+}
+
+BENCHMARK(EVENTS_gentable_since)->Arg(10000)->Arg(100000)->Arg(1000000);
+
 static void EVENTS_add_and_gentable(benchmark::State& state) {
   auto sub = std::make_shared<BenchmarkEventSubscriber>();
 
@@ -190,4 +336,311 @@ BENCHMARK(EVENTS_add_and_gentable)
     ->ArgPair(0, 100)
     ->ArgPair(0, 1000)
     ->ArgPair(0, 10000);
+
+#ifdef __linux__
+/// Records captured from the audit netlink for a single execve(2).
+static const std::vector<std::pair<int, std::string>> kAuditExecveTrace = {
+    {1300,
+     "arch=c000003e syscall=59 success=yes exit=0 a0=55d7e0b0a2c0 "
+     "a1=55d7e0b0a310 a2=55d7e0b0a328 a3=8 items=2 ppid=2114 pid=2187 "
+     "auid=1000 uid=1000 gid=1000 euid=1000 suid=1000 fsuid=1000 egid=1000 "
+     "sgid=1000 fsgid=1000 tty=pts0 ses=2 comm=\"ls\" exe=\"/usr/bin/ls\" "
+     "key=(null)"},
+    {1309, "argc=3 a0=\"ls\" a1=\"-la\" a2=\"/tmp\""},
+    {1307, "cwd=\"/home/user\""},
+    {1302,
+     "item=0 name=\"/usr/bin/ls\" inode=1311213 dev=08:01 mode=0100755 "
+     "ouid=0 ogid=0 rdev=00:00 nametype=NORMAL cap_fp=0 cap_fi=0 cap_fe=0 "
+     "cap_fver=0"},
+    {1302,
+     "item=1 name=\"/lib64/ld-linux-x86-64.so.2\" inode=1316018 dev=08:01 "
+     "mode=0100755 ouid=0 ogid=0 rdev=00:00 nametype=NORMAL cap_fp=0 "
+     "cap_fi=0 cap_fe=0 cap_fver=0"},
+    {1327, "proctitle=6C73002D6C61002F746D70"},
+    {1320, ""},
+};
+
+/// Build netlink messages replaying the trace as a number of execve(2) events.
+static std::vector<audit_reply> getAuditReplayTrace(size_t event_count) {
+  std::vector<audit_reply> trace;
+  trace.reserve(event_count * kAuditExecveTrace.size());
+
+  for (size_t serial = 1; serial <= event_count; serial++) {
+    auto header = "audit(1600000000.100:" + std::to_string(serial) + "): ";
+    for (const auto& record : kAuditExecveTrace) {
+      auto message = header + record.second;
+
+      audit_reply reply = {};
+      reply.msg.nlh.nlmsg_type = static_cast<__u16>(record.first);
+      reply.msg.nlh.nlmsg_len = NLMSG_LENGTH(message.size());
+      std::memcpy(reply.msg.data, message.data(), message.size());
+      trace.push_back(reply);
+    }
+  }
+  return trace;
+}
+
+/**
+ * Replay an audit trace through the reader, parser and publisher queues.
+ *
+ * The reader and the parser run on their own threads as in AuditdNetlink,
+ * the benchmark thread plays the publisher.
+ */
+static void EVENTS_audit_replay(benchmark::State& state) {
+  auto trace = getAuditReplayTrace(1000);
+  const std::set<int> syscalls_allowed_to_fail;
+
+  AuditdContext context(static_cast<size_t>(state.range(0)));
+  AuditTraceContext trace_context;
+
+  size_t fired = 0;
+  while (state.KeepRunning()) {
+    std::atomic<bool> read_done{false};
+
+    std::thread reader([&context, &trace]() {
+      auto& queue = context.unprocessed_records;
+      for (const auto& reply : trace) {
+        auto slot = queue.producerSlot();
+        if (slot == nullptr) {
+          context.dropped_records++;
+          continue;
+        }
+        *slot = reply;
+        queue.push();
+      }
+    });
+
+    std::thread parser([&context, &read_done]() {
+      auto& input = context.unprocessed_records;
+      auto& output = context.processed_events;
+      for (;;) {
+        auto reply = input.consumerSlot();
+        if (reply == nullptr) {
+          if (read_done) {
+            break;
+          }
+          input.waitForData(std::chrono::milliseconds(1));
+          continue;
+        }
+
+        AuditdNetlinkParser::AdjustAuditReply(*reply);
+        auto record = output.producerSlot();
+        while (record == nullptr) {
+          context.backpressure_waits++;
+          output.waitForSpace(std::chrono::milliseconds(1));
+          record = output.producerSlot();
+        }
+
+        if (AuditdNetlinkParser::ParseAuditReply(*reply, *record)) {
+          output.push();
+        }
+        input.pop();
+      }
+    });
+
+    auto publish = [&]() {
+      std::vector<AuditEventRecord> record_list;
+      auto& queue = context.processed_events;
+      for (auto record = queue.consumerSlot(); record != nullptr;
+           record = queue.consumerSlot()) {
+        record_list.push_back(std::move(*record));
+        queue.pop();
+      }
+
+      auto event_context = std::make_shared<AuditEventContext>();
+      AuditEventPublisher::ProcessEvents(event_context,
+                                         record_list,
+                                         trace_context,
+                                         syscalls_allowed_to_fail);
+      fired += event_context->audit_events.size();
+    };
+
+    reader.join();
+    read_done = true;
+    while (context.unprocessed_records.size() != 0U ||
+           context.processed_events.size() != 0U) {
+      context.processed_events.waitForData(std::chrono::milliseconds(1));
+      publish();
+    }
+    parser.join();
+    publish();
+  }
+
+  state.SetItemsProcessed(state.iterations() * trace.size());
+  state.counters["dropped"] =
+      static_cast<double>(context.dropped_records) / state.iterations();
+  state.counters["backpressure"] =
+      static_cast<double>(context.backpressure_waits) / state.iterations();
+  state.counters["events"] = static_cast<double>(fired) / state.iterations();
+}
+
+BENCHMARK(EVENTS_audit_replay)->Arg(256)->Arg(4096)->UseRealTime();
+
+/// Answers for any process id, instead of reading procfs.
+class BPFReplayProcessContextFactory final : public IProcessContextFactory {
+ public:
+  virtual bool captureSingleProcess(ProcessContext& process_context,
+                                    pid_t process_id) const override {
+    static_cast<void>(process_id);
+
+    process_context = {};
+    process_context.parent_process_id = 1;
+    process_context.binary_path = "/usr/bin/zsh";
+    process_context.argv = {"zsh"};
+    process_context.cwd = "/home/user";
+    return true;
+  }
+
+  virtual bool captureAllProcesses(
+      ProcessContextMap& process_map) const override {
+    process_map.clear();
+    return true;
+  }
+};
+
+enum BPFReplayEventIdentifier : std::uint64_t {
+  kBPFReplayFork = 1U,
+  kBPFReplayExecve,
+  kBPFReplayClose,
+};
+
+/// The time between two synthetic events, in nanoseconds.
+static const std::uint64_t kBPFReplayEventInterval{1000U};
+
+/// Build fork, execve and close events for a number of processes, in the
+/// order they could be read from the per-CPU perf buffers.
+static ShardedSystemStateTracker::BPFEventList getBPFReplayTrace(
+    size_t process_count) {
+  using Field = tob::ebpfpub::IFunctionTracer::Event::Field;
+
+  ShardedSystemStateTracker::BPFEventList trace;
+  trace.reserve(process_count * 3);
+
+  std::uint64_t timestamp = 1000000000U;
+  auto add_event = [&](std::uint64_t identifier, pid_t process_id)
+      -> ShardedSystemStateTracker::BPFEvent& {
+    ShardedSystemStateTracker::BPFEvent event{};
+    event.identifier = identifier;
+    event.header.timestamp = timestamp;
+    event.header.thread_id = process_id;
+    event.header.process_id = process_id;
+    event.header.user_id = 1000;
+    event.header.group_id = 1000;
+
+    timestamp += kBPFReplayEventInterval;
+    trace.push_back(std::move(event));
+    return trace.back();
+  };
+
+  for (size_t i = 0; i < process_count; i++) {
+    auto parent_process_id = static_cast<pid_t>(1000 + i % 16);
+    auto process_id = static_cast<pid_t>(2000 + i);
+
+    auto& fork_event = add_event(kBPFReplayFork, parent_process_id);
+    fork_event.name = "fork";
+    fork_event.header.exit_code = static_cast<std::uint64_t>(process_id);
+
+    auto& execve_event = add_event(kBPFReplayExecve, process_id);
+    execve_event.name = "execve";
+    execve_event.in_field_map.insert(
+        {"filename", Field{"filename", true, std::string("/usr/bin/ls")}});
+    execve_event.in_field_map.insert(
+        {"argv", Field{"argv", true, Field::Argv{"ls", "-la"}}});
+
+    auto& close_event = add_event(kBPFReplayClose, process_id);
+    close_event.name = "close";
+    close_event.in_field_map.insert(
+        {"fd", Field{"fd", true, std::uint64_t{2}}});
+  }
+
+  // Swap neighbours, as if they had been received from different CPUs
+  for (size_t i = 1; i < trace.size(); i += 3) {
+    std::swap(trace[i - 1], trace[i]);
+  }
+
+  return trace;
+}
+
+/**
+ * Replay synthetic BPF events through the reorder buffer and the sharded
+ * system state tracker, using the given number of shards.
+ *
+ * Events are pushed in batches, as read from the perf buffers; the reorder
+ * latency is measured on the timeline of the synthetic events.
+ */
+static void EVENTS_bpf_replay(benchmark::State& state) {
+  const size_t kBatchSize = 256;
+  const std::uint64_t kReorderDelay = 64 * kBPFReplayEventInterval;
+  const std::uint64_t kBucketWidth = 8 * kBPFReplayEventInterval;
+
+  auto trace = getBPFReplayTrace(1000);
+
+  const ShardedSystemStateTracker::HandlerMap handler_map = {
+      {kBPFReplayFork,
+       {&BPFEventPublisher::processForkEvent,
+        ShardedSystemStateTracker::Routing::ProcessCreation}},
+      {kBPFReplayExecve,
+       {&BPFEventPublisher::processExecveEvent,
+        ShardedSystemStateTracker::Routing::Process}},
+      {kBPFReplayClose,
+       {&BPFEventPublisher::processCloseEvent,
+        ShardedSystemStateTracker::Routing::Process}},
+  };
+
+  auto state_tracker = ShardedSystemStateTracker::create(
+      static_cast<size_t>(state.range(0)), []() -> IProcessContextFactory::Ref {
+        return std::make_unique<BPFReplayProcessContextFactory>();
+      });
+
+  if (state_tracker == nullptr) {
+    state.SkipWithError("Failed to create the system state tracker");
+    return;
+  }
+
+  std::uint64_t released = 0;
+  std::uint64_t total_latency = 0;
+  std::uint64_t max_latency = 0;
+  size_t generated = 0;
+
+  while (state.KeepRunning()) {
+    BPFEventReorderBuffer reorder_buffer(
+        kReorderDelay, kBucketWidth, trace.size());
+    BPFErrorState bpf_error_state;
+
+    for (size_t i = 0; i < trace.size(); i += kBatchSize) {
+      auto batch_end = std::min(i + kBatchSize, trace.size());
+      for (auto j = i; j < batch_end; j++) {
+        reorder_buffer.push(trace[j]);
+      }
+
+      // Flush everything after the last batch
+      auto now = trace[batch_end - 1].header.timestamp;
+      if (batch_end == trace.size()) {
+        now += kReorderDelay + kBucketWidth;
+      }
+
+      BPFEventReorderBuffer::EventList event_list;
+      reorder_buffer.release(event_list, now);
+
+      state_tracker->processEvents(event_list, handler_map, bpf_error_state);
+      generated += state_tracker->eventList().size();
+    }
+
+    const auto& stats = reorder_buffer.stats();
+    released += stats.released;
+    total_latency += stats.total_latency;
+    max_latency = std::max(max_latency, stats.max_latency);
+  }
+
+  state.SetItemsProcessed(state.iterations() * trace.size());
+  state.counters["events"] =
+      static_cast<double>(generated) / state.iterations();
+  state.counters["reorder_latency_avg_ns"] =
+      released != 0 ? static_cast<double>(total_latency) / released : 0.0;
+  state.counters["reorder_latency_max_ns"] = static_cast<double>(max_latency);
+}
+
+BENCHMARK(EVENTS_bpf_replay)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+#endif
+
 } // namespace osquery
@@ -297,6 +297,10 @@ void EventFactory::addForwarder(const std::string& logger) {
   getInstance().loggers_.push_back(logger);
 }
 
+bool EventFactory::hasForwarders() {
+  return !getInstance().loggers_.empty();
+}
+
 void EventFactory::forwardEvent(const std::string& event) {
   for (const auto& logger : getInstance().loggers_) {
     Registry::call("logger", logger, {{"event", event}});
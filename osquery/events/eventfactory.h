@@ -146,6 +146,9 @@ class EventFactory : private boost::noncopyable {
   /// Set log forwarding by adding a logger receiver.
   static void addForwarder(const std::string& logger);
 
+  /// Check if any logger receives forwarded events.
+  static bool hasForwarders();
+
   /// Optionally forward events to loggers.
   static void forwardEvent(const std::string& event);
 
@@ -41,6 +41,14 @@ size_t EventPublisherPlugin::restartCount() const {
   return restart_count_;
 }
 
+uint64_t EventPublisherPlugin::droppedCount() const {
+  return dropped_count_;
+}
+
+uint64_t EventPublisherPlugin::backpressureCount() const {
+  return backpressure_count_;
+}
+
 bool EventPublisherPlugin::interrupted() {
   // Warning: deprecated. Use isEnding() instead
   return false;
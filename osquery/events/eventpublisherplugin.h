@@ -123,6 +123,12 @@ class EventPublisherPlugin : public Plugin,
   /// Get the number of publisher restarts.
   size_t restartCount() const;
 
+  /// Get the number of events dropped because the publisher fell behind.
+  uint64_t droppedCount() const;
+
+  /// Get the number of times the publisher waited for its consumers.
+  uint64_t backpressureCount() const;
+
   explicit EventPublisherPlugin(EventPublisherPlugin const&) = delete;
   EventPublisherPlugin& operator=(EventPublisherPlugin const&) = delete;
 
@@ -155,6 +161,12 @@ class EventPublisherPlugin : public Plugin,
   /// This is not used to store event date in the backing store.
   std::atomic<EventContextID> next_ec_id_{0};
 
+  /// Events dropped before they were fired, maintained by the publisher.
+  std::atomic<uint64_t> dropped_count_{0};
+
+  /// Waits for slow consumers, maintained by the publisher.
+  std::atomic<uint64_t> backpressure_count_{0};
+
  private:
   /// Set ending to True to cause event type run loops to finish.
   std::atomic<bool> ending_{false};
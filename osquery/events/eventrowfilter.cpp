@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+#include <osquery/events/eventrowfilter.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+namespace {
+
+inline bool isNumericType(ColumnType type) {
+  return type == INTEGER_TYPE || type == BIGINT_TYPE ||
+         type == UNSIGNED_BIGINT_TYPE;
+}
+
+inline bool isFilteredOperator(unsigned char op) {
+  return op == EQUALS || op == GREATER_THAN || op == GREATER_THAN_OR_EQUALS ||
+         op == LESS_THAN || op == LESS_THAN_OR_EQUALS || op == LIKE ||
+         op == GLOB;
+}
+
+/// SQLite's LIKE folds the case of ASCII characters only.
+inline char foldCase(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/**
+ * Check the literal prefix of a LIKE or GLOB pattern.
+ *
+ * A value matching the pattern starts with the characters before the first
+ * wildcard, or equals the pattern if it has no wildcards.
+ */
+bool matchesPattern(std::string_view value,
+                    const std::string& pattern,
+                    bool like) {
+  auto wildcard = pattern.find_first_of(like ? "%_" : "*?[");
+  auto prefix_size =
+      (wildcard == std::string::npos) ? pattern.size() : wildcard;
+  if (value.size() < prefix_size ||
+      (wildcard == std::string::npos && value.size() != prefix_size)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < prefix_size; i++) {
+    if (like ? foldCase(value[i]) != foldCase(pattern[i])
+             : value[i] != pattern[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Parse an integer constraint expression, the whole expression must parse.
+bool integerExpression(const std::string& expr, long long& number) {
+  if (expr.empty() || std::isspace(static_cast<unsigned char>(expr[0]))) {
+    return false;
+  }
+
+  char* end = nullptr;
+  errno = 0;
+  number = std::strtoll(expr.c_str(), &end, 10);
+  return errno == 0 && end != nullptr && *end == '\0';
+}
+
+/// Read a numeric column value the way DynamicTableRow gives it to SQLite.
+bool numericValue(ColumnType type, std::string_view value, long long& number) {
+  if (value.empty()) {
+    return false;
+  }
+
+  std::string expr(value);
+  if (type == INTEGER_TYPE) {
+    auto afinite = tryTo<long>(expr, 0);
+    if (afinite.isError()) {
+      return false;
+    }
+    number = static_cast<int>(afinite.take());
+    return true;
+  }
+
+  auto afinite = tryTo<long long>(expr, 0);
+  if (afinite.isError()) {
+    return false;
+  }
+  number = afinite.take();
+  return true;
+}
+
+} // namespace
+
+EventRowFilter::EventRowFilter(const QueryContext& context) {
+  for (const auto& column : context.constraints) {
+    const auto& constraint_list = column.second;
+    if (constraint_list.affinity != TEXT_TYPE &&
+        !isNumericType(constraint_list.affinity)) {
+      continue;
+    }
+
+    ColumnFilter filter;
+    filter.name = column.first;
+    filter.affinity = constraint_list.affinity;
+    for (const auto& constraint : constraint_list.getAll()) {
+      if (!isFilteredOperator(constraint.op)) {
+        continue;
+      }
+
+      Predicate predicate{constraint.op, constraint.expr};
+      if (isNumericType(filter.affinity)) {
+        // Compare numbers only against integer expressions.
+        if (constraint.op == LIKE || constraint.op == GLOB ||
+            !integerExpression(constraint.expr, predicate.number)) {
+          continue;
+        }
+      } else if (constraint.op != EQUALS && constraint.op != LIKE &&
+                 constraint.op != GLOB) {
+        continue;
+      }
+      filter.predicates.push_back(std::move(predicate));
+    }
+
+    if (!filter.predicates.empty()) {
+      columns_.push_back(std::move(filter));
+    }
+  }
+}
+
+bool EventRowFilter::matchesValue(const ColumnFilter& column,
+                                  std::string_view value) {
+  if (column.affinity == TEXT_TYPE) {
+    for (const auto& predicate : column.predicates) {
+      if (predicate.op == EQUALS) {
+        if (value != predicate.expr) {
+          return false;
+        }
+      } else if (!matchesPattern(value, predicate.expr, predicate.op == LIKE)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // A value that does not cast is NULL, which never compares true.
+  long long number = 0;
+  if (!numericValue(column.affinity, value, number)) {
+    return false;
+  }
+
+  for (const auto& predicate : column.predicates) {
+    auto op = predicate.op;
+    auto expr = predicate.number;
+    if ((op == EQUALS && !(number == expr)) ||
+        (op == GREATER_THAN && !(number > expr)) ||
+        (op == GREATER_THAN_OR_EQUALS && !(number >= expr)) ||
+        (op == LESS_THAN && !(number < expr)) ||
+        (op == LESS_THAN_OR_EQUALS && !(number <= expr))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EventRowFilter::matches(const std::string& serialized_row) const {
+  if (columns_.empty() || !isBinaryRow(serialized_row)) {
+    return true;
+  }
+
+  // Columns missing from the row are left to SQLite, they may be aliases.
+  bool matched = true;
+  auto visitor = [this, &matched](std::string_view name,
+                                  std::string_view value) {
+    for (const auto& column : columns_) {
+      if (column.name == name) {
+        matched = matchesValue(column, value);
+        break;
+      }
+    }
+    return matched;
+  };
+  auto status = visitRowBinary(serialized_row, visitor);
+
+  // Rows that cannot be read are reported when they are deserialized.
+  return !status.ok() || matched;
+}
+
+bool EventRowFilter::matches(const Row& row) const {
+  for (const auto& column : columns_) {
+    auto it = row.find(column.name);
+    if (it != row.end() && !matchesValue(column, it->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace osquery
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/core/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief Evaluate query constraints on stored event rows.
+ *
+ * An EventSubscriber's table reads every stored event within the 'time'
+ * bounds, SQLite then applies the remaining constraints to each yielded row.
+ * The filter is built from the query constraints and applied while events are
+ * read from the backing store: binary rows are inspected in place and only
+ * deserialized if they may match.
+ *
+ * Only equality and range comparisons on numeric and TEXT columns and the
+ * literal prefix of LIKE and GLOB patterns are evaluated. A row is rejected
+ * only if SQLite would reject it, every other constraint is left to SQLite.
+ */
+class EventRowFilter {
+ public:
+  EventRowFilter() = default;
+
+  /// Collect the constraints a query context gives to the table.
+  explicit EventRowFilter(const QueryContext& context);
+
+  /// Check if the filter has no constraints and matches every row.
+  bool empty() const {
+    return columns_.empty();
+  }
+
+  /**
+   * @brief Check if a serialized stored row may match the constraints.
+   *
+   * Rows that are not binary, or cannot be read, are not rejected.
+   *
+   * @param serialized_row a row written by serializeRowBinary.
+   * @return false if the row cannot match.
+   */
+  bool matches(const std::string& serialized_row) const;
+
+  /// Check if a deserialized row may match the constraints.
+  bool matches(const Row& row) const;
+
+ private:
+  /// A constraint with its expression parsed for numeric columns.
+  struct Predicate {
+    unsigned char op;
+    std::string expr;
+    long long number{0};
+  };
+
+  /// The constraints on a single column.
+  struct ColumnFilter {
+    std::string name;
+    ColumnType affinity{TEXT_TYPE};
+    std::vector<Predicate> predicates;
+  };
+
+  /// Check a column value as SQLite would read it from a DynamicTableRow.
+  static bool matchesValue(const ColumnFilter& column, std::string_view value);
+
+ private:
+  std::vector<ColumnFilter> columns_;
+};
+
+} // namespace osquery
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cerrno>
+#include <cstdlib>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/database/database.h>
@@ -68,6 +71,37 @@ void removeDeprecatedEventKeysOnce() {
   std::call_once(f, removeDeprecatedEventKeysOnceHelper);
 }
 
+/// Deserialize a stored event row, rows stored by previous versions are JSON.
+Status deserializeEventRow(const std::string& serialized_row, Row& row) {
+  if (isBinaryRow(serialized_row)) {
+    return deserializeRowBinary(serialized_row, row);
+  }
+  return deserializeRowJSON(serialized_row, row);
+}
+
+/// Prefix of the database keys storing events for a subscriber.
+inline std::string eventKeyPrefix(
+    const EventSubscriberPlugin::Context& context) {
+  return "data." + context.database_namespace + ".";
+}
+
+/// Number of stored events read by each scan when generating rows.
+const std::size_t kEventScanBatchSize{1024U};
+
+/// Parse a zero-padded decimal key component ending with a separator.
+bool parseKeyComponent(const char*& input, char separator, uint64_t& value) {
+  char* end = nullptr;
+  errno = 0;
+  auto int_value = std::strtoull(input, &end, 10);
+  if (errno != 0 || end == nullptr || end == input || *end != separator) {
+    return false;
+  }
+
+  value = static_cast<uint64_t>(int_value);
+  input = end + 1;
+  return true;
+}
+
 } // namespace
 
 FLAG(bool,
@@ -125,32 +159,34 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
     auto event_identifier = getEventID();
     event_id_list.push_back(event_identifier);
 
-    auto string_event_identifier = toIndex(event_identifier);
-
     row["time"] = string_event_time;
-    row["eid"] = string_event_identifier;
+    row["eid"] = toIndex(event_identifier);
 
-    // Serialize and store the row data, for query-time retrieval.
-    std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
-    if (!status.ok()) {
-      VLOG(1) << status.getMessage();
-      continue;
-    }
+    // Logger plugins may request events to be forwarded directly.
+    // Only serialize JSON if an active logger is marked 'usesLogEvent'.
+    if (EventFactory::hasForwarders()) {
+      std::string json_row;
+      auto status = serializeRowJSON(row, json_row);
+      if (!status.ok()) {
+        VLOG(1) << status.getMessage();
+        continue;
+      }
 
-    // Then remove the newline.
-    if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
-      serialized_row.pop_back();
+      // Then remove the newline.
+      if (json_row.size() > 0 && json_row.back() == '\n') {
+        json_row.pop_back();
+      }
+      EventFactory::forwardEvent(json_row);
     }
 
-    // Logger plugins may request events to be forwarded directly.
-    // If no active logger is marked 'usesLogEvent' then this is a no-op.
-    EventFactory::forwardEvent(serialized_row);
+    // Serialize and store the row data, for query-time retrieval.
+    std::string serialized_row;
+    serializeRowBinary(row, serialized_row);
 
-    // Store the event data in the batch
-    database_data.push_back(
-        std::make_pair("data." + dbNamespace() + "." + string_event_identifier,
-                       serialized_row));
+    // Store the event data in the batch, keys are ordered by time.
+    database_data.push_back(std::make_pair(
+        databaseKeyForEventId(context, event_time, event_identifier),
+        std::move(serialized_row)));
   }
 
   if (database_data.empty()) {
@@ -254,7 +290,8 @@ uint64_t EventSubscriberPlugin::getExpireTime() {
 void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                                          bool can_optimize,
                                          EventTime start_time,
-                                         EventTime stop_time) {
+                                         EventTime stop_time,
+                                         const EventRowFilter& filter) {
   EventTime optimize_time{0U};
   EventID optimize_eid{0U};
   if (can_optimize && shouldOptimize()) {
@@ -274,7 +311,8 @@ void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                              callback,
                              start_time,
                              stop_time,
-                             optimize_eid);
+                             optimize_eid,
+                             filter);
 
     if (can_optimize && shouldOptimize()) {
       if (last != this->context.event_index.end()) {
@@ -318,7 +356,10 @@ void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
     yield(TableRowHolder(new DynamicTableRow(std::move(row))));
   };
 
-  generateRows(generateRowsCallback, can_optimize, start, stop);
+  // Reject stored rows that cannot match the remaining constraints before
+  // they are deserialized and handed to SQLite.
+  EventRowFilter filter(context);
+  generateRows(generateRowsCallback, can_optimize, start, stop, filter);
 }
 
 size_t EventSubscriberPlugin::numSubscriptions() const {
@@ -334,6 +375,23 @@ bool EventSubscriberPlugin::executedAllQueries() const {
   return queries_.size() >= query_count_;
 }
 
+std::string EventSubscriberPlugin::getExecutingQuery(
+    IDatabaseInterface& db_interface) {
+  // Scheduled queries record their name on the thread executing them.
+  std::string query_name = Config::getExecutingQuery();
+  if (!query_name.empty()) {
+    return query_name;
+  }
+
+  db_interface.getDatabaseValue(
+      kPersistentSettings, kExecutingQuery, query_name);
+  if (query_name.find('\n') != std::string::npos) {
+    // Several scheduled queries are executing, none of them on this thread.
+    return "";
+  }
+  return query_name;
+}
+
 std::string EventSubscriberPlugin::toIndex(std::uint64_t i) {
   auto str_index = std::to_string(i);
   if (str_index.size() < 10) {
@@ -346,9 +404,7 @@ void EventSubscriberPlugin::setOptimizeData(IDatabaseInterface& db_interface,
                                             EventTime time,
                                             EventID eid) {
   // Store the optimization time and eid.
-  std::string query_name;
-  db_interface.getDatabaseValue(
-      kPersistentSettings, kExecutingQuery, query_name);
+  auto query_name = getExecutingQuery(db_interface);
   if (query_name.empty()) {
     return;
   }
@@ -370,8 +426,7 @@ void EventSubscriberPlugin::getOptimizeData(IDatabaseInterface& db_interface,
                                             EventID& o_eid,
                                             std::string& query_name) {
   // Read the optimization time for the current executing query.
-  db_interface.getDatabaseValue(
-      kPersistentSettings, kExecutingQuery, query_name);
+  query_name = getExecutingQuery(db_interface);
 
   if (query_name.empty()) {
     o_time = 0;
@@ -406,73 +461,50 @@ void EventSubscriberPlugin::setDatabaseNamespace(Context& context,
 
 Status EventSubscriberPlugin::generateEventDataIndex(
     Context& context, IDatabaseInterface& db_interface) {
-  std::vector<std::string> key_list;
-
-  std::string prefix = "data." + context.database_namespace + ".";
-  auto status = db_interface.scanDatabaseKeys(kEvents, key_list, prefix, 0);
-  if (!status.ok()) {
-    return status;
-  }
-
   std::vector<std::string> invalid_data_key_list;
   std::size_t event_count{0U};
 
   EventID last_event_id{1U};
   EventIndex event_index;
 
-  for (const auto& key : key_list) {
-    auto string_event_id = &key[prefix.size()];
-
-    EventID event_identifier = {};
-
-    {
-      char* null_terminator = nullptr;
-      auto int_value = std::strtoull(string_event_id, &null_terminator, 10);
-      if (int_value == 0U || null_terminator == nullptr ||
-          *null_terminator != '\0') {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      event_identifier = static_cast<EventID>(int_value);
-    }
-
-    last_event_id = std::max(last_event_id, event_identifier);
-
-    EventTime event_time = {};
-
-    {
-      std::string serialized_row;
-      status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-      if (!status.ok()) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      Row row;
-      if (!deserializeRowJSON(serialized_row, row)) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
+  // Both the event time and identifier are part of the key, the index is
+  // rebuilt without reading the stored rows. Keys are sorted by time so each
+  // time bucket is appended to the end of the index.
+  DatabaseScanOptions scan_options;
+  scan_options.prefix = eventKeyPrefix(context);
+  scan_options.keys_only = true;
+
+  auto status = db_interface.scanDatabaseValues(
+      kEvents,
+      scan_options,
+      [&](const std::string& key, const std::string&) {
+        const char* input = key.c_str() + scan_options.prefix.size();
+
+        EventTime event_time{};
+        EventID event_identifier{};
+        if (!parseKeyComponent(input, '.', event_time) ||
+            !parseKeyComponent(input, '\0', event_identifier) ||
+            event_identifier == 0U) {
+          invalid_data_key_list.push_back(key);
+          return true;
+        }
+
+        last_event_id = std::max(last_event_id, event_identifier);
+
+        auto it = event_index.end();
+        if (event_index.empty() || std::prev(it)->first != event_time) {
+          it = event_index.emplace_hint(it, event_time, EventIDList{});
+        } else {
+          --it;
+        }
+
+        it->second.push_back(event_identifier);
+        ++event_count;
+        return true;
+      });
 
-      if (row.count("time") == 0) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
-
-      event_time = boost::lexical_cast<EventTime>(row.at("time"));
-    }
-
-    auto it = event_index.find(event_time);
-    if (it == event_index.end()) {
-      auto insert_status = event_index.insert({event_time, {}});
-      it = insert_status.first;
-    }
-
-    auto& event_id_list = it->second;
-    event_id_list.push_back(event_identifier);
-
-    ++event_count;
+  if (!status.ok()) {
+    return status;
   }
 
   if (!invalid_data_key_list.empty()) {
@@ -500,11 +532,19 @@ Status EventSubscriberPlugin::generateEventDataIndex(
 }
 
 std::string EventSubscriberPlugin::databaseKeyForEventId(Context& context,
+                                                         EventTime event_time,
                                                          EventID event_id) {
-  auto string_event_id = toIndex(event_id);
+  return eventKeyPrefix(context) + toIndex(event_time) + "." +
+         toIndex(event_id);
+}
 
-  return std::string("data.") + context.database_namespace + "." +
-         string_event_id;
+Status EventSubscriberPlugin::removeEventsBefore(
+    Context& context, IDatabaseInterface& db_interface, EventTime event_time) {
+  // The range is inclusive, the upper key sorts after every identifier stored
+  // in the last time bucket and before the next bucket.
+  auto prefix = eventKeyPrefix(context);
+  return db_interface.deleteDatabaseRange(
+      kEvents, prefix, prefix + toIndex(event_time) + ".~");
 }
 
 void EventSubscriberPlugin::removeOverflowingEventBatches(
@@ -553,26 +593,15 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     string_last_query_time = buffer.data();
   }
 
-  std::size_t batches_removed{};
-  for (const auto& p : excess_event_batch_list) {
-    const auto& event_identifier_list = p.second;
-
-    for (auto event_id : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_id);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (status.ok()) {
-        ++batches_removed;
-      }
-    }
-  }
-
-  auto failed_delete_count = (excess_event_batch_list.size() - batches_removed);
+  // The removed batches are the oldest, delete them with a single range.
+  auto status = removeEventsBefore(
+      context, db_interface, excess_event_batch_list.rbegin()->first);
 
   std::stringstream message;
-  message << "Removed " << batches_removed << " event batches ";
+  message << "Removed " << excess_event_batch_list.size() << " event batches ";
 
-  if (failed_delete_count > 0U) {
-    message << "(with " << failed_delete_count << " delete errors)  ";
+  if (!status.ok()) {
+    message << "(with delete error: " << status.getMessage() << ")  ";
   }
 
   message << "for subscriber: " << context.database_namespace
@@ -590,7 +619,8 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
     return;
   }
 
-  EventIndex expired_event_batch_list;
+  EventTime expired_time{0U};
+  std::size_t expired_count{0U};
 
   {
     WriteLock lock(context.event_index_mutex);
@@ -608,30 +638,18 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
     auto range_start = context.event_index.begin();
     auto range_end = context.event_index.upper_bound(oldest_valid_time);
 
-    expired_event_batch_list.insert(std::make_move_iterator(range_start),
-                                    std::make_move_iterator(range_end));
+    expired_time = std::prev(range_end)->first;
+    for (auto it = range_start; it != range_end; ++it) {
+      expired_count += it->second.size();
+    }
 
     context.event_index.erase(range_start, range_end);
   }
 
-  // TODO(alessandro): Implement deleteDatabaseBatch
-  std::size_t error_count{};
-
-  for (const auto& p : expired_event_batch_list) {
-    const auto& event_identifier_list = p.second;
-
-    for (const auto& event_identifier : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_identifier);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (!status.ok()) {
-        ++error_count;
-      }
-    }
-  }
-
-  if (error_count > 0U) {
-    LOG(ERROR) << "Failed to expire " << error_count
-               << " events due to database errors";
+  auto status = removeEventsBefore(context, db_interface, expired_time);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to expire " << expired_count
+               << " events due to database errors: " << status.getMessage();
   }
 }
 
@@ -641,7 +659,8 @@ EventIndex::iterator EventSubscriberPlugin::generateRows(
     std::function<void(Row)> callback,
     EventTime start_time,
     EventTime end_time,
-    EventID last_eid) {
+    EventID last_eid,
+    const EventRowFilter& filter) {
   auto last = context.event_index.end();
   if (end_time != 0 && start_time > end_time) {
     return last;
@@ -662,35 +681,85 @@ EventIndex::iterator EventSubscriberPlugin::generateRows(
                             ? context.event_index.end()
                             : context.event_index.upper_bound(end_time);
 
+  if (lower_bound_it == upper_bound_it) {
+    return last;
+  }
+  last = std::prev(upper_bound_it);
+
+  // The rows of the selected time buckets are read with key/value scans, from
+  // the first bucket to the end of the last one. The callback may suspend the
+  // query, rows are emitted between scans of a bounded number of keys.
+  auto prefix = eventKeyPrefix(context);
+  DatabaseScanOptions scan_options;
+  scan_options.prefix = prefix;
+  scan_options.low = prefix + toIndex(lower_bound_it->first) + ".";
+  scan_options.high = prefix + toIndex(last->first) + ".~";
+  scan_options.max = kEventScanBatchSize;
+
   std::vector<std::string> invalid_key_list;
-  for (auto it = lower_bound_it; it != upper_bound_it; ++it) {
-    const auto& event_id_list = it->second;
+  std::vector<Row> row_list;
+  std::size_t scanned_key_count{0U};
+  std::string last_key;
+
+  auto visitor = [&](const std::string& key,
+                     const std::string& serialized_row) {
+    ++scanned_key_count;
+    last_key = key;
+
+    const char* input = key.c_str() + prefix.size();
+
+    EventTime event_time{};
+    EventID event_identifier{};
+    if (!parseKeyComponent(input, '.', event_time) ||
+        !parseKeyComponent(input, '\0', event_identifier) ||
+        serialized_row.empty()) {
+      invalid_key_list.push_back(key);
+      return true;
+    }
 
-    for (const auto& event_identifier : event_id_list) {
-      if (last_eid >= event_identifier) {
-        // A previous optimized query has already visited this event.
-        continue;
-      }
-      auto key = databaseKeyForEventId(context, event_identifier);
+    if (last_eid >= event_identifier) {
+      // A previous optimized query has already visited this event.
+      return true;
+    }
 
-      std::string serialized_row;
-      auto status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-      if (serialized_row.empty()) {
-        invalid_key_list.push_back(key);
-        continue;
-      }
+    if (!filter.matches(serialized_row)) {
+      return true;
+    }
 
-      Row row = {};
-      status = deserializeRowJSON(serialized_row, row);
-      if (!status.ok()) {
-        invalid_key_list.push_back(key);
-        continue;
-      }
+    Row row = {};
+    auto status = deserializeEventRow(serialized_row, row);
+    if (!status.ok()) {
+      invalid_key_list.push_back(key);
+      return true;
+    }
+
+    // Rows stored as JSON by previous versions are filtered once parsed.
+    if (!isBinaryRow(serialized_row) && !filter.matches(row)) {
+      return true;
+    }
+
+    row_list.push_back(std::move(row));
+    return true;
+  };
+
+  do {
+    scanned_key_count = 0U;
+    row_list.clear();
 
+    auto status =
+        db_interface.scanDatabaseValues(kEvents, scan_options, visitor);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to read the events of subscriber "
+                 << context.database_namespace << ": " << status.getMessage();
+    }
+
+    for (auto& row : row_list) {
       callback(std::move(row));
     }
-    last = it;
-  }
+
+    // Continue right after the last visited key.
+    scan_options.low = last_key + '\0';
+  } while (scanned_key_count == kEventScanBatchSize);
 
   if (!invalid_key_list.empty()) {
     std::size_t erased_key_count{0U};
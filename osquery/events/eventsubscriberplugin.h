@@ -15,6 +15,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/events/eventer.h>
+#include <osquery/events/eventrowfilter.h>
 #include <osquery/events/types.h>
 #include <osquery/utils/mutex.h>
 
@@ -123,12 +124,14 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param can_optimize If true then optimization can be considered.
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
+   * @param filter (optional) Query constraints applied to stored rows.
    * @return Set of event rows matching time limits.
    */
   void generateRows(std::function<void(Row)> callback,
                     bool can_optimize,
                     EventTime start_time,
-                    EventTime stop_stop);
+                    EventTime stop_stop,
+                    const EventRowFilter& filter = EventRowFilter());
 
   /// Track a query execution.
   virtual void setExecutedQuery(const std::string& query_name,
@@ -192,6 +195,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
   static std::string toIndex(std::uint64_t i);
 
+  /// Name of the scheduled query reading events on the calling thread.
+  static std::string getExecutingQuery(IDatabaseInterface& db_interface);
+
   static void setOptimizeData(IDatabaseInterface& db_interface,
                               EventTime time,
                               EventID eid);
@@ -212,7 +218,20 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   static Status generateEventDataIndex(Context& context,
                                        IDatabaseInterface& db_interface);
 
-  static std::string databaseKeyForEventId(Context& context, EventID event_id);
+  /**
+   * @brief Build the database key of an event.
+   *
+   * Event keys are ordered by time then event id, so the events stored before
+   * a time are a contiguous range of keys.
+   */
+  static std::string databaseKeyForEventId(Context& context,
+                                           EventTime event_time,
+                                           EventID event_id);
+
+  /// Remove every event stored at or before a time with one range delete.
+  static Status removeEventsBefore(Context& context,
+                                   IDatabaseInterface& db_interface,
+                                   EventTime event_time);
 
   static void removeOverflowingEventBatches(Context& context,
                                             IDatabaseInterface& db_interface,
@@ -234,14 +253,17 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
    * @param last_eid (optional) The last visited event id.
+   * @param filter (optional) Query constraints applied to stored rows.
    * @return The upper bound time or 0 if there were no events in the range.
    */
-  static EventIndex::iterator generateRows(Context& context,
-                                           IDatabaseInterface& db_interface,
-                                           std::function<void(Row)> callback,
-                                           EventTime start_time,
-                                           EventTime end_time,
-                                           EventID last_eid = 0);
+  static EventIndex::iterator generateRows(
+      Context& context,
+      IDatabaseInterface& db_interface,
+      std::function<void(Row)> callback,
+      EventTime start_time,
+      EventTime end_time,
+      EventID last_eid = 0,
+      const EventRowFilter& filter = EventRowFilter());
 
   explicit EventSubscriberPlugin(EventSubscriberPlugin const&) = delete;
   EventSubscriberPlugin& operator=(EventSubscriberPlugin const&) = delete;
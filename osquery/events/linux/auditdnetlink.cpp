@@ -13,7 +13,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 
 #include <boost/utility/string_ref.hpp>
@@ -56,6 +58,13 @@ FLAG(int32, audit_backlog_wait_time, 0, "The audit backlog wait time");
 /// This value is passed directly to the audit API.
 FLAG(int32, audit_backlog_limit, 4096, "The audit backlog limit");
 
+/// Size of the queues between the netlink reader, the parser and the publisher.
+FLAG(uint64,
+     audit_queue_size,
+     4096,
+     "Number of audit records queued between the netlink reader, the parser "
+     "and the publisher");
+
 // External flags; they are used to determine which rules need to be installed
 DECLARE_bool(audit_allow_config);
 DECLARE_bool(audit_allow_fim_events);
@@ -130,7 +139,9 @@ enum AuditStatus {
 
 AuditdNetlink::AuditdNetlink() {
   try {
-    auditd_context_ = std::make_shared<AuditdContext>();
+    auto queue_size = static_cast<std::size_t>(
+        std::max<std::uint64_t>(FLAGS_audit_queue_size, 1U));
+    auditd_context_ = std::make_shared<AuditdContext>(queue_size);
 
     Dispatcher::addService(
         std::make_shared<AuditdNetlinkReader>(auditd_context_));
@@ -148,25 +159,32 @@ AuditdNetlink::AuditdNetlink() {
 std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
   std::vector<AuditEventRecord> record_list;
 
-  {
-    std::unique_lock<std::mutex> queue_lock(
-        auditd_context_->processed_events_mutex);
+  auto& processed_events = auditd_context_->processed_events;
+  if (!processed_events.waitForData(std::chrono::seconds(1))) {
+    return record_list;
+  }
 
-    if (auditd_context_->processed_records_cv.wait_for(
-            queue_lock, std::chrono::seconds(1)) ==
-        std::cv_status::no_timeout) {
-      record_list = std::move(auditd_context_->processed_events);
-      auditd_context_->processed_events.clear();
-    }
+  record_list.reserve(processed_events.size());
+  for (auto record = processed_events.consumerSlot(); record != nullptr;
+       record = processed_events.consumerSlot()) {
+    record_list.push_back(std::move(*record));
+    processed_events.pop();
   }
 
   return record_list;
 }
 
+std::uint64_t AuditdNetlink::droppedRecords() const noexcept {
+  return auditd_context_->dropped_records;
+}
+
+std::uint64_t AuditdNetlink::backpressureWaits() const noexcept {
+  return auditd_context_->backpressure_waits;
+}
+
 AuditdNetlinkReader::AuditdNetlinkReader(AuditdContextRef context)
     : InternalRunnable("AuditdNetlinkReader"),
-      auditd_context_(std::move(context)),
-      read_buffer_(4096U) {}
+      auditd_context_(std::move(context)) {}
 
 void AuditdNetlinkReader::start() {
   int counter_to_next_status_request = 0;
@@ -224,7 +242,7 @@ void AuditdNetlinkReader::stop() {
 
   VLOG(1) << "Releasing the audit handle...";
 
-  auditd_context_->unprocessed_records_cv.notify_all();
+  auditd_context_->unprocessed_records.notifyAll();
 
   if (FLAGS_audit_allow_config) {
     restoreAuditServiceConfiguration();
@@ -240,13 +258,16 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
   struct sockaddr_nl nladdr = {};
   socklen_t nladdrlen = sizeof(nladdr);
 
+  auto& unprocessed_records = auditd_context_->unprocessed_records;
   bool reset_handle = false;
-  size_t events_received = 0;
 
-  // Attempt to read as many messages as possible before we exit, and terminate
-  // early if we have been asked to terminate
-  for (events_received = 0;
-       !interrupted() && events_received < read_buffer_.size();
+  // A scratch slot used to drain the netlink while the parser is behind
+  audit_reply discarded_reply = {};
+
+  // Attempt to read as many messages as the queue holds before we exit, and
+  // terminate early if we have been asked to terminate
+  for (size_t events_received = 0;
+       !interrupted() && events_received < unprocessed_records.capacity();
        events_received++) {
     errno = 0;
     int poll_status = ::poll(fds, 1, 2000);
@@ -267,7 +288,11 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    audit_reply reply = {};
+    // Never stop reading when the parser falls behind: the kernel would block
+    // audited processes or drop records once the audit backlog is full.
+    // Records are received directly into the queue slots
+    auto slot = unprocessed_records.producerSlot();
+    auto& reply = (slot != nullptr) ? *slot : discarded_reply;
     ssize_t len = recvfrom(audit_netlink_handle_,
                            &reply.msg,
                            sizeof(reply.msg),
@@ -281,6 +306,13 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
+    // Slots are reused; clear the bytes following the message, the parser
+    // reads up to the terminator
+    auto received = static_cast<size_t>(len);
+    auto padding = std::min(sizeof(reply.msg) - received,
+                            static_cast<size_t>(NLMSG_HDRLEN) + 1U);
+    std::memset(reinterpret_cast<char*>(&reply.msg) + received, 0, padding);
+
     if (nladdrlen != sizeof(nladdr)) {
       VLOG(1) << "Protocol error";
       reset_handle = true;
@@ -304,22 +336,12 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    read_buffer_[events_received] = reply;
-  }
-
-  if (events_received != 0) {
-    std::unique_lock<std::mutex> lock(
-        auditd_context_->unprocessed_records_mutex);
-
-    auditd_context_->unprocessed_records.reserve(
-        auditd_context_->unprocessed_records.size() + events_received);
-
-    auditd_context_->unprocessed_records.insert(
-        auditd_context_->unprocessed_records.end(),
-        read_buffer_.begin(),
-        std::next(read_buffer_.begin(), events_received));
+    if (slot == nullptr) {
+      auditd_context_->dropped_records++;
+      continue;
+    }
 
-    auditd_context_->unprocessed_records_cv.notify_all();
+    unprocessed_records.push();
   }
 
   if (reset_handle) {
@@ -689,85 +711,71 @@ AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context)
       auditd_context_(std::move(context)) {}
 
 void AuditdNetlinkParser::start() {
-  while (!interrupted()) {
-    std::vector<audit_reply> queue;
-
-    {
-      std::unique_lock<std::mutex> lock(
-          auditd_context_->unprocessed_records_mutex);
+  auto& unprocessed_records = auditd_context_->unprocessed_records;
+  auto& processed_events = auditd_context_->processed_events;
 
-      while (auditd_context_->unprocessed_records.empty() && !interrupted()) {
-        auditd_context_->unprocessed_records_cv.wait_for(
-            lock, std::chrono::seconds(1));
-      }
-
-      queue = std::move(auditd_context_->unprocessed_records);
-      auditd_context_->unprocessed_records.clear();
+  while (!interrupted()) {
+    auto reply_slot = unprocessed_records.consumerSlot();
+    if (reply_slot == nullptr) {
+      unprocessed_records.waitForData(std::chrono::seconds(1));
+      continue;
     }
 
-    std::vector<AuditEventRecord> audit_event_record_queue;
-    audit_event_record_queue.reserve(queue.size());
+    auto& reply = *reply_slot;
+    AdjustAuditReply(reply);
 
-    for (auto& reply : queue) {
-      if (interrupted()) {
-        break;
-      }
+    // This record carries the process id of the controlling daemon; in case
+    // we lost control of the audit service, we are going to request a reset
+    // as soon as we finish processing the pending queue
+    if (reply.type == AUDIT_GET) {
+      reply.status = static_cast<struct audit_status*>(NLMSG_DATA(reply.nlh));
+      auto new_pid = static_cast<pid_t>(reply.status->pid);
 
-      AdjustAuditReply(reply);
+      if (new_pid != getpid()) {
+        VLOG(1) << "Audit control lost to pid: " << new_pid;
 
-      // This record carries the process id of the controlling daemon; in case
-      // we lost control of the audit service, we are going to request a reset
-      // as soon as we finish processing the pending queue
-      if (reply.type == AUDIT_GET) {
-        reply.status = static_cast<struct audit_status*>(NLMSG_DATA(reply.nlh));
-        auto new_pid = static_cast<pid_t>(reply.status->pid);
+        if (FLAGS_audit_persist) {
+          VLOG(1) << "Attempting to reacquire control of the audit service";
+          auditd_context_->acquire_handle = true;
+        }
+      }
 
-        if (new_pid != getpid()) {
-          VLOG(1) << "Audit control lost to pid: " << new_pid;
+      unprocessed_records.pop();
+      continue;
+    }
 
-          if (FLAGS_audit_persist) {
-            VLOG(1) << "Attempting to reacquire control of the audit service";
-            auditd_context_->acquire_handle = true;
-          }
-        }
+    // We are not interested in all messages; only get the ones related to
+    // user events, seccomp, syscalls, SELinux events and AppArmor events
+    if (!ShouldHandle(reply)) {
+      unprocessed_records.pop();
+      continue;
+    }
 
-        continue;
-      }
+    // Wait for the publisher instead of dropping parsed records; the reader
+    // keeps draining the netlink meanwhile
+    auto event_slot = processed_events.producerSlot();
+    if (event_slot == nullptr) {
+      auditd_context_->backpressure_waits++;
 
-      // We are not interested in all messages; only get the ones related to
-      // user events, seccomp, syscalls, SELinux events and AppArmor events
-      if (!ShouldHandle(reply)) {
-        continue;
+      while (event_slot == nullptr && !interrupted()) {
+        processed_events.waitForSpace(std::chrono::milliseconds(100));
+        event_slot = processed_events.producerSlot();
       }
 
-      AuditEventRecord audit_event_record = {};
-      if (!ParseAuditReply(reply, audit_event_record)) {
-        VLOG(1) << "Malformed audit record received";
-        continue;
+      if (event_slot == nullptr) {
+        break;
       }
-
-      audit_event_record_queue.push_back(audit_event_record);
     }
 
-    // Save the new records and notify the reader
-    if (!audit_event_record_queue.empty()) {
-      std::lock_guard<std::mutex> queue_lock(
-          auditd_context_->processed_events_mutex);
-
-      auditd_context_->processed_events.reserve(
-          auditd_context_->processed_events.size() +
-          audit_event_record_queue.size());
+    auto parsed = ParseAuditReply(reply, *event_slot);
+    unprocessed_records.pop();
 
-      auditd_context_->processed_events.insert(
-          auditd_context_->processed_events.end(),
-          audit_event_record_queue.begin(),
-          audit_event_record_queue.end());
-
-      auditd_context_->processed_records_cv.notify_all();
+    if (!parsed) {
+      VLOG(1) << "Malformed audit record received";
+      continue;
     }
 
-    queue.clear();
-    audit_event_record_queue.clear();
+    processed_events.push();
   }
 }
 
@@ -829,8 +837,7 @@ bool AuditdNetlinkParser::ParseAuditReply(
       // tok.
       if (!key.empty()) {
         // Multiple space tokens are supported.
-        event_record.fields.emplace(
-            std::make_pair(std::move(key), std::move(value)));
+        event_record.fields.emplace(std::move(key), std::move(value));
       }
 
       found_enclose = false;
@@ -860,8 +867,7 @@ bool AuditdNetlinkParser::ParseAuditReply(
 
   // Last step, if there was no trailing tokenizer.
   if (!key.empty()) {
-    event_record.fields.emplace(
-        std::make_pair(std::move(key), std::move(value)));
+    event_record.fields.emplace(std::move(key), std::move(value));
   }
 
   return true;
@@ -11,13 +11,22 @@
 
 #include <libaudit.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <future>
+#include <initializer_list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/algorithm/hex.hpp>
@@ -32,6 +41,113 @@ enum class NetlinkStatus { ActiveMutable, ActiveImmutable, Disabled, Error };
 /// Contains an audit_rule_data structure
 using AuditRuleDataObject = std::vector<std::uint8_t>;
 
+/**
+ * @brief The fields of an audit record, kept sorted by name in a flat vector.
+ *
+ * A record carries a few dozen short fields. Keeping them in a single vector
+ * costs one allocation per record, instead of one tree node per field, and
+ * most names and values fit in the inline storage of their strings.
+ * Lookups and the iteration order are the ones of a std::map.
+ */
+class AuditFieldMap final {
+ public:
+  using value_type = std::pair<std::string, std::string>;
+  using iterator = std::vector<value_type>::iterator;
+  using const_iterator = std::vector<value_type>::const_iterator;
+
+  AuditFieldMap() = default;
+
+  AuditFieldMap(std::initializer_list<value_type> fields) {
+    fields_.reserve(fields.size());
+    for (const auto& field : fields) {
+      emplace(field.first, field.second);
+    }
+  }
+
+  iterator begin() noexcept {
+    return fields_.begin();
+  }
+
+  iterator end() noexcept {
+    return fields_.end();
+  }
+
+  const_iterator begin() const noexcept {
+    return fields_.begin();
+  }
+
+  const_iterator end() const noexcept {
+    return fields_.end();
+  }
+
+  std::size_t size() const noexcept {
+    return fields_.size();
+  }
+
+  bool empty() const noexcept {
+    return fields_.empty();
+  }
+
+  void clear() noexcept {
+    fields_.clear();
+  }
+
+  void reserve(std::size_t size) {
+    fields_.reserve(size);
+  }
+
+  iterator find(std::string_view name) {
+    auto it = std::lower_bound(fields_.begin(), fields_.end(), name, lessThan);
+    return (it != fields_.end() && it->first == name) ? it : fields_.end();
+  }
+
+  const_iterator find(std::string_view name) const {
+    auto it = std::lower_bound(fields_.begin(), fields_.end(), name, lessThan);
+    return (it != fields_.end() && it->first == name) ? it : fields_.end();
+  }
+
+  std::size_t count(std::string_view name) const {
+    return (find(name) != end()) ? 1U : 0U;
+  }
+
+  /// Access an existing field, throws std::out_of_range like std::map::at.
+  const std::string& at(std::string_view name) const {
+    auto it = find(name);
+    if (it == end()) {
+      throw std::out_of_range("Missing audit record field");
+    }
+    return it->second;
+  }
+
+  /// Access a field, adding an empty value if it is missing.
+  std::string& operator[](std::string_view name) {
+    auto it = std::lower_bound(fields_.begin(), fields_.end(), name, lessThan);
+    if (it == fields_.end() || it->first != name) {
+      it = fields_.emplace(it, std::string(name), std::string());
+    }
+    return it->second;
+  }
+
+  /// Add a field unless a field with the same name exists.
+  std::pair<iterator, bool> emplace(std::string name, std::string value) {
+    auto it = std::lower_bound(fields_.begin(), fields_.end(), name, lessThan);
+    if (it != fields_.end() && it->first == name) {
+      return std::make_pair(it, false);
+    }
+
+    it = fields_.emplace(it, std::move(name), std::move(value));
+    return std::make_pair(it, true);
+  }
+
+ private:
+  static bool lessThan(const value_type& field, std::string_view name) {
+    return std::string_view(field.first) < name;
+  }
+
+ private:
+  std::vector<value_type> fields_;
+};
+
 /// A single, prepared audit event record.
 struct AuditEventRecord final {
   /// Record type (i.e.: AUDIT_SYSCALL, AUDIT_PATH, ...)
@@ -45,7 +161,7 @@ struct AuditEventRecord final {
 
   /// The field list for this record. Valid for everything except SELinux and
   /// AppArmor records
-  std::map<std::string, std::string> fields;
+  AuditFieldMap fields;
 
   /// The raw message, only valid for SELinux and AppArmor records (because they
   /// have broken syntax)
@@ -55,29 +171,142 @@ struct AuditEventRecord final {
 static_assert(std::is_move_constructible<AuditEventRecord>::value,
               "not move constructible");
 
+/**
+ * @brief A bounded single-producer, single-consumer ring buffer.
+ *
+ * The slots are allocated once. The producer fills the slot returned by
+ * producerSlot() in place and publishes it with push(), the consumer reads
+ * the slot returned by consumerSlot() and releases it with pop(). Neither
+ * side takes a lock; a mutex is only used to sleep while the buffer is empty
+ * or full.
+ */
+template <typename T>
+class AuditRingBuffer final : private boost::noncopyable {
+ public:
+  /// The capacity is rounded up to a power of two.
+  explicit AuditRingBuffer(std::size_t capacity) {
+    std::size_t size = 1U;
+    while (size < capacity) {
+      size <<= 1U;
+    }
+
+    slots_.resize(size);
+    mask_ = size - 1U;
+  }
+
+  std::size_t capacity() const noexcept {
+    return slots_.size();
+  }
+
+  /// The number of published slots that have not been consumed.
+  std::size_t size() const noexcept {
+    auto head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+  /// Returns the next free slot, or nullptr if the buffer is full.
+  T* producerSlot() noexcept {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return nullptr;
+    }
+
+    return &slots_[tail & mask_];
+  }
+
+  /// Publishes the slot returned by producerSlot().
+  void push() noexcept {
+    tail_.fetch_add(1U, std::memory_order_seq_cst);
+    wake();
+  }
+
+  /// Returns the oldest published slot, or nullptr if the buffer is empty.
+  T* consumerSlot() noexcept {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+
+    return &slots_[head & mask_];
+  }
+
+  /// Releases the slot returned by consumerSlot().
+  void pop() noexcept {
+    head_.fetch_add(1U, std::memory_order_seq_cst);
+    wake();
+  }
+
+  /// Waits until a slot can be consumed; returns false on timeout.
+  bool waitForData(std::chrono::milliseconds timeout) {
+    return waitFor(timeout, [this]() { return size() != 0U; });
+  }
+
+  /// Waits until a slot can be filled; returns false on timeout.
+  bool waitForSpace(std::chrono::milliseconds timeout) {
+    return waitFor(timeout, [this]() { return size() != slots_.size(); });
+  }
+
+  /// Wakes up the threads waiting on the buffer.
+  void notifyAll() {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    wait_cv_.notify_all();
+  }
+
+ private:
+  void wake() {
+    if (waiters_.load(std::memory_order_seq_cst) != 0U) {
+      notifyAll();
+    }
+  }
+
+  template <typename Predicate>
+  bool waitFor(std::chrono::milliseconds timeout, Predicate predicate) {
+    if (predicate()) {
+      return true;
+    }
+
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    waiters_.fetch_add(1U, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ready = wait_cv_.wait_for(lock, timeout, predicate);
+    waiters_.fetch_sub(1U, std::memory_order_seq_cst);
+    return ready;
+  }
+
+ private:
+  std::vector<T> slots_;
+  std::size_t mask_{0U};
+
+  /// Next slot to consume, only written by the consumer.
+  alignas(64) std::atomic<std::size_t> head_{0U};
+
+  /// Next slot to fill, only written by the producer.
+  alignas(64) std::atomic<std::size_t> tail_{0U};
+
+  /// Number of threads sleeping in waitFor().
+  std::atomic<std::size_t> waiters_{0U};
+
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
 // This structure is used to share data between the reading and processing
 // services
 struct AuditdContext final {
-  /// Unprocessed audit records
-  std::vector<audit_reply> unprocessed_records;
-  static_assert(
-      std::is_move_constructible<decltype(unprocessed_records)>::value,
-      "not move constructible");
-
-  /// Mutex for the list of unprocessed records
-  std::mutex unprocessed_records_mutex;
+  explicit AuditdContext(std::size_t queue_size)
+      : unprocessed_records(queue_size), processed_events(queue_size) {}
 
-  /// Processed events condition variable
-  std::condition_variable unprocessed_records_cv;
+  /// Records read from the netlink, consumed by the parser
+  AuditRingBuffer<audit_reply> unprocessed_records;
 
-  /// This queue contains processed events
-  std::vector<AuditEventRecord> processed_events;
+  /// Records prepared by the parser, consumed by the publisher
+  AuditRingBuffer<AuditEventRecord> processed_events;
 
-  /// Processed events queue mutex.
-  std::mutex processed_events_mutex;
+  /// Records dropped by the reader because the parser fell behind
+  std::atomic<std::uint64_t> dropped_records{0U};
 
-  /// Used to wake up the thread that processes the raw audit records
-  std::condition_variable processed_records_cv;
+  /// Times the parser waited for the publisher to consume records
+  std::atomic<std::uint64_t> backpressure_waits{0U};
 
   /// When set to true, the audit handle is (re)acquired
   std::atomic_bool acquire_handle{true};
@@ -117,9 +346,6 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// Shared data
   AuditdContextRef auditd_context_;
 
-  /// Read buffer used when receiving events from the netlink
-  std::vector<audit_reply> read_buffer_;
-
   /// The set of rules we applied (and that we'll uninstall when exiting)
   std::vector<audit_rule_data> installed_rule_list_;
 
@@ -157,6 +383,12 @@ class AuditdNetlink final : private boost::noncopyable {
   /// Prepares the raw audit event records stored in the given context.
   std::vector<AuditEventRecord> getEvents() noexcept;
 
+  /// Records dropped because the parser fell behind the netlink reader.
+  std::uint64_t droppedRecords() const noexcept;
+
+  /// Times the parser waited for the publisher to consume records.
+  std::uint64_t backpressureWaits() const noexcept;
+
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
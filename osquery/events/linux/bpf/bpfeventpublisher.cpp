@@ -10,15 +10,16 @@
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/bpf/bpferrorstate.h>
 #include <osquery/events/linux/bpf/bpfeventpublisher.h>
+#include <osquery/events/linux/bpf/eventreorderbuffer.h>
 #include <osquery/events/linux/bpf/serializers.h>
 #include <osquery/events/linux/bpf/setrlimit.h>
-#include <osquery/events/linux/bpf/systemstatetracker.h>
+#include <osquery/events/linux/bpf/shardedsystemstatetracker.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/system/time.h>
 
 #include <fcntl.h>
-#include <sys/sysinfo.h>
+#include <time.h>
 
 namespace osquery {
 
@@ -27,6 +28,17 @@ HIDDEN_FLAG(uint32,
             10,
             "Number of minutes between BPF system state tracker resets");
 
+HIDDEN_FLAG(uint32,
+            bpf_state_tracker_shards,
+            1,
+            "Number of threads processing BPF events, process states are "
+            "sharded by pid");
+
+HIDDEN_FLAG(uint64,
+            bpf_reorder_buffer_size,
+            262144,
+            "Maximum number of BPF events held while restoring their order");
+
 namespace ebpfpub = tob::ebpfpub;
 namespace ebpf = tob::ebpf;
 
@@ -35,10 +47,14 @@ namespace {
 const std::size_t kEventMapSize{2048};
 const std::size_t kMaxNameToHandleAtSize{128U};
 
-using EventHandler = bool (*)(ISystemStateTracker& state,
-                              const ebpfpub::IFunctionTracer::Event&);
+/// How long events are held to restore their order, in nanoseconds
+const std::uint64_t kEventReorderDelay{5000000000ULL};
+
+/// The time span of each reorder buffer bucket, in nanoseconds
+const std::uint64_t kEventReorderBucketWidth{100000000ULL};
 
-using EventHandlerMap = std::unordered_map<std::uint64_t, EventHandler>;
+using EventHandler = ShardedSystemStateTracker::EventHandler;
+using EventHandlerMap = ShardedSystemStateTracker::HandlerMap;
 
 using BufferStorageMap =
     std::unordered_map<std::uint8_t, ebpfpub::IBufferStorage::Ref>;
@@ -106,6 +122,31 @@ const FunctionTracerAllocatorList kFunctionTracerAllocators = {
      false},
     {"execve", &BPFEventPublisher::processExecveEvent, 3U, true},
     {"execveat", &BPFEventPublisher::processExecveatEvent, 3U, true}};
+
+/// Process creations move the new process to its shard, file handles saved by
+/// name_to_handle_at can be opened by any process
+ShardedSystemStateTracker::Routing getEventRouting(
+    const std::string& syscall_name) {
+  if (syscall_name == "fork" || syscall_name == "vfork" ||
+      syscall_name == "clone") {
+    return ShardedSystemStateTracker::Routing::ProcessCreation;
+  }
+
+  if (syscall_name == "name_to_handle_at") {
+    return ShardedSystemStateTracker::Routing::Broadcast;
+  }
+
+  return ShardedSystemStateTracker::Routing::Process;
+}
+
+/// Returns the time on the clock of the BPF event timestamps, in nanoseconds
+std::uint64_t getMonotonicTime() {
+  struct timespec time_spec {};
+  clock_gettime(CLOCK_MONOTONIC, &time_spec);
+
+  return static_cast<std::uint64_t>(time_spec.tv_sec) * 1000000000ULL +
+         static_cast<std::uint64_t>(time_spec.tv_nsec);
+}
 } // namespace
 
 FLAG(bool,
@@ -133,8 +174,8 @@ struct BPFEventPublisher::PrivateData final {
   BufferStorageMap buffer_storage_map;
   EventHandlerMap event_handler_map;
 
-  std::map<std::uint64_t, ebpfpub::IFunctionTracer::Event> event_queue;
-  ISystemStateTracker::Ref system_state_tracker;
+  std::unique_ptr<BPFEventReorderBuffer> event_queue;
+  ShardedSystemStateTracker::Ref system_state_tracker;
 };
 
 Status BPFEventPublisher::setUp() {
@@ -263,15 +304,23 @@ Status BPFEventPublisher::setUp() {
     VLOG(1) << "Initialized BPF probe for syscall "
             << tracer_allocator.syscall_name << " (" << event_id << ")";
 
-    d->event_handler_map[event_id] = tracer_allocator.event_handler;
+    d->event_handler_map[event_id] = {
+        tracer_allocator.event_handler,
+        getEventRouting(tracer_allocator.syscall_name)};
     d->perf_event_reader->insert(std::move(function_tracer));
   }
 
-  d->system_state_tracker = SystemStateTracker::create();
+  d->system_state_tracker =
+      ShardedSystemStateTracker::create(FLAGS_bpf_state_tracker_shards);
   if (!d->system_state_tracker) {
     return Status::failure("Failed to create the system state tracker object");
   }
 
+  d->event_queue = std::make_unique<BPFEventReorderBuffer>(
+      kEventReorderDelay,
+      kEventReorderBucketWidth,
+      static_cast<std::size_t>(FLAGS_bpf_reorder_buffer_size));
+
   d->initialized = true;
   return Status::success();
 }
@@ -337,8 +386,7 @@ Status BPFEventPublisher::run() {
               ++bpf_error_state.probe_error_counter;
             }
 
-            auto rel_timestamp = event.header.timestamp;
-            d->event_queue.insert({rel_timestamp, std::move(event)});
+            d->event_queue->push(std::move(event));
           }
         });
 
@@ -348,34 +396,14 @@ Status BPFEventPublisher::run() {
       last_error_report = current_time;
     }
 
-    auto& state = *d->system_state_tracker.get();
-
-    struct sysinfo system_info {};
-    sysinfo(&system_info);
-
-    for (auto event_it = d->event_queue.begin();
-         event_it != d->event_queue.end();) {
-      const auto& rel_timestamp = event_it->first / 1000000000ULL;
-      if (system_info.uptime - rel_timestamp < 5ULL) {
-        ++event_it;
-        continue;
-      }
-
-      auto event = std::move(event_it->second);
-      event_it = d->event_queue.erase(event_it);
+    // Events are released once they are old enough to have been received
+    // from all the per-CPU perf buffers
+    BPFEventReorderBuffer::EventList ordered_event_list;
+    d->event_queue->release(ordered_event_list, getMonotonicTime());
 
-      auto event_handler_it = d->event_handler_map.find(event.identifier);
-      if (event_handler_it == d->event_handler_map.end()) {
-        LOG(ERROR) << "Unhandled event received in BPFEventPublisher: "
-                   << event.identifier;
-        continue;
-      }
-
-      const auto& event_handler = event_handler_it->second;
-      if (!event_handler(state, event)) {
-        bpf_error_state.errored_tracer_list.insert(event.identifier);
-      }
-    }
+    auto& state = *d->system_state_tracker.get();
+    state.processEvents(
+        ordered_event_list, d->event_handler_map, bpf_error_state);
 
     auto event_list = state.eventList();
     if (!event_list.empty()) {
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/bpf/eventreorderbuffer.h>
+
+#include <algorithm>
+
+namespace osquery {
+
+struct BPFEventReorderBuffer::PrivateData final {
+  std::vector<EventList> bucket_list;
+  std::uint64_t bucket_width{};
+  std::uint64_t delay{};
+  std::size_t max_events{};
+
+  /// The time slot of the oldest bucket
+  std::uint64_t first_slot{};
+
+  std::size_t event_count{};
+  Stats stats;
+
+  EventList& bucket(std::uint64_t slot) {
+    return bucket_list[static_cast<std::size_t>(slot % bucket_list.size())];
+  }
+
+  void releaseOldestBucket(EventList& event_list, std::uint64_t now);
+};
+
+BPFEventReorderBuffer::BPFEventReorderBuffer(std::uint64_t delay,
+                                             std::uint64_t bucket_width,
+                                             std::size_t max_events)
+    : d(new PrivateData) {
+  d->bucket_width = std::max<std::uint64_t>(bucket_width, 1U);
+  d->delay = delay;
+  d->max_events = max_events;
+
+  // The wheel spans the reorder delay, plus the bucket being filled
+  d->bucket_list.resize(static_cast<std::size_t>(delay / d->bucket_width) +
+                        1U);
+}
+
+BPFEventReorderBuffer::~BPFEventReorderBuffer() {}
+
+void BPFEventReorderBuffer::push(Event event) {
+  auto slot_count = static_cast<std::uint64_t>(d->bucket_list.size());
+  auto slot = event.header.timestamp / d->bucket_width;
+
+  if (slot >= d->first_slot + slot_count) {
+    if (d->event_count == 0U) {
+      // Leave room for older events that have yet to be received
+      d->first_slot = slot - (slot_count - 1U);
+
+    } else {
+      // Skip the expired buckets; a timestamp that is still ahead of the
+      // wheel is kept in the newest bucket
+      while (slot >= d->first_slot + slot_count &&
+             d->bucket(d->first_slot).empty()) {
+        ++d->first_slot;
+      }
+
+      slot = std::min(slot, d->first_slot + slot_count - 1U);
+    }
+
+  } else if (slot < d->first_slot) {
+    // Newer events have been released already; release this one next
+    ++d->stats.late;
+    slot = d->first_slot;
+  }
+
+  d->bucket(slot).push_back(std::move(event));
+
+  ++d->event_count;
+  ++d->stats.pushed;
+}
+
+void BPFEventReorderBuffer::release(EventList& event_list, std::uint64_t now) {
+  while (d->event_count != 0U) {
+    auto bucket_end = (d->first_slot + 1U) * d->bucket_width;
+    auto expired = bucket_end + d->delay <= now;
+
+    if (!expired && d->event_count <= d->max_events) {
+      break;
+    }
+
+    if (!expired) {
+      d->stats.overflowed += d->bucket(d->first_slot).size();
+    }
+
+    d->releaseOldestBucket(event_list, now);
+    ++d->first_slot;
+  }
+}
+
+std::size_t BPFEventReorderBuffer::size() const {
+  return d->event_count;
+}
+
+const BPFEventReorderBuffer::Stats& BPFEventReorderBuffer::stats() const {
+  return d->stats;
+}
+
+void BPFEventReorderBuffer::PrivateData::releaseOldestBucket(
+    EventList& event_list, std::uint64_t now) {
+  auto& oldest_bucket = bucket(first_slot);
+  if (oldest_bucket.empty()) {
+    return;
+  }
+
+  std::stable_sort(oldest_bucket.begin(),
+                   oldest_bucket.end(),
+                   [](const Event& lhs, const Event& rhs) {
+                     return lhs.header.timestamp < rhs.header.timestamp;
+                   });
+
+  for (auto& event : oldest_bucket) {
+    auto timestamp = event.header.timestamp;
+    auto latency = (now > timestamp) ? now - timestamp : 0U;
+
+    stats.total_latency += latency;
+    stats.max_latency = std::max(stats.max_latency, latency);
+
+    event_list.push_back(std::move(event));
+  }
+
+  stats.released += oldest_bucket.size();
+  event_count -= oldest_bucket.size();
+
+  // Keep the bucket allocation for the next round
+  oldest_bucket.clear();
+}
+
+} // namespace osquery
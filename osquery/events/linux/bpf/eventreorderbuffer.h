@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <ebpfpub/ifunctiontracer.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace osquery {
+
+/// \brief Restores the timestamp order of the events read from the perf buffers
+/// Events are read from one perf buffer per CPU, and may be received out of
+/// order. They are held in a time wheel of fixed width buckets until the
+/// bucket is older than the reorder delay, then released sorted by timestamp.
+/// The number of events held is bounded: when the limit is exceeded the oldest
+/// buckets are released early
+class BPFEventReorderBuffer final {
+ public:
+  using Event = tob::ebpfpub::IFunctionTracer::Event;
+  using EventList = std::vector<Event>;
+
+  /// Counters, times are in nanoseconds
+  struct Stats final {
+    /// Events received
+    std::uint64_t pushed{};
+
+    /// Events released
+    std::uint64_t released{};
+
+    /// Events received after newer events had been released
+    std::uint64_t late{};
+
+    /// Events released before the reorder delay to honor the size limit
+    std::uint64_t overflowed{};
+
+    /// Sum of the differences between release times and event timestamps
+    std::uint64_t total_latency{};
+
+    /// Largest difference between a release time and an event timestamp
+    std::uint64_t max_latency{};
+  };
+
+  /// \param delay how long events are held, in nanoseconds
+  /// \param bucket_width the time span of each bucket, in nanoseconds
+  /// \param max_events how many events can be held
+  BPFEventReorderBuffer(std::uint64_t delay,
+                        std::uint64_t bucket_width,
+                        std::size_t max_events);
+
+  ~BPFEventReorderBuffer();
+
+  /// Adds an event, ordered by its timestamp
+  void push(Event event);
+
+  /// Appends the events older than the reorder delay, in timestamp order
+  /// \param now the current time, on the clock of the event timestamps
+  void release(EventList& event_list, std::uint64_t now);
+
+  /// Returns how many events are held
+  std::size_t size() const;
+
+  /// Returns the counters
+  const Stats& stats() const;
+
+ private:
+  struct PrivateData;
+  std::unique_ptr<PrivateData> d;
+};
+
+} // namespace osquery
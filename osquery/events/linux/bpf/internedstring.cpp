@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/bpf/internedstring.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace osquery {
+
+struct InternedString::Entry final {
+  std::string value;
+  std::atomic<std::size_t> reference_count{1U};
+  std::size_t stripe{};
+};
+
+namespace {
+
+/// Separate locks, so that the state trackers of different threads
+/// rarely wait on each other
+const std::size_t kStripeCount{16U};
+
+struct PoolStripe final {
+  std::mutex mutex;
+
+  /// Keys point to the value of the entry they map to
+  std::unordered_map<std::string_view, std::unique_ptr<InternedString::Entry>>
+      entry_map;
+};
+
+using StringPool = std::array<PoolStripe, kStripeCount>;
+
+/// Never destroyed, since interned strings may be released by other
+/// static objects during shutdown
+StringPool& getStringPool() {
+  static auto string_pool = new StringPool;
+  return *string_pool;
+}
+
+const std::string kEmptyString;
+
+InternedString::Entry* internString(const std::string& value) {
+  auto stripe_index = std::hash<std::string>{}(value) % kStripeCount;
+  auto& stripe = getStringPool()[stripe_index];
+
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+
+  auto entry_it = stripe.entry_map.find(value);
+  if (entry_it != stripe.entry_map.end()) {
+    auto entry = entry_it->second.get();
+    entry->reference_count.fetch_add(1U, std::memory_order_relaxed);
+
+    return entry;
+  }
+
+  auto entry = std::make_unique<InternedString::Entry>();
+  entry->value = value;
+  entry->value.shrink_to_fit();
+  entry->stripe = stripe_index;
+
+  auto entry_ptr = entry.get();
+  stripe.entry_map.insert({entry_ptr->value, std::move(entry)});
+
+  return entry_ptr;
+}
+
+} // namespace
+
+InternedString::InternedString(const std::string& value) {
+  if (!value.empty()) {
+    entry = internString(value);
+  }
+}
+
+InternedString::InternedString(const char* value)
+    : InternedString(std::string(value)) {}
+
+InternedString::InternedString(const InternedString& other)
+    : entry(other.entry) {
+  if (entry != nullptr) {
+    entry->reference_count.fetch_add(1U, std::memory_order_relaxed);
+  }
+}
+
+InternedString::InternedString(InternedString&& other) noexcept
+    : entry(other.entry) {
+  other.entry = nullptr;
+}
+
+InternedString& InternedString::operator=(const InternedString& other) {
+  if (this != &other) {
+    InternedString copy(other);
+    *this = std::move(copy);
+  }
+
+  return *this;
+}
+
+InternedString& InternedString::operator=(InternedString&& other) noexcept {
+  if (this != &other) {
+    release();
+
+    entry = other.entry;
+    other.entry = nullptr;
+  }
+
+  return *this;
+}
+
+InternedString::~InternedString() {
+  release();
+}
+
+const std::string& InternedString::str() const {
+  if (entry == nullptr) {
+    return kEmptyString;
+  }
+
+  return entry->value;
+}
+
+std::size_t InternedString::storageSize() const {
+  if (entry == nullptr) {
+    return 0U;
+  }
+
+  return sizeof(Entry) + entry->value.capacity() + 1U;
+}
+
+std::size_t InternedString::poolSize() {
+  std::size_t pool_size{};
+
+  for (auto& stripe : getStringPool()) {
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    pool_size += stripe.entry_map.size();
+  }
+
+  return pool_size;
+}
+
+void InternedString::release() {
+  if (entry == nullptr) {
+    return;
+  }
+
+  auto current_entry = entry;
+  entry = nullptr;
+
+  // Only the last reference has to take the lock, since the pool can
+  // hand out new references to the entry as long as it is listed
+  auto reference_count =
+      current_entry->reference_count.load(std::memory_order_relaxed);
+
+  while (reference_count > 1U) {
+    if (current_entry->reference_count.compare_exchange_weak(
+            reference_count,
+            reference_count - 1U,
+            std::memory_order_release,
+            std::memory_order_relaxed)) {
+      return;
+    }
+  }
+
+  auto& stripe = getStringPool()[current_entry->stripe];
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+
+  if (current_entry->reference_count.fetch_sub(
+          1U, std::memory_order_acq_rel) == 1U) {
+    auto entry_it = stripe.entry_map.find(current_entry->value);
+    stripe.entry_map.erase(entry_it);
+  }
+}
+
+} // namespace osquery
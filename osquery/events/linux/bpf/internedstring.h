@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace osquery {
+
+/// \brief An immutable, reference counted string stored in a global pool
+/// Equal strings share the same storage: copying an interned string only
+/// increments a counter. This is used for the paths kept in the process
+/// contexts, which are inherited by every child process. Strings are
+/// released from the pool when the last reference goes away
+class InternedString final {
+ public:
+  InternedString() = default;
+
+  InternedString(const std::string& value);
+  InternedString(const char* value);
+
+  InternedString(const InternedString& other);
+  InternedString(InternedString&& other) noexcept;
+
+  InternedString& operator=(const InternedString& other);
+  InternedString& operator=(InternedString&& other) noexcept;
+
+  ~InternedString();
+
+  /// Returns the string value
+  const std::string& str() const;
+
+  operator const std::string&() const {
+    return str();
+  }
+
+  const char* c_str() const {
+    return str().c_str();
+  }
+
+  bool empty() const {
+    return str().empty();
+  }
+
+  std::size_t size() const {
+    return str().size();
+  }
+
+  char front() const {
+    return str().front();
+  }
+
+  char back() const {
+    return str().back();
+  }
+
+  /// Returns true if both strings share the same storage
+  bool sameStorage(const InternedString& other) const {
+    return entry == other.entry;
+  }
+
+  /// Returns how many bytes are used by the pooled string
+  std::size_t storageSize() const;
+
+  /// Returns the number of strings in the pool
+  static std::size_t poolSize();
+
+  struct Entry;
+
+ private:
+  void release();
+
+  Entry* entry{nullptr};
+};
+
+inline bool operator==(const InternedString& lhs, const InternedString& rhs) {
+  return lhs.sameStorage(rhs) || lhs.str() == rhs.str();
+}
+
+inline bool operator==(const InternedString& lhs, const std::string& rhs) {
+  return lhs.str() == rhs;
+}
+
+inline bool operator==(const std::string& lhs, const InternedString& rhs) {
+  return lhs == rhs.str();
+}
+
+inline bool operator==(const InternedString& lhs, const char* rhs) {
+  return lhs.str() == rhs;
+}
+
+template <typename T>
+bool operator!=(const InternedString& lhs, const T& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const std::string& lhs, const InternedString& rhs) {
+  return !(lhs == rhs);
+}
+
+inline std::string operator+(const InternedString& lhs,
+                             const std::string& rhs) {
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const InternedString& lhs, const char* rhs) {
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const InternedString& lhs, char rhs) {
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const std::string& lhs,
+                             const InternedString& rhs) {
+  return lhs + rhs.str();
+}
+
+inline std::ostream& operator<<(std::ostream& stream,
+                                const InternedString& value) {
+  return stream << value.str();
+}
+
+} // namespace osquery
@@ -9,11 +9,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 
 #include <osquery/events/linux/bpf/ifilesystem.h>
+#include <osquery/events/linux/bpf/internedstring.h>
 
 namespace osquery {
 
@@ -24,7 +29,7 @@ struct ProcessContext final {
     /// Path data for files
     struct FileData final {
       /// File or directory path
-      std::string path;
+      InternedString path;
     };
 
     /// Network information for sockets
@@ -60,20 +65,109 @@ struct ProcessContext final {
 
   using FileDescriptorMap = std::unordered_map<int, FileDescriptor>;
 
+  /// \brief A copy-on-write file descriptor map
+  /// Copies share the same map until one of them is modified, so that
+  /// forking a process does not duplicate its file descriptors
+  class FileDescriptorTable final {
+   public:
+    using const_iterator = FileDescriptorMap::const_iterator;
+
+    std::size_t size() const {
+      return get().size();
+    }
+
+    bool empty() const {
+      return get().empty();
+    }
+
+    std::size_t count(int fd) const {
+      return get().count(fd);
+    }
+
+    const FileDescriptor& at(int fd) const {
+      return get().at(fd);
+    }
+
+    const_iterator find(int fd) const {
+      return get().find(fd);
+    }
+
+    const_iterator begin() const {
+      return get().begin();
+    }
+
+    const_iterator end() const {
+      return get().end();
+    }
+
+    /// Returns the map for reading
+    const FileDescriptorMap& get() const {
+      static const FileDescriptorMap kEmptyMap;
+      return fd_map ? *fd_map : kEmptyMap;
+    }
+
+    /// Returns the map for writing, copying it first if it is shared
+    FileDescriptorMap& mutate() {
+      if (!fd_map) {
+        fd_map = std::make_shared<FileDescriptorMap>();
+
+      } else if (fd_map.use_count() != 1) {
+        fd_map = std::make_shared<FileDescriptorMap>(*fd_map);
+
+      } else {
+        // Another tracker thread may have just stopped reading this map
+        std::atomic_thread_fence(std::memory_order_acquire);
+      }
+
+      return *fd_map;
+    }
+
+    std::pair<FileDescriptorMap::iterator, bool> insert(
+        const FileDescriptorMap::value_type& value) {
+      return mutate().insert(value);
+    }
+
+    std::pair<FileDescriptorMap::iterator, bool> insert(
+        FileDescriptorMap::value_type&& value) {
+      return mutate().insert(std::move(value));
+    }
+
+    std::size_t erase(int fd) {
+      if (count(fd) == 0U) {
+        return 0U;
+      }
+
+      return mutate().erase(fd);
+    }
+
+    /// Returns true if both tables share the same map
+    bool sameStorage(const FileDescriptorTable& other) const {
+      return fd_map == other.fd_map;
+    }
+
+    /// Returns an identifier for the shared map; null if empty
+    const void* storageId() const {
+      return fd_map.get();
+    }
+
+   private:
+    std::shared_ptr<FileDescriptorMap> fd_map;
+  };
+
   /// Parent process id
   pid_t parent_process_id{};
 
   /// Current binary path
-  std::string binary_path;
+  InternedString binary_path;
 
   /// Program argument list
   std::vector<std::string> argv;
 
   /// Current working directory
-  std::string cwd;
+  InternedString cwd;
 
   /// File descriptor map, automatically inherited when forking
-  FileDescriptorMap fd_map;
+  FileDescriptorTable fd_map;
 };
 
 using ProcessContextMap = std::unordered_map<pid_t, ProcessContext>;
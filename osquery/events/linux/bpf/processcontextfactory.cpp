@@ -130,9 +130,12 @@ bool ProcessContextFactory::captureSingleProcess(
     return false;
   }
 
-  succeeded = fs.readLinkAt(output.binary_path, process_root.get(), "exe");
+  std::string binary_path;
+  succeeded = fs.readLinkAt(binary_path, process_root.get(), "exe");
   static_cast<void>(succeeded);
 
+  output.binary_path = binary_path;
+
   succeeded = getArgvFromCmdlineFile(fs, output.argv, process_cmdline.get());
   static_cast<void>(succeeded);
 
@@ -142,10 +145,13 @@ bool ProcessContextFactory::captureSingleProcess(
     return false;
   }
 
-  if (!fs.readLinkAt(output.cwd, process_root.get(), "cwd")) {
+  std::string cwd;
+  if (!fs.readLinkAt(cwd, process_root.get(), "cwd")) {
     return false;
   }
 
+  output.cwd = cwd;
+
   if (!getParentPidFromStatFile(
           fs, output.parent_process_id, process_stat.get())) {
     return false;
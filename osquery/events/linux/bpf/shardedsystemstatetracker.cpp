@@ -0,0 +1,347 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/bpf/shardedsystemstatetracker.h>
+#include <osquery/logger/logger.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace osquery {
+
+struct ShardedSystemStateTracker::PrivateData final {
+  struct QueuedEvent final {
+    const Handler* handler{nullptr};
+    const BPFEvent* event{nullptr};
+  };
+
+  struct Shard final {
+    ISystemStateTracker::Ref tracker;
+    std::vector<QueuedEvent> queue;
+    std::unordered_set<std::uint64_t> errored_tracer_list;
+  };
+
+  /// A process context waiting to be moved to the shard of its process
+  struct Transfer final {
+    std::size_t source{};
+    std::size_t destination{};
+  };
+
+  std::vector<Shard> shard_list;
+  std::unordered_map<pid_t, Transfer> pending_transfer_map;
+
+  /// One worker per shard; the first shard runs on the caller thread
+  std::vector<std::thread> worker_list;
+
+  std::mutex worker_mutex;
+  std::condition_variable work_cv;
+  std::condition_variable done_cv;
+  std::uint64_t generation{};
+  std::size_t busy_worker_count{};
+  bool terminate{false};
+
+  std::size_t shardIndex(pid_t process_id) const {
+    return static_cast<std::size_t>(static_cast<std::uint32_t>(process_id)) %
+           shard_list.size();
+  }
+
+  SystemStateTracker& tracker(std::size_t index) {
+    return static_cast<SystemStateTracker&>(*shard_list.at(index).tracker);
+  }
+
+  void workerLoop(std::size_t index);
+  void runShard(Shard& shard);
+  void runQueues();
+  void applyTransfers();
+
+  /// Processes the queued events, then moves the new process contexts
+  void flush() {
+    runQueues();
+    applyTransfers();
+  }
+};
+
+ShardedSystemStateTracker::Ref ShardedSystemStateTracker::create(
+    std::size_t shard_count) {
+  return create(shard_count, []() -> IProcessContextFactory::Ref {
+    IProcessContextFactory::Ref process_context_factory;
+    auto status = IProcessContextFactory::create(process_context_factory);
+    if (!status) {
+      throw status;
+    }
+
+    return process_context_factory;
+  });
+}
+
+ShardedSystemStateTracker::Ref ShardedSystemStateTracker::create(
+    std::size_t shard_count,
+    const ProcessContextFactoryCreator& process_context_factory_creator) {
+  try {
+    return ShardedSystemStateTracker::Ref(new ShardedSystemStateTracker(
+        shard_count, process_context_factory_creator));
+
+  } catch (const Status& status) {
+    LOG(ERROR) << "Failed to create the sharded state tracker: "
+               << status.getMessage();
+    return nullptr;
+
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+ShardedSystemStateTracker::~ShardedSystemStateTracker() {
+  {
+    std::lock_guard<std::mutex> lock(d->worker_mutex);
+    d->terminate = true;
+  }
+
+  d->work_cv.notify_all();
+
+  for (auto& worker : d->worker_list) {
+    worker.join();
+  }
+}
+
+Status ShardedSystemStateTracker::restart() {
+  if (d->shard_list.size() == 1U) {
+    return d->shard_list.front().tracker->restart();
+  }
+
+  // Scan the procfs folder once, then hand out the processes
+  ProcessContextMap process_map;
+  auto& process_context_factory = d->tracker(0U).processContextFactory();
+  if (!process_context_factory.captureAllProcesses(process_map)) {
+    return Status::failure("Failed to scan the procfs folder");
+  }
+
+  for (std::size_t i = 0U; i < d->shard_list.size(); ++i) {
+    d->tracker(i).processContextMap().clear();
+  }
+
+  for (auto& process : process_map) {
+    auto& shard_process_map =
+        d->tracker(d->shardIndex(process.first)).processContextMap();
+
+    shard_process_map.insert({process.first, std::move(process.second)});
+  }
+
+  return Status::success();
+}
+
+void ShardedSystemStateTracker::processEvents(const BPFEventList& event_list,
+                                              const HandlerMap& handler_map,
+                                              BPFErrorState& bpf_error_state) {
+  for (const auto& event : event_list) {
+    auto handler_it = handler_map.find(event.identifier);
+    if (handler_it == handler_map.end()) {
+      LOG(ERROR) << "Unhandled event received in BPFEventPublisher: "
+                 << event.identifier;
+      continue;
+    }
+
+    const auto& handler = handler_it->second;
+    auto process_id = event.header.process_id;
+
+    // The context of this process is still in the shard of its parent
+    if (d->pending_transfer_map.count(process_id) != 0U) {
+      d->flush();
+    }
+
+    if (handler.routing == Routing::Broadcast) {
+      for (auto& shard : d->shard_list) {
+        shard.queue.push_back({&handler, &event});
+      }
+
+      continue;
+    }
+
+    auto index = d->shardIndex(process_id);
+
+    if (handler.routing == Routing::ProcessCreation) {
+      auto child_process_id = static_cast<pid_t>(event.header.exit_code);
+
+      if (child_process_id > 0 && d->shardIndex(child_process_id) != index) {
+        if (d->pending_transfer_map.count(child_process_id) != 0U) {
+          d->flush();
+        }
+
+        d->pending_transfer_map.insert(
+            {child_process_id, {index, d->shardIndex(child_process_id)}});
+      }
+    }
+
+    d->shard_list[index].queue.push_back({&handler, &event});
+  }
+
+  d->flush();
+
+  for (auto& shard : d->shard_list) {
+    bpf_error_state.errored_tracer_list.insert(
+        shard.errored_tracer_list.begin(), shard.errored_tracer_list.end());
+
+    shard.errored_tracer_list.clear();
+  }
+}
+
+ISystemStateTracker::EventList ShardedSystemStateTracker::eventList() {
+  if (d->shard_list.size() == 1U) {
+    return d->shard_list.front().tracker->eventList();
+  }
+
+  ISystemStateTracker::EventList event_list;
+  for (auto& shard : d->shard_list) {
+    auto shard_event_list = shard.tracker->eventList();
+
+    event_list.insert(event_list.end(),
+                      std::make_move_iterator(shard_event_list.begin()),
+                      std::make_move_iterator(shard_event_list.end()));
+  }
+
+  std::stable_sort(event_list.begin(),
+                   event_list.end(),
+                   [](const ISystemStateTracker::Event& lhs,
+                      const ISystemStateTracker::Event& rhs) {
+                     return lhs.bpf_header.timestamp < rhs.bpf_header.timestamp;
+                   });
+
+  return event_list;
+}
+
+std::size_t ShardedSystemStateTracker::shardCount() const {
+  return d->shard_list.size();
+}
+
+SystemStateTracker& ShardedSystemStateTracker::shard(std::size_t index) {
+  return d->tracker(index);
+}
+
+ShardedSystemStateTracker::ShardedSystemStateTracker(
+    std::size_t shard_count,
+    const ProcessContextFactoryCreator& process_context_factory_creator)
+    : d(new PrivateData) {
+  d->shard_list.resize(std::max<std::size_t>(shard_count, 1U));
+
+  for (auto& shard : d->shard_list) {
+    shard.tracker =
+        SystemStateTracker::create(process_context_factory_creator());
+
+    if (!shard.tracker) {
+      throw Status::failure("Failed to create the system state tracker");
+    }
+  }
+
+  if (d->shard_list.size() == 1U) {
+    return;
+  }
+
+  // Each tracker has captured all the processes; keep them in one shard
+  auto status = restart();
+  if (!status.ok()) {
+    throw status;
+  }
+
+  for (std::size_t i = 1U; i < d->shard_list.size(); ++i) {
+    d->worker_list.emplace_back(&PrivateData::workerLoop, d.get(), i);
+  }
+}
+
+void ShardedSystemStateTracker::PrivateData::workerLoop(std::size_t index) {
+  std::uint64_t last_generation{};
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(worker_mutex);
+      work_cv.wait(lock, [&]() {
+        return terminate || generation != last_generation;
+      });
+
+      if (terminate) {
+        return;
+      }
+
+      last_generation = generation;
+    }
+
+    runShard(shard_list[index]);
+
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex);
+      --busy_worker_count;
+    }
+
+    done_cv.notify_one();
+  }
+}
+
+void ShardedSystemStateTracker::PrivateData::runShard(Shard& shard) {
+  for (const auto& queued_event : shard.queue) {
+    const auto& event = *queued_event.event;
+
+    if (!queued_event.handler->callback(*shard.tracker, event)) {
+      shard.errored_tracer_list.insert(event.identifier);
+    }
+  }
+
+  shard.queue.clear();
+}
+
+void ShardedSystemStateTracker::PrivateData::runQueues() {
+  auto pending = std::any_of(
+      shard_list.begin(), shard_list.end(), [](const Shard& shard) {
+        return !shard.queue.empty();
+      });
+
+  if (!pending) {
+    return;
+  }
+
+  if (worker_list.empty()) {
+    runShard(shard_list.front());
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    busy_worker_count = worker_list.size();
+    ++generation;
+  }
+
+  work_cv.notify_all();
+  runShard(shard_list.front());
+
+  std::unique_lock<std::mutex> lock(worker_mutex);
+  done_cv.wait(lock, [&]() { return busy_worker_count == 0U; });
+}
+
+void ShardedSystemStateTracker::PrivateData::applyTransfers() {
+  for (const auto& pending_transfer : pending_transfer_map) {
+    auto process_id = pending_transfer.first;
+    const auto& transfer = pending_transfer.second;
+
+    auto& source_map = tracker(transfer.source).processContextMap();
+    auto process_it = source_map.find(process_id);
+    if (process_it == source_map.end()) {
+      continue;
+    }
+
+    auto& destination_map = tracker(transfer.destination).processContextMap();
+
+    destination_map.insert_or_assign(process_id, std::move(process_it->second));
+    source_map.erase(process_it);
+  }
+
+  pending_transfer_map.clear();
+}
+
+} // namespace osquery
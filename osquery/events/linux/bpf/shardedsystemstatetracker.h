@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/events/linux/bpf/bpferrorstate.h>
+#include <osquery/events/linux/bpf/systemstatetracker.h>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace osquery {
+
+/// \brief Processes BPF events with one system state tracker per worker thread
+/// Process contexts are sharded by process id. Events are routed to the shard
+/// of the process that emitted them, and shards process their events in
+/// parallel. When a new process is assigned to a different shard than its
+/// parent, its context is moved to its own shard before any of its events is
+/// processed. With a single shard, events are processed on the caller thread
+class ShardedSystemStateTracker final {
+ public:
+  using Ref = std::unique_ptr<ShardedSystemStateTracker>;
+  using BPFEvent = tob::ebpfpub::IFunctionTracer::Event;
+  using BPFEventList = std::vector<BPFEvent>;
+
+  /// Creates the process context factory of a shard
+  using ProcessContextFactoryCreator =
+      std::function<IProcessContextFactory::Ref()>;
+
+  /// How an event is routed to the shards
+  enum class Routing {
+    /// The shard of the process that emitted the event
+    Process,
+
+    /// Same as Process; the new process id is the event exit code
+    ProcessCreation,
+
+    /// All the shards, for events updating state shared by all processes
+    Broadcast
+  };
+
+  using EventHandler = bool (*)(ISystemStateTracker& state,
+                                const BPFEvent& event);
+
+  struct Handler final {
+    EventHandler callback{nullptr};
+    Routing routing{Routing::Process};
+  };
+
+  using HandlerMap = std::unordered_map<std::uint64_t, Handler>;
+
+  static Ref create(std::size_t shard_count);
+  static Ref create(
+      std::size_t shard_count,
+      const ProcessContextFactoryCreator& process_context_factory_creator);
+
+  ~ShardedSystemStateTracker();
+
+  /// Rescans the running processes, and assigns them to the shards
+  Status restart();
+
+  /// Processes a list of events sorted by timestamp
+  void processEvents(const BPFEventList& event_list,
+                     const HandlerMap& handler_map,
+                     BPFErrorState& bpf_error_state);
+
+  /// Returns the events generated by all the shards, sorted by timestamp
+  ISystemStateTracker::EventList eventList();
+
+  /// Returns the number of shards
+  std::size_t shardCount() const;
+
+  /// Returns the state tracker of the given shard
+  SystemStateTracker& shard(std::size_t index);
+
+  ShardedSystemStateTracker(const ShardedSystemStateTracker&) = delete;
+  ShardedSystemStateTracker& operator=(const ShardedSystemStateTracker&) =
+      delete;
+
+ private:
+  ShardedSystemStateTracker(
+      std::size_t shard_count,
+      const ProcessContextFactoryCreator& process_context_factory_creator);
+
+  struct PrivateData;
+  std::unique_ptr<PrivateData> d;
+};
+
+} // namespace osquery
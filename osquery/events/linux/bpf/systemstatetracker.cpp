@@ -7,9 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <unordered_set>
 
 #include <osquery/events/linux/bpf/systemstatetracker.h>
 #include <osquery/logger/logger.h>
@@ -29,7 +31,26 @@ namespace {
 const std::size_t kMaxFileHandleEntryCount{512U};
 const std::uint64_t kExpirationTime{180U};
 const std::size_t kEventsBeforeExpiration{10000U};
+
+/// How many processes are checked against procfs each time the event list
+/// is collected, while an expiration pass is in progress
+const std::size_t kExpirationBatchSize{1024U};
+
+/// An estimate of the allocator overhead of each hash table node
+const std::size_t kHashNodeOverhead{2U * sizeof(void*)};
+
+std::size_t getStringHeapSize(const std::string& str) {
+  auto data = reinterpret_cast<const std::uint8_t*>(str.data());
+  auto object = reinterpret_cast<const std::uint8_t*>(&str);
+
+  // Short strings are stored inside the object
+  if (data >= object && data < object + sizeof(str)) {
+    return 0U;
+  }
+
+  return str.capacity() + 1U;
 }
+} // namespace
 
 struct SystemStateTracker::PrivateData final {
   Context context;
@@ -242,13 +263,24 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
 
   d->event_count_since_expiration += event_list.size();
 
+  // Expiration passes are split across calls, so that a large process map
+  // does not stall the event processing
   auto current_time = getUnixTime();
-  if (d->last_expiration + kExpirationTime < current_time ||
+  auto expiration_pending = !d->context.expiration_queue.empty();
+
+  if (expiration_pending ||
+      d->last_expiration + kExpirationTime < current_time ||
       d->event_count_since_expiration >= kEventsBeforeExpiration) {
+    if (!expiration_pending) {
+      d->last_expiration = current_time;
+      d->event_count_since_expiration = 0;
+    }
+
     IFilesystem::Ref fs;
     auto status = IFilesystem::create(fs);
     if (status.ok()) {
-      status = expireProcessContexts(d->context, *fs.get());
+      status =
+          expireProcessContexts(d->context, *fs.get(), kExpirationBatchSize);
       if (!status.ok()) {
         LOG(ERROR) << "BPF system state tracker cleanup error: "
                    << status.getMessage();
@@ -259,8 +291,15 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
                  << status.getMessage();
     }
 
-    d->last_expiration = current_time;
-    d->event_count_since_expiration = 0;
+    if (d->context.expiration_queue.empty()) {
+      auto memory_usage = getMemoryUsage(d->context);
+
+      VLOG(1) << "BPF system state tracker: " << memory_usage.process_count
+              << " processes, " << memory_usage.fd_table_count
+              << " file descriptor tables, " << memory_usage.string_count
+              << " paths, " << memory_usage.bytesPerProcess()
+              << " bytes per process";
+    }
   }
 
   return event_list;
@@ -305,26 +344,49 @@ ProcessContext& SystemStateTracker::getProcessContext(
 }
 
 Status SystemStateTracker::expireProcessContexts(Context& context,
-                                                 IFilesystem& fs) {
+                                                 IFilesystem& fs,
+                                                 std::size_t max_entries) {
+  auto& expiration_queue = context.expiration_queue;
+
   tob::utils::UniqueFd procfs_root;
   if (!fs.open(procfs_root, "/proc", O_DIRECTORY)) {
+    expiration_queue.clear();
     return Status::failure("Failed to open the procfs root: /proc");
   }
 
+  // Start a new pass; processes created from now on are checked by the
+  // next one
+  if (expiration_queue.empty()) {
+    expiration_queue.reserve(context.process_map.size());
+
+    for (const auto& p : context.process_map) {
+      expiration_queue.push_back(p.first);
+    }
+  }
+
+  auto entry_count = expiration_queue.size();
+  if (max_entries != 0U) {
+    entry_count = std::min(entry_count, max_entries);
+  }
+
   bool return_error{false};
-  for (auto process_map_it = context.process_map.begin();
-       process_map_it != context.process_map.end();) {
-    auto process_id = std::to_string(process_map_it->first);
+  for (std::size_t i = 0U; i < entry_count; ++i) {
+    auto process_id = expiration_queue.back();
+    expiration_queue.pop_back();
+
+    auto process_map_it = context.process_map.find(process_id);
+    if (process_map_it == context.process_map.end()) {
+      continue;
+    }
 
     bool exists{false};
-    if (!fs.fileExists(exists, procfs_root.get(), process_id.c_str())) {
+    if (!fs.fileExists(
+            exists, procfs_root.get(), std::to_string(process_id).c_str())) {
       return_error = true;
     }
 
     if (!exists) {
-      process_map_it = context.process_map.erase(process_map_it);
-    } else {
-      ++process_map_it;
+      context.process_map.erase(process_map_it);
     }
   }
 
@@ -434,13 +496,24 @@ bool SystemStateTracker::executeBinary(
 
   process_context.argv = argv;
 
-  for (auto fd_it = process_context.fd_map.begin();
-       fd_it != process_context.fd_map.end();) {
-    const auto& fd_info = fd_it->second;
-    if (fd_info.close_on_exec) {
-      fd_it = process_context.fd_map.erase(fd_it);
-    } else {
-      ++fd_it;
+  // Only detach the file descriptor table if it is going to change
+  auto close_on_exec = std::any_of(
+      process_context.fd_map.begin(),
+      process_context.fd_map.end(),
+      [](const ProcessContext::FileDescriptorMap::value_type& fd) {
+        return fd.second.close_on_exec;
+      });
+
+  if (close_on_exec) {
+    auto& fd_map = process_context.fd_map.mutate();
+
+    for (auto fd_it = fd_map.begin(); fd_it != fd_map.end();) {
+      const auto& fd_info = fd_it->second;
+      if (fd_info.close_on_exec) {
+        fd_it = fd_map.erase(fd_it);
+      } else {
+        ++fd_it;
+      }
     }
   }
 
@@ -497,11 +570,13 @@ bool SystemStateTracker::setWorkingDirectory(
     process_context.cwd = path;
 
   } else {
-    if (process_context.cwd.back() != '/') {
-      process_context.cwd += '/';
+    std::string cwd = process_context.cwd;
+    if (cwd.back() != '/') {
+      cwd += '/';
     }
 
-    process_context.cwd += path;
+    cwd += path;
+    process_context.cwd = cwd;
   }
 
   return true;
@@ -612,7 +687,7 @@ bool SystemStateTracker::closeHandle(
     return false;
   }
 
-  process_context.fd_map.erase(fd_info_it);
+  process_context.fd_map.erase(fd);
   return true;
 }
 
@@ -652,14 +727,15 @@ bool SystemStateTracker::bind(
 
   // If we dont have a file descriptor, create one right now. We may have
   // to figure out what's in the sockaddr structure
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  auto& fd_map = process_context.fd_map.mutate();
+
+  auto fd_info_it = fd_map.find(fd);
+  if (fd_info_it == fd_map.end()) {
     ProcessContext::FileDescriptor fd_info;
     fd_info.close_on_exec = false;
     fd_info.data = ProcessContext::FileDescriptor::SocketData{};
 
-    auto insert_status =
-        process_context.fd_map.insert({fd, std::move(fd_info)});
+    auto insert_status = fd_map.insert({fd, std::move(fd_info)});
 
     fd_info_it = insert_status.first;
   }
@@ -796,14 +872,15 @@ bool SystemStateTracker::connect(
 
   // If we dont have a file descriptor, create one right now. We may have
   // to figure out what's in the sockaddr structure
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  auto& fd_map = process_context.fd_map.mutate();
+
+  auto fd_info_it = fd_map.find(fd);
+  if (fd_info_it == fd_map.end()) {
     ProcessContext::FileDescriptor fd_info;
     fd_info.close_on_exec = false;
     fd_info.data = ProcessContext::FileDescriptor::SocketData{};
 
-    auto insert_status =
-        process_context.fd_map.insert({fd, std::move(fd_info)});
+    auto insert_status = fd_map.insert({fd, std::move(fd_info)});
 
     fd_info_it = insert_status.first;
   }
@@ -879,14 +956,15 @@ bool SystemStateTracker::accept(
 
   // If we dont have a file descriptor, create one right now. We may have
   // to figure out what's in the sockaddr structure
-  auto parent_fd_info_it = process_context.fd_map.find(fd);
-  if (parent_fd_info_it == process_context.fd_map.end()) {
+  auto& fd_map = process_context.fd_map.mutate();
+
+  auto parent_fd_info_it = fd_map.find(fd);
+  if (parent_fd_info_it == fd_map.end()) {
     ProcessContext::FileDescriptor fd_info;
     fd_info.close_on_exec = false;
     fd_info.data = ProcessContext::FileDescriptor::SocketData{};
 
-    auto insert_status =
-        process_context.fd_map.insert({fd, std::move(fd_info)});
+    auto insert_status = fd_map.insert({fd, std::move(fd_info)});
 
     parent_fd_info_it = insert_status.first;
   }
@@ -912,7 +990,7 @@ bool SystemStateTracker::accept(
     return false;
   }
 
-  process_context.fd_map.insert({newfd, new_fd_info});
+  fd_map.insert({newfd, new_fd_info});
 
   Event event;
   event.type = Event::Type::Accept;
@@ -1268,4 +1346,93 @@ SystemStateTracker::Context SystemStateTracker::getContextCopy() const {
   return d->context;
 }
 
+ProcessContextMap& SystemStateTracker::processContextMap() {
+  return d->context.process_map;
+}
+
+const IProcessContextFactory& SystemStateTracker::processContextFactory()
+    const {
+  return *d->process_context_factory.get();
+}
+
+SystemStateTracker::MemoryUsage SystemStateTracker::memoryUsage() const {
+  return getMemoryUsage(d->context);
+}
+
+SystemStateTracker::MemoryUsage SystemStateTracker::getMemoryUsage(
+    const Context& context) {
+  MemoryUsage memory_usage;
+  memory_usage.process_count = context.process_map.size();
+
+  // Shared strings and tables are only counted once
+  std::unordered_set<const void*> visited_storage;
+
+  auto add_string = [&](const InternedString& str) {
+    if (!str.empty() && visited_storage.insert(str.c_str()).second) {
+      ++memory_usage.string_count;
+      memory_usage.byte_count += str.storageSize();
+    }
+  };
+
+  auto& byte_count = memory_usage.byte_count;
+  byte_count += context.process_map.bucket_count() * sizeof(void*);
+
+  for (const auto& p : context.process_map) {
+    const auto& process_context = p.second;
+
+    byte_count += sizeof(p) + kHashNodeOverhead;
+    byte_count += process_context.argv.capacity() * sizeof(std::string);
+
+    for (const auto& arg : process_context.argv) {
+      byte_count += getStringHeapSize(arg);
+    }
+
+    add_string(process_context.binary_path);
+    add_string(process_context.cwd);
+
+    const auto& fd_map = process_context.fd_map;
+    if (fd_map.storageId() == nullptr ||
+        !visited_storage.insert(fd_map.storageId()).second) {
+      continue;
+    }
+
+    ++memory_usage.fd_table_count;
+
+    byte_count += sizeof(ProcessContext::FileDescriptorMap) +
+                  fd_map.get().bucket_count() * sizeof(void*);
+
+    for (const auto& fd : fd_map) {
+      byte_count +=
+          sizeof(ProcessContext::FileDescriptorMap::value_type) +
+          kHashNodeOverhead;
+
+      const auto& fd_info = fd.second;
+      if (std::holds_alternative<ProcessContext::FileDescriptor::FileData>(
+              fd_info.data)) {
+        const auto& file_data =
+            std::get<ProcessContext::FileDescriptor::FileData>(fd_info.data);
+
+        add_string(file_data.path);
+
+      } else if (std::holds_alternative<
+                     ProcessContext::FileDescriptor::SocketData>(
+                     fd_info.data)) {
+        const auto& socket_data =
+            std::get<ProcessContext::FileDescriptor::SocketData>(
+                fd_info.data);
+
+        if (socket_data.opt_local_address.has_value()) {
+          byte_count += getStringHeapSize(*socket_data.opt_local_address);
+        }
+
+        if (socket_data.opt_remote_address.has_value()) {
+          byte_count += getStringHeapSize(*socket_data.opt_remote_address);
+        }
+      }
+    }
+  }
+
+  return memory_usage;
+}
+
 } // namespace osquery
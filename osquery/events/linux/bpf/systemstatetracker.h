@@ -106,6 +106,34 @@ class SystemStateTracker final : public ISystemStateTracker {
   struct Context;
   Context getContextCopy() const;
 
+  /// Returns the process contexts; used to move them across trackers
+  ProcessContextMap& processContextMap();
+
+  /// Returns the factory used to capture the process contexts
+  const IProcessContextFactory& processContextFactory() const;
+
+  /// An estimate of the memory used to track the processes
+  struct MemoryUsage final {
+    /// Number of tracked processes
+    std::size_t process_count{};
+
+    /// Number of distinct file descriptor tables
+    std::size_t fd_table_count{};
+
+    /// Number of distinct path strings
+    std::size_t string_count{};
+
+    /// Estimated size of all the above, in bytes
+    std::size_t byte_count{};
+
+    /// Returns the estimated size per tracked process, in bytes
+    std::size_t bytesPerProcess() const {
+      return process_count != 0U ? byte_count / process_count : 0U;
+    }
+  };
+
+  MemoryUsage memoryUsage() const;
+
  private:
   SystemStateTracker(IProcessContextFactory::Ref process_context_factory);
 
@@ -115,7 +143,7 @@ class SystemStateTracker final : public ISystemStateTracker {
 
   struct FileHandleStruct final {
     int dfd{};
-    std::string name;
+    InternedString name;
     int flags{};
   };
 
@@ -127,6 +155,9 @@ class SystemStateTracker final : public ISystemStateTracker {
 
     std::vector<std::string> file_handle_struct_index;
     FileHandleStructMap file_handle_struct_map;
+
+    /// Processes left to check in the current expiration pass
+    std::vector<pid_t> expiration_queue;
   };
 
   static ProcessContext& getProcessContext(
@@ -134,7 +165,14 @@ class SystemStateTracker final : public ISystemStateTracker {
       IProcessContextFactory& process_context_factory,
       pid_t process_id);
 
-  static Status expireProcessContexts(Context& context, IFilesystem& fs);
+  /// Removes the contexts of the processes that no longer exist. When
+  /// max_entries is not zero, at most max_entries processes are checked;
+  /// the next call resumes from where this one stopped
+  static Status expireProcessContexts(Context& context,
+                                      IFilesystem& fs,
+                                      std::size_t max_entries = 0U);
+
+  static MemoryUsage getMemoryUsage(const Context& context);
 
   static bool createProcess(
       Context& context,
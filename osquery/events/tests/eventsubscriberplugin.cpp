@@ -53,6 +53,14 @@ TEST_F(EventSubscriberPluginTests, generateEventDataIndex) {
   EXPECT_TRUE(status.ok());
   EXPECT_EQ(mocked_database.key_map.size(), 10U);
   EXPECT_EQ(context.event_index.size(), 10U);
+
+  // The index is built from the keys, ordered by the event time
+  EventTime event_time{0U};
+  for (const auto& p : context.event_index) {
+    EXPECT_EQ(p.first, event_time++);
+    EXPECT_EQ(p.second.size(), 1U);
+  }
+  EXPECT_EQ(context.last_event_id, 19U);
 }
 
 TEST_F(EventSubscriberPluginTests, toIndex) {
@@ -117,16 +125,23 @@ TEST_F(EventSubscriberPluginTests, databaseKeyForEventId) {
   EventSubscriberPlugin::Context context;
   EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
 
+  const EventTime kEventTime{1500000000U};
   const std::size_t kEventIdentifier{1000};
 
   std::stringstream expected_key;
-  expected_key << "data." << context.database_namespace << "."
-               << std::setfill('0') << std::setw(10) << kEventIdentifier;
+  expected_key << "data." << context.database_namespace << "." << kEventTime
+               << "." << std::setfill('0') << std::setw(10)
+               << kEventIdentifier;
 
-  auto key =
-      EventSubscriberPlugin::databaseKeyForEventId(context, kEventIdentifier);
+  auto key = EventSubscriberPlugin::databaseKeyForEventId(
+      context, kEventTime, kEventIdentifier);
 
   EXPECT_EQ(key, expected_key.str());
+
+  // Keys sort by time before the event identifier
+  auto next_key = EventSubscriberPlugin::databaseKeyForEventId(
+      context, kEventTime + 1, 1);
+  EXPECT_LT(key, next_key);
 }
 
 TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
@@ -155,12 +170,15 @@ TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
       context, mocked_database, 6U);
 
   EXPECT_EQ(context.event_index.size(), 6U);
+  EXPECT_EQ(mocked_database.key_map.size(), 6U);
+  EXPECT_EQ(context.event_index.begin()->first, 4U);
 
   // Try again with a limit of 4; this should remove an additional 2
   EventSubscriberPlugin::removeOverflowingEventBatches(
       context, mocked_database, 4U);
 
   EXPECT_EQ(context.event_index.size(), 4U);
+  EXPECT_EQ(mocked_database.key_map.size(), 4U);
 
   // Going higher than 4 will have no effect
   EventSubscriberPlugin::removeOverflowingEventBatches(
@@ -191,6 +209,14 @@ TEST_F(EventSubscriberPluginTests, expireEventBatches) {
 
   EventSubscriberPlugin::expireEventBatches(context, mocked_database, 1, 5);
   EXPECT_EQ(context.event_index.size(), 5U);
+
+  // The expired events are removed from the database with the index
+  EXPECT_EQ(mocked_database.key_map.size(), 5U);
+  for (const auto& p : context.event_index) {
+    auto key = EventSubscriberPlugin::databaseKeyForEventId(
+        context, p.first, p.second.front());
+    EXPECT_EQ(mocked_database.key_map.count(key), 1U);
+  }
 }
 
 TEST_F(EventSubscriberPluginTests, generateRows) {
@@ -237,6 +263,110 @@ TEST_F(EventSubscriberPluginTests, generateRows) {
   EXPECT_EQ(last, context.event_index.end());
 }
 
+TEST_F(EventSubscriberPluginTests, generateRowsWithFilter) {
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name");
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+
+  std::size_t callback_count{0U};
+  auto callback = [&callback_count](Row) { ++callback_count; };
+
+  // Every stored row, binary or JSON, matches the base row columns.
+  QueryContext query_context;
+  query_context.constraints["key1"].add(Constraint(EQUALS, "value1"));
+  query_context.constraints["key2"].add(Constraint(LIKE, "VALUE%"));
+  EventRowFilter filter(query_context);
+  EXPECT_FALSE(filter.empty());
+
+  EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0, 0, filter);
+  EXPECT_EQ(callback_count, 10U);
+
+  // Numeric constraints compare the column values as integers.
+  query_context.constraints["time"].affinity = BIGINT_TYPE;
+  query_context.constraints["time"].add(Constraint(GREATER_THAN, "4"));
+  query_context.constraints["time"].add(Constraint(LESS_THAN_OR_EQUALS, "07"));
+
+  callback_count = 0;
+  EventSubscriberPlugin::generateRows(context,
+                                      mocked_database,
+                                      callback,
+                                      0,
+                                      0,
+                                      0,
+                                      EventRowFilter(query_context));
+  EXPECT_EQ(callback_count, 3U);
+
+  // Rows are rejected on the stored value, a missing column is kept.
+  QueryContext prefix_context;
+  prefix_context.constraints["key3"].add(Constraint(GLOB, "other*"));
+  prefix_context.constraints["missing"].add(Constraint(EQUALS, "value"));
+
+  callback_count = 0;
+  EventSubscriberPlugin::generateRows(context,
+                                      mocked_database,
+                                      callback,
+                                      0,
+                                      0,
+                                      0,
+                                      EventRowFilter(prefix_context));
+  EXPECT_EQ(callback_count, 0U);
+
+  // Every stored row is still valid.
+  EXPECT_EQ(mocked_database.key_map.size(), 10U);
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsAcrossScans) {
+  MockedOsqueryDatabase mocked_database;
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  // Enough events for the rows to be read by several scans.
+  for (std::size_t i = 0U; i < 3000U; ++i) {
+    auto event_id = EventSubscriberPlugin::generateEventIdentifier(context);
+
+    Row row = {{"time", std::to_string(i / 2)},
+               {"eid", std::to_string(event_id)}};
+    std::string serialized_row;
+    serializeRowBinary(row, serialized_row);
+
+    auto key = EventSubscriberPlugin::databaseKeyForEventId(
+        context, i / 2, event_id);
+    mocked_database.key_map.insert({key, std::move(serialized_row)});
+  }
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 1500U);
+
+  std::vector<std::string> eid_list;
+  auto callback = [&eid_list](Row row) { eid_list.push_back(row["eid"]); };
+
+  auto last = EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0);
+  EXPECT_EQ(last->first, 1499U);
+  ASSERT_EQ(eid_list.size(), 3000U);
+
+  // Every event is emitted once, in order.
+  for (std::size_t i = 0U; i < eid_list.size(); ++i) {
+    EXPECT_EQ(eid_list[i], std::to_string(i + 1));
+  }
+
+  // Only the events after the last visited identifier are emitted.
+  eid_list.clear();
+  EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 100, 1200, 2000);
+  EXPECT_EQ(eid_list.size(), 402U);
+}
+
 class FakeEventSubscriberPlugin : public EventSubscriberPlugin {
  public:
   FakeEventSubscriberPlugin(IDatabaseInterface& db)
@@ -15,6 +15,7 @@
 #include <ctime>
 
 #include <sstream>
+#include <thread>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
@@ -90,6 +91,73 @@ TEST_F(AuditTests, test_audit_value_decode) {
   EXPECT_EQ(decoded_fail, "7");
 }
 
+TEST_F(AuditTests, test_audit_field_map) {
+  AuditFieldMap fields;
+  EXPECT_TRUE(fields.emplace("a1", "\"/bin/sh\"").second);
+  EXPECT_TRUE(fields.emplace("argc", "3").second);
+  EXPECT_TRUE(fields.emplace("a0", "\"H=1 \"").second);
+
+  // The first value of a field is kept, as in std::map.
+  EXPECT_FALSE(fields.emplace("argc", "4").second);
+  EXPECT_EQ(fields.size(), 3U);
+  EXPECT_EQ(fields.at("argc"), "3");
+
+  // Fields are iterated in name order.
+  std::vector<std::string> names;
+  for (const auto& field : fields) {
+    names.push_back(field.first);
+  }
+  EXPECT_EQ(names, std::vector<std::string>({"a0", "a1", "argc"}));
+
+  EXPECT_EQ(fields.count("a2"), 0U);
+  EXPECT_EQ(fields.find("a2"), fields.end());
+  EXPECT_THROW(fields.at("a2"), std::out_of_range);
+
+  fields["a2"] = "c";
+  EXPECT_EQ(fields.size(), 4U);
+  EXPECT_EQ(fields.at("a2"), "c");
+}
+
+TEST_F(AuditTests, test_audit_ring_buffer) {
+  // The capacity is rounded up to a power of two.
+  AuditRingBuffer<int> ring(3);
+  EXPECT_EQ(ring.capacity(), 4U);
+  EXPECT_EQ(ring.consumerSlot(), nullptr);
+  EXPECT_FALSE(ring.waitForData(std::chrono::milliseconds(1)));
+
+  // Fill and drain the ring a few times to wrap around.
+  int value = 0;
+  for (size_t round = 0; round < 3; round++) {
+    for (auto slot = ring.producerSlot(); slot != nullptr;
+         slot = ring.producerSlot()) {
+      *slot = value++;
+      ring.push();
+    }
+
+    EXPECT_EQ(ring.size(), 4U);
+    EXPECT_FALSE(ring.waitForSpace(std::chrono::milliseconds(1)));
+
+    int expected = value - 4;
+    for (auto slot = ring.consumerSlot(); slot != nullptr;
+         slot = ring.consumerSlot()) {
+      EXPECT_EQ(*slot, expected++);
+      ring.pop();
+    }
+    EXPECT_EQ(ring.size(), 0U);
+  }
+
+  // A waiting consumer is woken up by the producer.
+  std::thread producer([&ring]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    *ring.producerSlot() = 42;
+    ring.push();
+  });
+  EXPECT_TRUE(ring.waitForData(std::chrono::seconds(10)));
+  EXPECT_EQ(*ring.consumerSlot(), 42);
+  ring.pop();
+  producer.join();
+}
+
 size_t kAuditCounter{0};
 
 bool SimpleUpdate(size_t t, const StringMap& f, StringMap& m) {
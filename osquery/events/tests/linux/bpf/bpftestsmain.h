@@ -28,4 +28,14 @@ class ProcessContextFactoryTests : public testing::Test {
   virtual void SetUp() override{};
 };
 
+class BPFEventReorderBufferTests : public testing::Test {
+ protected:
+  virtual void SetUp() override{};
+};
+
+class ShardedSystemStateTrackerTests : public testing::Test {
+ protected:
+  virtual void SetUp() override{};
+};
+
 } // namespace osquery
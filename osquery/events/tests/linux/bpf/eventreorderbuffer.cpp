@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "bpftestsmain.h"
+
+#include <osquery/events/linux/bpf/eventreorderbuffer.h>
+
+namespace osquery {
+
+namespace {
+
+const std::uint64_t kTestReorderDelay{1000U};
+const std::uint64_t kTestBucketWidth{100U};
+
+BPFEventReorderBuffer::Event createEvent(std::uint64_t timestamp) {
+  BPFEventReorderBuffer::Event event{};
+  event.identifier = 1U;
+  event.header.timestamp = timestamp;
+
+  return event;
+}
+
+std::vector<std::uint64_t> getTimestampList(
+    const BPFEventReorderBuffer::EventList& event_list) {
+  std::vector<std::uint64_t> timestamp_list;
+  for (const auto& event : event_list) {
+    timestamp_list.push_back(event.header.timestamp);
+  }
+
+  return timestamp_list;
+}
+
+} // namespace
+
+TEST_F(BPFEventReorderBufferTests, release_order) {
+  BPFEventReorderBuffer reorder_buffer(
+      kTestReorderDelay, kTestBucketWidth, 100U);
+
+  reorder_buffer.push(createEvent(550U));
+  reorder_buffer.push(createEvent(180U));
+  reorder_buffer.push(createEvent(320U));
+  reorder_buffer.push(createEvent(120U));
+  EXPECT_EQ(reorder_buffer.size(), 4U);
+
+  // Nothing is older than the reorder delay yet
+  BPFEventReorderBuffer::EventList event_list;
+  reorder_buffer.release(event_list, 1000U);
+  EXPECT_TRUE(event_list.empty());
+
+  // Only the bucket ending at 200 has expired; events sharing the
+  // same bucket must still be sorted
+  reorder_buffer.release(event_list, 1300U);
+  EXPECT_EQ(getTimestampList(event_list),
+            std::vector<std::uint64_t>({120U, 180U}));
+
+  event_list.clear();
+  reorder_buffer.release(event_list, 2000U);
+  EXPECT_EQ(getTimestampList(event_list),
+            std::vector<std::uint64_t>({320U, 550U}));
+
+  EXPECT_EQ(reorder_buffer.size(), 0U);
+
+  const auto& stats = reorder_buffer.stats();
+  EXPECT_EQ(stats.pushed, 4U);
+  EXPECT_EQ(stats.released, 4U);
+  EXPECT_EQ(stats.late, 0U);
+  EXPECT_EQ(stats.overflowed, 0U);
+  EXPECT_EQ(stats.total_latency, 1180U + 1120U + 1680U + 1450U);
+  EXPECT_EQ(stats.max_latency, 1680U);
+}
+
+TEST_F(BPFEventReorderBufferTests, duplicated_timestamps) {
+  BPFEventReorderBuffer reorder_buffer(
+      kTestReorderDelay, kTestBucketWidth, 100U);
+
+  // Events with the same timestamp must all be kept, in the order they
+  // have been received
+  for (std::uint64_t i = 0U; i < 3U; ++i) {
+    auto event = createEvent(150U);
+    event.identifier = i;
+
+    reorder_buffer.push(std::move(event));
+  }
+
+  BPFEventReorderBuffer::EventList event_list;
+  reorder_buffer.release(event_list, 2000U);
+  ASSERT_EQ(event_list.size(), 3U);
+
+  for (std::uint64_t i = 0U; i < 3U; ++i) {
+    EXPECT_EQ(event_list.at(i).identifier, i);
+  }
+}
+
+TEST_F(BPFEventReorderBufferTests, late_events) {
+  BPFEventReorderBuffer reorder_buffer(
+      kTestReorderDelay, kTestBucketWidth, 100U);
+
+  reorder_buffer.push(createEvent(150U));
+  reorder_buffer.push(createEvent(550U));
+
+  BPFEventReorderBuffer::EventList event_list;
+  reorder_buffer.release(event_list, 1300U);
+  EXPECT_EQ(getTimestampList(event_list), std::vector<std::uint64_t>({150U}));
+
+  // This event belongs to a bucket that has already been released; it
+  // is kept in the oldest bucket, and released on the next expiration
+  reorder_buffer.push(createEvent(120U));
+  EXPECT_EQ(reorder_buffer.stats().late, 1U);
+
+  event_list.clear();
+  reorder_buffer.release(event_list, 1400U);
+  EXPECT_EQ(getTimestampList(event_list), std::vector<std::uint64_t>({120U}));
+
+  event_list.clear();
+  reorder_buffer.release(event_list, 1600U);
+  EXPECT_EQ(getTimestampList(event_list), std::vector<std::uint64_t>({550U}));
+}
+
+TEST_F(BPFEventReorderBufferTests, future_events) {
+  BPFEventReorderBuffer reorder_buffer(
+      kTestReorderDelay, kTestBucketWidth, 100U);
+
+  // The second event is further away than the wheel can span; it is
+  // kept in the newest bucket until the older one is released
+  reorder_buffer.push(createEvent(150U));
+  reorder_buffer.push(createEvent(5000U));
+
+  BPFEventReorderBuffer::EventList event_list;
+  reorder_buffer.release(event_list, 1200U);
+  EXPECT_EQ(getTimestampList(event_list), std::vector<std::uint64_t>({150U}));
+
+  event_list.clear();
+  reorder_buffer.release(event_list, 6100U);
+  EXPECT_EQ(getTimestampList(event_list), std::vector<std::uint64_t>({5000U}));
+  EXPECT_EQ(reorder_buffer.stats().late, 0U);
+}
+
+TEST_F(BPFEventReorderBufferTests, size_limit) {
+  BPFEventReorderBuffer reorder_buffer(
+      kTestReorderDelay, kTestBucketWidth, 2U);
+
+  reorder_buffer.push(createEvent(100U));
+  reorder_buffer.push(createEvent(200U));
+  reorder_buffer.push(createEvent(300U));
+
+  // The oldest bucket is released early to get back within the limit
+  BPFEventReorderBuffer::EventList event_list;
+  reorder_buffer.release(event_list, 0U);
+  EXPECT_EQ(getTimestampList(event_list), std::vector<std::uint64_t>({100U}));
+
+  EXPECT_EQ(reorder_buffer.size(), 2U);
+  EXPECT_EQ(reorder_buffer.stats().overflowed, 1U);
+}
+
+} // namespace osquery
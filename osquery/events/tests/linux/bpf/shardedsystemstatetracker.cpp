@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "bpftestsmain.h"
+#include "mockedprocesscontextfactory.h"
+
+#include <osquery/events/linux/bpf/bpfeventpublisher.h>
+#include <osquery/events/linux/bpf/shardedsystemstatetracker.h>
+
+namespace osquery {
+
+namespace {
+
+const std::uint64_t kForkEventIdentifier{1U};
+const std::uint64_t kExecveEventIdentifier{2U};
+
+// clang-format off
+const ShardedSystemStateTracker::HandlerMap kTestHandlerMap = {
+  {
+    kForkEventIdentifier,
+
+    {
+      &BPFEventPublisher::processForkEvent,
+      ShardedSystemStateTracker::Routing::ProcessCreation
+    }
+  },
+
+  {
+    kExecveEventIdentifier,
+
+    {
+      &BPFEventPublisher::processExecveEvent,
+      ShardedSystemStateTracker::Routing::Process
+    }
+  }
+};
+// clang-format on
+
+ShardedSystemStateTracker::BPFEvent createEvent(std::uint64_t identifier,
+                                                std::uint64_t timestamp,
+                                                pid_t process_id) {
+  ShardedSystemStateTracker::BPFEvent event{};
+  event.identifier = identifier;
+  event.header.timestamp = timestamp;
+  event.header.thread_id = process_id;
+  event.header.process_id = process_id;
+
+  return event;
+}
+
+} // namespace
+
+TEST_F(ShardedSystemStateTrackerTests, process_transfer) {
+  std::vector<MockedProcessContextFactory*> factory_list;
+
+  auto state_tracker_ref = ShardedSystemStateTracker::create(
+      2U, [&factory_list]() -> IProcessContextFactory::Ref {
+        auto factory = new MockedProcessContextFactory;
+        factory_list.push_back(factory);
+
+        return IProcessContextFactory::Ref(factory);
+      });
+
+  ASSERT_NE(state_tracker_ref, nullptr);
+  ASSERT_EQ(factory_list.size(), 2U);
+
+  auto& state_tracker = *state_tracker_ref.get();
+  EXPECT_EQ(state_tracker.shardCount(), 2U);
+
+  // The process 1000 creates the process 1001, which then runs execve. The
+  // two processes belong to different shards
+  ShardedSystemStateTracker::BPFEventList event_list;
+
+  auto fork_event = createEvent(kForkEventIdentifier, 1000U, 1000);
+  fork_event.name = "fork";
+  fork_event.header.exit_code = 1001;
+  event_list.push_back(std::move(fork_event));
+
+  auto execve_event = createEvent(kExecveEventIdentifier, 2000U, 1001);
+  execve_event.name = "execve";
+
+  // clang-format off
+  execve_event.in_field_map.insert(
+    {
+      "filename",
+      { "filename", true, std::string("/usr/bin/bash") }
+    }
+  );
+
+  execve_event.in_field_map.insert(
+    {
+      "argv",
+      { "argv", true, std::vector<std::string>{ "bash" } }
+    }
+  );
+  // clang-format on
+
+  event_list.push_back(std::move(execve_event));
+
+  BPFErrorState bpf_error_state;
+  state_tracker.processEvents(event_list, kTestHandlerMap, bpf_error_state);
+  EXPECT_TRUE(bpf_error_state.errored_tracer_list.empty());
+
+  // The child process context has been moved to its own shard before the
+  // execve event was processed, so it was never captured from procfs
+  auto parent_context = state_tracker.shard(0U).getContextCopy();
+  EXPECT_EQ(parent_context.process_map.count(1000), 1U);
+  EXPECT_EQ(parent_context.process_map.count(1001), 0U);
+
+  auto child_context = state_tracker.shard(1U).getContextCopy();
+  ASSERT_EQ(child_context.process_map.count(1001), 1U);
+  EXPECT_EQ(factory_list.at(1U)->invocationCount(), 0U);
+
+  const auto& child_process = child_context.process_map.at(1001);
+  EXPECT_EQ(child_process.parent_process_id, 1000);
+  EXPECT_EQ(child_process.binary_path, "/usr/bin/bash");
+
+  // Events from all the shards are returned in timestamp order
+  auto generated_event_list = state_tracker.eventList();
+  ASSERT_EQ(generated_event_list.size(), 2U);
+
+  EXPECT_EQ(generated_event_list.at(0U).type,
+            ISystemStateTracker::Event::Type::Fork);
+
+  EXPECT_EQ(generated_event_list.at(1U).type,
+            ISystemStateTracker::Event::Type::Exec);
+}
+
+TEST_F(ShardedSystemStateTrackerTests, unhandled_events) {
+  auto state_tracker_ref = ShardedSystemStateTracker::create(
+      1U, []() -> IProcessContextFactory::Ref {
+        return IProcessContextFactory::Ref(new MockedProcessContextFactory);
+      });
+
+  ASSERT_NE(state_tracker_ref, nullptr);
+
+  auto& state_tracker = *state_tracker_ref.get();
+  EXPECT_EQ(state_tracker.shardCount(), 1U);
+
+  // Events without a handler are skipped
+  ShardedSystemStateTracker::BPFEventList event_list;
+  event_list.push_back(createEvent(100U, 1000U, 1000));
+
+  BPFErrorState bpf_error_state;
+  state_tracker.processEvents(event_list, kTestHandlerMap, bpf_error_state);
+
+  EXPECT_TRUE(bpf_error_state.errored_tracer_list.empty());
+  EXPECT_TRUE(state_tracker.eventList().empty());
+}
+
+} // namespace osquery
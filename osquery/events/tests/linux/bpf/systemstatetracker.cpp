@@ -1384,4 +1384,113 @@ TEST_F(SystemStateTrackerTests, expireProcessContexts) {
   EXPECT_EQ(context.process_map.size(), 1U);
 }
 
+TEST_F(SystemStateTrackerTests, expireProcessContexts_incremental) {
+  SystemStateTracker::Context context;
+
+  context.process_map.insert(
+      {kBaseBPFEventHeader.process_id, ProcessContext{}});
+
+  context.process_map.insert(
+      {kBaseBPFEventHeader.process_id + 1, ProcessContext{}});
+
+  context.process_map.insert(
+      {kBaseBPFEventHeader.process_id + 2, ProcessContext{}});
+
+  // Check one process at a time; the pass covers the processes that were
+  // tracked when it started
+  MockedFilesystem mocked_filesystem;
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 1U);
+  EXPECT_EQ(context.expiration_queue.size(), 2U);
+
+  context.process_map.insert(
+      {kBaseBPFEventHeader.process_id + 3, ProcessContext{}});
+
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 1U);
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 1U);
+  EXPECT_TRUE(context.expiration_queue.empty());
+
+  EXPECT_EQ(context.process_map.size(), 2U);
+  EXPECT_EQ(context.process_map.count(kBaseBPFEventHeader.process_id), 1U);
+  EXPECT_EQ(context.process_map.count(kBaseBPFEventHeader.process_id + 3),
+            1U);
+
+  // The next pass picks up the new process
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 1U);
+  SystemStateTracker::expireProcessContexts(context, mocked_filesystem, 1U);
+  EXPECT_TRUE(context.expiration_queue.empty());
+
+  EXPECT_EQ(context.process_map.size(), 1U);
+  EXPECT_EQ(context.process_map.count(kBaseBPFEventHeader.process_id), 1U);
+}
+
+TEST_F(SystemStateTrackerTests, shared_process_contexts) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  const std::size_t kChildProcessCount{1000U};
+  const pid_t kFirstChildProcessId{2000};
+
+  // Fork the same parent many times; children should share the parent
+  // strings and file descriptor table
+  SystemStateTracker::Context context;
+  for (std::size_t i = 0U; i < kChildProcessCount; ++i) {
+    auto bpf_event_header = kBaseBPFEventHeader;
+    bpf_event_header.process_id = kFirstChildProcessId + static_cast<pid_t>(i);
+
+    auto succeeded =
+        SystemStateTracker::createProcess(context,
+                                          *process_context_factory.get(),
+                                          bpf_event_header,
+                                          1000,
+                                          bpf_event_header.process_id);
+
+    ASSERT_TRUE(succeeded);
+  }
+
+  EXPECT_EQ(context.process_map.size(), kChildProcessCount + 1U);
+
+  const auto& parent_process = context.process_map.at(1000);
+  const auto& child_process = context.process_map.at(kFirstChildProcessId);
+
+  EXPECT_TRUE(
+      child_process.binary_path.sameStorage(parent_process.binary_path));
+  EXPECT_TRUE(child_process.cwd.sameStorage(parent_process.cwd));
+  EXPECT_TRUE(child_process.fd_map.sameStorage(parent_process.fd_map));
+
+  // The paths of the parent process: binary, cwd, /dev/pts/1 and five
+  // .zwc files
+  auto memory_usage = SystemStateTracker::getMemoryUsage(context);
+  EXPECT_EQ(memory_usage.process_count, kChildProcessCount + 1U);
+  EXPECT_EQ(memory_usage.fd_table_count, 1U);
+  EXPECT_EQ(memory_usage.string_count, 8U);
+
+  // Without sharing, each copy of the 8 file descriptors and paths would
+  // take more than this
+  EXPECT_LT(memory_usage.bytesPerProcess(), 512U);
+
+  // The file descriptor table is copied when one of the processes changes
+  // it; execve drops the descriptors 0, 1 and 2 (close-on-exec)
+  auto bpf_event_header = kBaseBPFEventHeader;
+  bpf_event_header.process_id = kFirstChildProcessId;
+
+  auto succeeded =
+      SystemStateTracker::executeBinary(context,
+                                        *process_context_factory.get(),
+                                        bpf_event_header,
+                                        kFirstChildProcessId,
+                                        AT_FDCWD,
+                                        0,
+                                        "/usr/bin/date",
+                                        {"date"});
+
+  ASSERT_TRUE(succeeded);
+  EXPECT_FALSE(child_process.fd_map.sameStorage(parent_process.fd_map));
+  EXPECT_EQ(child_process.fd_map.size(), 5U);
+  EXPECT_EQ(parent_process.fd_map.size(), 8U);
+
+  memory_usage = SystemStateTracker::getMemoryUsage(context);
+  EXPECT_EQ(memory_usage.fd_table_count, 2U);
+  EXPECT_EQ(memory_usage.string_count, 9U);
+}
+
 } // namespace osquery
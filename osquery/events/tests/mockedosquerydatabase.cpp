@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/events/eventsubscriber.h>
 
 #include "mockedosquerydatabase.h"
@@ -42,19 +44,26 @@ void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
     row.insert({"time", std::to_string(i)});
     row.insert({"eid", std::to_string(event_id)});
 
+    // Alternate the binary format with JSON rows stored by older versions.
     std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
-    if (!status.ok()) {
-      throw std::runtime_error(
-          "MockedOsqueryDatabase: Failed to serialize the row");
+    if (i % 2 == 0) {
+      serializeRowBinary(row, serialized_row);
+    } else {
+      auto status = serializeRowJSON(row, serialized_row);
+      if (!status.ok()) {
+        throw std::runtime_error(
+            "MockedOsqueryDatabase: Failed to serialize the row");
+      }
     }
 
-    auto key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    auto key =
+        EventSubscriberPlugin::databaseKeyForEventId(context, i, event_id);
     key_map.insert({key, std::move(serialized_row)});
 
-    // this value can't be deserialized and should be skipped
+    // this key has no event time and should be skipped
     event_id = EventSubscriberPlugin::generateEventIdentifier(context);
-    key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    key = "data." + context.database_namespace + "." +
+          EventSubscriberPlugin::toIndex(event_id);
     key_map.insert({key, "broken_serialized_value"});
   }
 }
@@ -155,8 +164,19 @@ Status MockedOsqueryDatabase::deleteDatabaseRange(
     const std::string& domain,
     const std::string& low,
     const std::string& high) const {
-  return Status::failure(
-      "MockedOsqueryDatabase: Unsupported deleteDatabaseRange call");
+  if (domain != kEvents) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid domain passed to "
+        "deleteDatabaseRange: " +
+        domain);
+  }
+
+  if (low > high) {
+    return Status::failure("Invalid range: low > high");
+  }
+
+  key_map.erase(key_map.lower_bound(low), key_map.upper_bound(high));
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
@@ -190,4 +210,35 @@ Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
   return Status::success();
 }
 
+Status MockedOsqueryDatabase::scanDatabaseValues(
+    const std::string& domain,
+    const DatabaseScanOptions& options,
+    const DatabaseScanVisitor& visitor) const {
+  if (domain != kEvents) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid domain passed to scanDatabaseValues: " +
+        domain);
+  }
+
+  std::size_t count{0U};
+  auto key_it = key_map.lower_bound(std::max(options.prefix, options.low));
+  for (; key_it != key_map.end(); ++key_it) {
+    const auto& current_key = key_it->first;
+    if (current_key.find(options.prefix) != 0 ||
+        (!options.high.empty() && current_key > options.high)) {
+      break;
+    }
+
+    if (!visitor(current_key, options.keys_only ? "" : key_it->second)) {
+      break;
+    }
+
+    if (options.max != 0 && ++count >= options.max) {
+      break;
+    }
+  }
+
+  return Status::success();
+}
+
 } // namespace osquery
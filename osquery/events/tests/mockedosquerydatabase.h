@@ -57,6 +57,11 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
                                   std::vector<std::string>& keys,
                                   const std::string& prefix,
                                   size_t max) const override;
+
+  virtual Status scanDatabaseValues(
+      const std::string& domain,
+      const DatabaseScanOptions& options,
+      const DatabaseScanVisitor& visitor) const override;
 };
 
 } // namespace osquery
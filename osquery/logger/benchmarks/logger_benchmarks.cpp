@@ -9,14 +9,23 @@
 
 #include <benchmark/benchmark.h>
 
+#include <boost/filesystem.hpp>
+
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 
+#include <plugins/logger/filesystem_logger.h>
+
+namespace fs = boost::filesystem;
+
 namespace osquery {
 
 DECLARE_bool(disable_logging);
+DECLARE_string(logger_path);
+DECLARE_uint64(logger_flush_size);
 
 class DummyLoggerPlugin : public LoggerPlugin {
  public:
@@ -83,4 +92,131 @@ static void LOGGER_logstring_plugin(benchmark::State& state) {
 }
 
 BENCHMARK(LOGGER_logstring_plugin);
+
+static void LOGGER_filesystem_results(benchmark::State& state) {
+  // Profile writing result lines, each line opens and appends to the log
+  // unless lines are buffered (Arg is the buffer size).
+  auto logger_path = fs::temp_directory_path() /
+                     fs::unique_path("osquery.logger_benchmarks.%%%%.%%%%");
+  fs::create_directories(logger_path);
+  auto previous_path = FLAGS_logger_path;
+  FLAGS_logger_path = logger_path.string();
+  FLAGS_logger_flush_size = static_cast<uint64_t>(state.range(0));
+
+  FilesystemLoggerPlugin plugin;
+  plugin.setUp();
+
+  const std::string line(256, 'r');
+  while (state.KeepRunning()) {
+    plugin.logString(line);
+  }
+  plugin.flush();
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * (line.size() + 1));
+
+  FLAGS_logger_flush_size = 0;
+  plugin.setUp();
+  FLAGS_logger_path = previous_path;
+  boost::system::error_code ec;
+  fs::remove_all(logger_path, ec);
+}
+
+BENCHMARK(LOGGER_filesystem_results)->Arg(0)->Arg(64 * 1024);
+
+static QueryLogItem getBenchmarkQueryLogItem(size_t rows) {
+  QueryLogItem item;
+  item.name = "benchmark";
+  item.identifier = "benchmark-host";
+  item.calendar_time = "Mon Oct 12 00:00:00 2026 UTC";
+  item.time = 1760227200;
+  item.decorations["hostname"] = "benchmark-host";
+  item.decorations["username"] = "root";
+
+  for (size_t i = 0; i < rows; i++) {
+    RowTyped row;
+    row["pid"] = static_cast<long long>(i);
+    row["name"] = "process" + std::to_string(i);
+    row["path"] = "/usr/local/bin/process" + std::to_string(i);
+    row["resident_size"] = static_cast<long long>(i * 4096);
+    row["user_time"] = 0.5 * i;
+    if (i % 2 == 0) {
+      item.results.added.push_back(std::move(row));
+    } else {
+      item.results.removed.push_back(std::move(row));
+    }
+  }
+  return item;
+}
+
+static void LOGGER_serialize_query_log_item_events(benchmark::State& state) {
+  // Each differential row becomes one event line, the shared header is
+  // written once per log item.
+  auto item = getBenchmarkQueryLogItem(static_cast<size_t>(state.range(0)));
+
+  size_t bytes = 0;
+  while (state.KeepRunning()) {
+    serializeQueryLogItemAsEventsJSON(item, [&bytes](const std::string& e) {
+      bytes += e.size();
+      return Status::success();
+    });
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(LOGGER_serialize_query_log_item_events)->Arg(10000);
+
+static void LOGGER_serialize_query_log_item_events_document(
+    benchmark::State& state) {
+  // The same events built as JSON documents, for comparison.
+  auto item = getBenchmarkQueryLogItem(static_cast<size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    auto doc = JSON::newArray();
+    serializeQueryLogItemAsEvents(item, doc);
+
+    std::string event;
+    for (auto& row : doc.doc().GetArray()) {
+      rapidjson::StringBuffer sb;
+      rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+      row.Accept(writer);
+      event = sb.GetString();
+    }
+    benchmark::DoNotOptimize(event);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(LOGGER_serialize_query_log_item_events_document)->Arg(10000);
+
+static void LOGGER_serialize_query_log_item_batch(benchmark::State& state) {
+  auto item = getBenchmarkQueryLogItem(static_cast<size_t>(state.range(0)));
+
+  std::string json;
+  while (state.KeepRunning()) {
+    json.clear();
+    serializeQueryLogItemJSON(item, json);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+BENCHMARK(LOGGER_serialize_query_log_item_batch)->Arg(10000);
+
+static void LOGGER_serialize_query_log_item_batch_document(
+    benchmark::State& state) {
+  auto item = getBenchmarkQueryLogItem(static_cast<size_t>(state.range(0)));
+
+  std::string json;
+  while (state.KeepRunning()) {
+    auto doc = JSON::newObject();
+    serializeQueryLogItem(item, doc);
+    json.clear();
+    doc.toString(json);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+BENCHMARK(LOGGER_serialize_query_log_item_batch_document)->Arg(10000);
 }
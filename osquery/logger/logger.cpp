@@ -416,23 +416,24 @@ Status logQueryLogItem(const QueryLogItem& results,
         kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
   }
 
-  std::vector<std::string> json_items;
   Status status;
   if (FLAGS_logger_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(results, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(results, json);
-    json_items.emplace_back(json);
+    // Each event is logged as soon as it is serialized.
+    Status log_status;
+    status = serializeQueryLogItemAsEventsJSON(
+        results, [&log_status, &receiver](const std::string& json) {
+          log_status = logString(json, "event", receiver);
+          return Status::success();
+        });
+    return (status.ok()) ? log_status : status;
   }
+
+  std::string json;
+  status = serializeQueryLogItemJSON(results, json);
   if (!status.ok()) {
     return status;
   }
-
-  for (const auto& json : json_items) {
-    status = logString(json, "event", receiver);
-  }
-  return status;
+  return logString(json, "event", receiver);
 }
 
 Status logSnapshotQuery(const QueryLogItem& item) {
@@ -445,22 +446,12 @@ Status logSnapshotQuery(const QueryLogItem& item) {
         kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
   }
 
-  std::vector<std::string> json_items;
-  Status status;
-  if (FLAGS_logger_snapshot_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(item, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(item, json);
-    json_items.emplace_back(json);
-  }
-  if (!status.ok()) {
-    return status;
-  }
+  auto receiver = RegistryFactory::get().getActive("logger");
+  auto loggers = osquery::split(receiver, ",");
 
-  for (const auto& json : json_items) {
-    auto receiver = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(receiver, ",")) {
+  Status status;
+  auto log_snapshot = [&loggers, &status](const std::string& json) {
+    for (const auto& logger : loggers) {
       if (Registry::get().exists("logger", logger, true)) {
         auto plugin = Registry::get().plugin("logger", logger);
         auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
@@ -469,8 +460,23 @@ Status logSnapshotQuery(const QueryLogItem& item) {
         status = Registry::call("logger", logger, {{"snapshot", json}});
       }
     }
+    return Status::success();
+  };
+
+  if (FLAGS_logger_snapshot_event_type) {
+    // Each event is logged as soon as it is serialized.
+    auto serialize_status =
+        serializeQueryLogItemAsEventsJSON(item, log_snapshot);
+    return (serialize_status.ok()) ? status : serialize_status;
+  }
+
+  std::string json;
+  auto serialize_status = serializeQueryLogItemJSON(item, json);
+  if (!serialize_status.ok()) {
+    return serialize_status;
   }
 
+  log_snapshot(json);
   return status;
 }
 
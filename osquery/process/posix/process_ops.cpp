@@ -7,10 +7,21 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#ifdef __linux__
+// Needed for linux specific RUSAGE_THREAD, before including anything else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <sys/resource.h>
 #include <sys/syscall.h>
@@ -27,6 +38,30 @@ namespace osquery {
 
 DECLARE_uint64(alarm_timeout);
 
+namespace {
+
+#ifdef __linux__
+/// The last field of /proc/<pid>/stat used, the resident pages.
+const size_t kStatRssField = 24;
+
+/// Read a procfs file at once, its content is generated when read.
+ssize_t readProcFile(const std::string& path, char* buffer, size_t size) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  auto length = ::read(fd, buffer, size);
+  ::close(fd);
+  return length;
+}
+
+uint64_t toMilliseconds(const struct timeval& time) {
+  return static_cast<uint64_t>(time.tv_sec) * 1000 + time.tv_usec / 1000;
+}
+#endif
+} // namespace
+
 uint32_t platformGetUid() {
   return ::getuid();
 }
@@ -71,4 +106,77 @@ int platformGetPid() {
 uint64_t platformGetTid() {
   return std::hash<std::thread::id>()(std::this_thread::get_id());
 }
+
+Status platformGetProcessResourceUsage(pid_t pid, ProcessResourceUsage& usage) {
+#ifdef __linux__
+  static const uint64_t kMillisecondsPerTick = 1000 / ::sysconf(_SC_CLK_TCK);
+  static const uint64_t kPageSize = ::sysconf(_SC_PAGESIZE);
+
+  auto path = "/proc/" + std::to_string(pid) + "/stat";
+  char buffer[1024];
+  auto length = readProcFile(path, buffer, sizeof(buffer) - 1);
+  if (length <= 0) {
+    return Status::failure("Cannot read " + path);
+  }
+  buffer[length] = '\0';
+
+  // The command name can contain anything, the fields follow its last ')'.
+  char* cursor = std::strrchr(buffer, ')');
+  if (cursor == nullptr) {
+    return Status::failure("Cannot parse " + path);
+  }
+  cursor++;
+
+  uint64_t fields[kStatRssField + 1] = {};
+  for (size_t field = 3; field <= kStatRssField; field++) {
+    while (*cursor == ' ') {
+      cursor++;
+    }
+
+    // The third field is the state, the ones used after are numbers.
+    char* end = cursor;
+    if (field == 3) {
+      while (*end != ' ' && *end != '\0') {
+        end++;
+      }
+    } else {
+      fields[field] = std::strtoull(cursor, &end, 10);
+    }
+
+    if (end == cursor) {
+      return Status::failure("Cannot parse " + path);
+    }
+    cursor = end;
+  }
+
+  usage.parent = static_cast<pid_t>(fields[4]);
+  usage.user_time = fields[14] * kMillisecondsPerTick;
+  usage.system_time = fields[15] * kMillisecondsPerTick;
+  usage.total_size = fields[23];
+  usage.resident_size = fields[kStatRssField] * kPageSize;
+  return Status::success();
+#else
+  return Status::failure("Resource sampling is not supported");
+#endif
+}
+
+Status platformGetThreadResourceUsage(ProcessResourceUsage& usage) {
+#ifdef __linux__
+  struct rusage stats;
+  if (::getrusage(RUSAGE_THREAD, &stats) != 0) {
+    return Status::failure("Cannot get the thread resource usage");
+  }
+
+  auto status = platformGetProcessResourceUsage(::getpid(), usage);
+  if (!status.ok()) {
+    return status;
+  }
+
+  usage.user_time = toMilliseconds(stats.ru_utime);
+  usage.system_time = toMilliseconds(stats.ru_stime);
+  return Status::success();
+#else
+  return Status::failure("Resource sampling is not supported");
+#endif
 }
+} // namespace osquery
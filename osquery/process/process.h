@@ -20,6 +20,7 @@
 
 #include <osquery/core/core.h>
 #include <osquery/core/system.h>
+#include <osquery/utils/status/status.h>
 // FIXME(fmanco): env functions were split but most usages still include
 // process.h. Once those includes are fixed this can be removed.
 #include <osquery/utils/system/env.h>
@@ -270,4 +271,35 @@ int platformGetPid();
  * and on posix platforms returns gettid()
  */
 uint64_t platformGetTid();
+
+/// Resources used by a process, in the units of the processes table.
+struct ProcessResourceUsage {
+  /// The pid of the parent process.
+  pid_t parent{0};
+
+  /// CPU times in milliseconds.
+  uint64_t user_time{0};
+  uint64_t system_time{0};
+
+  /// Memory sizes in bytes.
+  uint64_t resident_size{0};
+  uint64_t total_size{0};
+};
+
+/**
+ * @brief Samples the resources used by a process
+ *
+ * This reads the kernel counters directly, which is much cheaper than a
+ * select on the processes table. It fails on platforms without a direct
+ * sampler, callers are expected to fall back to the processes table then.
+ */
+Status platformGetProcessResourceUsage(pid_t pid, ProcessResourceUsage& usage);
+
+/**
+ * @brief Samples the resources used by the calling thread
+ *
+ * The CPU times only count the calling thread, so they are not affected by
+ * other threads of the process, the memory sizes are the process ones.
+ */
+Status platformGetThreadResourceUsage(ProcessResourceUsage& usage);
 } // namespace osquery
@@ -299,4 +299,12 @@ int platformGetPid() {
 uint64_t platformGetTid() {
   return GetCurrentThreadId();
 }
+
+Status platformGetProcessResourceUsage(pid_t pid, ProcessResourceUsage& usage) {
+  return Status::failure("Resource sampling is not supported");
+}
+
+Status platformGetThreadResourceUsage(ProcessResourceUsage& usage) {
+  return Status::failure("Resource sampling is not supported");
+}
 } // namespace osquery
@@ -7,13 +7,23 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/remote/requests.h>
+
 #include <cstring>
 #include <string>
 
 #include <zlib.h>
+#include <zstd.h>
 
 namespace osquery {
 
+namespace {
+
+/// Request bodies favor compression speed, this is the zstd default level.
+const int kZstdCompressionLevel{3};
+
+} // namespace
+
 #define MOD_GZIP_ZLIB_WINDOWSIZE 15
 #define MOD_GZIP_ZLIB_CFACTOR 9
 
@@ -56,4 +66,78 @@ std::string compressString(const std::string& data) {
 
   return output;
 }
+
+std::string compressStringZstd(const std::string& data) {
+  std::string output(ZSTD_compressBound(data.size()), '\0');
+  auto size = ZSTD_compress(&output[0],
+                            output.size(),
+                            data.data(),
+                            data.size(),
+                            kZstdCompressionLevel);
+  if (ZSTD_isError(size)) {
+    return std::string();
+  }
+
+  output.resize(size);
+  return output;
+}
+
+ZstdStringStream::ZstdStringStream(std::string& output) : output_(output) {
+  context_ = ZSTD_createCStream();
+  if (context_ == nullptr) {
+    status_ = Status::failure("Could not create a zstd compression stream");
+    return;
+  }
+
+  auto result = ZSTD_initCStream(context_, kZstdCompressionLevel);
+  if (ZSTD_isError(result)) {
+    status_ = Status::failure(std::string("Could not init zstd stream: ") +
+                              ZSTD_getErrorName(result));
+    return;
+  }
+
+  input_.reserve(ZSTD_CStreamInSize());
+}
+
+ZstdStringStream::~ZstdStringStream() {
+  ZSTD_freeCStream(context_);
+}
+
+void ZstdStringStream::compress(bool end) {
+  if (!status_.ok()) {
+    input_.clear();
+    return;
+  }
+
+  ZSTD_inBuffer input = {input_.data(), input_.size(), 0};
+  size_t remaining = 0;
+  do {
+    // Compressed blocks are written directly into the output string.
+    auto offset = output_.size();
+    output_.resize(offset + ZSTD_CStreamOutSize());
+    ZSTD_outBuffer output = {&output_[offset], ZSTD_CStreamOutSize(), 0};
+
+    if (input.pos < input.size) {
+      remaining = ZSTD_compressStream(context_, &output, &input);
+    } else if (end) {
+      remaining = ZSTD_endStream(context_, &output);
+    } else {
+      remaining = 0;
+    }
+    output_.resize(offset + output.pos);
+
+    if (ZSTD_isError(remaining)) {
+      status_ = Status::failure(std::string("zstd compression error: ") +
+                                ZSTD_getErrorName(remaining));
+      break;
+    }
+  } while (input.pos < input.size || (end && remaining != 0));
+
+  input_.clear();
+}
+
+Status ZstdStringStream::finish() {
+  compress(true);
+  return status_;
 }
+} // namespace osquery
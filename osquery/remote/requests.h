@@ -13,12 +13,16 @@
 #include <utility>
 #include <string>
 
+#include <boost/noncopyable.hpp>
+
 #include <gtest/gtest_prod.h>
 
 #include <osquery/logger/logger.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/status/status.h>
 
+struct ZSTD_CCtx_s;
+
 namespace osquery {
 
 class Serializer;
@@ -34,6 +38,61 @@ class Serializer;
  */
 std::string compressString(const std::string& data);
 
+/**
+ * @brief Compress data using Zstandard.
+ *
+ * This is the one-shot variant of ZstdStringStream, see compressString.
+ *
+ * @param data The input container.
+ */
+std::string compressStringZstd(const std::string& data);
+
+/**
+ * @brief A Zstandard compressed string output stream.
+ *
+ * Serializers may write a request body into this stream as they produce it.
+ * The input is compressed each time a block is filled, so the uncompressed
+ * body is never held in memory as a whole. This implements the rapidjson
+ * output stream concept; call finish() to end the compressed frame.
+ */
+class ZstdStringStream : private boost::noncopyable {
+ public:
+  using Ch = char;
+
+  /// Compressed bytes are appended to output.
+  explicit ZstdStringStream(std::string& output);
+  ~ZstdStringStream();
+
+  void Put(char c) {
+    input_.push_back(c);
+    if (input_.size() == input_.capacity()) {
+      compress(false);
+    }
+  }
+
+  /// Writers flush at the end of each document, the frame stays open.
+  void Flush() {}
+
+  /// Compress the remaining input and end the frame.
+  Status finish();
+
+ private:
+  void compress(bool end);
+
+ private:
+  /// Uncompressed input, filled up to its reserved capacity.
+  std::string input_;
+
+  /// Compressed output.
+  std::string& output_;
+
+  /// The Zstandard compression context.
+  ZSTD_CCtx_s* context_{nullptr};
+
+  /// The first compression error.
+  Status status_;
+};
+
 /**
  * @brief Abstract base class for remote transport implementations
  *
@@ -82,6 +141,22 @@ class Transport {
   virtual Status sendRequest(const std::string& params,
                              bool compress = false) = 0;
 
+  /**
+   * @brief Send an encoded request body to the destination
+   *
+   * Used when the body was compressed while serializing, the transport sends
+   * the body as-is and advertises its content encoding.
+   *
+   * @param body A string representing the encoded, serialized parameters
+   * @param content_encoding The name of the body encoding, e.g. "zstd"
+   *
+   * @return success or failure of the operation
+   */
+  virtual Status sendEncodedRequest(const std::string& body,
+                                    const std::string& content_encoding) {
+    return Status::failure("Transport does not support encoded requests");
+  }
+
   /**
    * @brief Get the status of the response
    *
@@ -155,6 +230,30 @@ class Serializer {
    */
   virtual Status serialize(const JSON& json, std::string& serialized) = 0;
 
+  /**
+   * @brief Serialize a JSON object into a Zstandard compressed string
+   *
+   * Serializers may override this to compress while serializing, the default
+   * compresses the complete serialized string.
+   *
+   * @param params a JSON object to be serialized
+   * @param compressed the output compressed string
+   * @return success or failure of the operation
+   */
+  virtual Status serializeZstd(const JSON& json, std::string& compressed) {
+    std::string serialized;
+    auto s = serialize(json, serialized);
+    if (!s.ok()) {
+      return s;
+    }
+
+    compressed = compressStringZstd(serialized);
+    if (compressed.empty()) {
+      return Status::failure("Could not compress the serialized request");
+    }
+    return Status::success();
+  }
+
   /**
    * @brief Deserialize a JSON string into a JSON object
    *
@@ -225,19 +324,36 @@ class Request {
    * @return success or failure of the operation
    */
   Status call(const JSON& params) {
+    // The compress option is either true, for gzip, or an encoding name.
+    std::string encoding;
+    auto it = options_.doc().FindMember("compress");
+    if (it != options_.doc().MemberEnd()) {
+      if (it->value.IsBool() && it->value.GetBool()) {
+        encoding = "gzip";
+      } else if (it->value.IsString()) {
+        encoding = it->value.GetString();
+      }
+    }
+
+    if (encoding == "zstd") {
+      std::string compressed;
+      auto s = serializer_->serializeZstd(params, compressed);
+      if (!s.ok()) {
+        return s;
+      }
+
+      return transport_->sendEncodedRequest(compressed, encoding);
+    } else if (!encoding.empty() && encoding != "gzip") {
+      return Status::failure("Unsupported request compression: " + encoding);
+    }
+
     std::string serialized;
     auto s = serializer_->serialize(params, serialized);
     if (!s.ok()) {
       return s;
     }
 
-    bool compress = false;
-    auto it = options_.doc().FindMember("compress");
-    if (it != options_.doc().MemberEnd() && it->value.IsBool()) {
-      compress = it->value.GetBool();
-    }
-
-    return transport_->sendRequest(serialized, compress);
+    return transport_->sendRequest(serialized, !encoding.empty());
   }
 
   /**
@@ -272,6 +388,7 @@ class Request {
  private:
   FRIEND_TEST(TLSTransportsTests, test_call);
   FRIEND_TEST(TLSTransportsTests, test_call_with_params);
+  FRIEND_TEST(TLSTransportsTests, test_call_with_zstd_params);
   FRIEND_TEST(TLSTransportsTests, test_call_verify_peer);
   FRIEND_TEST(TLSTransportsTests, test_call_server_cert_pinning);
   FRIEND_TEST(TLSTransportsTests, test_call_client_auth);
@@ -17,6 +17,14 @@ Status JSONSerializer::serialize(const JSON& json, std::string& serialized) {
   return json.toString(serialized);
 }
 
+Status JSONSerializer::serializeZstd(const JSON& json,
+                                     std::string& compressed) {
+  ZstdStringStream stream(compressed);
+  rapidjson::Writer<ZstdStringStream> writer(stream);
+  json.doc().Accept(writer);
+  return stream.finish();
+}
+
 Status JSONSerializer::deserialize(const std::string& serialized, JSON& json) {
   if (serialized.empty()) {
     // Prevent errors from being thrown when a TLS endpoint accepts the JSON
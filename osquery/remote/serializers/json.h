@@ -23,6 +23,13 @@ class JSONSerializer : public Serializer {
    */
   Status serialize(const JSON& json, std::string& serialized);
 
+  /**
+   * @brief See Serializer::serializeZstd
+   *
+   * The document is written directly into a Zstandard stream.
+   */
+  Status serializeZstd(const JSON& json, std::string& compressed);
+
   /**
    * @brief See Serializer::deserialize
    */
@@ -9,11 +9,34 @@
 
 #include <gtest/gtest.h>
 
+#include <zstd.h>
+
 #include "osquery/remote/serializers/json.h"
 
 namespace osquery {
 
-class JSONSerializersTests : public testing::Test {};
+class JSONSerializersTests : public testing::Test {
+ public:
+  std::string decompress(const std::string& compressed) {
+    auto stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+
+    std::string decompressed;
+    std::string buffer(ZSTD_DStreamOutSize(), '\0');
+    ZSTD_inBuffer input = {compressed.data(), compressed.size(), 0};
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = {&buffer[0], buffer.size(), 0};
+      auto result = ZSTD_decompressStream(stream, &output, &input);
+      if (ZSTD_isError(result)) {
+        break;
+      }
+      decompressed.append(buffer.data(), output.pos);
+    }
+
+    ZSTD_freeDStream(stream);
+    return decompressed;
+  }
+};
 
 TEST_F(JSONSerializersTests, test_serialize) {
   auto json = JSONSerializer();
@@ -38,4 +61,25 @@ TEST_F(JSONSerializersTests, test_deserialize) {
   EXPECT_TRUE(s.ok());
   EXPECT_EQ(params.doc(), expected.doc());
 }
+
+TEST_F(JSONSerializersTests, test_serialize_zstd) {
+  auto json = JSONSerializer();
+  JSON params;
+  auto data = params.newArray();
+
+  // Write more than one input block into the compressed stream.
+  for (size_t i = 0; i < 20000; i++) {
+    params.pushCopy("line " + std::to_string(i), data.doc());
+  }
+  params.add("data", data.doc());
+
+  std::string compressed;
+  auto s = json.serializeZstd(params, compressed);
+  ASSERT_TRUE(s.ok());
+
+  std::string serialized;
+  json.serialize(params, serialized);
+  EXPECT_LT(compressed.size(), serialized.size());
+  EXPECT_EQ(decompress(compressed), serialized);
+}
 }
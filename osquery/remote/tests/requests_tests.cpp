@@ -112,6 +112,12 @@ class CopyTransport : public Transport {
     response_status_ = Status(0, (compress) ? compressString(params) : params);
     return response_status_;
   }
+
+  Status sendEncodedRequest(const std::string& body,
+                            const std::string& content_encoding) override {
+    response_status_ = Status(0, body);
+    return response_status_;
+  }
 };
 
 class CopySerializer : public Serializer {
@@ -177,4 +183,37 @@ TEST_F(RequestsTests, test_compression) {
   EXPECT_EQ(compressed.substr(10), expected2);
   EXPECT_LT(compressed.size(), uncompressed.size());
 }
+
+TEST_F(RequestsTests, test_zstd_compression) {
+  Request<CopyTransport, CopySerializer> req("foobar");
+
+  // The compress option may name the content encoding.
+  req.setOption("compress", std::string("zstd"));
+
+  std::string uncompressed = "stringstringstringstring";
+  for (size_t i = 0; i < 10; i++) {
+    uncompressed += uncompressed;
+  }
+
+  JSON params;
+  params.add("copy", uncompressed);
+
+  // The 'copy' serializer does not stream, the serialized string is
+  // compressed before it reaches the transport.
+  ASSERT_TRUE(req.call(params).ok());
+  auto status = req.getResponse(params);
+
+  auto compressed = status.getMessage();
+  EXPECT_EQ(compressed, compressStringZstd(uncompressed));
+  EXPECT_LT(compressed.size(), uncompressed.size());
+}
+
+TEST_F(RequestsTests, test_unsupported_compression) {
+  Request<CopyTransport, CopySerializer> req("foobar");
+  req.setOption("compress", std::string("lzma"));
+
+  JSON params;
+  params.add("copy", "string");
+  EXPECT_FALSE(req.call(params).ok());
+}
 }
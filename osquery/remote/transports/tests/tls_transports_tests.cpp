@@ -20,6 +20,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/core/system.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/base64.h>
 #include <osquery/utils/info/platform_type.h>
 
 #include "osquery/remote/requests.h"
@@ -129,6 +130,43 @@ TEST_F(TLSTransportsTests, test_call_with_params) {
       << "Expected: " << json_expected << "\nReceived: " << json_received;
 }
 
+TEST_F(TLSTransportsTests, test_call_with_zstd_params) {
+  startServer();
+
+  auto t = std::make_shared<TLSTransport>();
+  t->disableVerifyPeer();
+
+  // The testing server echoes the encoded body of requests to this URI.
+  auto url = "https://localhost:" + port_ + "/encoded";
+  Request<TLSTransport, JSONSerializer> r(url, t);
+  r.setOption("compress", std::string("zstd"));
+
+  JSON params;
+  auto data = params.newArray();
+  for (size_t i = 0; i < 1000; i++) {
+    params.pushCopy("line " + std::to_string(i), data.doc());
+  }
+  params.add("data", data.doc());
+
+  Status status;
+  ASSERT_NO_THROW(status = r.call(params));
+  ASSERT_TRUE(status.ok()) << getTLSError(status);
+
+  JSON recv;
+  status = r.getResponse(recv);
+  ASSERT_TRUE(status.ok());
+
+  // The body was compressed while serializing, it is sent as-is.
+  std::string expected;
+  ASSERT_TRUE(JSONSerializer().serializeZstd(params, expected).ok());
+
+  const auto& doc = recv.doc();
+  ASSERT_TRUE(doc.HasMember("content_encoding"));
+  EXPECT_EQ(std::string(doc["content_encoding"].GetString()), "zstd");
+  ASSERT_TRUE(doc.HasMember("body"));
+  EXPECT_EQ(base64::decode(doc["body"].GetString()), expected);
+}
+
 TEST_F(TLSTransportsTests, test_call_verify_peer) {
   startServer();
 
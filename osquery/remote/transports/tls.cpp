@@ -51,6 +51,12 @@ CLI_FLAG(string,
          "",
          "Optional path to a TLS client-auth PEM private key");
 
+/// Content encoding used when a request asks for compression.
+CLI_FLAG(string,
+         tls_compression,
+         "gzip",
+         "Encoding of compressed TLS/HTTPS request bodies (gzip, zstd)");
+
 /// Reuse TLS session sockets.
 CLI_FLAG(bool, tls_session_reuse, true, "Reuse TLS session sockets");
 
@@ -230,6 +236,30 @@ Status TLSTransport::sendRequest() {
 }
 
 Status TLSTransport::sendRequest(const std::string& params, bool compress) {
+  if (FLAGS_verbose && FLAGS_tls_dump) {
+    fprintf(stdout, "%s\n", params.c_str());
+  }
+
+  if (compress) {
+    return sendBody(compressString(params), "gzip");
+  }
+  return sendBody(params, "");
+}
+
+Status TLSTransport::sendEncodedRequest(const std::string& body,
+                                        const std::string& content_encoding) {
+  if (FLAGS_verbose && FLAGS_tls_dump) {
+    fprintf(stdout,
+            "<%zu bytes of %s encoded content>\n",
+            body.size(),
+            content_encoding.c_str());
+  }
+
+  return sendBody(body, content_encoding);
+}
+
+Status TLSTransport::sendBody(const std::string& body,
+                              const std::string& content_encoding) {
   if (destination_.find("https://") == std::string::npos) {
     return Status::failure(
         "Cannot create TLS request for non-HTTPS protocol URI");
@@ -237,9 +267,8 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
 
   http::Request r(destination_);
   decorateRequest(r);
-  if (compress) {
-    // Later, when posting/putting, the data will be optionally compressed.
-    r << http::Request::Header("Content-Encoding", "gzip");
+  if (!content_encoding.empty()) {
+    r << http::Request::Header("Content-Encoding", content_encoding);
   }
 
   // Allow request calls to override the default HTTP POST verb.
@@ -252,18 +281,15 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
 
   VLOG(1) << "TLS/HTTPS " << ((verb == HTTP_POST) ? "POST" : "PUT")
           << " request to URI: " << destination_;
-  if (FLAGS_verbose && FLAGS_tls_dump) {
-    fprintf(stdout, "%s\n", params.c_str());
-  }
 
   try {
     std::shared_ptr<http::Client> client = getClient();
     client->setOptions(getInternalOptions());
 
     if (verb == HTTP_POST) {
-      response_ = client->post(r, (compress) ? compressString(params) : params);
+      response_ = client->post(r, body);
     } else {
-      response_ = client->put(r, (compress) ? compressString(params) : params);
+      response_ = client->put(r, body);
     }
 
     const auto& response_body = response_.body();
@@ -69,6 +69,15 @@ class TLSTransport : public Transport {
    */
   Status sendRequest(const std::string& params, bool compress = false) override;
 
+  /**
+   * @brief Send an encoded request body to the destination
+   *
+   * The body is sent as-is with a Content-Encoding header, see
+   * Transport::sendEncodedRequest.
+   */
+  Status sendEncodedRequest(const std::string& body,
+                            const std::string& content_encoding) override;
+
   /**
    * @brief Class destructor
    */
@@ -134,6 +143,9 @@ class TLSTransport : public Transport {
    */
   void decorateRequest(http::Request& r);
 
+  /// Post or put a request body with an optional content encoding.
+  Status sendBody(const std::string& body, const std::string& content_encoding);
+
  protected:
   /// Storage for the HTTP response object
   http::Response response_;
@@ -141,6 +153,7 @@ class TLSTransport : public Transport {
  private:
   FRIEND_TEST(TLSTransportsTests, test_call);
   FRIEND_TEST(TLSTransportsTests, test_call_with_params);
+  FRIEND_TEST(TLSTransportsTests, test_call_with_zstd_params);
   FRIEND_TEST(TLSTransportsTests, test_call_verify_peer);
   FRIEND_TEST(TLSTransportsTests, test_call_server_cert_pinning);
   FRIEND_TEST(TLSTransportsTests, test_call_client_auth);
@@ -29,6 +29,7 @@ namespace osquery {
 
 DECLARE_string(tls_enroll_override);
 DECLARE_string(tls_hostname);
+DECLARE_string(tls_compression);
 DECLARE_bool(tls_node_api);
 DECLARE_bool(tls_secret_always);
 DECLARE_bool(disable_reenrollment);
@@ -102,8 +103,9 @@ class TLSRequestHelper : private boost::noncopyable {
     bool compress = false;
     auto it = params_doc.FindMember("_compress");
     if (it != params_doc.MemberEnd()) {
+      // Callers request compression, the encoding is a transport setting.
       compress = true;
-      request.setOption("compress", compress);
+      request.setOption("compress", FLAGS_tls_compression);
       params_doc.RemoveMember("_compress");
     }
 
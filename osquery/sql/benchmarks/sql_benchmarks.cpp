@@ -7,11 +7,20 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#include <fstream>
+
 #include <benchmark/benchmark.h>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/columnar_table_row.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/sql/sql.h>
 
 #include "osquery/sql/virtual_table.h"
@@ -197,6 +206,9 @@ BENCHMARK(SQL_virtual_table_internal_long);
 
 size_t kWideCount{0};
 
+/// Rows generated by the wide benchmark tables.
+size_t kWideGenerated{0};
+
 class BenchmarkWideTablePlugin : public TablePlugin {
  protected:
   TableColumns columns() const override {
@@ -216,6 +228,7 @@ class BenchmarkWideTablePlugin : public TablePlugin {
         r["test_" + std::to_string(i)] = "0";
       }
       results.push_back(std::move(r));
+      kWideGenerated++;
     }
     return results;
   }
@@ -233,6 +246,7 @@ class BenchmarkWideTableYieldPlugin : public BenchmarkWideTablePlugin {
       for (size_t i = 0; i < 20; i++) {
         r["test_" + std::to_string(i)] = "0";
       }
+      kWideGenerated++;
       yield(std::move(r));
     }
   }
@@ -291,6 +305,276 @@ BENCHMARK(SQL_virtual_table_internal_wide_yield)
     ->ArgPair(0, 100)
     ->ArgPair(0, 1000);
 
+class BenchmarkWideTableColumnarPlugin : public BenchmarkWideTablePlugin {
+ protected:
+  TableRows generate(QueryContext& ctx) override {
+    auto results = std::make_shared<ColumnarRows>(columns());
+    results->reserve(kWideCount);
+    for (size_t k = 0; k < kWideCount; k++) {
+      results->append();
+      for (size_t i = 0; i < 20; i++) {
+        results->setInteger(i, 0);
+      }
+    }
+    return tableRowsFromColumnar(results);
+  }
+};
+
+static void SQL_virtual_table_internal_wide_columnar(benchmark::State& state) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("wide_benchmark_columnar",
+              std::make_shared<BenchmarkWideTableColumnarPlugin>());
+
+  PluginResponse res;
+  Registry::call(
+      "table", "wide_benchmark_columnar", {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("wide_benchmark_columnar",
+                      columnDefinition(res, false, false),
+                      dbc,
+                      false);
+
+  kWideCount = state.range(1);
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select * from wide_benchmark_columnar", results, dbc);
+    dbc->clearAffectedTables();
+  }
+}
+
+BENCHMARK(SQL_virtual_table_internal_wide_columnar)
+    ->ArgPair(0, 1)
+    ->ArgPair(0, 10)
+    ->ArgPair(0, 100)
+    ->ArgPair(0, 1000);
+
+/// Reset the process peak resident set size, where the platform allows it.
+static void resetPeakRss() {
+#ifdef __linux__
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+#endif
+}
+
+/// Read the process peak resident set size in kilobytes.
+static double peakRssKb() {
+#ifndef WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return static_cast<double>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<double>(usage.ru_maxrss);
+#endif
+  }
+#endif
+  return 0;
+}
+
+/// Run a LIMIT query against a wide table, counting the rows it generated.
+static void benchmarkWideLimit(benchmark::State& state,
+                               const std::string& table,
+                               std::shared_ptr<TablePlugin> plugin) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add(table, std::move(plugin));
+
+  PluginResponse res;
+  Registry::call("table", table, {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(table, columnDefinition(res, false, false), dbc, false);
+
+  kWideCount = state.range(0);
+  kWideGenerated = 0;
+  resetPeakRss();
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select * from " + table + " limit 10", results, dbc);
+    dbc->clearAffectedTables();
+  }
+
+  // A streamed scan stops after the limit, the peak memory stays flat.
+  state.counters["rows_generated"] =
+      static_cast<double>(kWideGenerated) / state.iterations();
+  state.counters["peak_rss_kb"] = peakRssKb();
+}
+
+static void SQL_virtual_table_internal_wide_limit(benchmark::State& state) {
+  benchmarkWideLimit(state,
+                     "wide_benchmark_limit",
+                     std::make_shared<BenchmarkWideTablePlugin>());
+}
+
+BENCHMARK(SQL_virtual_table_internal_wide_limit)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
+
+static void SQL_virtual_table_internal_wide_yield_limit(
+    benchmark::State& state) {
+  benchmarkWideLimit(state,
+                     "wide_benchmark_yield_limit",
+                     std::make_shared<BenchmarkWideTableYieldPlugin>());
+}
+
+BENCHMARK(SQL_virtual_table_internal_wide_yield_limit)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
+
+/// Each column of the pruned benchmark table costs this many digest rounds.
+const size_t kPrunedColumnCost{4096};
+
+class BenchmarkPrunedTablePlugin : public TablePlugin {
+ protected:
+  TableColumns columns() const override {
+    TableColumns cols;
+    for (size_t i = 0; i < 8; i++) {
+      cols.push_back(std::make_tuple(
+          "test_" + std::to_string(i), BIGINT_TYPE, ColumnOptions::DEFAULT));
+    }
+    return cols;
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    TableRows results;
+    for (size_t k = 0; k < 100; k++) {
+      auto r = make_table_row();
+      for (size_t i = 0; i < 8; i++) {
+        auto column = "test_" + std::to_string(i);
+        if (!ctx.isColumnUsed(column)) {
+          continue;
+        }
+
+        // Stand in for an expensive per-column source, such as a proc file.
+        size_t digest = k;
+        for (size_t round = 0; round < kPrunedColumnCost; round++) {
+          digest = digest * 31 + round;
+        }
+        r[column] = BIGINT(digest);
+      }
+      results.push_back(std::move(r));
+    }
+    return results;
+  }
+};
+
+static void SQL_virtual_table_internal_pruned(benchmark::State& state) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("pruned_benchmark",
+              std::make_shared<BenchmarkPrunedTablePlugin>());
+
+  PluginResponse res;
+  Registry::call("table", "pruned_benchmark", {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "pruned_benchmark", columnDefinition(res, false, false), dbc, false);
+
+  // Select the first N columns, the cost should scale with N.
+  std::string query = "select test_0";
+  for (int64_t i = 1; i < state.range(0); i++) {
+    query += ", test_" + std::to_string(i);
+  }
+  query += " from pruned_benchmark";
+
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal(query, results, dbc);
+    dbc->clearAffectedTables();
+  }
+}
+
+BENCHMARK(SQL_virtual_table_internal_pruned)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+/// Rows generated by the regex benchmark table.
+size_t kRegexRows{0};
+
+class BenchmarkRegexTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("path", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    TableRows results;
+    for (size_t i = 0; i < kRegexRows; i++) {
+      auto index = std::to_string(i);
+      auto path = (i % 2 == 0) ? "/usr/local/bin/process" + index
+                               : "/opt/vendor" + index + "/lib/libtool.so";
+      results.push_back(make_table_row({{"path", path}}));
+    }
+    return results;
+  }
+};
+
+/// Run a regex filter over the rows of the regex table, with either engine.
+static void benchmarkRegexFilter(benchmark::State& state,
+                                 const std::string& filter) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("regex_benchmark", std::make_shared<BenchmarkRegexTablePlugin>());
+
+  PluginResponse res;
+  Registry::call("table", "regex_benchmark", {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "regex_benchmark", columnDefinition(res, false, false), dbc, false);
+
+  kRegexRows = static_cast<size_t>(state.range(0));
+  Flag::updateValue("regex_linear_engine",
+                    state.range(1) != 0 ? "true" : "false");
+
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal(
+        "select count(*) from regex_benchmark where " + filter, results, dbc);
+    dbc->clearAffectedTables();
+  }
+
+  Flag::updateValue("regex_linear_engine", "true");
+
+  // Reported as rows per second.
+  state.SetItemsProcessed(state.iterations() * kRegexRows);
+}
+
+static void SQL_regex_match_filter(benchmark::State& state) {
+  benchmarkRegexFilter(
+      state,
+      "regex_match(path, '^/usr/(local/)?bin/[a-z]+[0-9]*7$', 0) is not null");
+}
+
+BENCHMARK(SQL_regex_match_filter)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1)
+    ->Unit(benchmark::kMillisecond);
+
+static void SQL_regex_match_group(benchmark::State& state) {
+  benchmarkRegexFilter(
+      state, "regex_match(path, '.+/([^./]+)\\.so$', 1) = 'libtool'");
+}
+
+BENCHMARK(SQL_regex_match_group)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1)
+    ->Unit(benchmark::kMillisecond);
+
+static void SQL_regex_split_filter(benchmark::State& state) {
+  benchmarkRegexFilter(state, "regex_split(path, '/+', 2) = 'local'");
+}
+
+BENCHMARK(SQL_regex_split_filter)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1)
+    ->Unit(benchmark::kMillisecond);
+
 static void SQL_select_metadata(benchmark::State& state) {
   auto dbc = SQLiteDBManager::getUnique();
   while (state.KeepRunning()) {
@@ -310,4 +594,36 @@ static void SQL_select_basic(benchmark::State& state) {
 }
 
 BENCHMARK(SQL_select_basic);
+
+static void SQL_select_basic_prepare(benchmark::State& state) {
+  // Profile a repeated query with or without the prepared statement cache.
+  Flag::updateValue("sql_statement_cache_size",
+                    std::to_string(state.range(0)));
+
+  auto dbc = SQLiteDBManager::getUnique();
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select * from benchmark", results, dbc);
+    dbc->clearAffectedTables();
+  }
+
+  Flag::updateValue("sql_statement_cache_size", "512");
+}
+
+BENCHMARK(SQL_select_basic_prepare)->Arg(0)->Arg(512);
+
+static void SQL_select_basic_contended(benchmark::State& state) {
+  // Profile a query while the primary database is in use, the query runs on
+  // a pooled transient database or attaches every table to a new one.
+  Flag::updateValue("sql_instance_pool_size", std::to_string(state.range(0)));
+
+  auto primary = SQLiteDBManager::get();
+  while (state.KeepRunning()) {
+    SQLInternal results("select * from benchmark");
+  }
+
+  Flag::updateValue("sql_instance_pool_size", "4");
+}
+
+BENCHMARK(SQL_select_basic_contended)->Arg(0)->Arg(4);
 } // namespace osquery
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "columnar_table_row.h"
+#include "virtual_table.h"
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+TableRows tableRowsFromColumnar(const ColumnarRowsRef& rows) {
+  TableRows result;
+  if (rows == nullptr) {
+    return result;
+  }
+
+  result.reserve(rows->size());
+  for (size_t i = 0; i < rows->size(); i++) {
+    result.push_back(TableRowHolder(new ColumnarTableRow(rows, i)));
+  }
+  return result;
+}
+
+QueryData queryDataFromColumnar(const ColumnarRows& rows) {
+  QueryData result;
+  result.reserve(rows.size());
+  for (size_t i = 0; i < rows.size(); i++) {
+    result.push_back(rows.toRow(i));
+  }
+  return result;
+}
+
+int ColumnarTableRow::get_rowid(sqlite_int64 default_value,
+                                sqlite_int64* pRowid) const {
+  auto col = rows_->columnIndex("rowid");
+  if (col == rows_->columnCount() || rows_->isNull(index_, col)) {
+    *pRowid = default_value;
+  } else {
+    *pRowid = rows_->getInteger(index_, col);
+  }
+  return SQLITE_OK;
+}
+
+int ColumnarTableRow::get_column(sqlite3_context* ctx,
+                                 sqlite3_vtab* vtab,
+                                 int col) {
+  auto index = static_cast<size_t>(col);
+  if (index >= rows_->columnCount()) {
+    // Column aliases are appended as HIDDEN columns after the table layout,
+    // move content from the column they alias.
+    const auto* pVtab = reinterpret_cast<const VirtualTable*>(vtab);
+    const auto& column_name = std::get<0>(pVtab->content->columns[index]);
+    auto alias = pVtab->content->aliases.find(column_name);
+    if (alias == pVtab->content->aliases.end()) {
+      sqlite3_result_null(ctx);
+      return SQLITE_OK;
+    }
+    index = alias->second;
+  }
+
+  return rows_->result(ctx, index_, index);
+}
+
+Status ColumnarTableRow::serialize(JSON& doc, rj::Value& obj) const {
+  return rows_->serialize(index_, doc, obj);
+}
+
+TableRowHolder ColumnarTableRow::clone() const {
+  return TableRowHolder(new ColumnarTableRow(rows_, index_));
+}
+
+} // namespace osquery
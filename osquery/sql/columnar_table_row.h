@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/core/sql/columnar_rows.h>
+#include <osquery/core/sql/query_data.h>
+#include <osquery/core/sql/table_row.h>
+#include <osquery/core/sql/table_rows.h>
+
+namespace osquery {
+
+/**
+ * A TableRow view into a shared ColumnarRows batch.
+ *
+ * The view only holds a reference to the batch and a row index, SQLite
+ * column reads and serialization are answered directly from the batch's
+ * typed column storage.
+ */
+class ColumnarTableRow : public TableRow {
+ public:
+  ColumnarTableRow(std::shared_ptr<const ColumnarRows> rows, size_t index)
+      : rows_(std::move(rows)), index_(index) {}
+  ColumnarTableRow(const ColumnarTableRow&) = delete;
+  ColumnarTableRow& operator=(const ColumnarTableRow&) = delete;
+  explicit operator Row() const override {
+    return rows_->toRow(index_);
+  }
+  int get_rowid(sqlite_int64 default_value,
+                sqlite_int64* pRowid) const override;
+  int get_column(sqlite3_context* ctx, sqlite3_vtab* pVtab, int col) override;
+  Status serialize(JSON& doc, rapidjson::Value& obj) const override;
+  TableRowHolder clone() const override;
+
+ private:
+  std::shared_ptr<const ColumnarRows> rows_;
+  size_t index_{0};
+};
+
+/// Converts a ColumnarRows batch to TableRows of views sharing the batch.
+TableRows tableRowsFromColumnar(const ColumnarRowsRef& rows);
+
+/// Converts a ColumnarRows batch to string maps, e.g. for namespace workers.
+QueryData queryDataFromColumnar(const ColumnarRows& rows);
+
+} // namespace osquery
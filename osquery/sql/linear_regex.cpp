@@ -0,0 +1,1051 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/sql/linear_regex.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace osquery {
+
+namespace {
+
+/// Upper bound of a quantifier without a maximum.
+const size_t kUnbounded = std::numeric_limits<size_t>::max();
+
+/// Counted repetitions are expanded, so they are bounded.
+const size_t kMaxRepeat = 1000;
+
+/// The program is bounded to keep the matching cost per byte in check.
+const size_t kMaxInstructions = 10000;
+
+/// Groups are parsed recursively.
+const size_t kMaxDepth = 100;
+
+/// The assertions true at a position, the follows of a pc depend on them.
+const uint32_t kContextBegin = 1 << 0;
+const uint32_t kContextEnd = 1 << 1;
+const uint32_t kContextWordBoundary = 1 << 2;
+const uint32_t kContexts = 1 << 3;
+
+/// The follows not computed yet.
+const uint32_t kNotComputed = std::numeric_limits<uint32_t>::max();
+
+/// Bounds the memory of the follows, the ones after are computed each time.
+const size_t kMaxFollows = 1 << 18;
+
+using ByteSet = std::bitset<256>;
+
+bool isWordByte(unsigned char c) {
+  return std::isalnum(c) || c == '_';
+}
+
+void addDigits(ByteSet& set) {
+  for (int c = '0'; c <= '9'; c++) {
+    set.set(c);
+  }
+}
+
+void addWordBytes(ByteSet& set) {
+  for (int c = 0; c < 128; c++) {
+    if (isWordByte(static_cast<unsigned char>(c))) {
+      set.set(c);
+    }
+  }
+}
+
+void addSpaces(ByteSet& set) {
+  for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+    set.set(c);
+  }
+}
+} // namespace
+
+struct LinearRegex::Node {
+  enum class Type {
+    kEmpty,
+    kByte,
+    kSet,
+    kConcat,
+    kAlternate,
+    kRepeat,
+    kCapture,
+    kBegin,
+    kEnd,
+    kWordBoundary,
+    kNotWordBoundary,
+  };
+
+  explicit Node(Type type) : type(type) {}
+
+  /// True if the node can match without consuming input.
+  bool isNullable() const;
+
+  Type type;
+  unsigned char byte{0};
+  size_t set{0};
+  size_t group{0};
+  size_t min{0};
+  size_t max{0};
+  bool greedy{true};
+  std::vector<std::unique_ptr<Node>> children;
+};
+
+bool LinearRegex::Node::isNullable() const {
+  switch (type) {
+  case Type::kByte:
+  case Type::kSet:
+    return false;
+  case Type::kConcat:
+    return std::all_of(children.begin(),
+                       children.end(),
+                       [](const auto& child) { return child->isNullable(); });
+  case Type::kAlternate:
+    return std::any_of(children.begin(),
+                       children.end(),
+                       [](const auto& child) { return child->isNullable(); });
+  case Type::kRepeat:
+    return min == 0 || children[0]->isNullable();
+  case Type::kCapture:
+    return children[0]->isNullable();
+  default:
+    return true;
+  }
+}
+
+namespace {
+
+using Node = LinearRegex::Node;
+using NodeRef = std::unique_ptr<Node>;
+
+/**
+ * @brief Recursive descent parser of the ECMAScript grammar.
+ *
+ * Anything not understood fails, std::regex has the last word on those.
+ */
+class Parser {
+ public:
+  Parser(const std::string& pattern, std::vector<ByteSet>& sets)
+      : pattern_(pattern), sets_(sets) {}
+
+  Status parse(NodeRef& root) {
+    auto status = parseAlternate(root, 0);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (!done()) {
+      return Status::failure("Unexpected ')' in the regex");
+    }
+    return Status::success();
+  }
+
+  size_t groups() const {
+    return groups_;
+  }
+
+ private:
+  bool done() const {
+    return pos_ >= pattern_.size();
+  }
+
+  unsigned char peek(size_t offset = 0) const {
+    return pos_ + offset < pattern_.size()
+               ? static_cast<unsigned char>(pattern_[pos_ + offset])
+               : 0;
+  }
+
+  static bool isQuantifier(unsigned char c) {
+    return c == '*' || c == '+' || c == '?' || c == '{';
+  }
+
+  NodeRef makeSet(const ByteSet& set) {
+    auto node = std::make_unique<Node>(Node::Type::kSet);
+    node->set = sets_.size();
+    sets_.push_back(set);
+    return node;
+  }
+
+  Status parseAlternate(NodeRef& node, size_t depth) {
+    if (depth > kMaxDepth) {
+      return Status::failure("Too many nested groups in the regex");
+    }
+
+    NodeRef branch;
+    auto status = parseConcat(branch, depth);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (peek() != '|') {
+      node = std::move(branch);
+      return Status::success();
+    }
+
+    node = std::make_unique<Node>(Node::Type::kAlternate);
+    node->children.push_back(std::move(branch));
+    while (peek() == '|') {
+      pos_++;
+      status = parseConcat(branch, depth);
+      if (!status.ok()) {
+        return status;
+      }
+      node->children.push_back(std::move(branch));
+    }
+    return Status::success();
+  }
+
+  Status parseConcat(NodeRef& node, size_t depth) {
+    node = std::make_unique<Node>(Node::Type::kConcat);
+    while (!done() && peek() != '|' && peek() != ')') {
+      NodeRef term;
+      auto status = parseRepeat(term, depth);
+      if (!status.ok()) {
+        return status;
+      }
+      node->children.push_back(std::move(term));
+    }
+
+    if (node->children.empty()) {
+      node = std::make_unique<Node>(Node::Type::kEmpty);
+    } else if (node->children.size() == 1) {
+      node = std::move(node->children[0]);
+    }
+    return Status::success();
+  }
+
+  Status parseRepeat(NodeRef& node, size_t depth) {
+    auto status = parseAtom(node, depth);
+    if (!status.ok() || !isQuantifier(peek())) {
+      return status;
+    }
+
+    switch (node->type) {
+    case Node::Type::kBegin:
+    case Node::Type::kEnd:
+    case Node::Type::kWordBoundary:
+    case Node::Type::kNotWordBoundary:
+      return Status::failure("Quantified assertion in the regex");
+    default:
+      break;
+    }
+
+    auto repeat = std::make_unique<Node>(Node::Type::kRepeat);
+    auto c = peek();
+    pos_++;
+    if (c == '*') {
+      repeat->min = 0;
+      repeat->max = kUnbounded;
+    } else if (c == '+') {
+      repeat->min = 1;
+      repeat->max = kUnbounded;
+    } else if (c == '?') {
+      repeat->min = 0;
+      repeat->max = 1;
+    } else {
+      status = parseCount(repeat->min, repeat->max);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+
+    if (peek() == '?') {
+      repeat->greedy = false;
+      pos_++;
+    }
+
+    if (isQuantifier(peek())) {
+      return Status::failure("Nested quantifier in the regex");
+    }
+
+    repeat->children.push_back(std::move(node));
+    node = std::move(repeat);
+    return Status::success();
+  }
+
+  Status parseNumber(size_t& value) {
+    if (!std::isdigit(peek())) {
+      return Status::failure("Invalid quantifier in the regex");
+    }
+
+    value = 0;
+    while (std::isdigit(peek())) {
+      value = value * 10 + (peek() - '0');
+      pos_++;
+      if (value > kMaxRepeat) {
+        return Status::failure("Quantifier too big in the regex");
+      }
+    }
+    return Status::success();
+  }
+
+  Status parseCount(size_t& min, size_t& max) {
+    auto status = parseNumber(min);
+    if (!status.ok()) {
+      return status;
+    }
+
+    max = min;
+    if (peek() == ',') {
+      pos_++;
+      max = kUnbounded;
+      if (peek() != '}') {
+        status = parseNumber(max);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+
+    if (peek() != '}' || min > max) {
+      return Status::failure("Invalid quantifier in the regex");
+    }
+    pos_++;
+    return Status::success();
+  }
+
+  Status parseAtom(NodeRef& node, size_t depth) {
+    auto c = peek();
+    pos_++;
+
+    switch (c) {
+    case '(': {
+      size_t group = 0;
+      if (peek() == '?') {
+        if (peek(1) != ':') {
+          return Status::failure("Unsupported group in the regex");
+        }
+        pos_ += 2;
+      } else {
+        group = ++groups_;
+      }
+
+      NodeRef child;
+      auto status = parseAlternate(child, depth + 1);
+      if (!status.ok()) {
+        return status;
+      }
+
+      if (peek() != ')') {
+        return Status::failure("Missing ')' in the regex");
+      }
+      pos_++;
+
+      if (group == 0) {
+        node = std::move(child);
+      } else {
+        node = std::make_unique<Node>(Node::Type::kCapture);
+        node->group = group;
+        node->children.push_back(std::move(child));
+      }
+      return Status::success();
+    }
+    case '[':
+      return parseClass(node);
+    case '.': {
+      ByteSet set;
+      set.set();
+      set.reset('\n');
+      set.reset('\r');
+      node = makeSet(set);
+      return Status::success();
+    }
+    case '^':
+      node = std::make_unique<Node>(Node::Type::kBegin);
+      return Status::success();
+    case '$':
+      node = std::make_unique<Node>(Node::Type::kEnd);
+      return Status::success();
+    case '\\':
+      if (peek() == 'b' || peek() == 'B') {
+        node = std::make_unique<Node>(peek() == 'b'
+                                          ? Node::Type::kWordBoundary
+                                          : Node::Type::kNotWordBoundary);
+        pos_++;
+        return Status::success();
+      }
+      break;
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '}':
+    case ']':
+      return Status::failure("Unexpected character in the regex");
+    default:
+      break;
+    }
+
+    pos_--;
+    ByteSet set;
+    auto status = parseClassAtom(set);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (set.count() == 1) {
+      node = std::make_unique<Node>(Node::Type::kByte);
+      for (size_t i = 0; i < set.size(); i++) {
+        if (set.test(i)) {
+          node->byte = static_cast<unsigned char>(i);
+        }
+      }
+    } else {
+      node = makeSet(set);
+    }
+    return Status::success();
+  }
+
+  /// Parse a byte, or an escape, into a set of bytes.
+  Status parseClassAtom(ByteSet& set, bool* is_byte = nullptr) {
+    auto c = peek();
+    pos_++;
+
+    // The bytes above ASCII depend on the locale.
+    if (c == 0 || c >= 0x80) {
+      return Status::failure("Unsupported character in the regex");
+    }
+
+    if (is_byte != nullptr) {
+      *is_byte = true;
+    }
+
+    if (c != '\\') {
+      set.set(c);
+      return Status::success();
+    }
+
+    c = peek();
+    pos_++;
+
+    ByteSet escaped;
+    switch (c) {
+    case 'f':
+      set.set('\f');
+      return Status::success();
+    case 'n':
+      set.set('\n');
+      return Status::success();
+    case 'r':
+      set.set('\r');
+      return Status::success();
+    case 't':
+      set.set('\t');
+      return Status::success();
+    case 'v':
+      set.set('\v');
+      return Status::success();
+    case 'd':
+    case 'D':
+      addDigits(escaped);
+      break;
+    case 'w':
+    case 'W':
+      addWordBytes(escaped);
+      break;
+    case 's':
+    case 'S':
+      addSpaces(escaped);
+      break;
+    default:
+      // Backreferences, hexadecimal and control escapes are not supported.
+      if (c >= 0x80 || !std::ispunct(c)) {
+        return Status::failure("Unsupported escape in the regex");
+      }
+      set.set(c);
+      return Status::success();
+    }
+
+    if (is_byte != nullptr) {
+      *is_byte = false;
+    }
+
+    set |= std::isupper(c) ? ~escaped : escaped;
+    return Status::success();
+  }
+
+  Status parseClass(NodeRef& node) {
+    bool negate = false;
+    if (peek() == '^') {
+      negate = true;
+      pos_++;
+    }
+
+    ByteSet set;
+    bool first = true;
+    while (true) {
+      if (done()) {
+        return Status::failure("Missing ']' in the regex");
+      }
+
+      auto c = peek();
+      if (c == ']') {
+        // An empty class is valid in ECMAScript but an odd case.
+        if (first) {
+          return Status::failure("Empty class in the regex");
+        }
+        pos_++;
+        break;
+      }
+
+      // Character classes, equivalence classes and collating elements.
+      if (c == '[') {
+        return Status::failure("Unsupported class in the regex");
+      }
+
+      // A dash is a literal at the edges of the class only.
+      if (c == '-') {
+        if (!first && peek(1) != ']') {
+          return Status::failure("Invalid range in the regex");
+        }
+        set.set('-');
+        pos_++;
+        first = false;
+        continue;
+      }
+
+      ByteSet low;
+      bool low_is_byte = false;
+      auto status = parseClassAtom(low, &low_is_byte);
+      if (!status.ok()) {
+        return status;
+      }
+      first = false;
+
+      if (peek() != '-' || peek(1) == ']' || peek(1) == 0) {
+        set |= low;
+        continue;
+      }
+      pos_++;
+
+      if (peek() == '[') {
+        return Status::failure("Unsupported class in the regex");
+      }
+
+      ByteSet high;
+      bool high_is_byte = false;
+      status = parseClassAtom(high, &high_is_byte);
+      if (!status.ok()) {
+        return status;
+      }
+
+      if (!low_is_byte || !high_is_byte) {
+        return Status::failure("Invalid range in the regex");
+      }
+
+      size_t from = 0;
+      size_t to = 0;
+      for (size_t i = 0; i < low.size(); i++) {
+        from = low.test(i) ? i : from;
+        to = high.test(i) ? i : to;
+      }
+
+      if (from > to) {
+        return Status::failure("Invalid range in the regex");
+      }
+
+      for (auto i = from; i <= to; i++) {
+        set.set(i);
+      }
+    }
+
+    node = makeSet(negate ? ~set : set);
+    return Status::success();
+  }
+
+ private:
+  const std::string& pattern_;
+  std::vector<ByteSet>& sets_;
+  size_t pos_{0};
+  size_t groups_{0};
+};
+} // namespace
+
+void LinearRegex::ThreadList::clear() {
+  size = 0;
+  if (++generation == 0) {
+    std::fill(marks.begin(), marks.end(), 0);
+    generation = 1;
+  }
+}
+
+Status LinearRegex::compile(const std::string& pattern) {
+  program_.clear();
+  sets_.clear();
+
+  NodeRef root;
+  Parser parser(pattern, sets_);
+  auto status = parser.parse(root);
+  if (!status.ok()) {
+    return status;
+  }
+  groups_ = parser.groups();
+
+  append(Opcode::kSave, 0);
+  status = emit(*root);
+  if (status.ok() && program_.size() > kMaxInstructions) {
+    status = Status::failure("The regex is too complex");
+  }
+
+  if (!status.ok()) {
+    program_.clear();
+    return status;
+  }
+  append(Opcode::kSave, 1);
+  append(Opcode::kMatch);
+
+  auto captures = 2 * (groups_ + 1);
+  for (auto list : {&current_, &next_}) {
+    list->pcs.resize(program_.size());
+    list->captures.resize(program_.size() * captures);
+    list->marks.assign(program_.size(), 0);
+    list->generation = 0;
+    list->size = 0;
+  }
+  seed_.assign(captures, std::string::npos);
+
+  follow_ranges_.assign(kContexts * program_.size(), {kNotComputed, 0});
+  follows_.clear();
+  follow_saves_.clear();
+  marks_.assign(program_.size(), 0);
+  generation_ = 0;
+
+  has_word_boundaries_ = std::any_of(
+      program_.begin(), program_.end(), [](const Instruction& instruction) {
+        return instruction.op == Opcode::kWordBoundary ||
+               instruction.op == Opcode::kNotWordBoundary;
+      });
+
+  // Both let the search skip the positions where no match can begin.
+  anchored_ = true;
+  visitStart(false, [this](const Instruction& instruction) {
+    if (instruction.op != Opcode::kAssertBegin) {
+      anchored_ = false;
+    }
+  });
+
+  has_first_bytes_ = true;
+  first_bytes_.reset();
+  visitStart(true, [this](const Instruction& instruction) {
+    if (instruction.op == Opcode::kByte) {
+      first_bytes_.set(instruction.byte);
+    } else if (instruction.op == Opcode::kSet) {
+      first_bytes_ |= sets_[instruction.x];
+    } else {
+      has_first_bytes_ = false;
+    }
+  });
+  return Status::success();
+}
+
+template <typename Visitor>
+void LinearRegex::visitStart(bool through_begin, Visitor visitor) const {
+  std::vector<bool> seen(program_.size(), false);
+  std::vector<uint32_t> pcs = {0};
+  while (!pcs.empty()) {
+    auto pc = pcs.back();
+    pcs.pop_back();
+    if (seen[pc]) {
+      continue;
+    }
+    seen[pc] = true;
+
+    const auto& instruction = program_[pc];
+    switch (instruction.op) {
+    case Opcode::kJump:
+      pcs.push_back(instruction.x);
+      break;
+    case Opcode::kSplit:
+      pcs.push_back(instruction.x);
+      pcs.push_back(instruction.y);
+      break;
+    case Opcode::kSave:
+    case Opcode::kAssertEnd:
+    case Opcode::kWordBoundary:
+    case Opcode::kNotWordBoundary:
+      pcs.push_back(pc + 1);
+      break;
+    case Opcode::kAssertBegin:
+      if (through_begin) {
+        pcs.push_back(pc + 1);
+      } else {
+        visitor(instruction);
+      }
+      break;
+    default:
+      visitor(instruction);
+      break;
+    }
+  }
+}
+
+uint32_t LinearRegex::append(Opcode op, uint32_t x, uint32_t y) {
+  program_.push_back({op, 0, x, y});
+  return static_cast<uint32_t>(program_.size() - 1);
+}
+
+Status LinearRegex::emit(const Node& node) {
+  // Counted repetitions may grow the program past its limit quickly.
+  if (program_.size() > kMaxInstructions) {
+    return Status::failure("The regex is too complex");
+  }
+
+  auto here = [this]() { return static_cast<uint32_t>(program_.size()); };
+
+  switch (node.type) {
+  case Node::Type::kEmpty:
+    break;
+  case Node::Type::kByte:
+    program_[append(Opcode::kByte)].byte = node.byte;
+    break;
+  case Node::Type::kSet:
+    append(Opcode::kSet, static_cast<uint32_t>(node.set));
+    break;
+  case Node::Type::kBegin:
+    append(Opcode::kAssertBegin);
+    break;
+  case Node::Type::kEnd:
+    append(Opcode::kAssertEnd);
+    break;
+  case Node::Type::kWordBoundary:
+    append(Opcode::kWordBoundary);
+    break;
+  case Node::Type::kNotWordBoundary:
+    append(Opcode::kNotWordBoundary);
+    break;
+  case Node::Type::kConcat:
+    for (const auto& child : node.children) {
+      auto status = emit(*child);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    break;
+  case Node::Type::kCapture: {
+    auto slot = static_cast<uint32_t>(2 * node.group);
+    append(Opcode::kSave, slot);
+    auto status = emit(*node.children[0]);
+    if (!status.ok()) {
+      return status;
+    }
+    append(Opcode::kSave, slot + 1);
+    break;
+  }
+  case Node::Type::kAlternate: {
+    // The branches are tried in order: split to the branch or the next one.
+    std::vector<uint32_t> jumps;
+    for (size_t i = 0; i < node.children.size(); i++) {
+      uint32_t split = 0;
+      if (i + 1 < node.children.size()) {
+        split = append(Opcode::kSplit, here() + 1);
+      }
+
+      auto status = emit(*node.children[i]);
+      if (!status.ok()) {
+        return status;
+      }
+
+      if (i + 1 < node.children.size()) {
+        jumps.push_back(append(Opcode::kJump));
+        program_[split].y = here();
+      }
+    }
+
+    for (auto jump : jumps) {
+      program_[jump].x = here();
+    }
+    break;
+  }
+  case Node::Type::kRepeat: {
+    const auto& child = *node.children[0];
+    for (size_t i = 0; i < node.min; i++) {
+      auto status = emit(child);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+
+    if (node.max == kUnbounded) {
+      // std::regex enters a loop again after an empty iteration, where the
+      // VM stops, so their results could differ.
+      if (child.isNullable()) {
+        return Status::failure("Unsupported repeated empty match in the regex");
+      }
+
+      auto split = append(Opcode::kSplit);
+      auto status = emit(child);
+      if (!status.ok()) {
+        return status;
+      }
+      append(Opcode::kJump, split);
+
+      auto body = split + 1;
+      program_[split].x = node.greedy ? body : here();
+      program_[split].y = node.greedy ? here() : body;
+      break;
+    }
+
+    // Each optional copy is skipped as a whole, as nested '?'.
+    std::vector<uint32_t> splits;
+    for (auto i = node.min; i < node.max; i++) {
+      splits.push_back(append(Opcode::kSplit));
+      auto status = emit(child);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+
+    for (auto split : splits) {
+      program_[split].x = node.greedy ? split + 1 : here();
+      program_[split].y = node.greedy ? here() : split + 1;
+    }
+    break;
+  }
+  }
+
+  return Status::success();
+}
+
+uint32_t LinearRegex::getContext(const std::string& input,
+                                 size_t pos,
+                                 size_t start,
+                                 int flags) const {
+  uint32_t context = 0;
+  if (pos == start && !(flags & kMatchPrevAvail)) {
+    context |= kContextBegin;
+  }
+
+  if (pos == input.size()) {
+    context |= kContextEnd;
+  }
+
+  if (has_word_boundaries_) {
+    bool left_is_word =
+        (pos > start || (pos > 0 && flags & kMatchPrevAvail)) &&
+        isWordByte(static_cast<unsigned char>(input[pos - 1]));
+    bool right_is_word = pos < input.size() &&
+                         isWordByte(static_cast<unsigned char>(input[pos]));
+    if (left_is_word != right_is_word) {
+      context |= kContextWordBoundary;
+    }
+  }
+  return context;
+}
+
+LinearRegex::FollowRange LinearRegex::computeFollows(uint32_t pc,
+                                                     uint32_t context) {
+  if (++generation_ == 0) {
+    std::fill(marks_.begin(), marks_.end(), 0);
+    generation_ = 1;
+  }
+
+  FollowRange follows;
+  follows.begin = static_cast<uint32_t>(follows_.size());
+
+  // Follow the empty transitions depth first, so that threads are added in
+  // the order a backtracking engine would try them.
+  jobs_.clear();
+  jobs_.push_back({pc, 0});
+  while (!jobs_.empty()) {
+    auto job = jobs_.back();
+    jobs_.pop_back();
+
+    saves_.resize(job.saves);
+    pc = job.pc;
+    while (marks_[pc] != generation_) {
+      // A thread reaching a pc already seen has a lower priority.
+      marks_[pc] = generation_;
+
+      const auto& instruction = program_[pc];
+      bool follow = true;
+      switch (instruction.op) {
+      case Opcode::kJump:
+        pc = instruction.x;
+        break;
+      case Opcode::kSplit:
+        jobs_.push_back({instruction.y, static_cast<uint32_t>(saves_.size())});
+        pc = instruction.x;
+        break;
+      case Opcode::kSave:
+        saves_.push_back(instruction.x);
+        pc++;
+        break;
+      case Opcode::kAssertBegin:
+        follow = (context & kContextBegin) != 0;
+        pc++;
+        break;
+      case Opcode::kAssertEnd:
+        follow = (context & kContextEnd) != 0;
+        pc++;
+        break;
+      case Opcode::kWordBoundary:
+        follow = (context & kContextWordBoundary) != 0;
+        pc++;
+        break;
+      case Opcode::kNotWordBoundary:
+        follow = (context & kContextWordBoundary) == 0;
+        pc++;
+        break;
+      default: {
+        Follow thread;
+        thread.pc = pc;
+        thread.saves_begin = static_cast<uint32_t>(follow_saves_.size());
+        follow_saves_.insert(follow_saves_.end(), saves_.begin(), saves_.end());
+        thread.saves_end = static_cast<uint32_t>(follow_saves_.size());
+        follows_.push_back(thread);
+        follow = false;
+        break;
+      }
+      }
+
+      if (!follow) {
+        break;
+      }
+    }
+  }
+
+  follows.end = static_cast<uint32_t>(follows_.size());
+  return follows;
+}
+
+void LinearRegex::addThread(ThreadList& list,
+                            uint32_t pc,
+                            const size_t* captures,
+                            size_t pos,
+                            uint32_t context) {
+  const auto slots = seed_.size();
+
+  auto& range = follow_ranges_[context * program_.size() + pc];
+  auto follows = range;
+  if (follows.begin == kNotComputed) {
+    follows = computeFollows(pc, context);
+    if (follows_.size() + follow_saves_.size() <= kMaxFollows) {
+      range = follows;
+    }
+  }
+
+  for (auto i = follows.begin; i < follows.end; i++) {
+    const auto& follow = follows_[i];
+    if (list.marks[follow.pc] == list.generation) {
+      continue;
+    }
+    list.marks[follow.pc] = list.generation;
+
+    auto thread_captures = &list.captures[list.size * slots];
+    std::memcpy(thread_captures, captures, slots * sizeof(size_t));
+    for (auto j = follow.saves_begin; j < follow.saves_end; j++) {
+      thread_captures[follow_saves_[j]] = pos;
+    }
+    list.pcs[list.size++] = follow.pc;
+  }
+
+  if (range.begin == kNotComputed && follows.end > follows.begin) {
+    follow_saves_.resize(follows_[follows.begin].saves_begin);
+    follows_.resize(follows.begin);
+  }
+}
+
+bool LinearRegex::search(const std::string& input,
+                         size_t start,
+                         int flags,
+                         Captures& captures) {
+  if (program_.empty() || start > input.size()) {
+    return false;
+  }
+
+  const auto slots = seed_.size();
+  bool matched = false;
+
+  // Matches can only begin at the start when anchored.
+  bool continuous =
+      (flags & kMatchContinuous) || (anchored_ && !(flags & kMatchPrevAvail));
+
+  // The lists are swapped at each position.
+  auto current = &current_;
+  auto next = &next_;
+
+  current->clear();
+  for (auto pos = start;; pos++) {
+    if (current->size == 0 && !matched && !continuous && has_first_bytes_) {
+      // Without any thread, skip to where a match could begin.
+      while (pos < input.size() &&
+             !first_bytes_.test(static_cast<unsigned char>(input[pos]))) {
+        pos++;
+      }
+
+      if (pos == input.size()) {
+        break;
+      }
+
+      // The marks left by the dead threads are for another position.
+      current->clear();
+    }
+
+    // A new thread starts at each position until there is a match, it has
+    // the lowest priority since the match would begin later.
+    if (!matched && (pos == start || !continuous)) {
+      addThread(*current,
+                0,
+                seed_.data(),
+                pos,
+                getContext(input, pos, start, flags));
+    }
+
+    if (current->size == 0 && (matched || continuous)) {
+      break;
+    }
+
+    next->clear();
+    uint32_t next_context = 0;
+    if (pos < input.size()) {
+      next_context = getContext(input, pos + 1, start, flags);
+    }
+
+    for (size_t i = 0; i < current->size; i++) {
+      const auto& instruction = program_[current->pcs[i]];
+      auto thread_captures = &current->captures[i * slots];
+
+      if (instruction.op == Opcode::kMatch) {
+        if ((flags & kMatchNotNull) && thread_captures[0] == pos) {
+          continue;
+        }
+
+        // The threads after this one would give a worse match.
+        matched = true;
+        captures.assign(thread_captures, thread_captures + slots);
+        break;
+      }
+
+      if (pos == input.size()) {
+        continue;
+      }
+
+      auto c = static_cast<unsigned char>(input[pos]);
+      bool consumed = instruction.op == Opcode::kByte
+                          ? c == instruction.byte
+                          : sets_[instruction.x].test(c);
+      if (consumed) {
+        addThread(
+            *next, current->pcs[i] + 1, thread_captures, pos + 1, next_context);
+      }
+    }
+
+    std::swap(current, next);
+    if (pos == input.size()) {
+      break;
+    }
+  }
+
+  return matched;
+}
+} // namespace osquery
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief A regular expression matched in linear time.
+ *
+ * Patterns are compiled to a Thompson NFA which is run as a Pike VM, so a
+ * search takes O(pattern size * input size) time whatever the input.
+ *
+ * The regular subset of the ECMAScript grammar used by std::regex is
+ * supported: literals, '.', classes, '\\d \\w \\s' and their negations,
+ * groups, alternations, greedy and lazy quantifiers, '^', '$' and word
+ * boundaries. Threads are kept in priority order, so a search gives the same
+ * leftmost-first match and groups as std::regex.
+ *
+ * Patterns using other features (backreferences, lookarounds, ...) or
+ * invalid ones are refused by compile; callers are expected to use std::regex
+ * for those, which also reports the errors.
+ *
+ * A compiled regex keeps its matching state, so it must not be used by
+ * more than one thread at a time.
+ */
+class LinearRegex {
+ public:
+  /// Flags of a search, with the meaning of the std::regex_constants ones.
+  enum MatchFlags {
+    /// The match has to begin at the start offset.
+    kMatchContinuous = 1 << 0,
+
+    /// An empty match is not a match.
+    kMatchNotNull = 1 << 1,
+
+    /// The input before the start offset is visible to '^' and '\\b'.
+    kMatchPrevAvail = 1 << 2,
+  };
+
+  /// Offsets of the beginning and end of each group, npos when not matched.
+  using Captures = std::vector<size_t>;
+
+  /// Compile a pattern, fails if it's invalid or not supported.
+  Status compile(const std::string& pattern);
+
+  /**
+   * @brief Search the input for the leftmost match from an offset.
+   *
+   * On success captures holds 2 * (groups() + 1) offsets in the whole input,
+   * the first pair being the span of the match.
+   */
+  bool search(const std::string& input,
+              size_t start,
+              int flags,
+              Captures& captures);
+
+  /// The number of capturing groups.
+  size_t groups() const {
+    return groups_;
+  }
+
+  /// A node of the parsed pattern.
+  struct Node;
+
+ private:
+  enum class Opcode : uint8_t {
+    kByte,
+    kSet,
+    kMatch,
+    kJump,
+    kSplit,
+    kSave,
+    kAssertBegin,
+    kAssertEnd,
+    kWordBoundary,
+    kNotWordBoundary,
+  };
+
+  struct Instruction {
+    Opcode op;
+    unsigned char byte;
+    uint32_t x;
+    uint32_t y;
+  };
+
+  /// The threads alive at an input position, in priority order.
+  struct ThreadList {
+    std::vector<uint32_t> pcs;
+    std::vector<size_t> captures;
+    std::vector<uint32_t> marks;
+    uint32_t generation{0};
+    size_t size{0};
+
+    void clear();
+  };
+
+  /// A pc to follow, with the number of groups saved on the way to it.
+  struct Job {
+    uint32_t pc;
+    uint32_t saves;
+  };
+
+  /// A thread reached from a pc without input, and the groups it saves.
+  struct Follow {
+    uint32_t pc;
+    uint32_t saves_begin;
+    uint32_t saves_end;
+  };
+
+  /// The range of follows of a pc, in priority order.
+  struct FollowRange {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+ private:
+  Status emit(const Node& node);
+  uint32_t append(Opcode op, uint32_t x = 0, uint32_t y = 0);
+
+  /// Visit the instructions reachable from the start without input.
+  template <typename Visitor>
+  void visitStart(bool through_begin, Visitor visitor) const;
+
+  void addThread(ThreadList& list,
+                 uint32_t pc,
+                 const size_t* captures,
+                 size_t pos,
+                 uint32_t context);
+
+  /// Follow the empty transitions from a pc, the assertions being given.
+  FollowRange computeFollows(uint32_t pc, uint32_t context);
+
+  /// The assertions true at an input position.
+  uint32_t getContext(const std::string& input,
+                      size_t pos,
+                      size_t start,
+                      int flags) const;
+
+ private:
+  std::vector<Instruction> program_;
+  std::vector<std::bitset<256>> sets_;
+  size_t groups_{0};
+
+  /// Every match begins at the start of the input.
+  bool anchored_{false};
+
+  /// The bytes a match can begin with, if it can't be empty.
+  bool has_first_bytes_{false};
+  std::bitset<256> first_bytes_;
+
+  bool has_word_boundaries_{false};
+
+  /// The follows are computed once per pc and context, when first needed.
+  std::vector<FollowRange> follow_ranges_;
+  std::vector<Follow> follows_;
+  std::vector<uint32_t> follow_saves_;
+
+  ThreadList current_;
+  ThreadList next_;
+  std::vector<Job> jobs_;
+  std::vector<uint32_t> marks_;
+  uint32_t generation_{0};
+  std::vector<uint32_t> saves_;
+  Captures seed_;
+};
+} // namespace osquery
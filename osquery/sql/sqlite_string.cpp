@@ -16,12 +16,14 @@
 #endif
 
 #include <functional>
+#include <memory>
 #include <regex>
 #include <string>
 #include <vector>
 
 #include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/linear_regex.h>
 #include <osquery/utils/conversions/split.h>
 
 #include <sqlite3.h>
@@ -35,10 +37,171 @@ HIDDEN_FLAG(
     "Defines the maximum size in bytes of a regex that can be used with the "
     "regex_match and regex_split functions");
 
+HIDDEN_FLAG(bool,
+            regex_linear_engine,
+            true,
+            "Match the regex_match and regex_split patterns with a linear-time "
+            "engine when it supports them, instead of std::regex");
+
 using SplitResult = std::vector<std::string>;
 using StringSplitFunction = std::function<SplitResult(
     const std::string& input, const std::string& tokens)>;
 
+/**
+ * @brief A regex pattern compiled for the regex functions.
+ *
+ * The linear-time engine is used for the patterns it supports; std::regex,
+ * which backtracks, is only used for the others and gives the same results.
+ */
+class CompiledRegex {
+ public:
+  /// Throws std::regex_error if the pattern is invalid.
+  explicit CompiledRegex(const std::string& pattern) : pattern_(pattern) {
+    if (FLAGS_regex_linear_engine && linear_regex_.compile(pattern).ok()) {
+      use_linear_regex_ = true;
+      return;
+    }
+
+    regex_ = std::regex(pattern);
+  }
+
+  const std::string& pattern() const {
+    return pattern_;
+  }
+
+  /// Search for the first match, and get one of its groups.
+  bool search(const std::string& input, size_t index, std::string& group);
+
+  /// Split the input around the matches, as std::sregex_token_iterator does.
+  SplitResult split(const std::string& input);
+
+ private:
+  std::string pattern_;
+  bool use_linear_regex_{false};
+  LinearRegex linear_regex_;
+  LinearRegex::Captures captures_;
+  std::regex regex_;
+};
+
+bool CompiledRegex::search(const std::string& input,
+                           size_t index,
+                           std::string& group) {
+  if (!use_linear_regex_) {
+    std::smatch results;
+    if (!std::regex_search(input, results, regex_) ||
+        index >= results.size()) {
+      return false;
+    }
+
+    group = results[index].str();
+    return true;
+  }
+
+  if (index > linear_regex_.groups() ||
+      !linear_regex_.search(input, 0, 0, captures_)) {
+    return false;
+  }
+
+  // A group which did not participate in the match is empty.
+  auto begin = captures_[2 * index];
+  auto end = captures_[2 * index + 1];
+  group = begin == std::string::npos ? "" : input.substr(begin, end - begin);
+  return true;
+}
+
+SplitResult CompiledRegex::split(const std::string& input) {
+  SplitResult result;
+
+  if (!use_linear_regex_) {
+    std::sregex_token_iterator iter_begin(
+        input.begin(), input.end(), regex_, -1);
+    std::sregex_token_iterator iter_end;
+    std::copy(iter_begin, iter_end, std::back_inserter(result));
+    return result;
+  }
+
+  // Follow std::regex_iterator: after an empty match, first look for a
+  // non-empty one at the same position, then search from the next one.
+  size_t prefix = 0;
+  bool found = linear_regex_.search(input, 0, 0, captures_);
+  if (!found) {
+    result.push_back(input);
+    return result;
+  }
+
+  int flags = 0;
+  while (found) {
+    result.push_back(input.substr(prefix, captures_[0] - prefix));
+    prefix = captures_[1];
+
+    if (captures_[0] != captures_[1]) {
+      found = linear_regex_.search(
+          input, prefix, LinearRegex::kMatchPrevAvail, captures_);
+    } else if (prefix == input.size()) {
+      found = false;
+    } else {
+      found = linear_regex_.search(input,
+                                   prefix,
+                                   flags | LinearRegex::kMatchNotNull |
+                                       LinearRegex::kMatchContinuous,
+                                   captures_) ||
+              linear_regex_.search(
+                  input, prefix + 1, LinearRegex::kMatchPrevAvail, captures_);
+    }
+    flags = LinearRegex::kMatchPrevAvail;
+  }
+
+  // A trailing empty token is not part of the result.
+  if (prefix != input.size()) {
+    result.push_back(input.substr(prefix));
+  }
+  return result;
+}
+
+static void deleteCompiledRegex(void* regex) {
+  delete static_cast<CompiledRegex*>(regex);
+}
+
+/**
+ * @brief The compiled regex of a pattern argument.
+ *
+ * SQLite keeps the regex as the auxiliary data of the argument for as long
+ * as the argument is the same constant, so a pattern is compiled once per
+ * statement instead of once per row.
+ *
+ * SQLite may destroy the auxiliary data as soon as it's set, so a new regex
+ * is only handed to it when this goes out of scope.
+ */
+class StatementRegex {
+ public:
+  StatementRegex(sqlite3_context* context, int argument)
+      : context_(context), argument_(argument) {}
+
+  ~StatementRegex() {
+    if (compiled_ != nullptr) {
+      sqlite3_set_auxdata(
+          context_, argument_, compiled_.release(), deleteCompiledRegex);
+    }
+  }
+
+  /// Throws std::regex_error if the pattern is invalid.
+  CompiledRegex& get(const std::string& pattern) {
+    auto cached = static_cast<CompiledRegex*>(
+        sqlite3_get_auxdata(context_, argument_));
+    if (cached != nullptr && cached->pattern() == pattern) {
+      return *cached;
+    }
+
+    compiled_ = std::make_unique<CompiledRegex>(pattern);
+    return *compiled_;
+  }
+
+ private:
+  sqlite3_context* context_;
+  int argument_;
+  std::unique_ptr<CompiledRegex> compiled_;
+};
+
 /**
  * @brief A simple SQLite column string split implementation.
  *
@@ -74,22 +237,15 @@ static SplitResult tokenSplit(const std::string& input,
  *      192.168
  */
 static SplitResult regexSplit(const std::string& input,
-                              const std::string& token) {
+                              const std::string& token,
+                              StatementRegex& regex) {
   // Split using the token as a regex to support multi-character tokens.
   // Exceptions are caught by the caller, as that's where the sql context is
-  std::vector<std::string> result;
-
   if (token.size() > FLAGS_regex_max_size) {
     throw std::regex_error(std::regex_constants::error_complexity);
   }
 
-  std::regex pattern = std::regex(token);
-  std::sregex_token_iterator iter_begin(
-      input.begin(), input.end(), pattern, -1);
-  std::sregex_token_iterator iter_end;
-  std::copy(iter_begin, iter_end, std::back_inserter(result));
-
-  return result;
+  return regex.get(token).split(input);
 }
 
 static void callStringSplitFunc(sqlite3_context* context,
@@ -139,8 +295,15 @@ static void tokenStringSplitFunc(sqlite3_context* context,
 static void regexStringSplitFunc(sqlite3_context* context,
                                  int argc,
                                  sqlite3_value** argv) {
+  StatementRegex regex(context, 1);
   try {
-    callStringSplitFunc(context, argc, argv, regexSplit);
+    callStringSplitFunc(
+        context,
+        argc,
+        argv,
+        [&regex](const std::string& input, const std::string& token) {
+          return regexSplit(input, token, regex);
+        });
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -173,9 +336,9 @@ static void regexStringMatchFunc(sqlite3_context* context,
   // parse and verify input parameters
   const std::string input(
       reinterpret_cast<const char*>(sqlite3_value_text(argv[0])));
-  std::smatch results;
   auto index = static_cast<size_t>(sqlite3_value_int(argv[2]));
   bool isMatchFound = false;
+  std::string result;
 
   if (strnlen(regex, FLAGS_regex_max_size) == FLAGS_regex_max_size &&
       regex[FLAGS_regex_max_size] != '\0') {
@@ -186,8 +349,9 @@ static void regexStringMatchFunc(sqlite3_context* context,
     return;
   }
 
+  StatementRegex compiled_regex(context, 1);
   try {
-    isMatchFound = std::regex_search(input, results, std::regex(regex));
+    isMatchFound = compiled_regex.get(regex).search(input, index, result);
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -199,14 +363,9 @@ static void regexStringMatchFunc(sqlite3_context* context,
     return;
   }
 
-  if (index >= results.size()) {
-    sqlite3_result_null(context);
-    return;
-  }
-
   sqlite3_result_text(context,
-                      results[index].str().c_str(),
-                      static_cast<int>(results[index].str().size()),
+                      result.c_str(),
+                      static_cast<int>(result.size()),
                       SQLITE_TRANSIENT);
 }
 
@@ -39,6 +39,16 @@ FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     sql_instance_pool_size,
+     4,
+     "Number of attached SQLite databases kept for concurrent queries");
+
+FLAG(uint64,
+     sql_statement_cache_size,
+     512,
+     "Number of prepared statements kept for each SQLite database");
+
 using OpReg = QueryPlanner::Opcode::Register;
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
@@ -284,7 +294,11 @@ Status SQLiteSQLPlugin::attach(const std::string& name) {
   auto dbc = SQLiteDBManager::getConnection(true);
 
   // Attach as an extension, allowing read/write tables
-  return attachTableInternal(name, statement, dbc, is_extension);
+  status = attachTableInternal(name, statement, dbc, is_extension);
+
+  // Pooled transient instances were attached without this table.
+  SQLiteDBManager::resetPool();
+  return status;
 }
 
 Status SQLiteSQLPlugin::detach(const std::string& name) {
@@ -292,7 +306,9 @@ Status SQLiteSQLPlugin::detach(const std::string& name) {
   // primary database. To allow this, getConnection can explicitly request the
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
-  return detachTableInternal(name, dbc);
+  auto status = detachTableInternal(name, dbc);
+  SQLiteDBManager::resetPool();
+  return status;
 }
 
 SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
@@ -300,12 +316,111 @@ SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
   if (lock_.owns_lock()) {
     primary_ = true;
   } else {
+    // The manager provides a transient instance instead.
     db_ = nullptr;
-    VLOG(1) << "DBManager contention: opening transient SQLite database";
-    init();
   }
 }
 
+/// The collector of the statement executing on this thread.
+static thread_local PlannedIndexCollector* kPlannedIndexCollector{nullptr};
+
+PlannedIndexCollector::PlannedIndexCollector(
+    std::vector<PlannedIndex>& indexes)
+    : indexes_(indexes), previous_(kPlannedIndexCollector) {
+  kPlannedIndexCollector = this;
+}
+
+PlannedIndexCollector::~PlannedIndexCollector() {
+  kPlannedIndexCollector = previous_;
+}
+
+void PlannedIndexCollector::record(
+    const std::shared_ptr<VirtualTableContent>& content, size_t index) {
+  if (kPlannedIndexCollector == nullptr) {
+    return;
+  }
+
+  content->retained.insert(index);
+  kPlannedIndexCollector->indexes_.emplace_back(content, index);
+}
+
+void PlannedIndexCollector::release(const std::vector<PlannedIndex>& indexes) {
+  for (const auto& index : indexes) {
+    auto content = index.first.lock();
+    if (content == nullptr) {
+      // The table was detached or its database closed.
+      continue;
+    }
+
+    content->retained.erase(index.second);
+    content->constraints.erase(index.second);
+    content->colsUsed.erase(index.second);
+    content->colsUsedBitsets.erase(index.second);
+  }
+}
+
+/// Finalize a statement that is not cached and release its constraint sets.
+static void finalizeStatement(sqlite3_stmt* stmt,
+                              const std::vector<PlannedIndex>& indexes) {
+  sqlite3_finalize(stmt);
+  PlannedIndexCollector::release(indexes);
+}
+
+SQLiteStatementCache::~SQLiteStatementCache() {
+  clear();
+}
+
+sqlite3_stmt* SQLiteStatementCache::take(const std::string& sql,
+                                         size_t& tail,
+                                         std::vector<PlannedIndex>& indexes) {
+  WriteLock lock(mutex_);
+  auto it = index_.find(sql);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+
+  auto stmt = it->second->stmt;
+  tail = it->second->tail;
+  indexes = std::move(it->second->indexes);
+  statements_.erase(it->second);
+  index_.erase(it);
+  return stmt;
+}
+
+void SQLiteStatementCache::put(const std::string& sql,
+                               size_t tail,
+                               sqlite3_stmt* stmt,
+                               std::vector<PlannedIndex> indexes) {
+  WriteLock lock(mutex_);
+  if (FLAGS_sql_statement_cache_size == 0 || index_.count(sql) > 0) {
+    // A nested query with the same text returned its statement first.
+    finalizeStatement(stmt, indexes);
+    return;
+  }
+
+  statements_.push_front({sql, tail, stmt, std::move(indexes)});
+  index_[sql] = statements_.begin();
+  while (statements_.size() > FLAGS_sql_statement_cache_size) {
+    index_.erase(statements_.back().sql);
+    finalizeStatement(statements_.back().stmt, statements_.back().indexes);
+    statements_.pop_back();
+  }
+}
+
+void SQLiteStatementCache::clear() {
+  WriteLock lock(mutex_);
+  for (const auto& statement : statements_) {
+    finalizeStatement(statement.stmt, statement.indexes);
+  }
+  statements_.clear();
+  index_.clear();
+}
+
+size_t SQLiteStatementCache::size() const {
+  WriteLock lock(mutex_);
+  return statements_.size();
+}
+
 // This function is called by SQLite when a statement is prepared and we use
 // it to allowlist specific actions.
 int sqliteAuthorizer(void* userData,
@@ -405,6 +520,19 @@ TableAttributes SQLiteDBInstance::getAttributes() const {
   return attributes;
 }
 
+/// Erase the per-query state of constraint sets not kept by a statement.
+template <typename T>
+static void clearUnretained(const std::unordered_set<size_t>& retained,
+                            std::unordered_map<size_t, T>& state) {
+  for (auto it = state.begin(); it != state.end();) {
+    if (retained.count(it->first) == 0) {
+      it = state.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 void SQLiteDBInstance::clearAffectedTables() {
   if (isPrimary() && !managed_) {
     // A primary instance must forward clear requests to the DB manager's
@@ -414,10 +542,19 @@ void SQLiteDBInstance::clearAffectedTables() {
   }
 
   for (const auto& table : affected_tables_) {
-    table.second->constraints.clear();
-    table.second->cache.clear();
-    table.second->colsUsed.clear();
-    table.second->colsUsedBitsets.clear();
+    auto& content = *table.second;
+    content.cache.clear();
+    if (content.retained.empty()) {
+      content.constraints.clear();
+      content.colsUsed.clear();
+      content.colsUsedBitsets.clear();
+      continue;
+    }
+
+    // Cached statements are not planned again, keep their constraint sets.
+    clearUnretained(content.retained, content.constraints);
+    clearUnretained(content.retained, content.colsUsed);
+    clearUnretained(content.retained, content.colsUsedBitsets);
   }
   // Since the affected tables are cleared, there are no more affected tables.
   // There is no concept of compounding tables between queries.
@@ -427,6 +564,8 @@ void SQLiteDBInstance::clearAffectedTables() {
 
 SQLiteDBInstance::~SQLiteDBInstance() {
   if (!isPrimary() && db_ != nullptr) {
+    // Statements must be finalized before the database is closed.
+    statements_->clear();
     sqlite3_close(db_);
   } else {
     db_ = nullptr;
@@ -479,7 +618,11 @@ void SQLiteDBManager::resetPrimary() {
   auto& self = instance();
 
   WriteLock connection_lock(self.mutex_);
+  if (self.connection_ != nullptr) {
+    self.connection_->statements().clear();
+  }
   self.connection_.reset();
+  resetPool();
 
   {
     WriteLock create_lock(self.create_mutex_);
@@ -525,13 +668,71 @@ SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
   // Create a 'database connection' for the managed database instance.
   auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
   if (!instance->isPrimary()) {
-    attachVirtualTables(instance);
+    return getPooled();
   }
 
+  instance->statements_ = self.connection_->statements_;
   return instance;
 }
 
+SQLiteDBInstanceRef SQLiteDBManager::getPooled() {
+  auto& self = instance();
+
+  SQLiteDBInstanceRef pooled;
+  size_t generation = 0;
+  {
+    WriteLock lock(self.pool_mutex_);
+    generation = self.generation_;
+    if (!self.pool_.empty()) {
+      pooled = std::move(self.pool_.back());
+      self.pool_.pop_back();
+    }
+  }
+
+  if (pooled == nullptr) {
+    VLOG(1) << "DBManager contention: opening transient SQLite database";
+    pooled = std::make_shared<SQLiteDBInstance>();
+    pooled->generation_ = generation;
+    attachVirtualTables(pooled);
+  }
+
+  // The borrowed reference returns the instance to the pool when released.
+  return SQLiteDBInstanceRef(pooled.get(),
+                             [pooled](SQLiteDBInstance*) { release(pooled); });
+}
+
+void SQLiteDBManager::release(SQLiteDBInstanceRef dbc) {
+  auto& self = instance();
+  dbc->clearAffectedTables();
+
+  WriteLock lock(self.pool_mutex_);
+  if (dbc->generation_ == self.generation_ &&
+      self.pool_.size() < FLAGS_sql_instance_pool_size) {
+    self.pool_.push_back(std::move(dbc));
+    return;
+  }
+
+  // Close the stale or surplus instance without holding the pool lock.
+  lock.unlock();
+  dbc.reset();
+}
+
+void SQLiteDBManager::resetPool() {
+  auto& self = instance();
+
+  std::vector<SQLiteDBInstanceRef> pool;
+  {
+    WriteLock lock(self.pool_mutex_);
+    self.generation_++;
+    pool.swap(self.pool_);
+  }
+}
+
 SQLiteDBManager::~SQLiteDBManager() {
+  pool_.clear();
+  if (connection_ != nullptr) {
+    connection_->statements().clear();
+  }
   connection_ = nullptr;
   if (db_ != nullptr) {
     sqlite3_close(db_);
@@ -678,13 +879,6 @@ Status readRows(sqlite3_stmt* prepared_statement,
     } while (SQLITE_ROW == rc);
   }
   if (rc != SQLITE_DONE) {
-    auto s = Status::failure(sqlite3_errmsg(instance->db()));
-    sqlite3_finalize(prepared_statement);
-    return s;
-  }
-
-  rc = sqlite3_finalize(prepared_statement);
-  if (rc != SQLITE_OK) {
     return Status::failure(sqlite3_errmsg(instance->db()));
   }
 
@@ -699,6 +893,7 @@ Status queryInternal(const std::string& query,
   int rc = SQLITE_OK; /* Return Code */
   const char* leftover_sql = nullptr; /* Tail of unprocessed SQL */
   const char* sql = query.c_str(); /* SQL to be processed */
+  auto& statements = instance->statements();
 
   /* The big while loop.  One iteration per statement */
   while ((sql[0] != '\0') && (SQLITE_OK == rc)) {
@@ -708,19 +903,50 @@ Status queryInternal(const std::string& query,
     while (isspace(sql[0])) {
       sql++;
     }
-    rc = sqlite3_prepare_v2(
-        instance->db(), sql, -1, &prepared_statement, &leftover_sql);
-    if (rc != SQLITE_OK) {
-      Status s = Status::failure(sqlite3_errmsg(instance->db()));
-      sqlite3_finalize(prepared_statement);
-      return s;
+
+    // Repeated queries reuse the statement prepared from the same text.
+    std::string statement_sql(sql);
+    size_t tail = 0;
+    std::vector<PlannedIndex> indexes;
+    prepared_statement = statements.take(statement_sql, tail, indexes);
+
+    Status s;
+    {
+      // SQLite may also plan the statement again while stepping it.
+      PlannedIndexCollector collector(indexes);
+      if (prepared_statement != nullptr) {
+        leftover_sql = sql + tail;
+      } else {
+        rc = sqlite3_prepare_v3(instance->db(),
+                                sql,
+                                -1,
+                                SQLITE_PREPARE_PERSISTENT,
+                                &prepared_statement,
+                                &leftover_sql);
+        if (rc != SQLITE_OK) {
+          s = Status::failure(sqlite3_errmsg(instance->db()));
+        }
+      }
+
+      if (s.ok()) {
+        s = readRows(prepared_statement, results, instance);
+      }
     }
 
-    Status s = readRows(prepared_statement, results, instance);
     if (!s.ok()) {
+      finalizeStatement(prepared_statement, indexes);
       return s;
     }
 
+    // Do not cache a null prepared_statement (eg, if the sql was whitespace)
+    if (prepared_statement != nullptr) {
+      sqlite3_reset(prepared_statement);
+      statements.put(statement_sql,
+                     static_cast<size_t>(leftover_sql - sql),
+                     prepared_statement,
+                     std::move(indexes));
+    }
+
     sql = leftover_sql;
   } /* end while */
   sqlite3_db_release_memory(instance->db());
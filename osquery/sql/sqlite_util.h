@@ -10,9 +10,14 @@
 #pragma once
 
 #include <atomic>
+#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <sqlite3.h>
 
@@ -86,6 +91,93 @@ const std::unordered_set<std::string> kAllowedSQLitePragmas = {
 
 class SQLiteDBManager;
 
+/// A constraint set index planned by a virtual table's xBestIndex.
+using PlannedIndex = std::pair<std::weak_ptr<VirtualTableContent>, size_t>;
+
+/**
+ * @brief Collect the constraint sets planned while a statement executes.
+ *
+ * SQLite plans a statement once, a reset statement is stepped again without
+ * calling xBestIndex. While a collector is active on a thread, xBestIndex
+ * records its constraint sets there and the tables retain them across
+ * queries. They are released when the statement is finalized.
+ */
+class PlannedIndexCollector : private boost::noncopyable {
+ public:
+  explicit PlannedIndexCollector(std::vector<PlannedIndex>& indexes);
+  ~PlannedIndexCollector();
+
+  /// Record a constraint set with the thread's active collector, if any.
+  static void record(const std::shared_ptr<VirtualTableContent>& content,
+                     size_t index);
+
+  /// Drop the retained constraint sets of a finalized statement.
+  static void release(const std::vector<PlannedIndex>& indexes);
+
+ private:
+  std::vector<PlannedIndex>& indexes_;
+
+  /// The collector of an enclosing statement on the same thread.
+  PlannedIndexCollector* previous_{nullptr};
+};
+
+/**
+ * @brief A least-recently-used cache of prepared statements for a database.
+ *
+ * Scheduled queries repeat the same SQL text for the life of the process, the
+ * cache keeps their prepared statements so a repeated query is only reset and
+ * stepped again. Statements are keyed by the SQL text they were prepared from.
+ *
+ * A statement is taken out of the cache while it executes and put back once it
+ * is reset. A nested query with the same text prepares its own statement.
+ */
+class SQLiteStatementCache : private boost::noncopyable {
+ public:
+  SQLiteStatementCache() = default;
+  ~SQLiteStatementCache();
+
+  /**
+   * @brief Take the statement prepared from the start of a SQL text.
+   *
+   * @param sql the SQL text a statement was prepared from.
+   * @param tail [output] the length of SQL text the statement consumed.
+   * @param indexes [output] the constraint sets planned for the statement.
+   * @return the prepared statement or nullptr if none is cached.
+   */
+  sqlite3_stmt* take(const std::string& sql,
+                     size_t& tail,
+                     std::vector<PlannedIndex>& indexes);
+
+  /// Put a reset statement back, the least recently used may be finalized.
+  void put(const std::string& sql,
+           size_t tail,
+           sqlite3_stmt* stmt,
+           std::vector<PlannedIndex> indexes);
+
+  /// Finalize every cached statement.
+  void clear();
+
+  /// The number of cached statements.
+  size_t size() const;
+
+ private:
+  /// A cached statement and the length of SQL text it consumed.
+  struct Statement {
+    std::string sql;
+    size_t tail{0};
+    sqlite3_stmt* stmt{nullptr};
+    std::vector<PlannedIndex> indexes;
+  };
+
+  /// Cached statements, the most recently used first.
+  std::list<Statement> statements_;
+
+  /// Statements by the SQL text they were prepared from.
+  std::unordered_map<std::string, std::list<Statement>::iterator> index_;
+
+  mutable Mutex mutex_;
+};
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -95,7 +187,8 @@ class SQLiteDBManager;
  *
  * If there is resource contention (multiple threads want access to the SQLite
  * abstraction layer), then the SQLiteDBManager will provide a transient
- * SQLiteDBInstance.
+ * SQLiteDBInstance. Transient instances are pooled by the manager and reused
+ * by later contending requests.
  */
 class SQLiteDBInstance : private boost::noncopyable {
  public:
@@ -139,6 +232,11 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Lock the database for attaching virtual tables.
   RecursiveLock attachLock() const;
 
+  /// The prepared statements kept for this instance's database.
+  SQLiteStatementCache& statements() const {
+    return *statements_;
+  }
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
@@ -184,6 +282,18 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, std::shared_ptr<VirtualTableContent>> affected_tables_;
 
+  /**
+   * @brief Prepared statements for the database.
+   *
+   * Instances with access to the primary database share the cache of the
+   * manager's 'connection' instance.
+   */
+  std::shared_ptr<SQLiteStatementCache> statements_{
+      std::make_shared<SQLiteStatementCache>()};
+
+  /// The manager's attach generation when a pooled instance was attached.
+  size_t generation_{0};
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
@@ -274,6 +384,15 @@ class SQLiteDBManager : private boost::noncopyable {
   /// A write mutex for initializing the primary database.
   Mutex create_mutex_;
 
+  /// Idle transient instances with every virtual table attached.
+  std::vector<SQLiteDBInstanceRef> pool_;
+
+  /// Incremented when tables are attached or detached, pooled tables go stale.
+  size_t generation_{0};
+
+  /// Mutex protecting the pool and its generation.
+  Mutex pool_mutex_;
+
   /// Member variable to hold set of disabled tables.
   std::unordered_set<std::string> disabled_tables_;
 
@@ -289,6 +408,15 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /// Borrow a pooled transient instance, or attach a new one.
+  static SQLiteDBInstanceRef getPooled();
+
+  /// Return a borrowed transient instance to the pool.
+  static void release(SQLiteDBInstanceRef dbc);
+
+  /// Release the pooled instances, borrowed instances are not returned.
+  static void resetPool();
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
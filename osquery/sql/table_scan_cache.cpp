@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_scan_cache.h"
+
+namespace osquery {
+
+namespace {
+
+/// Check if a context reads only columns generated by a cached scan.
+inline bool scanCovers(const UsedColumnsBitset& scan,
+                       const QueryContext& context) {
+  if (!context.colsUsedBitset) {
+    return scan.all();
+  }
+  return (*context.colsUsedBitset & ~scan).none();
+}
+
+/// Check if a context constrains any column of the scanned table.
+inline bool hasConstraints(const QueryContext& context) {
+  for (const auto& column : context.constraints) {
+    if (!column.second.getAll().empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+TableScanCache& TableScanCache::get() {
+  static TableScanCache instance;
+  return instance;
+}
+
+void TableScanCache::begin(std::set<std::string> tables) {
+  WriteLock lock(mutex_);
+  tables_ = std::move(tables);
+  scans_.clear();
+  step_ = TableScanCacheStats();
+}
+
+TableScanCacheStats TableScanCache::end() {
+  WriteLock lock(mutex_);
+  tables_.clear();
+  scans_.clear();
+  auto step = step_;
+  step_ = TableScanCacheStats();
+  return step;
+}
+
+bool TableScanCache::enabled(const std::string& table,
+                             const QueryContext& context) const {
+  if (hasConstraints(context)) {
+    return false;
+  }
+
+  ReadLock lock(mutex_);
+  return tables_.count(table) > 0;
+}
+
+bool TableScanCache::lookup(const std::string& table,
+                            const QueryContext& context,
+                            TableRows& rows) {
+  if (hasConstraints(context)) {
+    return false;
+  }
+
+  WriteLock lock(mutex_);
+  auto scans = scans_.find(table);
+  if (scans != scans_.end()) {
+    for (const auto& scan : scans->second) {
+      if (!scanCovers(scan.columns, context)) {
+        continue;
+      }
+
+      rows.reserve(scan.rows.size());
+      for (const auto& row : scan.rows) {
+        rows.push_back(row->clone());
+      }
+      step_.hits++;
+      total_.hits++;
+      return true;
+    }
+  }
+
+  step_.misses++;
+  total_.misses++;
+  return false;
+}
+
+void TableScanCache::store(const std::string& table,
+                           const QueryContext& context,
+                           const TableRows& rows) {
+  if (hasConstraints(context)) {
+    return;
+  }
+
+  Scan scan;
+  if (context.colsUsedBitset) {
+    scan.columns = *context.colsUsedBitset;
+  } else {
+    scan.columns.set();
+  }
+  scan.rows.reserve(rows.size());
+  for (const auto& row : rows) {
+    scan.rows.push_back(row->clone());
+  }
+
+  WriteLock lock(mutex_);
+  if (tables_.count(table) == 0) {
+    // The step ended while the table was generated.
+    return;
+  }
+  scans_[table].push_back(std::move(scan));
+}
+
+uint64_t TableScanCache::hits() const {
+  ReadLock lock(mutex_);
+  return total_.hits;
+}
+
+uint64_t TableScanCache::misses() const {
+  ReadLock lock(mutex_);
+  return total_.misses;
+}
+
+} // namespace osquery
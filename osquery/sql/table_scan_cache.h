@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/table_rows.h>
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/// Scan cache lookups counted during a schedule step.
+struct TableScanCacheStats {
+  uint64_t hits{0};
+  uint64_t misses{0};
+};
+
+/**
+ * @brief An in-memory cache of table scans shared by queries in one step.
+ *
+ * Several scheduled queries executing in the same schedule step often read
+ * the same tables. The scheduler opens the cache for a step with the tables
+ * read by more than one due query, the virtual table filter then reuses the
+ * rows generated by the first scan for later scans of that table.
+ *
+ * Only unconstrained scans are cached. A constrained scan is often the inner
+ * loop of a join, repeated with a different constraint for each outer row,
+ * caching it would clone every row it generates for little reuse. A cached
+ * scan answers a later scan if it generated every column the later scan
+ * uses. Rows are cloned out of the cache, nothing is serialized.
+ *
+ * Scans are only cached for queries that requested the warm query cache, the
+ * cache is emptied when the step ends.
+ */
+class TableScanCache : private boost::noncopyable {
+ public:
+  /// Access the process-wide scan cache.
+  static TableScanCache& get();
+
+  /// Start caching scans of the given tables.
+  void begin(std::set<std::string> tables);
+
+  /// Stop caching, release the cached scans and return the step's counters.
+  TableScanCacheStats end();
+
+  /// Check if a table scan with the given context is cached in this step.
+  bool enabled(const std::string& table, const QueryContext& context) const;
+
+  /**
+   * @brief Look up a cached scan of a table for a query context.
+   *
+   * @param table the table name.
+   * @param context the context the table would be generated with.
+   * @param rows [output] clones of the cached rows.
+   *
+   * @return true if a cached scan answered the lookup.
+   */
+  bool lookup(const std::string& table,
+              const QueryContext& context,
+              TableRows& rows);
+
+  /// Save the rows of an unconstrained scan of a table.
+  void store(const std::string& table,
+             const QueryContext& context,
+             const TableRows& rows);
+
+  /// Total lookups answered by the cache since the process started.
+  uint64_t hits() const;
+
+  /// Total lookups not answered by the cache since the process started.
+  uint64_t misses() const;
+
+ private:
+  TableScanCache() = default;
+
+  /// The rows generated by a table scan and the columns it generated.
+  struct Scan {
+    UsedColumnsBitset columns;
+    TableRows rows;
+  };
+
+ private:
+  /// Tables cached in the current step, empty if no step is open.
+  std::set<std::string> tables_;
+
+  /// Cached scans by table name.
+  std::unordered_map<std::string, std::vector<Scan>> scans_;
+
+  /// Counters for the current step.
+  TableScanCacheStats step_;
+
+  /// Counters since the process started.
+  TableScanCacheStats total_;
+
+  mutable Mutex mutex_;
+};
+
+} // namespace osquery
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <osquery/sql/linear_regex.h>
+
+namespace osquery {
+class LinearRegexTests : public testing::Test {
+ public:
+  /// Compare the groups of the first match with the ones of std::regex.
+  void expectSameSearch(const std::string& pattern, const std::string& input) {
+    LinearRegex regex;
+    auto status = regex.compile(pattern);
+    ASSERT_TRUE(status.ok()) << pattern << ": " << status.getMessage();
+
+    std::smatch expected;
+    bool expected_found =
+        std::regex_search(input, expected, std::regex(pattern));
+
+    LinearRegex::Captures captures;
+    bool found = regex.search(input, 0, 0, captures);
+    ASSERT_EQ(found, expected_found) << pattern << " on " << input;
+
+    if (!found) {
+      return;
+    }
+
+    ASSERT_EQ(captures.size(), 2 * expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      if (!expected[i].matched) {
+        EXPECT_EQ(captures[2 * i], std::string::npos)
+            << pattern << " on " << input << ", group " << i;
+        continue;
+      }
+
+      EXPECT_EQ(captures[2 * i], static_cast<size_t>(expected.position(i)))
+          << pattern << " on " << input << ", group " << i;
+      EXPECT_EQ(captures[2 * i + 1] - captures[2 * i],
+                static_cast<size_t>(expected.length(i)))
+          << pattern << " on " << input << ", group " << i;
+    }
+  }
+};
+
+TEST_F(LinearRegexTests, test_same_matches_as_std_regex) {
+  const std::vector<std::string> patterns = {
+      "",
+      "|",
+      "hello",
+      "(l)(o).*",
+      "(\\w+) .*(or|ld)",
+      ".+/([^./]+)",
+      "(;|/)+",
+      "^/usr/(local/)?bin/[a-z]+$",
+      "a*?b",
+      "(a|ab)(c|bcd)(d*)",
+      "(a+)+?b",
+      "x{2,3}",
+      "x{2,}?",
+      "(?:ab){2}",
+      "\\bworld\\b",
+      "\\Bor",
+      "[\\d.]+",
+      "[^\\s]+$",
+      "[a-c-]+",
+      "\\.\\*\\\\",
+      "(a)|b",
+  };
+
+  const std::vector<std::string> inputs = {
+      "",
+      "hello world",
+      "/usr/local/bin/osqueryd",
+      "/usr/bin/osqueryi",
+      "/filesystem/path/download.extension.zip",
+      "foo;bar//qux",
+      "aaab abcd xxxx",
+      "version 1.2.3 .*\\",
+      "b-c-a",
+  };
+
+  for (const auto& pattern : patterns) {
+    for (const auto& input : inputs) {
+      expectSameSearch(pattern, input);
+    }
+  }
+}
+
+TEST_F(LinearRegexTests, test_search_flags) {
+  LinearRegex regex;
+  ASSERT_TRUE(regex.compile("^a*").ok());
+
+  LinearRegex::Captures captures;
+  ASSERT_TRUE(regex.search("baa", 1, 0, captures));
+  EXPECT_EQ(captures[0], 1U);
+  EXPECT_EQ(captures[1], 3U);
+
+  // The start is not the beginning of the input anymore.
+  EXPECT_FALSE(
+      regex.search("baa", 1, LinearRegex::kMatchPrevAvail, captures));
+
+  ASSERT_TRUE(regex.search("baa", 0, 0, captures));
+  EXPECT_EQ(captures[1], 0U);
+  EXPECT_FALSE(regex.search("baa", 0, LinearRegex::kMatchNotNull, captures));
+
+  ASSERT_TRUE(regex.compile("a").ok());
+  EXPECT_FALSE(
+      regex.search("baa", 0, LinearRegex::kMatchContinuous, captures));
+  ASSERT_TRUE(regex.search("baa", 2, LinearRegex::kMatchContinuous, captures));
+  EXPECT_EQ(captures[0], 2U);
+}
+
+TEST_F(LinearRegexTests, test_unsupported_patterns) {
+  LinearRegex regex;
+
+  // Invalid patterns.
+  EXPECT_FALSE(regex.compile("(/").ok());
+  EXPECT_FALSE(regex.compile("+").ok());
+  EXPECT_FALSE(regex.compile("a)").ok());
+  EXPECT_FALSE(regex.compile("[z-a]").ok());
+  EXPECT_FALSE(regex.compile("a{3,2}").ok());
+
+  // Valid, but left to std::regex.
+  EXPECT_FALSE(regex.compile("(a)\\1").ok());
+  EXPECT_FALSE(regex.compile("a(?=b)").ok());
+  EXPECT_FALSE(regex.compile("[[:alpha:]]").ok());
+  EXPECT_FALSE(regex.compile("\\x41").ok());
+  EXPECT_FALSE(regex.compile("(a*)*").ok());
+  EXPECT_FALSE(regex.compile("(?:a{1000}){1000}").ok());
+  EXPECT_FALSE(regex.compile("\xc3\xa9").ok());
+}
+
+TEST_F(LinearRegexTests, test_linear_time) {
+  // This makes a backtracking engine try an exponential number of paths.
+  LinearRegex regex;
+  ASSERT_TRUE(regex.compile("(a|aa)+$").ok());
+
+  std::string input(100000, 'a');
+  input += "b";
+
+  LinearRegex::Captures captures;
+  EXPECT_FALSE(regex.search(input, 0, 0, captures));
+
+  input.pop_back();
+  ASSERT_TRUE(regex.search(input, 0, 0, captures));
+  EXPECT_EQ(captures[0], 0U);
+  EXPECT_EQ(captures[1], input.size());
+}
+} // namespace osquery
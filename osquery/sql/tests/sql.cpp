@@ -265,6 +265,24 @@ TEST_F(SQLTests, test_regex_match_too_big) {
             0);
 }
 
+TEST_F(SQLTests, test_regex_match_per_row_pattern) {
+  QueryData d;
+
+  // Patterns are compiled once per statement, unless they change per row.
+  // The last one uses a backreference, which only std::regex supports.
+  auto status = query(
+      "select regex_match(input, pattern, 1) as t from ( \
+          select 'foo/bar' as input, '(\\w+)/' as pattern \
+          union all select 'foo/bar', '/(\\w+)' \
+          union all select 'foo/bar', '(o)\\1')",
+      d);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(d.size(), 3U);
+  EXPECT_EQ(d[0]["t"], "foo");
+  EXPECT_EQ(d[1]["t"], "bar");
+  EXPECT_EQ(d[2]["t"], "o");
+}
+
 /*
  * split
  */
@@ -402,6 +420,20 @@ TEST_F(SQLTests, test_regex_split_too_big) {
   ASSERT_TRUE(!status.ok());
 }
 
+TEST_F(SQLTests, test_regex_split_per_row_pattern) {
+  QueryData d;
+
+  auto status = query(
+      "select regex_split(input, pattern, 1) as t from ( \
+          select 'a;b;c' as input, ';' as pattern \
+          union all select 'x/y/z', '/')",
+      d);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(d.size(), 2U);
+  EXPECT_EQ(d[0]["t"], "b");
+  EXPECT_EQ(d[1]["t"], "y");
+}
+
 /*
  * concat
  */
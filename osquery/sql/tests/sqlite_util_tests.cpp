@@ -96,6 +96,101 @@ TEST_F(SQLiteUtilTests, test_sqlite_instance) {
   EXPECT_EQ(internal_db, SQLiteDBManager::get()->db());
 }
 
+TEST_F(SQLiteUtilTests, test_sqlite_instance_pool) {
+  // Hold the primary so the following requests are contended.
+  auto primary = SQLiteDBManager::get();
+  ASSERT_TRUE(primary->isPrimary());
+
+  sqlite3* transient_db = nullptr;
+  {
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_FALSE(dbc->isPrimary());
+    transient_db = dbc->db();
+    dbc->useCache(true);
+
+    QueryDataTyped results;
+    EXPECT_TRUE(queryInternal("SELECT * FROM time", results, dbc).ok());
+    EXPECT_EQ(results.size(), 1U);
+  }
+
+  // The released transient instance is reused, with its tables attached.
+  auto dbc = SQLiteDBManager::get();
+  EXPECT_EQ(transient_db, dbc->db());
+  EXPECT_FALSE(dbc->useCache());
+
+  QueryDataTyped results;
+  EXPECT_TRUE(queryInternal("SELECT * FROM time", results, dbc).ok());
+  EXPECT_EQ(results.size(), 1U);
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache) {
+  auto dbc = getTestDBC();
+  auto& statements = dbc->statements();
+  EXPECT_EQ(statements.size(), 0U);
+
+  QueryDataTyped results;
+  ASSERT_TRUE(queryInternal(kTestQuery, results, dbc).ok());
+  EXPECT_EQ(statements.size(), 1U);
+
+  // The repeated query is answered by the reset statement.
+  QueryDataTyped repeated;
+  ASSERT_TRUE(queryInternal(kTestQuery, repeated, dbc).ok());
+  EXPECT_EQ(statements.size(), 1U);
+  EXPECT_EQ(repeated, results);
+
+  // Each statement of a compound query is kept.
+  results.clear();
+  ASSERT_TRUE(
+      queryInternal("SELECT 1 AS a; SELECT 2 AS a", results, dbc).ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(statements.size(), 3U);
+
+  results.clear();
+  ASSERT_TRUE(
+      queryInternal("SELECT 1 AS a; SELECT 2 AS a", results, dbc).ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(boost::get<long long>(results[0]["a"]), 1);
+  EXPECT_EQ(boost::get<long long>(results[1]["a"]), 2);
+  EXPECT_EQ(statements.size(), 3U);
+
+  // A statement that fails is not kept.
+  results.clear();
+  EXPECT_FALSE(queryInternal("SELECT * FROM not_a_table", results, dbc).ok());
+  EXPECT_EQ(statements.size(), 3U);
+
+  // Cached statements follow changes to the schema.
+  sqlite3_exec(dbc->db(),
+               "ALTER TABLE test_table ADD COLUMN city varchar(30)",
+               nullptr,
+               nullptr,
+               nullptr);
+  results.clear();
+  ASSERT_TRUE(queryInternal("SELECT * FROM test_table", results, dbc).ok());
+  ASSERT_FALSE(results.empty());
+  EXPECT_EQ(results[0].count("city"), 1U);
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache_constraints) {
+  auto dbc = getTestDBC();
+  auto path = boost::filesystem::current_path().string();
+  auto query = "SELECT path FROM file WHERE path = '" + path + "'";
+
+  QueryDataTyped results;
+  auto status = queryInternal(query, results, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1U);
+  dbc->clearAffectedTables();
+
+  // The reset statement is not planned again, the REQUIRED column's
+  // constraint must outlive the first query.
+  QueryDataTyped repeated;
+  status = queryInternal(query, repeated, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(repeated, results);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(dbc->statements().size(), 1U);
+}
+
 TEST_F(SQLiteUtilTests, test_reset) {
   auto internal_db = SQLiteDBManager::get()->db();
   ASSERT_NE(nullptr, internal_db);
@@ -14,8 +14,10 @@
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/columnar_table_row.h>
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/table_scan_cache.h>
 
 #include <osquery/sql/virtual_table.h>
 
@@ -636,6 +638,77 @@ TEST_F(VirtualTableTests, test_table_results_cache_colcheck) {
   EXPECT_EQ(cache->generates_, 2U);
 }
 
+class scanCacheTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("d", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    generates_++;
+    auto r = make_table_row();
+    r["i"] = "1";
+    r["d"] = "data";
+    TableRows result;
+    result.push_back(std::move(r));
+    return result;
+  }
+
+  size_t generates_{0};
+};
+
+TEST_F(VirtualTableTests, test_table_scan_cache) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto scans = std::make_shared<scanCacheTablePlugin>();
+  tables->add("scan_cache", scans);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("scan_cache", scans->columnDefinition(false), dbc, false);
+
+  auto& cache = TableScanCache::get();
+  cache.begin({"scan_cache"});
+
+  // Scans are only shared by queries requesting the warm cache.
+  QueryData results;
+  queryInternal("SELECT * from scan_cache;", results, dbc);
+  queryInternal("SELECT * from scan_cache;", results, dbc);
+  EXPECT_EQ(scans->generates_, 2U);
+
+  dbc->useCache(true);
+  results.clear();
+  queryInternal("SELECT * from scan_cache;", results, dbc);
+  EXPECT_EQ(scans->generates_, 3U);
+
+  // A scan using a subset of the cached columns is answered by the cache.
+  results.clear();
+  queryInternal("SELECT d from scan_cache;", results, dbc);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["d"], "data");
+  EXPECT_EQ(scans->generates_, 3U);
+
+  // Constrained scans are neither answered by nor stored in the cache.
+  results.clear();
+  queryInternal("SELECT * from scan_cache where i = '1';", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(scans->generates_, 4U);
+
+  results.clear();
+  queryInternal("SELECT * from scan_cache where i = '1';", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(scans->generates_, 5U);
+
+  auto stats = cache.end();
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 1U);
+
+  // Once the step ends the table is generated again.
+  results.clear();
+  queryInternal("SELECT * from scan_cache;", results, dbc);
+  EXPECT_EQ(scans->generates_, 6U);
+}
+
 class yieldTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -681,6 +754,33 @@ TEST_F(VirtualTableTests, test_yield_generator) {
   EXPECT_EQ(results[0]["index"], "10");
 }
 
+TEST_F(VirtualTableTests, test_yield_generator_limit) {
+  auto table = std::make_shared<yieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("yield_limit", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "yield_limit", table->columnDefinition(false), dbc, false);
+
+  // The scan stops after the limit, the remaining rows are not generated.
+  QueryData results;
+  queryInternal("SELECT * from yield_limit LIMIT 2", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 2U);
+
+  results.clear();
+  queryInternal("SELECT * from yield_limit LIMIT 1", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_LT(std::stoul(results[0]["index"]), 10U);
+
+  // Callers without a cursor read every row the generator yields.
+  QueryContext context;
+  auto rows = table->generate(context);
+  EXPECT_EQ(rows.size(), 10U);
+}
+
 class likeTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -930,6 +1030,188 @@ TEST_F(VirtualTableTests, test_indexing_costs) {
   EXPECT_EQ(10U, j->scans);
 }
 
+/// A stand-in for a system table, with planner estimates and four rows.
+class estimatedTablePlugin : public TablePlugin {
+ public:
+  estimatedTablePlugin(TableColumns columns,
+                       size_t rows,
+                       ColumnSelectivityMap selectivity = {})
+      : columns_(std::move(columns)),
+        rows_(rows),
+        selectivity_(std::move(selectivity)) {}
+
+ private:
+  TableColumns columns() const override {
+    return columns_;
+  }
+
+  size_t estimatedRows() const override {
+    return rows_;
+  }
+
+  ColumnSelectivityMap columnSelectivity() const override {
+    return selectivity_;
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    scans++;
+
+    // Every column of row i holds the value i, indexes filter on equality.
+    TableRows results;
+    for (size_t i = 0; i < 4; i++) {
+      auto value = INTEGER(i);
+      bool matches = true;
+      for (const auto& column : columns_) {
+        auto values = context.constraints[std::get<0>(column)].getAll(EQUALS);
+        if (!values.empty() && values.count(value) == 0) {
+          matches = false;
+        }
+      }
+      if (!matches) {
+        continue;
+      }
+
+      auto r = make_table_row();
+      for (const auto& column : columns_) {
+        r[std::get<0>(column)] = value;
+      }
+      results.push_back(std::move(r));
+    }
+    return results;
+  }
+
+  // The plan is asserted from the number of scans.
+  size_t scans{0};
+
+ private:
+  TableColumns columns_;
+  size_t rows_{0};
+  ColumnSelectivityMap selectivity_;
+};
+
+TEST_F(VirtualTableTests, test_planner_estimates) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+  auto attach = [&dbc, &table_registry](
+                    const std::string& name,
+                    std::shared_ptr<estimatedTablePlugin> table) {
+    table_registry->add(name, table);
+    PluginResponse response;
+    Registry::call("table", name, {{"action", "columns"}}, response);
+    attachTableInternal(
+        name, columnDefinition(response, false, false), dbc, false);
+  };
+
+  // Reading a process is cheap, reading a process's sockets reads every
+  // socket in its namespace.
+  auto processes = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("pid", BIGINT_TYPE, ColumnOptions::INDEX),
+          std::make_tuple("uid", BIGINT_TYPE, ColumnOptions::DEFAULT),
+          std::make_tuple("path", TEXT_TYPE, ColumnOptions::DEFAULT),
+      },
+      512);
+  attach("plan_processes", processes);
+
+  auto sockets = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("pid", INTEGER_TYPE, ColumnOptions::INDEX),
+          std::make_tuple("fd", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      },
+      2048,
+      ColumnSelectivityMap{{"pid", 0.5}});
+  attach("plan_sockets", sockets);
+
+  auto open_files = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("pid", BIGINT_TYPE, ColumnOptions::INDEX),
+          std::make_tuple("path", TEXT_TYPE, ColumnOptions::DEFAULT),
+      },
+      8192,
+      ColumnSelectivityMap{{"pid", 0.002}});
+  attach("plan_open_files", open_files);
+
+  auto users = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("uid", BIGINT_TYPE, ColumnOptions::INDEX),
+          std::make_tuple("username", TEXT_TYPE, ColumnOptions::DEFAULT),
+      },
+      64);
+  attach("plan_users", users);
+
+  auto ports = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("pid", INTEGER_TYPE, ColumnOptions::DEFAULT),
+          std::make_tuple("port", INTEGER_TYPE, ColumnOptions::DEFAULT),
+      },
+      64);
+  attach("plan_ports", ports);
+
+  // Tables without estimates are costed on the same scale as the others,
+  // a missing REQUIRED constraint still costs the most.
+  auto unhinted = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("pid", BIGINT_TYPE, ColumnOptions::INDEX),
+          std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+      },
+      0);
+  attach("plan_unhinted", unhinted);
+
+  auto file = std::make_shared<estimatedTablePlugin>(
+      TableColumns{
+          std::make_tuple("path",
+                          TEXT_TYPE,
+                          ColumnOptions::REQUIRED | ColumnOptions::INDEX),
+          std::make_tuple("size", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      },
+      0);
+  attach("plan_file", file);
+
+  // Each query expects the outer table to be scanned once and the inner
+  // table once for each of the four outer rows.
+  auto expectPlan = [&dbc](const std::string& query,
+                           estimatedTablePlugin& outer,
+                           estimatedTablePlugin& inner) {
+    outer.scans = 0;
+    inner.scans = 0;
+
+    QueryData results;
+    auto status = queryInternal(query, results, dbc);
+    dbc->clearAffectedTables();
+    ASSERT_TRUE(status.ok()) << status.what();
+    EXPECT_EQ(4U, results.size()) << query;
+    EXPECT_EQ(1U, outer.scans) << query;
+    EXPECT_EQ(4U, inner.scans) << query;
+  };
+
+  expectPlan("select * from plan_processes join plan_sockets using (pid)",
+             *sockets,
+             *processes);
+  expectPlan("select * from plan_sockets join plan_processes using (pid)",
+             *sockets,
+             *processes);
+  expectPlan("select * from plan_processes join plan_open_files using (pid)",
+             *processes,
+             *open_files);
+  expectPlan("select * from plan_users join plan_processes using (uid)",
+             *processes,
+             *users);
+  expectPlan("select * from plan_processes join plan_ports using (pid)",
+             *ports,
+             *processes);
+  expectPlan(
+      "select * from plan_processes p join plan_file f on f.path = p.path",
+      *processes,
+      *file);
+  expectPlan("select * from plan_unhinted join plan_processes using (pid)",
+             *processes,
+             *unhinted);
+  expectPlan("select * from plan_processes join plan_unhinted using (pid)",
+             *processes,
+             *unhinted);
+}
+
 class colsUsedTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -1239,4 +1521,135 @@ TEST_F(VirtualTableTests, test_table_exceptions) {
   FLAGS_table_exceptions = backup_flag;
 }
 
+class columnarTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", BIGINT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  ColumnAliasSet columnAliases() const override {
+    return {
+        {"name", {"aliasToName"}},
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    auto results = std::make_shared<ColumnarRows>(columns());
+    results->append();
+    results->setInteger(0, 1);
+    results->setText(1, "shared");
+    results->setDouble(2, 0.5);
+
+    // Leave the ratio NULL and parse the id from its string form.
+    results->append();
+    results->setString(0, "2");
+    results->setText(1, "shared");
+    return tableRowsFromColumnar(results);
+  }
+};
+
+TEST_F(VirtualTableTests, test_columnar_rows) {
+  ColumnarRows rows({
+      std::make_tuple("id", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+  });
+  rows.append();
+  rows.setString(0, "not a number");
+  rows.setText(1, "a");
+  rows.append();
+  rows.setInteger(0, 10);
+  rows.setText(1, "a");
+
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_TRUE(rows.isNull(0, 0));
+  EXPECT_FALSE(rows.isNull(1, 0));
+  EXPECT_EQ(rows.getInteger(1, 0), 10);
+  // Repeated TEXT values share one interned string.
+  EXPECT_EQ(rows.internedCount(), 1U);
+
+  // A malformed value is NULL to SQLite but serialized as it was set.
+  Row expected = {{"id", "not a number"}, {"name", "a"}};
+  EXPECT_EQ(rows.toRow(0), expected);
+  expected = {{"id", "10"}, {"name", "a"}};
+  EXPECT_EQ(rows.toRow(1), expected);
+}
+
+TEST_F(VirtualTableTests, test_columnar_rows_parsing) {
+  ColumnarRows rows({
+      std::make_tuple("id", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("size", UNSIGNED_BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+  });
+  rows.append();
+  rows.setString(0, "010");
+  rows.setString(1, "18446744073709551615");
+  rows.setString(2, "");
+
+  // Numeric strings are base 10, unsigned values keep their full range.
+  EXPECT_EQ(rows.getInteger(0, 0), 10);
+  EXPECT_FALSE(rows.isNull(0, 1));
+  EXPECT_EQ(rows.getString(0, 1), "18446744073709551615");
+
+  // An empty numeric value is NULL to SQLite and serialized as empty.
+  EXPECT_TRUE(rows.isNull(0, 2));
+  Row expected = {
+      {"id", "10"}, {"size", "18446744073709551615"}, {"ratio", ""}};
+  EXPECT_EQ(rows.toRow(0), expected);
+
+  rows.append();
+  rows.setString(1, "-1");
+  rows.setString(2, "0.5");
+  EXPECT_TRUE(rows.isNull(1, 1));
+  EXPECT_EQ(rows.getString(1, 1), "-1");
+  EXPECT_EQ(rows.getDouble(1, 2), 0.5);
+
+  // Setting a value replaces the text of an unparsed cell.
+  rows.setUnsigned(1, 1);
+  expected = {{"size", "1"}, {"ratio", "0.500000"}};
+  EXPECT_EQ(rows.toRow(1), expected);
+}
+
+TEST_F(VirtualTableTests, test_columnar_table_rows) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto columnar = std::make_shared<columnarTablePlugin>();
+  tables->add("columnar", columnar);
+  auto dbc = SQLiteDBManager::getUnique();
+
+  PluginResponse response;
+  Registry::call("table", "columnar", {{"action", "columns"}}, response);
+  attachTableInternal(
+      "columnar", columnDefinition(response, true, false), dbc, false);
+
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT id, name, ratio, aliasToName FROM columnar WHERE ratio IS NULL",
+      results,
+      dbc);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["id"], "2");
+  EXPECT_EQ(results[0]["name"], "shared");
+  EXPECT_EQ(results[0]["ratio"], "");
+  EXPECT_EQ(results[0]["aliasToName"], "shared");
+
+  results.clear();
+  status = queryInternal(
+      "SELECT typeof(id) AS t FROM columnar WHERE id = 1", results, dbc);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["t"], "integer");
+
+  // The registry API serializes views back into string maps.
+  PluginResponse generated;
+  Registry::call("table", "columnar", {{"action", "generate"}}, generated);
+  ASSERT_EQ(generated.size(), 2U);
+  EXPECT_EQ(generated[0]["ratio"], "0.500000");
+  EXPECT_EQ(generated[1].count("ratio"), 0U);
+}
+
 } // namespace osquery
@@ -7,7 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstdlib>
 #include <unordered_set>
 
 #include <osquery/core/core.h>
@@ -17,6 +20,7 @@
 #include <osquery/process/process.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/table_scan_cache.h>
 #include <osquery/sql/virtual_table.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -58,6 +62,12 @@ static std::atomic<size_t> kConstraintIndexID{0};
 /// We consider the max-cost as an error-state, e.g., unusable constraints.
 const double kMaxIndexCost{1000000};
 
+/// Fraction of a scan expected to remain for a range or pattern constraint.
+const double kRangeSelectivity{0.25};
+
+/// Rows a full scan is assumed to generate if the table did not declare it.
+const double kDefaultEstimatedRows{1000};
+
 static inline std::string opString(unsigned char op) {
   switch (op) {
   case EQUALS:
@@ -627,6 +637,17 @@ int xCreate(sqlite3* db,
 
       pVtab->content->columns.push_back(std::make_tuple(
           cname->second, columnTypeName(ctype->second), options));
+
+      // Keep the optional planner hint, indexed like the column.
+      double selectivity = 0;
+      auto csel = column.find("selectivity");
+      if (csel != column.end()) {
+        selectivity = std::strtod(csel->second.c_str(), nullptr);
+        if (selectivity < 0 || selectivity > 1) {
+          selectivity = 0;
+        }
+      }
+      pVtab->content->selectivity.push_back(selectivity);
     } else if (cid->second == "alias") {
       // Create associated views for table aliases.
       auto calias = column.find("alias");
@@ -644,6 +665,7 @@ int xCreate(sqlite3* db,
       // Use an UNKNOWN_TYPE as a pseudo-mask, since the type does not matter.
       pVtab->content->columns.push_back(
           std::make_tuple(cname->second, UNKNOWN_TYPE, ColumnOptions::HIDDEN));
+      pVtab->content->selectivity.push_back(0);
       // Record a mapping of the requested column alias name.
       size_t target_index = 0;
       for (size_t i = 0; i < pVtab->content->columns.size(); i++) {
@@ -664,6 +686,14 @@ int xCreate(sqlite3* db,
               static_cast<TableAttributes>(attr.take());
         }
       }
+    } else if (cid->second == "estimates") {
+      auto crows = column.find("rows");
+      if (crows != column.end()) {
+        auto rows = tryTo<unsigned long long>(crows->second);
+        if (rows) {
+          pVtab->content->estimated_rows = static_cast<size_t>(rows.take());
+        }
+      }
     }
   }
 
@@ -713,12 +743,19 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   // Expect this index to correspond with argv within xFilter.
   size_t expr_index = 0;
   // If any constraints are unusable increment the cost of the index.
-  double cost = kMaxIndexCost;
+  double penalty = 0;
 
   // Tables may have requirements or use indexes.
   bool hasRequiredColumns = false;
   bool hasRequiredConstraints = false;
 
+  // Tables are costed by the rows a scan is expected to generate. Tables
+  // without estimates use a default, so every table is on the same scale.
+  const auto& content = pVtab->content;
+  double rows = (content->estimated_rows > 0)
+                    ? static_cast<double>(content->estimated_rows)
+                    : kDefaultEstimatedRows;
+
   // Expressions operating on the same virtual table are loosely identified by
   // the consecutive sets of terms each of the constraint sets are applied onto.
   // Subsequent attempts from failed (unusable) constraints replace the set,
@@ -747,7 +784,7 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       const auto& name = std::get<0>(columns[constraint_info.iColumn]);
       const auto& type = std::get<1>(columns[constraint_info.iColumn]);
       if (!sensibleComparison(type, constraint_info.op)) {
-        cost += 10;
+        penalty += 10;
         continue;
       }
 
@@ -755,14 +792,26 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       const auto& options = std::get<2>(columns[constraint_info.iColumn]);
       if (options & ColumnOptions::REQUIRED) {
         hasRequiredConstraints = true;
-        cost = 1;
       } else if (options & (ColumnOptions::INDEX | ColumnOptions::ADDITIONAL)) {
-        cost = 1;
+        // The constraint is passed to the table.
       } else {
         // not indexed, let sqlite filter it
         continue;
       }
 
+      // Without a hint an equality is expected to select a single row.
+      auto column_index = static_cast<size_t>(constraint_info.iColumn);
+      auto selectivity = column_index < content->selectivity.size()
+                             ? content->selectivity[column_index]
+                             : 0.0;
+      if (constraint_info.op != EQUALS) {
+        rows *= std::max(selectivity, kRangeSelectivity);
+      } else if (selectivity > 0) {
+        rows *= selectivity;
+      } else {
+        rows = std::min(rows, 1.0);
+      }
+
       // Save a pair of the name and the constraint operator.
       // Use this constraint during xFilter by performing a scan and column
       // name lookup through out all cursor constraint lists.
@@ -821,14 +870,18 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
 
   // Return max-cost if a required constraint is not present.
   // For example, you can't do a hash of a file if path not provided.
-  if (hasRequiredColumns && !hasRequiredConstraints) {
-    cost = kMaxIndexCost;
+  double cost = kMaxIndexCost;
+  if (!hasRequiredColumns || hasRequiredConstraints) {
+    rows = std::max(rows, 1.0);
+    cost = rows + penalty;
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(std::ceil(rows));
   }
 
   pIdxInfo->idxNum = static_cast<int>(kConstraintIndexID++);
   if (FLAGS_planner) {
     plan("xBestIndex Recording constraint set for table: " +
          pVtab->content->name + " [cost=" + std::to_string(cost) +
+         " rows=" + std::to_string(pIdxInfo->estimatedRows) +
          " size=" + std::to_string(constraints.size()) +
          " idx=" + std::to_string(pIdxInfo->idxNum) + "]");
   }
@@ -836,6 +889,8 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
   pVtab->content->colsUsed[pIdxInfo->idxNum] = std::move(colsUsed);
   pVtab->content->colsUsedBitsets[pIdxInfo->idxNum] = colsUsedBitset;
+  PlannedIndexCollector::record(pVtab->content,
+                                static_cast<size_t>(pIdxInfo->idxNum));
   pIdxInfo->estimatedCost = cost;
 
   return SQLITE_OK;
@@ -903,10 +958,13 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   }
 
   // Iterate over every argument to xFilter, filling in constraint values.
-  if (content->constraints.size() > 0) {
-    auto& constraints = content->constraints[idxNum];
+  auto planned = content->constraints.find(static_cast<size_t>(idxNum));
+  if (planned != content->constraints.end()) {
+    auto& constraints = planned->second;
     if (argc > 0) {
-      for (size_t i = 0; i < static_cast<size_t>(argc); ++i) {
+      for (size_t i = 0;
+           i < static_cast<size_t>(argc) && i < constraints.size();
+           ++i) {
         auto expr = (const char*)sqlite3_value_text(argv[i]);
         if (expr == nullptr || expr[0] == 0) {
           // SQLite did not expose the expression value.
@@ -943,14 +1001,16 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     }
   }
 
-  if (!content->colsUsedBitsets.empty()) {
-    context.colsUsedBitset = content->colsUsedBitsets[idxNum];
+  auto bitset = content->colsUsedBitsets.find(static_cast<size_t>(idxNum));
+  if (bitset != content->colsUsedBitsets.end()) {
+    context.colsUsedBitset = bitset->second;
   } else {
     // Unspecified; have to assume all columns are used
     context.colsUsedBitset->set();
   }
-  if (content->colsUsed.size() > 0) {
-    context.colsUsed = content->colsUsed[idxNum];
+  auto used = content->colsUsed.find(static_cast<size_t>(idxNum));
+  if (used != content->colsUsed.end()) {
+    context.colsUsed = used->second;
   }
 
   // Reset the virtual table contents.
@@ -989,7 +1049,24 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     auto plugin = Registry::get().plugin("table", pVtab->content->name);
     auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
     try {
-      if (table->usesGenerator()) {
+      // Scheduled queries in the same step may share unconstrained scans of
+      // a table. Event-based tables track what each query has read and
+      // utility tables report osquery's own, changing, state so neither is
+      // shared.
+      auto& scan_cache = TableScanCache::get();
+      bool share_scan =
+          context.useCache() &&
+          (content->attributes & TableAttributes::EVENT_BASED) == 0 &&
+          (content->attributes & TableAttributes::UTILITY) == 0 &&
+          scan_cache.enabled(content->name, context);
+
+      // Shared and cached scans need the complete table content, every other
+      // generator scan streams rows and stops when SQLite stops reading.
+      bool cache_scan =
+          share_scan ||
+          (context.useCache() &&
+           (content->attributes & TableAttributes::CACHEABLE) != 0);
+      if (table->usesGenerator() && !cache_scan) {
         pCur->uses_generator = true;
         pCur->generator = std::make_unique<RowGenerator::pull_type>(
             std::bind(&TablePlugin::generator,
@@ -1001,7 +1078,14 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
         }
         return SQLITE_OK;
       }
-      pCur->rows = table->generate(context);
+
+      if (!share_scan ||
+          !scan_cache.lookup(content->name, context, pCur->rows)) {
+        pCur->rows = table->generate(context);
+        if (share_scan) {
+          scan_cache.store(content->name, context, pCur->rows);
+        }
+      }
     } catch (const std::exception& e) {
       LOG(ERROR) << "Exception while executing table " << pVtab->content->name
                  << ": " << e.what();
@@ -18,6 +18,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/tables/system/freebsd/procstat.h>
 
 namespace osquery {
@@ -99,7 +100,7 @@ void genSockets(struct procstat* pstat,
   procstat_freefiles(pstat, files);
 }
 
-QueryData genOpenSockets(QueryContext &context) {
+TableRows genOpenSockets(QueryContext &context) {
   QueryData results;
   struct kinfo_proc* procs = nullptr;
   struct procstat* pstat = nullptr;
@@ -112,7 +113,7 @@ QueryData genOpenSockets(QueryContext &context) {
 
   procstatCleanup(pstat, procs);
 
-  return results;
+  return tableRowsFromQueryData(std::move(results));
 }
 }
 }
@@ -7,17 +7,23 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
+#include <osquery/rows/process_open_sockets.h>
+#include <osquery/sql/columnar_table_row.h>
 
 namespace osquery {
 namespace tables {
 
-QueryData genOpenSockets(QueryContext& context) {
+/// Sockets are yielded from batches of at most this many rows.
+const size_t kOpenSocketsBatchRows = 1024;
+
+void genOpenSockets(RowYield& yield, QueryContext& context) {
   Status status;
-  QueryData results;
 
   /*
    * If filtering by pid, restrict results to the list of pids provided
@@ -37,7 +43,7 @@ QueryData genOpenSockets(QueryContext& context) {
     status = osquery::procProcesses(pids);
     if (!status.ok()) {
       VLOG(1) << "Failed to acquire pid list: " << status.what();
-      return results;
+      return;
     }
   }
 
@@ -65,17 +71,27 @@ QueryData genOpenSockets(QueryContext& context) {
    * 1 and 2.
    */
 
+  /* Step 1 reads every file descriptor link of every process, it is only
+   * needed to filter by pid or if the pid or fd columns are selected.
+   */
+  bool map_inodes = pid_filter || context.isAnyColumnUsed(
+                                      ProcessOpenSocketsRow::PID |
+                                      ProcessOpenSocketsRow::FD);
+
   /* Use a set to record the namespaces already processed */
   std::set<ino_t> netns_list;
   SocketInodeToProcessInfoMap inode_proc_map;
   SocketInfoList socket_list;
   for (const auto& pid : pids) {
     /* Step 1 */
-    status = procGetSocketInodeToProcessInfoMap(pid, inode_proc_map);
-    if (!status.ok()) {
-      VLOG(1) << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire socket inode to process map for pid "
-              << pid << ": " << status.what();
+    if (map_inodes) {
+      status = procGetSocketInodeToProcessInfoMap(pid, inode_proc_map);
+      if (!status.ok()) {
+        VLOG(1)
+            << "Results for process_open_sockets might be incomplete. Failed "
+               "to acquire socket inode to process map for pid "
+            << pid << ": " << status.what();
+      }
     }
 
     /* Step 2 */
@@ -138,38 +154,44 @@ QueryData genOpenSockets(QueryContext& context) {
   /* Finally correlate all the information. Go through all the sockets
    * collected on step 3 and correlate that with the pid and fd collected from
    * step 1. If filtering only take sockets for which the inode is available on
-   * the inode to process information map.
+   * the inode to process information map. Rows are yielded as they are
+   * correlated, from bounded batches.
    */
+  std::shared_ptr<ProcessOpenSocketsBatch> results;
   for (const auto& info : socket_list) {
-    Row r;
     auto proc_it = inode_proc_map.find(info.socket);
-    if (proc_it != inode_proc_map.end()) {
-      r["pid"] = proc_it->second.pid;
-      r["fd"] = proc_it->second.fd;
-    } else if (!pid_filter) {
-      r["pid"] = "-1";
-      r["fd"] = "-1";
-    } else {
+    if (proc_it == inode_proc_map.end() && pid_filter) {
       /* If we're filtering by pid we only care about sockets associated with
        * pids on the list.*/
       continue;
     }
 
-    r["socket"] = info.socket;
-    r["family"] = std::to_string(info.family);
-    r["protocol"] = std::to_string(info.protocol);
-    r["local_address"] = info.local_address;
-    r["local_port"] = std::to_string(info.local_port);
-    r["remote_address"] = info.remote_address;
-    r["remote_port"] = std::to_string(info.remote_port);
-    r["path"] = info.unix_socket_path;
-    r["state"] = info.state;
-    r["net_namespace"] = std::to_string(info.net_ns);
-
-    results.push_back(std::move(r));
-  }
+    if (results == nullptr || results->size() == kOpenSocketsBatchRows) {
+      results = std::make_shared<ProcessOpenSocketsBatch>();
+      results->reserve(std::min(kOpenSocketsBatchRows, socket_list.size()));
+    }
 
-  return results;
+    auto index = results->append();
+    if (proc_it != inode_proc_map.end()) {
+      results->setString(ProcessOpenSocketsBatch::PID, proc_it->second.pid);
+      results->setString(ProcessOpenSocketsBatch::FD, proc_it->second.fd);
+    } else {
+      results->set_pid(-1);
+      results->set_fd(-1);
+    }
+
+    results->setString(ProcessOpenSocketsBatch::SOCKET, info.socket);
+    results->set_family(info.family);
+    results->set_protocol(info.protocol);
+    results->set_local_address(info.local_address);
+    results->set_local_port(info.local_port);
+    results->set_remote_address(info.remote_address);
+    results->set_remote_port(info.remote_port);
+    results->set_path(info.unix_socket_path);
+    results->set_state(info.state);
+    results->set_net_namespace(std::to_string(info.net_ns));
+    yield(TableRowHolder(new ColumnarTableRow(results, index)));
+  }
 }
 } // namespace tables
 } // namespace osquery
@@ -20,6 +20,7 @@
 #include <fuzzy.h>
 #endif
 
+#include <functional>
 #include <set>
 #include <thread>
 
@@ -30,6 +31,8 @@
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/core/tables.h>
+#include <osquery/rows/hash.h>
+#include <osquery/sql/columnar_table_row.h>
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/utils/mutex.h>
 #include <osquery/utils/info/platform_type.h>
@@ -58,6 +61,9 @@ namespace tables {
 /// Clear this amount of rows every time cache eviction is triggered.
 const size_t kHashCacheEvictSize{5};
 
+/// Rows appended to one shared batch before a new batch is started.
+const size_t kHashBatchRows{256};
+
 /**
  * @brief Implements persistent in-memory caching of files' hashes.
  *
@@ -93,13 +99,18 @@ struct FileHashCache {
    *
    * Maintains the cache of hash sums, stats file at path, if it has changed or
    * it is not present in cache calculates the hashes and caches the result.
+   * A cached entry missing some of the requested hash types is extended.
    *
    * @param path the path of file to hash.
+   * @param mask the HashType bits requested.
    * @param out stores the calculated hashes.
    *
    * @return true if succeeded, false if something went wrong.
    */
-  static bool load(const std::string& path, MultiHashes& out, Logger& logger);
+  static bool load(const std::string& path,
+                   int mask,
+                   MultiHashes& out,
+                   Logger& logger);
 };
 
 #if defined(WIN32)
@@ -129,6 +140,7 @@ static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
 }
 
 bool FileHashCache::load(const std::string& path,
+                         int mask,
                          MultiHashes& out,
                          Logger& logger) {
   // synchronize the access to cache
@@ -165,8 +177,7 @@ bool FileHashCache::load(const std::string& path,
       }
     }
 
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
+    auto hashes = hashMultiFromFile(mask, path);
     FileHashCache rec = {st.st_mtime, // .file_mtime
                          st.st_ino, // .file_inode
                          st.st_size, // .file_size
@@ -177,9 +188,13 @@ bool FileHashCache::load(const std::string& path,
     lru.push_back(&cache[path]);
     std::push_heap(lru.begin(), lru.end(), FileHashCache::greater);
     out = cache[path].hashes;
-  } else if (statInvalid(st, entry->second)) { // changed, update
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
+  } else if (statInvalid(st, entry->second) ||
+             (entry->second.hashes.mask & mask) != mask) { // changed, update
+    if (!statInvalid(st, entry->second)) {
+      // Still valid but missing hash types, keep the types already known.
+      mask |= entry->second.hashes.mask;
+    }
+    auto hashes = hashMultiFromFile(mask, path);
     entry->second.cache_access_time = time(nullptr);
     entry->second.file_inode = st.st_ino;
     entry->second.file_mtime = st.st_mtime;
@@ -224,48 +239,63 @@ Status genSsdeepForFile(const std::string& path, std::string& ssdeep_hash) {
 void genHashForFile(const std::string& path,
                     const std::string& dir,
                     QueryContext& context,
-                    QueryData& results,
-                    Logger& logger) {
-  // Must provide the path, filename, directory separate from boost path->string
-  // helpers to match any explicit (query-parsed) predicate constraints.
-  auto tr = TableRowHolder(new DynamicTableRow());
+                    Logger& logger,
+                    HashBatch& results) {
+  // Only compute the digests for selected hash columns.
+  int mask = 0;
+  if (context.isColumnUsed("md5")) {
+    mask |= HASH_TYPE_MD5;
+  }
+  if (context.isColumnUsed("sha1")) {
+    mask |= HASH_TYPE_SHA1;
+  }
+  if (context.isColumnUsed("sha256")) {
+    mask |= HASH_TYPE_SHA256;
+  }
+
   MultiHashes hashes;
-  if (!FLAGS_disable_hash_cache) {
-    FileHashCache::load(path, hashes, logger);
+  if (mask == 0) {
+    // No digest was requested, the file content is not read.
+  } else if (!FLAGS_disable_hash_cache) {
+    FileHashCache::load(path, mask, hashes, logger);
+  } else if (context.isCached(path)) {
+    // Use the inner-query cache if the global hash cache is disabled.
+    // This protects against hashing the same content twice in the same query.
+    auto cached = static_cast<Row>(*context.getCache(path));
+    hashes.md5 = std::move(cached["md5"]);
+    hashes.sha1 = std::move(cached["sha1"]);
+    hashes.sha256 = std::move(cached["sha256"]);
   } else {
-    if (context.isCached(path)) {
-      // Use the inner-query cache if the global hash cache is disabled.
-      // This protects against hashing the same content twice in the same query.
-      tr = context.getCache(path);
-    } else {
-      hashes = hashMultiFromFile(
-          HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
-    }
+    hashes = hashMultiFromFile(mask, path);
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
+    context.setCache(path,
+                     TableRowHolder(new DynamicTableRow({
+                         {"md5", hashes.md5},
+                         {"sha1", hashes.sha1},
+                         {"sha256", hashes.sha256},
+                     })));
   }
 
-  DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
-  r["path"] = path;
-  r["directory"] = dir;
-  r["md5"] = std::move(hashes.md5);
-  r["sha1"] = std::move(hashes.sha1);
-  r["sha256"] = std::move(hashes.sha256);
+  // Must provide the path, filename, directory separate from boost path->string
+  // helpers to match any explicit (query-parsed) predicate constraints.
+  results.append();
+  results.set_path(path);
+  results.set_directory(dir);
+  results.set_md5(hashes.md5);
+  results.set_sha1(hashes.sha1);
+  results.set_sha256(hashes.sha256);
 
   if (isPlatform(PlatformType::TYPE_POSIX) && context.isColumnUsed("ssdeep")) {
-    auto status = genSsdeepForFile(path, r["ssdeep"]);
+    std::string ssdeep;
+    auto status = genSsdeepForFile(path, ssdeep);
 
     if (!status.ok()) {
       logger.log(google::GLOG_WARNING, status.getMessage());
     }
+    results.set_ssdeep(ssdeep);
   }
 
-  if (FLAGS_disable_hash_cache) {
-    context.setCache(path, tr);
-  }
-
-  r["pid_with_namespace"] = "0";
-
-  results.push_back(static_cast<Row>(r));
+  results.set_pid_with_namespace(0);
 }
 
 void expandFSPathConstraints(QueryContext& context,
@@ -288,8 +318,9 @@ void expandFSPathConstraints(QueryContext& context,
       }));
 }
 
-QueryData genHashImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
+void genHashPaths(QueryContext& context,
+                  const std::function<void(const std::string& path,
+                                           const std::string& dir)>& predicate) {
   boost::system::error_code ec;
 
   // The query must provide a predicate with constraints including path or
@@ -305,8 +336,7 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
       continue;
     }
 
-    genHashForFile(
-        path_string, path.parent_path().string(), context, results, logger);
+    predicate(path_string, path.parent_path().string());
   }
 
   // Now loop through constraints using the directory column constraint.
@@ -325,22 +355,42 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
     boost::filesystem::directory_iterator begin(directory), end;
     for (; begin != end; ++begin) {
       if (boost::filesystem::is_regular_file(begin->path(), ec)) {
-        genHashForFile(
-            begin->path().string(), directory_string, context, results, logger);
+        predicate(begin->path().string(), directory_string);
       }
     }
   }
+}
 
-  return results;
+QueryData genHashImpl(QueryContext& context, Logger& logger) {
+  HashBatch results;
+  genHashPaths(context, [&](const std::string& path, const std::string& dir) {
+    genHashForFile(path, dir, context, logger, results);
+  });
+  return queryDataFromColumnar(results);
 }
 
-QueryData genHash(QueryContext& context) {
+void genHash(RowYield& yield, QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "hash", genHashImpl);
-  } else {
-    GLOGLogger logger;
-    return genHashImpl(context, logger);
+    // Rows generated within another namespace are returned all at once.
+    for (auto& r : generateInNamespace(context, "hash", genHashImpl)) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    return;
   }
+
+  // Hash each file when SQLite asks for the next row, a scan stopped by a
+  // LIMIT does not read the remaining files.
+  GLOGLogger logger;
+  std::shared_ptr<HashBatch> results;
+  genHashPaths(context, [&](const std::string& path, const std::string& dir) {
+    if (results == nullptr || results->size() == kHashBatchRows) {
+      results = std::make_shared<HashBatch>();
+    }
+
+    auto index = results->size();
+    genHashForFile(path, dir, context, logger, *results);
+    yield(TableRowHolder(new ColumnarTableRow(results, index)));
+  });
 }
 } // namespace tables
 } // namespace osquery
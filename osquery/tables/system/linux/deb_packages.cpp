@@ -16,6 +16,9 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/rows/deb_packages.h>
+#include <osquery/sql/columnar_table_row.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -97,17 +100,17 @@ void dpkg_teardown(struct pkg_array* packages) {
   pop_error_context(ehflag_normaltidy);
 }
 
-const std::map<std::string, std::string> kFieldMappings = {
-    {"Package", "name"},
-    {"Version", "version"},
-    {"Installed-Size", "size"},
-    {"Architecture", "arch"},
-    {"Source", "source"},
-    {"Revision", "revision"},
-    {"Status", "status"},
-    {"Maintainer", "maintainer"},
-    {"Section", "section"},
-    {"Priority", "priority"}};
+const std::map<std::string, DebPackagesBatch::ColumnIndex> kFieldMappings = {
+    {"Package", DebPackagesBatch::NAME},
+    {"Version", DebPackagesBatch::VERSION},
+    {"Installed-Size", DebPackagesBatch::SIZE},
+    {"Architecture", DebPackagesBatch::ARCH},
+    {"Source", DebPackagesBatch::SOURCE},
+    {"Revision", DebPackagesBatch::REVISION},
+    {"Status", DebPackagesBatch::STATUS},
+    {"Maintainer", DebPackagesBatch::MAINTAINER},
+    {"Section", DebPackagesBatch::SECTION},
+    {"Priority", DebPackagesBatch::PRIORITY}};
 
 /**
  * @brief Field names and function references to extract information.
@@ -132,8 +135,11 @@ const struct fieldinfo fieldinfos[] = {
     {FIELD("Section"), f_section, w_section, 0},
     {}};
 
-void extractDebPackageInfo(const struct pkginfo* pkg, QueryData& results) {
-  Row r;
+void extractDebPackageInfo(const struct pkginfo* pkg,
+                           QueryContext& context,
+                           DebPackagesBatch& results) {
+  results.append();
+  bool has_size = false;
 
   struct varbuf vb;
   varbuf_init(&vb, 20);
@@ -142,6 +148,13 @@ void extractDebPackageInfo(const struct pkginfo* pkg, QueryData& results) {
   // to extract the package's information.
   const struct fieldinfo* fip = nullptr;
   for (fip = fieldinfos; fip->name; fip++) {
+    auto column = kFieldMappings.find(fip->name);
+    if (column != kFieldMappings.end() &&
+        !context.isColumnUsed(results.columnName(column->second))) {
+      // Skip formatting fields for columns the query did not select.
+      continue;
+    }
+
     fip->wcall(&vb, pkg, &pkg->installed, fw_printheader, fip);
 
     std::string line = vb.string();
@@ -153,29 +166,28 @@ void extractDebPackageInfo(const struct pkginfo* pkg, QueryData& results) {
       auto it = kFieldMappings.find(key);
       if (it != kFieldMappings.end()) {
         boost::algorithm::trim(value);
-        r[it->second] = std::move(value);
+        results.setString(it->second, value);
+        has_size |= (it->second == DebPackagesBatch::SIZE);
       }
     }
     varbuf_reset(&vb);
   }
   varbuf_destroy(&vb);
 
-  if (r.find("size") == r.end()) {
+  if (!has_size) {
     // Possible meta-package without an installed-size.
-    r["size"] = "0";
+    results.set_size(0);
   }
 
-  r["pid_with_namespace"] = "0";
-
-  results.push_back(r);
+  results.set_pid_with_namespace(0);
 }
 
-QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
-
+void genDebPackageRows(QueryContext& context,
+                       Logger& logger,
+                       DebPackagesBatch& results) {
   if (!osquery::isDirectory(kDPKGPath)) {
     logger.vlog(1, "Cannot find DPKG database: " + kDPKGPath);
-    return results;
+    return;
   }
 
   auto dropper = DropPrivileges::get();
@@ -184,6 +196,7 @@ QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
   struct pkg_array packages;
   dpkg_setup(&packages);
 
+  results.reserve(static_cast<size_t>(packages.n_pkgs));
   for (int i = 0; i < packages.n_pkgs; i++) {
     struct pkginfo* pkg = packages.pkgs[i];
     // Casted to int to allow the older enums that were embedded in the packages
@@ -193,20 +206,29 @@ QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
       continue;
     }
 
-    extractDebPackageInfo(pkg, results);
+    extractDebPackageInfo(pkg, context, results);
   }
 
   dpkg_teardown(&packages);
-  return results;
 }
 
-QueryData genDebPackages(QueryContext& context) {
+QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
+  DebPackagesBatch results;
+  genDebPackageRows(context, logger, results);
+  return queryDataFromColumnar(results);
+}
+
+TableRows genDebPackages(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "deb_packages", genDebPackagesImpl);
-  } else {
-    GLOGLogger logger;
-    return genDebPackagesImpl(context, logger);
+    return tableRowsFromQueryData(
+        generateInNamespace(context, "deb_packages", genDebPackagesImpl));
   }
+
+  // The whole package database is read in one pass, the rows share a batch.
+  GLOGLogger logger;
+  auto results = std::make_shared<DebPackagesBatch>();
+  genDebPackageRows(context, logger, *results);
+  return tableRowsFromColumnar(results);
 }
 } // namespace tables
 } // namespace osquery
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <map>
 #include <regex>
 #include <string>
@@ -24,7 +25,8 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
-#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/rows/processes.h>
+#include <osquery/sql/columnar_table_row.h>
 
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/system/uptime.h>
@@ -36,6 +38,9 @@ namespace tables {
 
 const int kMSIn1CLKTCK = (1000 / sysconf(_SC_CLK_TCK));
 
+/// Processes are yielded from batches of at most this many rows.
+const size_t kProcessesBatchRows = 256;
+
 inline std::string getProcAttr(const std::string& attr,
                                const std::string& pid) {
   return "/proc/" + pid + "/" + attr;
@@ -227,12 +232,24 @@ struct SimpleProcStat : private boost::noncopyable {
   /// For errors processing proc data.
   Status status;
 
-  explicit SimpleProcStat(const std::string& pid);
+  /**
+   * @brief Parse /proc/<pid>/stat and optionally /proc/<pid>/status.
+   *
+   * The status file holds the name, credentials and memory sizes. Callers
+   * that do not select any of those columns may skip reading it, the stat
+   * file is then used to check that the process still exists.
+   */
+  explicit SimpleProcStat(const std::string& pid, bool read_status = true);
 };
 
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
+SimpleProcStat::SimpleProcStat(const std::string& pid, bool read_status) {
   std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
+  if (!readFile(getProcAttr("stat", pid), content).ok()) {
+    if (!read_status) {
+      status = Status(1, "Cannot read /proc/stat");
+      return;
+    }
+  } else {
     auto start = content.find_last_of(")");
     // Start parsing stats from ") <MODE>..."
     if (start == std::string::npos || content.size() <= start + 2) {
@@ -256,6 +273,10 @@ SimpleProcStat::SimpleProcStat(const std::string& pid) {
     this->start_time = details.at(19);
   }
 
+  if (!read_status) {
+    return;
+  }
+
   // /proc/N/status may be not available, or readable by this user.
   if (!readFile(getProcAttr("status", pid), content).ok()) {
     status = Status(1, "Cannot read /proc/status");
@@ -394,72 +415,94 @@ int getOnDisk(const std::string& pid, std::string& path) {
 
 void genProcess(const std::string& pid,
                 long system_boot_time,
-                TableRows& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-  // Parse the process io
-  SimpleProcIo proc_io(pid);
+                QueryContext& context,
+                ProcessesBatch& results) {
+  // Parse the process stat and, if needed, the status.
+  SimpleProcStat proc_stat(
+      pid,
+      context.isAnyColumnUsed(
+          ProcessesRow::NAME | ProcessesRow::UID | ProcessesRow::EUID |
+          ProcessesRow::SUID | ProcessesRow::GID | ProcessesRow::EGID |
+          ProcessesRow::SGID | ProcessesRow::RESIDENT_SIZE |
+          ProcessesRow::TOTAL_SIZE));
 
   if (!proc_stat.status.ok()) {
     VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
     return;
   }
 
-  auto r = make_table_row();
-  r["pid"] = pid;
-  r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
-  r["pgroup"] = proc_stat.group;
-  r["state"] = proc_stat.state;
-  r["nice"] = proc_stat.nice;
-  r["threads"] = proc_stat.threads;
-  // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
-
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+  results.append();
+  results.setString(ProcessesBatch::PID, pid);
+  results.setString(ProcessesBatch::PARENT, proc_stat.parent);
+  results.set_name(proc_stat.name);
+  results.setString(ProcessesBatch::PGROUP, proc_stat.group);
+  results.set_state(proc_stat.state);
+  results.setString(ProcessesBatch::NICE, proc_stat.nice);
+  results.setString(ProcessesBatch::THREADS, proc_stat.threads);
+  results.setString(ProcessesBatch::UID, proc_stat.real_uid);
+  results.setString(ProcessesBatch::EUID, proc_stat.effective_uid);
+  results.setString(ProcessesBatch::SUID, proc_stat.saved_uid);
+  results.setString(ProcessesBatch::GID, proc_stat.real_gid);
+  results.setString(ProcessesBatch::EGID, proc_stat.effective_gid);
+  results.setString(ProcessesBatch::SGID, proc_stat.saved_gid);
+
+  if (context.isAnyColumnUsed(ProcessesRow::CMDLINE)) {
+    // Read/parse cmdline arguments.
+    results.set_cmdline(readProcCMDLine(pid));
+  }
+
+  if (context.isAnyColumnUsed(ProcessesRow::CWD)) {
+    results.set_cwd(readProcLink("cwd", pid));
+  }
+
+  if (context.isAnyColumnUsed(ProcessesRow::ROOT)) {
+    results.set_root(readProcLink("root", pid));
+  }
+
+  if (context.isAnyColumnUsed(ProcessesRow::PATH | ProcessesRow::ON_DISK)) {
+    // The on-disk check may strip a " (deleted)" suffix from the path.
+    auto path = readProcLink("exe", pid);
+    results.set_on_disk(getOnDisk(pid, path));
+    results.set_path(path);
+  }
 
   // size/memory information
-  r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
+  results.set_wired_size(0); // No support for unpagable counters in linux.
+  results.setString(ProcessesBatch::RESIDENT_SIZE, proc_stat.resident_size);
+  results.setString(ProcessesBatch::TOTAL_SIZE, proc_stat.total_size);
 
   // time information
   auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
-  r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
+  results.set_user_time(usr_time * kMSIn1CLKTCK);
   auto sys_time = std::strtoull(proc_stat.system_time.data(), nullptr, 10);
-  r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
+  results.set_system_time(sys_time * kMSIn1CLKTCK);
 
   auto proc_start_time_exp = tryTo<long>(proc_stat.start_time);
   if (proc_start_time_exp.isValue() && system_boot_time > 0) {
-    r["start_time"] = INTEGER(system_boot_time + proc_start_time_exp.take() /
-                                                     sysconf(_SC_CLK_TCK));
+    results.set_start_time(system_boot_time + proc_start_time_exp.take() /
+                                                  sysconf(_SC_CLK_TCK));
   } else {
-    r["start_time"] = "-1";
+    results.set_start_time(-1);
+  }
+
+  if (!context.isAnyColumnUsed(ProcessesRow::DISK_BYTES_READ |
+                               ProcessesRow::DISK_BYTES_WRITTEN)) {
+    return;
   }
 
+  // Parse the process io
+  SimpleProcIo proc_io(pid);
   if (!proc_io.status.ok()) {
     // /proc/<pid>/io can require root to access, so don't fail if we can't
     VLOG(1) << proc_io.status.getMessage();
   } else {
-    r["disk_bytes_read"] = proc_io.read_bytes;
+    results.setString(ProcessesBatch::DISK_BYTES_READ, proc_io.read_bytes);
     long long write_bytes = tryTo<long long>(proc_io.write_bytes).takeOr(0ll);
     long long cancelled_write_bytes =
         tryTo<long long>(proc_io.cancelled_write_bytes).takeOr(0ll);
 
-    r["disk_bytes_written"] =
-        std::to_string(write_bytes - cancelled_write_bytes);
+    results.set_disk_bytes_written(write_bytes - cancelled_write_bytes);
   }
-
-  results.push_back(r);
 }
 
 void genNamespaces(const std::string& pid, QueryData& results) {
@@ -480,19 +523,31 @@ void genNamespaces(const std::string& pid, QueryData& results) {
   results.push_back(r);
 }
 
-TableRows genProcesses(QueryContext& context) {
-  TableRows results;
-  auto system_boot_time = getUptime();
-  if (system_boot_time > 0) {
-    system_boot_time = std::time(nullptr) - system_boot_time;
+void genProcesses(RowYield& yield, QueryContext& context) {
+  long system_boot_time = 0;
+  if (context.isAnyColumnUsed(ProcessesRow::START_TIME)) {
+    system_boot_time = getUptime();
+    if (system_boot_time > 0) {
+      system_boot_time = std::time(nullptr) - system_boot_time;
+    }
   }
 
+  // Each process is read when SQLite asks for the next row, a scan stopped
+  // by a LIMIT does not read the remaining processes.
   auto pidlist = getProcList(context);
+  std::shared_ptr<ProcessesBatch> results;
   for (const auto& pid : pidlist) {
-    genProcess(pid, system_boot_time, results);
-  }
+    if (results == nullptr || results->size() == kProcessesBatchRows) {
+      results = std::make_shared<ProcessesBatch>();
+      results->reserve(std::min(kProcessesBatchRows, pidlist.size()));
+    }
 
-  return results;
+    auto index = results->size();
+    genProcess(pid, system_boot_time, context, *results);
+    if (results->size() > index) {
+      yield(TableRowHolder(new ColumnarTableRow(results, index)));
+    }
+  }
 }
 
 QueryData genProcessEnvs(QueryContext& context) {
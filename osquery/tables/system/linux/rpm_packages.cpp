@@ -21,7 +21,10 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/rows/rpm_packages.h>
+#include <osquery/sql/columnar_table_row.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/utils/scope_guard.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -39,6 +42,22 @@ namespace tables {
 // Maximum number of files per RPM.
 #define MAX_RPM_FILES (64 * 1024)
 
+/// Header tags read for each rpm_packages column.
+const std::vector<std::pair<RpmPackagesBatch::ColumnIndex, rpmTag>>
+    kRpmPackageColumnTags = {
+        {RpmPackagesBatch::NAME, RPMTAG_NAME},
+        {RpmPackagesBatch::VERSION, RPMTAG_VERSION},
+        {RpmPackagesBatch::RELEASE, RPMTAG_RELEASE},
+        {RpmPackagesBatch::SOURCE, RPMTAG_SOURCERPM},
+        {RpmPackagesBatch::SIZE, RPMTAG_SIZE},
+        {RpmPackagesBatch::SHA1, RPMTAG_SHA1HEADER},
+        {RpmPackagesBatch::ARCH, RPMTAG_ARCH},
+        {RpmPackagesBatch::EPOCH, RPMTAG_EPOCH},
+        {RpmPackagesBatch::INSTALL_TIME, RPMTAG_INSTALLTIME},
+        {RpmPackagesBatch::VENDOR, RPMTAG_VENDOR},
+        {RpmPackagesBatch::PACKAGE_GROUP, RPMTAG_GROUP},
+};
+
 /**
  * @brief Return a string representation of the RPM tag type.
  *
@@ -77,6 +96,35 @@ static std::string getRpmAttribute(const Header& header,
   return result;
 }
 
+/**
+ * @brief Set a batch column of the last row from an RPM header tag.
+ *
+ * Numeric tags are stored without the string round trip of getRpmAttribute,
+ * a tag that cannot be read keeps the empty text getRpmAttribute returns.
+ */
+static void setRpmAttribute(RpmPackagesBatch& results,
+                            size_t col,
+                            const Header& header,
+                            rpmTag tag,
+                            const rpmtd& td,
+                            Logger& logger) {
+  if (headerGet(header, tag, td, HEADERGET_DEFAULT) == 0) {
+    // Intentional check for a 0 = failure.
+    logger.vlog(1, "Could not get RPM header flag.");
+    results.setString(col, "");
+    return;
+  }
+
+  if (rpmTagGetClass(tag) == RPM_NUMERIC_CLASS) {
+    results.setInteger(col, static_cast<long long>(rpmtdGetNumber(td)));
+  } else if (rpmTagGetClass(tag) == RPM_STRING_CLASS) {
+    const char* attr = rpmtdGetString(td);
+    results.setString(col, (attr != nullptr) ? attr : "");
+  } else {
+    results.setString(col, "");
+  }
+}
+
 class RpmEnvironmentManager : public boost::noncopyable {
  public:
   RpmEnvironmentManager(Logger& logger)
@@ -125,13 +173,13 @@ class RpmEnvironmentManager : public boost::noncopyable {
   Logger* logger_;
 };
 
-QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
-
+void genRpmPackageRows(QueryContext& context,
+                       Logger& logger,
+                       RpmPackagesBatch& results) {
   auto dropper = DropPrivileges::get();
   if (!dropper->dropTo("nobody") && isUserAdmin()) {
     logger.log(google::GLOG_WARNING, "Cannot drop privileges for rpm_packages");
-    return results;
+    return;
   }
 
   // Isolate RPM/package inspection to the canonical: /usr/lib/rpm.
@@ -141,7 +189,7 @@ QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
   rpmInitCrypto();
   if (rpmReadConfigFiles(nullptr, nullptr) != 0) {
     logger.vlog(1, "Cannot read RPM configuration files");
-    return results;
+    return;
   }
 
   rpmts ts = rpmtsCreate();
@@ -153,43 +201,50 @@ QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
   }
 
+  // Only look up the header tags of selected columns.
+  std::vector<std::pair<RpmPackagesBatch::ColumnIndex, rpmTag>> tags;
+  for (const auto& column_tag : kRpmPackageColumnTags) {
+    if (context.isColumnUsed(results.columnName(column_tag.first))) {
+      tags.push_back(column_tag);
+    }
+  }
+
   Header header;
   while ((header = rpmdbNextIterator(matches)) != nullptr) {
-    Row r;
+    results.append();
     rpmtd td = rpmtdNew();
-    r["name"] = getRpmAttribute(header, RPMTAG_NAME, td, logger);
-    r["version"] = getRpmAttribute(header, RPMTAG_VERSION, td, logger);
-    r["release"] = getRpmAttribute(header, RPMTAG_RELEASE, td, logger);
-    r["source"] = getRpmAttribute(header, RPMTAG_SOURCERPM, td, logger);
-    r["size"] = getRpmAttribute(header, RPMTAG_SIZE, td, logger);
-    r["sha1"] = getRpmAttribute(header, RPMTAG_SHA1HEADER, td, logger);
-    r["arch"] = getRpmAttribute(header, RPMTAG_ARCH, td, logger);
-    r["epoch"] = INTEGER(getRpmAttribute(header, RPMTAG_EPOCH, td, logger));
-    r["install_time"] =
-        INTEGER(getRpmAttribute(header, RPMTAG_INSTALLTIME, td, logger));
-    r["vendor"] = getRpmAttribute(header, RPMTAG_VENDOR, td, logger);
-    r["package_group"] = getRpmAttribute(header, RPMTAG_GROUP, td, logger);
-    r["pid_with_namespace"] = "0";
+    for (const auto& column_tag : tags) {
+      setRpmAttribute(
+          results, column_tag.first, header, column_tag.second, td, logger);
+    }
+    results.set_pid_with_namespace(0);
 
     rpmtdFree(td);
-    results.push_back(r);
   }
 
   rpmdbFreeIterator(matches);
   rpmtsFree(ts);
   rpmFreeCrypto();
   rpmFreeRpmrc();
+}
 
-  return results;
+QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
+  RpmPackagesBatch results;
+  genRpmPackageRows(context, logger, results);
+  return queryDataFromColumnar(results);
 }
 
-QueryData genRpmPackages(QueryContext& context) {
+TableRows genRpmPackages(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "rpm_packages", genRpmPackagesImpl);
-  } else {
-    GLOGLogger logger;
-    return genRpmPackagesImpl(context, logger);
+    return tableRowsFromQueryData(
+        generateInNamespace(context, "rpm_packages", genRpmPackagesImpl));
   }
+
+  // The whole package database is read in one pass, the rows share a batch.
+  GLOGLogger logger;
+  auto results = std::make_shared<RpmPackagesBatch>();
+  genRpmPackageRows(context, logger, *results);
+  return tableRowsFromColumnar(results);
 }
 
 void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
@@ -218,24 +273,31 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
   }
 
+  // SQLite may stop reading rows at any yield, which unwinds this scope.
+  auto const rpmdb_guard = scope_guard::create([ts, matches]() {
+    rpmdbFreeIterator(matches);
+    rpmtsFree(ts);
+    rpmFreeRpmrc();
+  });
+
   Header header;
   while ((header = rpmdbNextIterator(matches)) != nullptr) {
     rpmtd td = rpmtdNew();
     rpmfi fi = rpmfiNew(ts, header, RPMTAG_BASENAMES, RPMFI_NOHEADER);
+    auto const package_guard = scope_guard::create([td, fi]() {
+      rpmfiFree(fi);
+      rpmtdFree(td);
+    });
     std::string package_name = getRpmAttribute(header, RPMTAG_NAME, td, logger);
 
     auto file_count = rpmfiFC(fi);
     if (file_count <= 0) {
       logger.vlog(1, "RPM package " + package_name + " contains 0 files");
-      rpmfiFree(fi);
-      rpmtdFree(td);
       continue;
     } else if (file_count > MAX_RPM_FILES) {
       logger.vlog(1,
                   "RPM package " + package_name + " contains over " +
                       std::to_string(MAX_RPM_FILES) + " files");
-      rpmfiFree(fi);
-      rpmtdFree(td);
       continue;
     }
 
@@ -263,14 +325,7 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
 
       yield(std::move(r));
     }
-
-    rpmfiFree(fi);
-    rpmtdFree(td);
   }
-
-  rpmdbFreeIterator(matches);
-  rpmtsFree(ts);
-  rpmFreeRpmrc();
 }
 } // namespace tables
 } // namespace osquery
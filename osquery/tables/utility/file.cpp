@@ -11,13 +11,17 @@
 #include <sys/stat.h>
 #endif
 
+#include <functional>
+
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/rows/file.h>
+#include <osquery/sql/columnar_table_row.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
-#include <osquery/worker/logging/glog/glog_logger.h>
 
 namespace fs = boost::filesystem;
 
@@ -25,6 +29,8 @@ namespace osquery {
 
 namespace tables {
 
+const size_t kFileBatchRows = 256;
+
 #if !defined(WIN32)
 
 const std::map<fs::file_type, std::string> kTypeNames{
@@ -44,16 +50,8 @@ const std::map<fs::file_type, std::string> kTypeNames{
 void genFileInfo(const fs::path& path,
                  const fs::path& parent,
                  const std::string& pattern,
-                 QueryData& results) {
-  // Must provide the path, filename, directory separate from boost path->string
-  // helpers to match any explicit (query-parsed) predicate constraints.
-
-  Row r;
-  r["path"] = path.string();
-  r["filename"] = path.filename().string();
-  r["directory"] = parent.string();
-  r["symlink"] = "0";
-
+                 const QueryContext& context,
+                 FileBatch& results) {
 #if !defined(WIN32)
 
   struct stat file_stat;
@@ -64,42 +62,64 @@ void genFileInfo(const fs::path& path,
     // Path was not real, had too may links, or could not be accessed.
     return;
   }
-  if (S_ISLNK(link_stat.st_mode)) {
-    r["symlink"] = "1";
-  }
 
   if (stat(path.string().c_str(), &file_stat)) {
     file_stat = link_stat;
   }
 
-  r["inode"] = BIGINT(file_stat.st_ino);
-  r["uid"] = BIGINT(file_stat.st_uid);
-  r["gid"] = BIGINT(file_stat.st_gid);
-  r["mode"] = lsperms(file_stat.st_mode);
-  r["device"] = BIGINT(file_stat.st_rdev);
-  r["size"] = BIGINT(file_stat.st_size);
-  r["block_size"] = INTEGER(file_stat.st_blksize);
-  r["hard_links"] = INTEGER(file_stat.st_nlink);
+#else
+
+  WINDOWS_STAT file_stat;
+
+  auto rtn = platformStat(path, &file_stat);
+  if (!rtn.ok()) {
+    VLOG(1) << "PlatformStat failed with " << rtn.getMessage();
+    return;
+  }
+
+#endif
+
+  // Must provide the path, filename, directory separate from boost path->string
+  // helpers to match any explicit (query-parsed) predicate constraints.
+  results.append();
+  results.set_path(path.string());
+  results.set_filename(path.filename().string());
+  results.set_directory(parent.string());
+
+#if !defined(WIN32)
+
+  results.set_symlink(S_ISLNK(link_stat.st_mode) ? 1 : 0);
+  results.set_inode(static_cast<long long>(file_stat.st_ino));
+  results.set_uid(static_cast<long long>(file_stat.st_uid));
+  results.set_gid(static_cast<long long>(file_stat.st_gid));
+  results.set_mode(lsperms(file_stat.st_mode));
+  results.set_device(static_cast<long long>(file_stat.st_rdev));
+  results.set_size(static_cast<long long>(file_stat.st_size));
+  results.set_block_size(static_cast<long long>(file_stat.st_blksize));
+  results.set_hard_links(static_cast<long long>(file_stat.st_nlink));
 
-  r["atime"] = BIGINT(file_stat.st_atime);
-  r["mtime"] = BIGINT(file_stat.st_mtime);
-  r["ctime"] = BIGINT(file_stat.st_ctime);
+  results.set_atime(static_cast<long long>(file_stat.st_atime));
+  results.set_mtime(static_cast<long long>(file_stat.st_mtime));
+  results.set_ctime(static_cast<long long>(file_stat.st_ctime));
 
 #if defined(__linux__)
   // No 'birth' or create time in Linux or Windows.
-  r["btime"] = "0";
-  r["pid_with_namespace"] = "0";
+  results.set_btime(0);
+  results.set_pid_with_namespace(0);
 #else
-  r["btime"] = BIGINT(file_stat.st_birthtimespec.tv_sec);
+  results.set_btime(
+      static_cast<long long>(file_stat.st_birthtimespec.tv_sec));
 #endif
 
-  // Type booleans
-  boost::system::error_code ec;
-  auto status = fs::status(path, ec);
-  if (kTypeNames.count(status.type())) {
-    r["type"] = kTypeNames.at(status.type());
-  } else {
-    r["type"] = "unknown";
+  // Type booleans, resolving the type costs another stat.
+  if (context.isColumnUsed("type")) {
+    boost::system::error_code ec;
+    auto status = fs::status(path, ec);
+    if (kTypeNames.count(status.type())) {
+      results.set_type(kTypeNames.at(status.type()));
+    } else {
+      results.set_type("unknown");
+    }
   }
 
 #if defined(__APPLE__)
@@ -110,47 +130,38 @@ void genFileInfo(const fs::path& path,
         << path;
   }
 
-  r["bsd_flags"] = bsd_file_flags_description;
+  results.set_bsd_flags(bsd_file_flags_description);
 #endif
 
 #else
 
-  WINDOWS_STAT file_stat;
-
-  auto rtn = platformStat(path, &file_stat);
-  if (!rtn.ok()) {
-    VLOG(1) << "PlatformStat failed with " << rtn.getMessage();
-    return;
-  }
-
-  r["symlink"] = INTEGER(file_stat.symlink);
-  r["inode"] = BIGINT(file_stat.inode);
-  r["uid"] = BIGINT(file_stat.uid);
-  r["gid"] = BIGINT(file_stat.gid);
-  r["mode"] = SQL_TEXT(file_stat.mode);
-  r["device"] = BIGINT(file_stat.device);
-  r["size"] = BIGINT(file_stat.size);
-  r["block_size"] = INTEGER(file_stat.block_size);
-  r["hard_links"] = INTEGER(file_stat.hard_links);
-  r["atime"] = BIGINT(file_stat.atime);
-  r["mtime"] = BIGINT(file_stat.mtime);
-  r["ctime"] = BIGINT(file_stat.ctime);
-  r["btime"] = BIGINT(file_stat.btime);
-  r["type"] = SQL_TEXT(file_stat.type);
-  r["attributes"] = SQL_TEXT(file_stat.attributes);
-  r["file_id"] = SQL_TEXT(file_stat.file_id);
-  r["volume_serial"] = SQL_TEXT(file_stat.volume_serial);
-  r["product_version"] = SQL_TEXT(file_stat.product_version);
-  r["file_version"] = SQL_TEXT(file_stat.file_version);
+  results.set_symlink(file_stat.symlink);
+  results.set_inode(file_stat.inode);
+  results.set_uid(file_stat.uid);
+  results.set_gid(file_stat.gid);
+  results.set_mode(file_stat.mode);
+  results.set_device(file_stat.device);
+  results.set_size(file_stat.size);
+  results.set_block_size(file_stat.block_size);
+  results.set_hard_links(file_stat.hard_links);
+  results.set_atime(file_stat.atime);
+  results.set_mtime(file_stat.mtime);
+  results.set_ctime(file_stat.ctime);
+  results.set_btime(file_stat.btime);
+  results.set_type(file_stat.type);
+  results.set_attributes(file_stat.attributes);
+  results.set_file_id(file_stat.file_id);
+  results.set_volume_serial(file_stat.volume_serial);
+  results.set_product_version(file_stat.product_version);
+  results.set_file_version(file_stat.file_version);
 
 #endif
-
-  results.push_back(r);
 }
 
-QueryData genFileImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
-
+void genFilePaths(
+    QueryContext& context,
+    const std::function<void(const fs::path& path, const fs::path& parent)>&
+        predicate) {
   // Resolve file paths for EQUALS and LIKE operations.
   auto paths = context.constraints["path"].getAll(EQUALS);
   context.expandConstraints(
@@ -172,7 +183,7 @@ QueryData genFileImpl(QueryContext& context, Logger& logger) {
   // Iterate through each of the resolved/supplied paths.
   for (const auto& path_string : paths) {
     fs::path path = path_string;
-    genFileInfo(path, path.parent_path(), "", results);
+    predicate(path, path.parent_path());
   }
 
   // Resolve directories for EQUALS and LIKE operations.
@@ -203,23 +214,45 @@ QueryData genFileImpl(QueryContext& context, Logger& logger) {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
       for (; begin != end; ++begin) {
-        genFileInfo(begin->path(), directory_string, "", results);
+        predicate(begin->path(), directory_string);
       }
     } catch (const fs::filesystem_error& /* e */) {
       continue;
     }
   }
+}
 
-  return results;
+QueryData genFileImpl(QueryContext& context, Logger& logger) {
+  FileBatch results;
+  genFilePaths(context, [&](const fs::path& path, const fs::path& parent) {
+    genFileInfo(path, parent, "", context, results);
+  });
+  return queryDataFromColumnar(results);
 }
 
-QueryData genFile(QueryContext& context) {
+void genFile(RowYield& yield, QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "file", genFileImpl);
-  } else {
-    GLOGLogger logger;
-    return genFileImpl(context, logger);
+    // Rows generated within another namespace are returned all at once.
+    for (auto& r : generateInNamespace(context, "file", genFileImpl)) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    return;
   }
+
+  // Stat each file when SQLite asks for the next row, the rows are appended
+  // to shared batches and yielded as views into them.
+  std::shared_ptr<FileBatch> results;
+  genFilePaths(context, [&](const fs::path& path, const fs::path& parent) {
+    if (results == nullptr || results->size() == kFileBatchRows) {
+      results = std::make_shared<FileBatch>();
+    }
+
+    auto index = results->size();
+    genFileInfo(path, parent, "", context, *results);
+    if (results->size() > index) {
+      yield(TableRowHolder(new ColumnarTableRow(results, index)));
+    }
+  });
 }
 } // namespace tables
 } // namespace osquery
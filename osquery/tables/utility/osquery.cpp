@@ -13,6 +13,7 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
+#include <osquery/database/database.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/eventsubscriber.h>
@@ -33,6 +34,17 @@ DECLARE_bool(disable_events);
 
 namespace tables {
 
+QueryData genOsqueryDatabaseStats(QueryContext& context) {
+  QueryData results;
+
+  auto status = getDatabaseStats(results);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot read the database statistics: " << status.getMessage();
+  }
+
+  return results;
+}
+
 QueryData genOsqueryEvents(QueryContext& context) {
   QueryData results;
 
@@ -48,11 +60,15 @@ QueryData genOsqueryEvents(QueryContext& context) {
       r["subscriptions"] = INTEGER(pubref->numSubscriptions());
       r["events"] = INTEGER(pubref->numEvents());
       r["refreshes"] = INTEGER(pubref->restartCount());
+      r["dropped"] = BIGINT(pubref->droppedCount());
+      r["backpressure"] = BIGINT(pubref->backpressureCount());
       r["active"] = (pubref->hasStarted() && !pubref->isEnding()) ? "1" : "0";
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
       r["refreshes"] = "0";
+      r["dropped"] = "0";
+      r["backpressure"] = "0";
       r["active"] = "-1";
     }
     results.push_back(r);
@@ -65,6 +81,8 @@ QueryData genOsqueryEvents(QueryContext& context) {
     r["type"] = "subscriber";
     // Subscribers will never 'restart'.
     r["refreshes"] = "0";
+    r["dropped"] = "0";
+    r["backpressure"] = "0";
 
     auto subref = EventFactory::getEventSubscriber(subscriber);
     if (subref != nullptr) {
@@ -14,6 +14,7 @@
 #include <unordered_map>
 
 #include <osquery/core/sql/query_data.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
 #include <osquery/worker/ipc/table_ipc_json_converter.h>
 
 #include <osquery/worker/logging/glog_logger_types.h>
@@ -23,6 +24,18 @@ template <typename Derived>
 class TableIPCBase {
  public:
   Status sendQueryData(const QueryData& query_data) {
+    if (binary_query_data_) {
+      std::string message;
+      auto status =
+          TableIPCBinaryConverter::queryDataToBinary(query_data, message);
+
+      if (!status.ok()) {
+        return status;
+      }
+
+      return static_cast<Derived&>(*this).sendJSONString(message);
+    }
+
     JSON json_helper;
     auto status =
         TableIPCJSONConverter::queryDataToJSON(query_data, json_helper);
@@ -80,6 +93,15 @@ class TableIPCBase {
     return static_cast<Derived&>(*this).sendJSONString(json_string);
   }
 
+  /**
+   * @brief Send QueryData in the binary encoding instead of JSON.
+   *
+   * The receiving side accepts both encodings.
+   */
+  void setBinaryQueryData(bool binary_query_data) {
+    binary_query_data_ = binary_query_data;
+  }
+
   Status recvJSONMessage(JSON& json_message, JSONMessageType& message_type) {
     std::string json_string;
     auto status = static_cast<Derived&>(*this).recvJSONString(json_string);
@@ -88,7 +110,13 @@ class TableIPCBase {
       return status;
     }
 
-    status = json_message.fromString(json_string);
+    return parseJSONMessage(json_string, json_message, message_type);
+  }
+
+  Status parseJSONMessage(const std::string& json_string,
+                          JSON& json_message,
+                          JSONMessageType& message_type) {
+    auto status = json_message.fromString(json_string);
 
     if (!status.ok()) {
       return status;
@@ -104,8 +132,26 @@ class TableIPCBase {
 
   Status processOneMessage(QueryData* query_results,
                            JSONMessageType& message_type) {
+    std::string message;
+    auto status = static_cast<Derived&>(*this).recvJSONString(message);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (TableIPCBinaryConverter::isBinaryQueryData(message)) {
+      message_type = JSONMessageType::QueryData;
+
+      if (!query_results) {
+        return Status::failure(1, "Received unexpected QueryData message");
+      }
+
+      return TableIPCBinaryConverter::binaryToQueryData(message,
+                                                        *query_results);
+    }
+
     JSON json_message;
-    Status status = recvJSONMessage(json_message, message_type);
+    status = parseJSONMessage(message, json_message, message_type);
 
     if (!status.ok()) {
       return status;
@@ -139,5 +185,8 @@ class TableIPCBase {
 
     return status;
   }
+
+ private:
+  bool binary_query_data_{false};
 };
 } // namespace osquery
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/worker/ipc/linux/shared_memory_channel_factory.h>
+#include <osquery/worker/ipc/posix/pipe_channel_factory.h>
+#include <osquery/worker/ipc/table_ipc_base.h>
+
+namespace osquery {
+
+/// Sends and receives QueryData messages through a single channel.
+template <typename Channel>
+class BenchmarkTableIPC : public TableIPCBase<BenchmarkTableIPC<Channel>> {
+ public:
+  explicit BenchmarkTableIPC(Channel& channel) : channel_(&channel) {}
+
+  Status sendJSONString(const std::string& json_string) {
+    return channel_->sendStringMessage(json_string);
+  }
+
+  Status recvJSONString(std::string& json_string) {
+    return channel_->recvStringMessage(json_string);
+  }
+
+  Status processLogMessage(const JSON&) {
+    return Status::success();
+  }
+
+  Status processJobMessage(const JSON&) {
+    return Status::success();
+  }
+
+  Status processQueryDataMessage(const JSON& json_message,
+                                 QueryData& query_results) {
+    return TableIPCJSONConverter::JSONToQueryData(json_message, query_results);
+  }
+
+ private:
+  Channel* channel_;
+};
+
+static QueryData getBenchmarkQueryData(size_t rows) {
+  QueryData query_data;
+  query_data.reserve(rows);
+
+  for (size_t i = 0; i < rows; i++) {
+    Row r;
+    r["pid"] = std::to_string(i);
+    r["name"] = "process" + std::to_string(i);
+    r["path"] = "/usr/local/bin/process" + std::to_string(i);
+    r["cmdline"] = "/usr/local/bin/process" + std::to_string(i) + " --flag";
+    r["uid"] = "1000";
+    r["resident_size"] = std::to_string(i * 4096);
+    r["pid_with_namespace"] = "1";
+    r["mount_namespace_id"] = "4026531840";
+    query_data.push_back(std::move(r));
+  }
+  return query_data;
+}
+
+/**
+ * The parent asks a forked worker for the same results, as the container
+ * IPC does for each query, and decodes them.
+ */
+template <typename ChannelFactory>
+static void benchmarkWorkerQueryData(benchmark::State& state, bool binary) {
+  using Channel = typename GetChannelType<ChannelFactory>::Channel;
+
+  auto rows = static_cast<size_t>(state.range(0));
+  auto query_data = getBenchmarkQueryData(rows);
+
+  ChannelFactory factory;
+  auto ticket = factory.createChannelTicket();
+
+  pid_t pid = fork();
+
+  if (pid == -1) {
+    state.SkipWithError("Failed to fork the worker");
+    return;
+  }
+
+  if (pid == 0) {
+    auto& channel = factory.createChildChannel("benchmark", std::move(ticket));
+    BenchmarkTableIPC<Channel> ipc(channel);
+    ipc.setBinaryQueryData(binary);
+
+    std::string request;
+    while (channel.recvStringMessage(request).ok()) {
+      if (!ipc.sendQueryData(query_data).ok()) {
+        break;
+      }
+    }
+    std::_Exit(0);
+  }
+
+  auto& channel =
+      factory.createParentChannel("benchmark", std::move(ticket), pid);
+  BenchmarkTableIPC<Channel> ipc(channel);
+
+  while (state.KeepRunning()) {
+    channel.sendStringMessage("Job");
+
+    QueryData results;
+    JSONMessageType message_type;
+    auto status = ipc.processOneMessage(&results, message_type);
+
+    if (!status.ok() || results.size() != rows) {
+      state.SkipWithError("Failed to receive the worker results");
+      break;
+    }
+  }
+
+  // Closing the channel stops the worker.
+  factory.dropTableChannel("benchmark");
+  waitpid(pid, nullptr, 0);
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+
+static void WORKER_IPC_pipe_json(benchmark::State& state) {
+  benchmarkWorkerQueryData<PipeChannelFactory>(state, false);
+}
+
+BENCHMARK(WORKER_IPC_pipe_json)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void WORKER_IPC_pipe_binary(benchmark::State& state) {
+  benchmarkWorkerQueryData<PipeChannelFactory>(state, true);
+}
+
+BENCHMARK(WORKER_IPC_pipe_binary)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void WORKER_IPC_shared_memory_binary(benchmark::State& state) {
+  benchmarkWorkerQueryData<SharedMemoryChannelFactory>(state, true);
+}
+
+BENCHMARK(WORKER_IPC_shared_memory_binary)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+} // namespace osquery
@@ -20,10 +20,12 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <type_traits>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/worker/ipc/linux/shared_memory_channel_factory.h>
 #include <osquery/worker/ipc/posix/pipe_channel_factory.h>
 #include <osquery/worker/ipc/table_ipc_json_converter.h>
 
@@ -39,6 +41,12 @@ CLI_FLAG(bool,
          "Keep the container worker running to be reused instead of closing it "
          "after each query");
 
+CLI_FLAG(bool,
+         container_worker_shared_memory,
+         false,
+         "Exchange the results of container workers through shared memory "
+         "instead of pipes");
+
 namespace {
 
 const std::string kProc = "/proc";
@@ -133,14 +141,22 @@ ProcessState checkProcessStateAndLog(const PlatformProcess& process,
 extern template std::set<int> ConstraintList::getAll<int>(
     ConstraintOperator) const;
 
-LinuxTableContainerIPC::LinuxTableContainerIPC(PipeChannelFactory& factory)
-    : ipc_(factory, *this) {}
+template <typename ChannelFactory>
+LinuxTableContainerIPC<ChannelFactory>::LinuxTableContainerIPC(
+    ChannelFactory& factory)
+    : ipc_(factory, *this) {
+  // The worker encodes the results, it inherits this setting when forked.
+  ipc_.setBinaryQueryData(
+      std::is_same<ChannelFactory, SharedMemoryChannelFactory>::value);
+}
 
-LinuxTableContainerIPC::~LinuxTableContainerIPC() {
+template <typename ChannelFactory>
+LinuxTableContainerIPC<ChannelFactory>::~LinuxTableContainerIPC() {
   close(original_mnt_fd_);
 }
 
-Status LinuxTableContainerIPC::connectToContainer(
+template <typename ChannelFactory>
+Status LinuxTableContainerIPC<ChannelFactory>::connectToContainer(
     const std::string& table_name,
     bool keep_process_open,
     TableGeneratePtr function_ptr) {
@@ -170,7 +186,7 @@ Status LinuxTableContainerIPC::connectToContainer(
       stopContainerWorker();
     }
 
-    PipeChannelTicket channel_ticket = ipc_.createChannelTicket();
+    auto channel_ticket = ipc_.createChannelTicket();
 
     auto process_group = getpgrp();
     table_generate_ptr_ = function_ptr;
@@ -203,7 +219,8 @@ Status LinuxTableContainerIPC::connectToContainer(
 
   return Status::success();
 }
-void LinuxTableContainerIPC::stopContainerWorker() {
+template <typename ChannelFactory>
+void LinuxTableContainerIPC<ChannelFactory>::stopContainerWorker() {
   PlatformProcess child_process(std::move(current_running_process));
 
   if (child_process.pid() == kInvalidPid) {
@@ -257,9 +274,9 @@ void LinuxTableContainerIPC::stopContainerWorker() {
   }
 }
 
-Status LinuxTableContainerIPC::handleLog(GLOGLogType log_type,
-                                         int priority,
-                                         const std::string& message) {
+template <typename ChannelFactory>
+Status LinuxTableContainerIPC<ChannelFactory>::handleLog(
+    GLOGLogType log_type, int priority, const std::string& message) {
   auto logger = GLOGLogger::instance();
   switch (log_type) {
   case GLOGLogType::LOG: {
@@ -279,7 +296,9 @@ Status LinuxTableContainerIPC::handleLog(GLOGLogType log_type,
   return Status::success();
 }
 
-Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
+template <typename ChannelFactory>
+Status LinuxTableContainerIPC<ChannelFactory>::handleJob(
+    QueryContext& context) {
   QueryData query_data;
   auto pids_with_namespace =
       context.constraints.at("pid_with_namespace").getAll<int>(EQUALS);
@@ -359,7 +378,8 @@ Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
   return write_status;
 }
 
-void LinuxTableContainerIPC::executeQueryJobs() {
+template <typename ChannelFactory>
+void LinuxTableContainerIPC<ChannelFactory>::executeQueryJobs() {
   int exit_status_code = 0;
   if (keep_process_open_) {
     while (true) {
@@ -391,7 +411,8 @@ void LinuxTableContainerIPC::executeQueryJobs() {
   std::_Exit(exit_status_code);
 }
 
-Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
+template <typename ChannelFactory>
+Status LinuxTableContainerIPC<ChannelFactory>::retrieveQueryDataFromContainer(
     const QueryContext& context, QueryData& result) {
   CleanupWorkerOnError cleanupOnError(*this);
   auto status = ipc_.sendJob(context);
@@ -417,16 +438,22 @@ Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
   return status;
 }
 
-QueryData generateInNamespace(const QueryContext& context,
-                              const std::string& table_name,
-                              TableGeneratePtr generate_ptr) {
+template class LinuxTableContainerIPC<PipeChannelFactory>;
+template class LinuxTableContainerIPC<SharedMemoryChannelFactory>;
+
+namespace {
+
+template <typename ChannelFactory>
+QueryData generateInNamespaceWith(const QueryContext& context,
+                                  const std::string& table_name,
+                                  TableGeneratePtr generate_ptr) {
   bool keep_container_worker_open = FLAGS_keep_container_worker_open;
   QueryData results;
 
-  static PipeChannelFactory factory;
+  static ChannelFactory factory;
 
   try {
-    LinuxTableContainerIPC ipc(factory);
+    LinuxTableContainerIPC<ChannelFactory> ipc(factory);
     auto status = ipc.connectToContainer(
         table_name, keep_container_worker_open, generate_ptr);
 
@@ -454,5 +481,18 @@ QueryData generateInNamespace(const QueryContext& context,
 
   return results;
 }
+} // namespace
+
+QueryData generateInNamespace(const QueryContext& context,
+                              const std::string& table_name,
+                              TableGeneratePtr generate_ptr) {
+  if (FLAGS_container_worker_shared_memory) {
+    return generateInNamespaceWith<SharedMemoryChannelFactory>(
+        context, table_name, generate_ptr);
+  }
+
+  return generateInNamespaceWith<PipeChannelFactory>(
+      context, table_name, generate_ptr);
+}
 
 }; // namespace osquery
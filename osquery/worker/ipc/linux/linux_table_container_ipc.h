@@ -17,6 +17,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/utils/status/status.h>
 
+#include "osquery/worker/ipc/linux/shared_memory_channel_factory.h"
 #include "osquery/worker/ipc/posix/pipe_channel.h"
 #include "osquery/worker/ipc/posix/pipe_channel_factory.h"
 #include "osquery/worker/ipc/table_ipc_message_handler.h"
@@ -31,11 +32,15 @@ using TableGeneratePtr = QueryData (*)(QueryContext& query_context,
  * @brief The LinuxTableContainerIPC class drives the logic to connect to, query
  * and retrieve results from a container, together with managing the container
  * worker lifetime.
+ *
+ * The ChannelFactory decides how the processes talk to each other,
+ * pipes with JSON messages or shared memory with binary QueryData messages.
  */
+template <typename ChannelFactory>
 class LinuxTableContainerIPC : TableIPCMessageHandler {
  public:
   LinuxTableContainerIPC() = delete;
-  LinuxTableContainerIPC(PipeChannelFactory& factory);
+  LinuxTableContainerIPC(ChannelFactory& factory);
   ~LinuxTableContainerIPC();
 
   Status connectToContainer(const std::string& table_name,
@@ -52,8 +57,8 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   Status handleJob(QueryContext& context) override;
 
  private:
-  LinuxTableIPC ipc_;
-  LinuxTableIPCLogger logger_{ipc_};
+  LinuxTableIPC<ChannelFactory> ipc_;
+  LinuxTableIPCLogger<ChannelFactory> logger_{ipc_};
   TableGeneratePtr table_generate_ptr_;
   bool keep_process_open_{false};
   int original_mnt_fd_{-1};
@@ -80,6 +85,9 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   FRIEND_TEST(WorkerTableContainerTests, test_ipc_container_connect);
 };
 
+extern template class LinuxTableContainerIPC<PipeChannelFactory>;
+extern template class LinuxTableContainerIPC<SharedMemoryChannelFactory>;
+
 inline bool hasNamespaceConstraint(const QueryContext& context) {
   return context.hasConstraint("pid_with_namespace");
 }
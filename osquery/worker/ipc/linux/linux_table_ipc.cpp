@@ -10,7 +10,9 @@
 #include "linux_table_ipc.h"
 
 namespace osquery {
-Status LinuxTableIPC::sendJSONString(const std::string& json_string) {
+template <typename ChannelFactory>
+Status LinuxTableIPC<ChannelFactory>::sendJSONString(
+    const std::string& json_string) {
   if (active_channel_ == nullptr) {
     return Status::failure("No active channel to write to");
   }
@@ -18,7 +20,9 @@ Status LinuxTableIPC::sendJSONString(const std::string& json_string) {
   return active_channel_->sendStringMessage(json_string);
 }
 
-Status LinuxTableIPC::recvJSONString(std::string& json_string) {
+template <typename ChannelFactory>
+Status LinuxTableIPC<ChannelFactory>::recvJSONString(
+    std::string& json_string) {
   if (active_channel_ == nullptr) {
     return Status::failure("No active channel to read from");
   }
@@ -26,7 +30,9 @@ Status LinuxTableIPC::recvJSONString(std::string& json_string) {
   return active_channel_->recvStringMessage(json_string);
 }
 
-Status LinuxTableIPC::processLogMessage(const JSON& json_message) {
+template <typename ChannelFactory>
+Status LinuxTableIPC<ChannelFactory>::processLogMessage(
+    const JSON& json_message) {
   std::string message;
   int priority;
   int log_type_int;
@@ -48,7 +54,9 @@ Status LinuxTableIPC::processLogMessage(const JSON& json_message) {
   return message_handler_->handleLog(log_type, priority, message);
 }
 
-Status LinuxTableIPC::processJobMessage(const JSON& json_message) {
+template <typename ChannelFactory>
+Status LinuxTableIPC<ChannelFactory>::processJobMessage(
+    const JSON& json_message) {
   QueryContext context;
 
   auto status = deserializeQueryContextJSON(json_message, context);
@@ -61,8 +69,9 @@ Status LinuxTableIPC::processJobMessage(const JSON& json_message) {
   return message_handler_->handleJob(context);
 }
 
-Status LinuxTableIPC::processQueryDataMessage(const JSON& json_message,
-                                              QueryData& query_results) {
+template <typename ChannelFactory>
+Status LinuxTableIPC<ChannelFactory>::processQueryDataMessage(
+    const JSON& json_message, QueryData& query_results) {
   auto status =
       TableIPCJSONConverter::JSONToQueryData(json_message, query_results);
 
@@ -73,7 +82,9 @@ Status LinuxTableIPC::processQueryDataMessage(const JSON& json_message,
   return Status::success();
 }
 
-bool LinuxTableIPC::setActiveChannelIfOpen(const std::string table_name) {
+template <typename ChannelFactory>
+bool LinuxTableIPC<ChannelFactory>::setActiveChannelIfOpen(
+    const std::string table_name) {
   auto* channel = factory_->getTableChannel(table_name);
 
   if (!channel) {
@@ -84,20 +95,24 @@ bool LinuxTableIPC::setActiveChannelIfOpen(const std::string table_name) {
   return true;
 }
 
-void LinuxTableIPC::connectToChild(const std::string table_name,
-                                   PipeChannelTicket channel_ticket,
-                                   pid_t child_pid) {
+template <typename ChannelFactory>
+void LinuxTableIPC<ChannelFactory>::connectToChild(
+    const std::string table_name,
+    ChannelTicket channel_ticket,
+    pid_t child_pid) {
   active_channel_ = &factory_->createParentChannel(
       table_name, std::move(channel_ticket), child_pid);
 }
 
-void LinuxTableIPC::connectToParent(const std::string table_name,
-                                    PipeChannelTicket channel_ticket) {
+template <typename ChannelFactory>
+void LinuxTableIPC<ChannelFactory>::connectToParent(
+    const std::string table_name, ChannelTicket channel_ticket) {
   active_channel_ =
       &factory_->createChildChannel(table_name, std::move(channel_ticket));
 }
 
-void LinuxTableIPC::closeActiveChannel() {
+template <typename ChannelFactory>
+void LinuxTableIPC<ChannelFactory>::closeActiveChannel() {
   if (active_channel_ == nullptr) {
     return;
   }
@@ -107,8 +122,12 @@ void LinuxTableIPC::closeActiveChannel() {
   active_channel_ = nullptr;
 }
 
-std::string LinuxTableIPC::getTableNameFromPid(pid_t pid) {
+template <typename ChannelFactory>
+std::string LinuxTableIPC<ChannelFactory>::getTableNameFromPid(pid_t pid) {
   return factory_->getTableNameFromPid(pid);
 }
 
+template class LinuxTableIPC<PipeChannelFactory>;
+template class LinuxTableIPC<SharedMemoryChannelFactory>;
+
 } // namespace osquery
@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <type_traits>
+#include <utility>
+
+#include <osquery/worker/ipc/linux/shared_memory_channel_factory.h>
 #include <osquery/worker/ipc/posix/pipe_channel.h>
 #include <osquery/worker/ipc/posix/pipe_channel_factory.h>
 
@@ -22,12 +26,17 @@ namespace osquery {
 /**
  * @brief The LinuxTableIPC class manages the communication and connection
  * between processes handling table logic, using JSON as message protocol and
- * blocking pipes as communication channel.
+ * a blocking channel, either pipes or shared memory, as communication channel.
  *
  */
-class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
+template <typename ChannelFactory>
+class LinuxTableIPC : public TableIPCBase<LinuxTableIPC<ChannelFactory>> {
  public:
-  LinuxTableIPC(PipeChannelFactory& factory,
+  using Channel = typename GetChannelType<ChannelFactory>::Channel;
+  using ChannelTicket =
+      decltype(std::declval<ChannelFactory&>().createChannelTicket());
+
+  LinuxTableIPC(ChannelFactory& factory,
                 TableIPCMessageHandler& message_handler)
       : factory_(&factory), message_handler_(&message_handler) {}
 
@@ -39,15 +48,15 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
   Status processQueryDataMessage(const JSON& json_message,
                                  QueryData& query_results);
 
-  PipeChannelTicket createChannelTicket() {
+  ChannelTicket createChannelTicket() {
     return factory_->createChannelTicket();
   }
   bool setActiveChannelIfOpen(const std::string table_name);
   void connectToChild(const std::string table_name,
-                      PipeChannelTicket channel_ticket,
+                      ChannelTicket channel_ticket,
                       pid_t child_pid);
   void connectToParent(const std::string table_name,
-                       PipeChannelTicket channel_ticket);
+                       ChannelTicket channel_ticket);
   void closeActiveChannel();
 
   std::string getTableNameFromPid(pid_t pid);
@@ -64,15 +73,19 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
   }
 
  private:
-  PipeChannel* active_channel_{nullptr};
-  PipeChannelFactory* factory_;
+  Channel* active_channel_{nullptr};
+  ChannelFactory* factory_;
   TableIPCMessageHandler* message_handler_;
 };
 
+extern template class LinuxTableIPC<PipeChannelFactory>;
+extern template class LinuxTableIPC<SharedMemoryChannelFactory>;
+
+template <typename ChannelFactory>
 class LinuxTableIPCLogger final : public Logger {
  public:
   LinuxTableIPCLogger() = delete;
-  LinuxTableIPCLogger(LinuxTableIPC& ipc) : ipc(&ipc) {}
+  LinuxTableIPCLogger(LinuxTableIPC<ChannelFactory>& ipc) : ipc(&ipc) {}
 
   void log(int severity, const std::string& message) override {
     ipc->sendLogMessage(severity, GLOGLogType::LOG, message);
@@ -82,6 +95,6 @@ class LinuxTableIPCLogger final : public Logger {
     ipc->sendLogMessage(priority, GLOGLogType::VLOG, message);
   }
 
-  LinuxTableIPC* ipc;
+  LinuxTableIPC<ChannelFactory>* ipc;
 };
 } // namespace osquery
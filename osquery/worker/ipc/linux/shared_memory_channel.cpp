@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "shared_memory_channel.h"
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+namespace osquery {
+
+SharedMemoryChannel::SharedMemoryChannel(const std::string& table_name,
+                                         void* memory,
+                                         size_t memory_size,
+                                         bool is_parent,
+                                         int read_pipe_fd,
+                                         int write_pipe_fd,
+                                         pid_t remote_pid)
+    : TableChannelBase<SharedMemoryChannel>(table_name),
+      memory(memory),
+      memory_size(memory_size),
+      ring_capacity((memory_size - 2 * sizeof(SharedMemoryRing)) / 2),
+      read_pipe_fd(read_pipe_fd),
+      write_pipe_fd(write_pipe_fd),
+      remote_pid(remote_pid) {
+  auto rings = static_cast<SharedMemoryRing*>(memory);
+  auto data = static_cast<char*>(memory) + 2 * sizeof(SharedMemoryRing);
+
+  // The parent sends through the first ring and the child through the second.
+  size_t send_index = is_parent ? 0 : 1;
+  size_t recv_index = 1 - send_index;
+
+  send_ring = &rings[send_index];
+  send_data = data + send_index * ring_capacity;
+  recv_ring = &rings[recv_index];
+  recv_data = data + recv_index * ring_capacity;
+}
+
+SharedMemoryChannel::~SharedMemoryChannel() {
+  munmap(memory, memory_size);
+  close(read_pipe_fd);
+  close(write_pipe_fd);
+}
+
+size_t SharedMemoryChannel::getMemorySize(size_t ring_capacity) {
+  return 2 * sizeof(SharedMemoryRing) + 2 * ring_capacity;
+}
+
+Status SharedMemoryChannel::sendStringMessageImpl(const std::string& message) {
+  if (message.size() == 0) {
+    return Status::failure("Cannot send a zero length message");
+  }
+
+  if (message.size() > std::numeric_limits<ssize_t>::max()) {
+    return Status::failure("Cannot send, message too big, " +
+                           std::to_string(message.size()) + " bytes");
+  }
+
+  // Data written to the ring would not fail when the remote is gone,
+  // so check explicitly to report the same error as a pipe.
+  if (isRemoteClosed()) {
+    return Status::failure(
+        EPIPE, "Shared memory channel of table " + table_name_ + " closed");
+  }
+
+  const ssize_t message_size = static_cast<ssize_t>(message.size());
+
+  auto status = writeBytes(reinterpret_cast<const char*>(&message_size),
+                           sizeof(message_size));
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  return writeBytes(message.data(), message.size());
+}
+
+Status SharedMemoryChannel::recvStringMessageImpl(std::string& message) {
+  ssize_t message_size;
+  auto status =
+      readBytes(reinterpret_cast<char*>(&message_size), sizeof(message_size));
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (message_size <= 0) {
+    return Status::failure("Message size too small, it's " +
+                           std::to_string(message_size) + " bytes");
+  }
+
+  message.resize(static_cast<size_t>(message_size));
+  return readBytes(&message[0], message.size());
+}
+
+Status SharedMemoryChannel::writeBytes(const char* data, size_t size) {
+  while (size > 0) {
+    auto write_pos = send_ring->write_pos.load(std::memory_order_relaxed);
+    auto read_pos = send_ring->read_pos.load(std::memory_order_acquire);
+    auto free_space = ring_capacity - static_cast<size_t>(write_pos - read_pos);
+
+    if (free_space == 0) {
+      auto status = waitForRemote(send_ring->writer_waiting, [this]() {
+        return send_ring->write_pos.load() - send_ring->read_pos.load() <
+               ring_capacity;
+      });
+
+      if (!status.ok()) {
+        return Status::failure(EPIPE,
+                               "Shared memory channel of table " + table_name_ +
+                                   " closed while writing");
+      }
+      continue;
+    }
+
+    // Copy up to the free space, wrapping at the end of the ring.
+    auto offset = static_cast<size_t>(write_pos % ring_capacity);
+    auto chunk = std::min(size, free_space);
+    auto first = std::min(chunk, ring_capacity - offset);
+    std::memcpy(send_data + offset, data, first);
+    std::memcpy(send_data, data + first, chunk - first);
+
+    send_ring->write_pos.store(write_pos + chunk);
+
+    auto status = notifyRemote(send_ring->reader_waiting);
+    if (!status.ok()) {
+      return status;
+    }
+
+    data += chunk;
+    size -= chunk;
+  }
+
+  return Status::success();
+}
+
+Status SharedMemoryChannel::readBytes(char* data, size_t size) {
+  while (size > 0) {
+    auto read_pos = recv_ring->read_pos.load(std::memory_order_relaxed);
+    auto write_pos = recv_ring->write_pos.load(std::memory_order_acquire);
+    auto available = static_cast<size_t>(write_pos - read_pos);
+
+    if (available == 0) {
+      auto status = waitForRemote(recv_ring->reader_waiting, [this]() {
+        return recv_ring->write_pos.load() != recv_ring->read_pos.load();
+      });
+
+      if (!status.ok()) {
+        return Status::failure(2,
+                               "Shared memory channel of table " + table_name_ +
+                                   " closed while reading");
+      }
+      continue;
+    }
+
+    auto offset = static_cast<size_t>(read_pos % ring_capacity);
+    auto chunk = std::min(size, available);
+    auto first = std::min(chunk, ring_capacity - offset);
+    std::memcpy(data, recv_data + offset, first);
+    std::memcpy(data + first, recv_data, chunk - first);
+
+    recv_ring->read_pos.store(read_pos + chunk);
+
+    // The data has been read already; a remote that went away while waiting
+    // for space will be noticed on the next read.
+    notifyRemote(recv_ring->writer_waiting);
+
+    data += chunk;
+    size -= chunk;
+  }
+
+  return Status::success();
+}
+
+Status SharedMemoryChannel::waitForRemote(
+    std::atomic<uint32_t>& waiting_flag,
+    const std::function<bool()>& condition) {
+  while (true) {
+    // The flag has to be visible before the condition is checked again,
+    // otherwise the remote could update the ring without waking us up.
+    // It's set on every iteration, since a late wake up meant for
+    // a previous wait can clear it.
+    waiting_flag.store(1);
+
+    if (condition()) {
+      break;
+    }
+
+    struct pollfd fds[1];
+    fds[0].fd = read_pipe_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+
+    auto result = poll(fds, 1, -1);
+
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      waiting_flag.store(0);
+      return Status::failure(errno,
+                             "Failed to wait on the doorbell of table " +
+                                 table_name_ + ", errno " +
+                                 std::to_string(errno));
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char doorbell[64];
+      if (read(read_pipe_fd, doorbell, sizeof(doorbell)) > 0) {
+        continue;
+      }
+    }
+
+    // The remote closed its end, give it a last chance to have
+    // completed the update we are waiting for.
+    if (fds[0].revents & (POLLHUP | POLLERR | POLLIN)) {
+      waiting_flag.store(0);
+      return condition() ? Status::success()
+                         : Status::failure(2, "Remote side closed");
+    }
+  }
+
+  waiting_flag.store(0);
+  return Status::success();
+}
+
+Status SharedMemoryChannel::notifyRemote(std::atomic<uint32_t>& waiting_flag) {
+  if (waiting_flag.load() == 0 || waiting_flag.exchange(0) == 0) {
+    return Status::success();
+  }
+
+  auto old_mask = blockSIGPIPE();
+  char doorbell = 0;
+  ssize_t result;
+  do {
+    result = write(write_pipe_fd, &doorbell, sizeof(doorbell));
+  } while (result < 0 && errno == EINTR);
+  restoreSIGPIPE(old_mask);
+
+  if (result < 0) {
+    return Status::failure(errno,
+                           "Failed to ring the doorbell of table " +
+                               table_name_ + ", errno " +
+                               std::to_string(errno));
+  }
+
+  return Status::success();
+}
+
+bool SharedMemoryChannel::isRemoteClosed() {
+  struct pollfd fds[1];
+  fds[0].fd = read_pipe_fd;
+  fds[0].events = 0;
+  fds[0].revents = 0;
+
+  return poll(fds, 1, 0) > 0 && (fds[0].revents & (POLLHUP | POLLERR)) != 0;
+}
+
+sigset_t SharedMemoryChannel::blockSIGPIPE() {
+  sigset_t new_mask;
+  sigset_t old_mask;
+
+  sigemptyset(&new_mask);
+  sigaddset(&new_mask, SIGPIPE);
+
+  pthread_sigmask(SIG_BLOCK, &new_mask, &old_mask);
+
+  return old_mask;
+}
+
+void SharedMemoryChannel::restoreSIGPIPE(const sigset_t& old_mask) {
+  pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+}
+} // namespace osquery
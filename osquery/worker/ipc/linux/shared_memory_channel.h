@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <signal.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include <osquery/utils/status/status.h>
+
+#include "osquery/worker/ipc/table_channel_base.h"
+
+namespace osquery {
+
+/**
+ * @brief Control block of one direction of a SharedMemoryChannel.
+ *
+ * The positions count the bytes written and read since the channel was
+ * created, the data lives in a separate region of the same mapping.
+ * The waiting flags tell the other side that a process is blocked on
+ * its doorbell pipe and has to be woken up.
+ */
+struct alignas(64) SharedMemoryRing {
+  std::atomic<uint64_t> write_pos;
+  std::atomic<uint64_t> read_pos;
+  std::atomic<uint32_t> reader_waiting;
+  std::atomic<uint32_t> writer_waiting;
+};
+
+/**
+ * @brief A channel that moves messages through two ring buffers in a
+ * shared memory mapping, one for each direction.
+ *
+ * Each side also owns a doorbell pipe, which is only written to when the
+ * other side is waiting for data or for free space, and whose hang up
+ * tells that the other side has gone away.
+ */
+class SharedMemoryChannel : public TableChannelBase<SharedMemoryChannel> {
+ public:
+  SharedMemoryChannel() = delete;
+  SharedMemoryChannel(const std::string& table_name,
+                      void* memory,
+                      size_t memory_size,
+                      bool is_parent,
+                      int read_pipe_fd,
+                      int write_pipe_fd,
+                      pid_t remote_pid);
+  ~SharedMemoryChannel();
+
+  pid_t getRemotePid() {
+    return remote_pid;
+  }
+
+  /// Size of the mapping holding the two rings of the given capacity.
+  static size_t getMemorySize(size_t ring_capacity);
+
+ private:
+  friend TableChannelBase<SharedMemoryChannel>;
+
+  Status sendStringMessageImpl(const std::string& message);
+  Status recvStringMessageImpl(std::string& message);
+
+  Status writeBytes(const char* data, size_t size);
+  Status readBytes(char* data, size_t size);
+
+  /// Block until the condition is true or the remote side goes away.
+  Status waitForRemote(std::atomic<uint32_t>& waiting_flag,
+                       const std::function<bool()>& condition);
+  Status notifyRemote(std::atomic<uint32_t>& waiting_flag);
+  bool isRemoteClosed();
+
+  sigset_t blockSIGPIPE();
+  void restoreSIGPIPE(const sigset_t& old_mask);
+
+  void* const memory;
+  const size_t memory_size;
+  const size_t ring_capacity;
+
+  SharedMemoryRing* send_ring;
+  char* send_data;
+  SharedMemoryRing* recv_ring;
+  char* recv_data;
+
+  const int read_pipe_fd;
+  const int write_pipe_fd;
+  const pid_t remote_pid;
+};
+} // namespace osquery
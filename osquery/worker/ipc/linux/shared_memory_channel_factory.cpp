@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "shared_memory_channel_factory.h"
+
+#include <sys/mman.h>
+#include <syscall.h>
+#include <unistd.h>
+
+#include <new>
+#include <stdexcept>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace osquery {
+namespace {
+
+void* mapSharedMemory(size_t size) {
+#ifdef SYS_memfd_create
+  // We call the syscall directly because memfd_create() has been added as a
+  // function from glibc 2.27 and on only.
+  int fd = static_cast<int>(
+      syscall(SYS_memfd_create, "osquery_worker_ipc", MFD_CLOEXEC));
+
+  if (fd >= 0) {
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      auto error = errno;
+      close(fd);
+      throw std::runtime_error(
+          "Failed to resize the worker shared memory, error: " +
+          std::to_string(error));
+    }
+
+    void* memory =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    auto error = errno;
+    close(fd);
+
+    if (memory == MAP_FAILED) {
+      throw std::runtime_error(
+          "Failed to map the worker shared memory, error: " +
+          std::to_string(error));
+    }
+    return memory;
+  }
+#endif
+
+  // Kernels older than 3.17 have no memfd, the worker is forked
+  // so an anonymous shared mapping is as good.
+  void* memory = mmap(nullptr,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS,
+                      -1,
+                      0);
+
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Failed to map the worker shared memory, error: " +
+                             std::to_string(errno));
+  }
+  return memory;
+}
+} // namespace
+
+SharedMemoryChannelTicket::~SharedMemoryChannelTicket() {
+  release();
+}
+
+void SharedMemoryChannelTicket::release() {
+  if (memory_ != nullptr) {
+    munmap(memory_, memory_size_);
+    memory_ = nullptr;
+    memory_size_ = 0;
+  }
+}
+
+SharedMemoryChannelTicket SharedMemoryChannelFactory::createChannelTicket() {
+  auto doorbells = doorbell_factory_.createChannelTicket();
+
+  auto memory_size = SharedMemoryChannel::getMemorySize(ring_capacity_);
+  void* memory = mapSharedMemory(memory_size);
+
+  auto rings = static_cast<SharedMemoryRing*>(memory);
+  for (size_t i = 0; i < 2; i++) {
+    new (&rings[i]) SharedMemoryRing();
+  }
+
+  return SharedMemoryChannelTicket(std::move(doorbells), memory, memory_size);
+}
+
+SharedMemoryChannel& SharedMemoryChannelFactory::createChildChannel(
+    const std::string& table_name, SharedMemoryChannelTicket channel_ticket) {
+  return createChannel(table_name, std::move(channel_ticket), false);
+}
+
+SharedMemoryChannel& SharedMemoryChannelFactory::createParentChannel(
+    const std::string& table_name,
+    SharedMemoryChannelTicket channel_ticket,
+    pid_t child_pid) {
+  return createChannel(table_name, std::move(channel_ticket), true, child_pid);
+}
+
+std::string SharedMemoryChannelFactory::getTableNameFromPid(pid_t pid) {
+  for (const auto& pair : table_to_channel) {
+    if (pair.second->getRemotePid() == pid) {
+      return pair.second->table_name_;
+    }
+  }
+
+  return "Not Connected";
+}
+
+std::unique_ptr<SharedMemoryChannel>
+SharedMemoryChannelFactory::createChannelImpl(
+    const std::string& table_name,
+    SharedMemoryChannelTicket channel_ticket,
+    bool is_parent,
+    pid_t child_pid) {
+  // The doorbell pipes are used as the pipes of a PipeChannel.
+  auto& doorbells = channel_ticket.doorbells_;
+  int read_pipe_fd = is_parent ? doorbells.getAndUseReadFd(0)
+                               : doorbells.getAndUseWriteFd(0);
+  int write_pipe_fd = is_parent ? doorbells.getAndUseWriteFd(1)
+                                : doorbells.getAndUseReadFd(1);
+
+  auto memory = std::exchange(channel_ticket.memory_, nullptr);
+  auto memory_size = std::exchange(channel_ticket.memory_size_, 0);
+
+  return std::make_unique<SharedMemoryChannel>(table_name,
+                                               memory,
+                                               memory_size,
+                                               is_parent,
+                                               read_pipe_fd,
+                                               write_pipe_fd,
+                                               child_pid);
+}
+
+} // namespace osquery
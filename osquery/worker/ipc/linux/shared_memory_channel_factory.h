@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "osquery/worker/ipc/linux/shared_memory_channel.h"
+#include "osquery/worker/ipc/posix/pipe_channel_factory.h"
+#include "osquery/worker/ipc/table_channel_factory_base.h"
+
+namespace osquery {
+
+class SharedMemoryChannelFactory;
+template <>
+struct GetChannelType<SharedMemoryChannelFactory> {
+  using Channel = SharedMemoryChannel;
+};
+
+/// Default capacity of each direction of a shared memory channel.
+const size_t kSharedMemoryRingCapacity = 4 * 1024 * 1024;
+
+class SharedMemoryChannelTicket {
+ public:
+  ~SharedMemoryChannelTicket();
+
+  SharedMemoryChannelTicket(const SharedMemoryChannelTicket&) = delete;
+  SharedMemoryChannelTicket& operator=(const SharedMemoryChannelTicket&) =
+      delete;
+
+  SharedMemoryChannelTicket(SharedMemoryChannelTicket&& other)
+      : doorbells_(std::move(other.doorbells_)),
+        memory_(std::exchange(other.memory_, nullptr)),
+        memory_size_(std::exchange(other.memory_size_, 0)) {}
+
+  SharedMemoryChannelTicket& operator=(SharedMemoryChannelTicket&& other) {
+    release();
+    doorbells_ = std::move(other.doorbells_);
+    memory_ = std::exchange(other.memory_, nullptr);
+    memory_size_ = std::exchange(other.memory_size_, 0);
+    return *this;
+  }
+
+ private:
+  SharedMemoryChannelTicket(PipeChannelTicket doorbells,
+                            void* memory,
+                            size_t memory_size)
+      : doorbells_(std::move(doorbells)),
+        memory_(memory),
+        memory_size_(memory_size) {}
+
+  void release();
+
+  PipeChannelTicket doorbells_;
+  void* memory_{nullptr};
+  size_t memory_size_{0};
+
+  friend class SharedMemoryChannelFactory;
+};
+
+/**
+ * @brief Creates SharedMemoryChannel objects, with the same interface of the
+ * PipeChannelFactory.
+ *
+ * The shared memory is mapped when the ticket is created, so that it is
+ * inherited by the worker process when forking.
+ */
+class SharedMemoryChannelFactory
+    : public TableChannelFactoryBase<SharedMemoryChannelFactory> {
+ public:
+  explicit SharedMemoryChannelFactory(
+      size_t ring_capacity = kSharedMemoryRingCapacity)
+      : ring_capacity_(ring_capacity) {}
+
+  SharedMemoryChannelTicket createChannelTicket();
+  SharedMemoryChannel& createChildChannel(
+      const std::string& table_name, SharedMemoryChannelTicket channel_ticket);
+  SharedMemoryChannel& createParentChannel(
+      const std::string& table_name,
+      SharedMemoryChannelTicket channel_ticket,
+      pid_t child_pid);
+
+  std::string getTableNameFromPid(pid_t pid);
+
+ private:
+  std::unique_ptr<SharedMemoryChannel> createChannelImpl(
+      const std::string& table_name,
+      SharedMemoryChannelTicket channel_ticket,
+      bool is_parent,
+      pid_t child_pid = 0);
+  friend TableChannelFactoryBase<SharedMemoryChannelFactory>;
+
+  PipeChannelFactory doorbell_factory_;
+  const size_t ring_capacity_;
+};
+} // namespace osquery
@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <osquery/worker/ipc/linux/shared_memory_channel_factory.h>
+
+namespace osquery {
+class WorkerSharedMemoryChannelTests : public testing::Test {
+ public:
+  std::string getLargeMessage(size_t size) {
+    std::string message(size, 0);
+    for (size_t i = 0; i < size; i++) {
+      message[i] = static_cast<char>('a' + i % 26);
+    }
+    return message;
+  }
+};
+
+TEST_F(WorkerSharedMemoryChannelTests, test_read_after_exit) {
+  SharedMemoryChannelFactory factory;
+  auto ticket = factory.createChannelTicket();
+
+  int pid = fork();
+
+  ASSERT_NE(pid, -1);
+
+  if (pid == 0) {
+    // Child
+    auto& child_channel = factory.createChildChannel("test", std::move(ticket));
+
+    auto status = child_channel.sendStringMessage("Hello World!");
+    std::_Exit(status.ok() ? 0 : 1);
+  } else {
+    // Parent
+    auto& parent_channel =
+        factory.createParentChannel("test", std::move(ticket), pid);
+
+    int wexit;
+    waitpid(pid, &wexit, 0);
+    ASSERT_EQ(WEXITSTATUS(wexit), 0);
+
+    // We are able to read a message even after the child exited
+    std::string message;
+    auto status = parent_channel.recvStringMessage(message);
+
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    EXPECT_EQ(message, "Hello World!");
+
+    // But then the channel is closed
+    status = parent_channel.recvStringMessage(message);
+    ASSERT_FALSE(status.ok());
+    EXPECT_EQ(status.getCode(), 2);
+  }
+}
+
+TEST_F(WorkerSharedMemoryChannelTests, test_send_after_exit) {
+  SharedMemoryChannelFactory factory;
+  auto ticket = factory.createChannelTicket();
+
+  int pid = fork();
+
+  ASSERT_NE(pid, -1);
+
+  if (pid == 0) {
+    // Child
+    std::_Exit(0);
+  } else {
+    // Parent
+    auto& parent_channel =
+        factory.createParentChannel("test", std::move(ticket), pid);
+
+    int wexit;
+    waitpid(pid, &wexit, 0);
+    ASSERT_EQ(WEXITSTATUS(wexit), 0);
+
+    auto status = parent_channel.sendStringMessage("Hello World!");
+
+    ASSERT_FALSE(status.ok());
+    EXPECT_EQ(status.getCode(), EPIPE);
+  }
+}
+
+TEST_F(WorkerSharedMemoryChannelTests, test_messages_larger_than_ring) {
+  // Use a small ring so that messages have to wrap and wait for the reader.
+  SharedMemoryChannelFactory factory(4096);
+  auto ticket = factory.createChannelTicket();
+  auto expected = getLargeMessage(1024 * 1024 + 3);
+
+  int pid = fork();
+
+  ASSERT_NE(pid, -1);
+
+  if (pid == 0) {
+    // Child, echo back the messages received
+    auto& child_channel = factory.createChildChannel("test", std::move(ticket));
+
+    for (int i = 0; i < 3; i++) {
+      std::string message;
+      auto status = child_channel.recvStringMessage(message);
+
+      if (!status.ok()) {
+        std::_Exit(1);
+      }
+
+      status = child_channel.sendStringMessage(message);
+
+      if (!status.ok()) {
+        std::_Exit(1);
+      }
+    }
+    std::_Exit(0);
+  } else {
+    // Parent
+    auto& parent_channel =
+        factory.createParentChannel("test", std::move(ticket), pid);
+
+    for (const auto& sent : {std::string("small"), expected, expected}) {
+      auto status = parent_channel.sendStringMessage(sent);
+      ASSERT_TRUE(status.ok()) << status.getMessage();
+
+      std::string message;
+      status = parent_channel.recvStringMessage(message);
+      ASSERT_TRUE(status.ok()) << status.getMessage();
+      EXPECT_TRUE(message == sent);
+    }
+
+    int wexit;
+    waitpid(pid, &wexit, 0);
+    EXPECT_EQ(WEXITSTATUS(wexit), 0);
+  }
+}
+
+TEST_F(WorkerSharedMemoryChannelTests, test_exit_while_writing) {
+  SharedMemoryChannelFactory factory(4096);
+  auto ticket = factory.createChannelTicket();
+
+  int pid = fork();
+
+  ASSERT_NE(pid, -1);
+
+  if (pid == 0) {
+    // Child, leaves without reading
+    factory.createChildChannel("test", std::move(ticket));
+    std::_Exit(0);
+  } else {
+    // Parent
+    auto& parent_channel =
+        factory.createParentChannel("test", std::move(ticket), pid);
+
+    // The child never reads, the send has to fail instead of blocking.
+    auto status = parent_channel.sendStringMessage(getLargeMessage(65536));
+    EXPECT_FALSE(status.ok());
+
+    int wexit;
+    waitpid(pid, &wexit, 0);
+    EXPECT_EQ(WEXITSTATUS(wexit), 0);
+  }
+}
+} // namespace osquery
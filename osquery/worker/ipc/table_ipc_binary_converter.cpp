@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_ipc_binary_converter.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace osquery {
+namespace {
+
+const char kBinaryQueryDataMarker = '\x01';
+
+void writeVarint(std::string& message, uint64_t value) {
+  while (value >= 0x80) {
+    message.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  message.push_back(static_cast<char>(value));
+}
+
+void writeBytes(std::string& message, const std::string& bytes) {
+  writeVarint(message, bytes.size());
+  message.append(bytes);
+}
+
+class BinaryReader {
+ public:
+  explicit BinaryReader(const std::string& message)
+      : pos_(message.data()), end_(message.data() + message.size()) {}
+
+  bool readVarint(uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (pos_ == end_) {
+        return false;
+      }
+
+      auto byte = static_cast<uint8_t>(*pos_++);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readBytes(std::string& bytes) {
+    uint64_t size = 0;
+    if (!readVarint(size) || size > static_cast<uint64_t>(end_ - pos_)) {
+      return false;
+    }
+
+    bytes.assign(pos_, static_cast<size_t>(size));
+    pos_ += size;
+    return true;
+  }
+
+  bool skip(size_t size) {
+    if (size > static_cast<size_t>(end_ - pos_)) {
+      return false;
+    }
+
+    pos_ += size;
+    return true;
+  }
+
+  size_t remaining() const {
+    return static_cast<size_t>(end_ - pos_);
+  }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+} // namespace
+
+bool TableIPCBinaryConverter::isBinaryQueryData(const std::string& message) {
+  return !message.empty() && message[0] == kBinaryQueryDataMarker;
+}
+
+Status TableIPCBinaryConverter::queryDataToBinary(const QueryData& query_data,
+                                                  std::string& message) {
+  message.clear();
+  message.push_back(kBinaryQueryDataMarker);
+  writeVarint(message, query_data.size());
+
+  // Rows of a table share their column names, so each name is sent only
+  // the first time it's seen and then referenced by its index.
+  std::unordered_map<std::string, uint64_t> columns;
+  for (const auto& row : query_data) {
+    writeVarint(message, row.size());
+
+    for (const auto& column : row) {
+      auto it = columns.find(column.first);
+      if (it != columns.end()) {
+        writeVarint(message, it->second);
+      } else {
+        uint64_t index = columns.size();
+        writeVarint(message, index);
+        writeBytes(message, column.first);
+        columns.emplace(column.first, index);
+      }
+
+      writeBytes(message, column.second);
+    }
+  }
+
+  return Status::success();
+}
+
+Status TableIPCBinaryConverter::binaryToQueryData(const std::string& message,
+                                                  QueryData& query_data) {
+  if (!isBinaryQueryData(message)) {
+    return Status::failure("Not a binary QueryData message");
+  }
+
+  BinaryReader reader(message);
+  reader.skip(1);
+
+  uint64_t row_count = 0;
+  if (!reader.readVarint(row_count)) {
+    return Status::failure("Truncated binary QueryData message");
+  }
+
+  // Each row takes at least one byte, do not trust the count any further.
+  if (row_count > reader.remaining()) {
+    return Status::failure("Invalid binary QueryData row count " +
+                           std::to_string(row_count));
+  }
+
+  std::vector<std::string> columns;
+  query_data.reserve(query_data.size() + static_cast<size_t>(row_count));
+
+  for (uint64_t i = 0; i < row_count; i++) {
+    uint64_t column_count = 0;
+    if (!reader.readVarint(column_count)) {
+      return Status::failure("Truncated binary QueryData message");
+    }
+
+    Row row;
+    for (uint64_t j = 0; j < column_count; j++) {
+      uint64_t index = 0;
+      if (!reader.readVarint(index)) {
+        return Status::failure("Truncated binary QueryData message");
+      }
+
+      if (index == columns.size()) {
+        std::string column;
+        if (!reader.readBytes(column)) {
+          return Status::failure("Truncated binary QueryData message");
+        }
+        columns.push_back(std::move(column));
+      } else if (index > columns.size()) {
+        return Status::failure("Invalid binary QueryData column index " +
+                               std::to_string(index));
+      }
+
+      std::string value;
+      if (!reader.readBytes(value)) {
+        return Status::failure("Truncated binary QueryData message");
+      }
+
+      // Columns are written in the Row order, so they are appended.
+      row.emplace_hint(
+          row.end(), columns[static_cast<size_t>(index)], std::move(value));
+    }
+
+    query_data.push_back(std::move(row));
+  }
+
+  if (reader.remaining() != 0) {
+    return Status::failure("Trailing data after binary QueryData message");
+  }
+
+  return Status::success();
+}
+} // namespace osquery
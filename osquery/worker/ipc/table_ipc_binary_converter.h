@@ -0,0 +1,35 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Compact binary encoding of QueryData messages.
+ *
+ * A message starts with a marker byte that cannot start a JSON document, so
+ * binary and JSON messages can share the same channel. Rows are written as
+ * length prefixed column and value strings, column names are written once
+ * and then referenced by index.
+ */
+class TableIPCBinaryConverter {
+ public:
+  static bool isBinaryQueryData(const std::string& message);
+  static Status queryDataToBinary(const QueryData& query_data,
+                                  std::string& message);
+  static Status binaryToQueryData(const std::string& message,
+                                  QueryData& query_data);
+};
+} // namespace osquery
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
+
+namespace osquery {
+
+class WorkerBinaryConversionsTests : public testing::Test {};
+
+TEST_F(WorkerBinaryConversionsTests, test_querydata_and_binary_conversions) {
+  QueryData data;
+  Row r1;
+  r1["column1"] = "test";
+  r1["column2"] = "1";
+  data.push_back(r1);
+
+  // Rows can have different columns, and values any byte.
+  Row r2;
+  r2["column1"] = std::string("te\0st2", 6);
+  r2["column3"] = std::string(300, 'x');
+  data.push_back(r2);
+
+  data.push_back(Row());
+
+  Row r3;
+  r3["column2"] = "";
+  data.push_back(r3);
+
+  std::string message;
+  auto status = TableIPCBinaryConverter::queryDataToBinary(data, message);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(TableIPCBinaryConverter::isBinaryQueryData(message));
+
+  QueryData read_query_data;
+  status = TableIPCBinaryConverter::binaryToQueryData(message, read_query_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(read_query_data, data);
+
+  // Column names are only sent once.
+  EXPECT_EQ(message.find("column1"), message.rfind("column1"));
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_empty_querydata) {
+  std::string message;
+  auto status = TableIPCBinaryConverter::queryDataToBinary({}, message);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  QueryData read_query_data;
+  status = TableIPCBinaryConverter::binaryToQueryData(message, read_query_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(read_query_data.empty());
+}
+
+TEST_F(WorkerBinaryConversionsTests, test_invalid_binary_messages) {
+  QueryData read_query_data;
+
+  // JSON messages are not binary
+  EXPECT_FALSE(TableIPCBinaryConverter::isBinaryQueryData("{}"));
+  EXPECT_FALSE(TableIPCBinaryConverter::isBinaryQueryData(""));
+  EXPECT_FALSE(
+      TableIPCBinaryConverter::binaryToQueryData("{}", read_query_data).ok());
+
+  QueryData data;
+  Row r;
+  r["column1"] = "test";
+  r["column2"] = "1";
+  data.push_back(r);
+
+  std::string message;
+  ASSERT_TRUE(TableIPCBinaryConverter::queryDataToBinary(data, message).ok());
+
+  // Every truncation is detected
+  for (size_t size = 1; size < message.size(); size++) {
+    read_query_data.clear();
+    EXPECT_FALSE(TableIPCBinaryConverter::binaryToQueryData(
+                     message.substr(0, size), read_query_data)
+                     .ok())
+        << "Truncated at " << size;
+  }
+
+  read_query_data.clear();
+  EXPECT_FALSE(TableIPCBinaryConverter::binaryToQueryData(message + "x",
+                                                          read_query_data)
+                   .ok());
+
+  // A row referencing a column that was never defined
+  std::string bad_column("\x01\x01\x01\x05\x00", 5);
+  read_query_data.clear();
+  EXPECT_FALSE(
+      TableIPCBinaryConverter::binaryToQueryData(bad_column, read_query_data)
+          .ok());
+}
+} // namespace osquery
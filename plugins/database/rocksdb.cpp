@@ -9,9 +9,17 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/table.h>
 
 #include <osquery/core/flags.h>
 #include <osquery/filesystem/fileops.h>
@@ -31,6 +39,37 @@ HIDDEN_FLAG(int32, rocksdb_merge_number, 4, "Min write buffer number to merge");
 HIDDEN_FLAG(int32, rocksdb_background_flushes, 4, "Max background flushes");
 HIDDEN_FLAG(int32, rocksdb_buffer_blocks, 256, "Write buffer blocks (4k)");
 
+CLI_FLAG(uint64,
+         rocksdb_block_cache_size,
+         8,
+         "Size in MB of the block cache shared by all RocksDB domains");
+
+CLI_FLAG(int32,
+         rocksdb_bloom_bits,
+         10,
+         "Bits per key of the RocksDB bloom filters (0 disables them)");
+
+CLI_FLAG(string,
+         rocksdb_events_profile,
+         "ttl",
+         "Compaction profile of the events domain: level, ttl or fifo");
+
+CLI_FLAG(string,
+         rocksdb_logs_profile,
+         "ttl",
+         "Compaction profile of the logs domain: level, ttl or fifo");
+
+CLI_FLAG(uint64,
+         rocksdb_ttl,
+         86400,
+         "Seconds before files of the ttl and fifo profiles are compacted");
+
+CLI_FLAG(uint64,
+         rocksdb_fifo_size,
+         256,
+         "Size in MB of a fifo profile domain before its oldest files are "
+         "dropped");
+
 DECLARE_string(database_path);
 
 /**
@@ -44,6 +83,91 @@ std::atomic<bool> kRocksDBCorruptionIndicator{false};
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(RocksDBDatabasePlugin, "database", "rocksdb");
 
+namespace {
+
+/// How a domain is compacted, see getColumnFamilyOptions.
+enum class CompactionProfile {
+  /// Level compaction, for overwrite-heavy domains.
+  Level,
+
+  /// Level compaction which also rewrites files older than the TTL, so the
+  /// space held by expired (range deleted) keys is reclaimed.
+  TTL,
+
+  /// Files are dropped once they are older than the TTL or once the domain
+  /// grows beyond its size limit; the data is never rewritten.
+  FIFO,
+};
+
+const std::map<std::string, CompactionProfile> kCompactionProfiles = {
+    {"level", CompactionProfile::Level},
+    {"ttl", CompactionProfile::TTL},
+    {"fifo", CompactionProfile::FIFO},
+};
+
+CompactionProfile getCompactionProfile(const std::string& domain) {
+  std::string profile_name;
+  if (domain == kEvents) {
+    profile_name = FLAGS_rocksdb_events_profile;
+  } else if (domain == kLogs) {
+    profile_name = FLAGS_rocksdb_logs_profile;
+  } else {
+    return CompactionProfile::Level;
+  }
+
+  auto it = kCompactionProfiles.find(profile_name);
+  if (it == kCompactionProfiles.end()) {
+    LOG(WARNING) << "Unknown RocksDB compaction profile " << profile_name
+                 << " for " << domain << ", using level";
+    return CompactionProfile::Level;
+  }
+
+  return it->second;
+}
+
+std::string getCompactionProfileName(CompactionProfile profile) {
+  for (const auto& it : kCompactionProfiles) {
+    if (it.second == profile) {
+      return it.first;
+    }
+  }
+
+  return "";
+}
+
+/**
+ * @brief Extract the first component of a key, up to and including a '.'.
+ *
+ * Keys are namespaced this way, for example "data.<type>.<name>.<time>",
+ * "carves.<guid>" or "meta.<query>". Keys without a '.' have no prefix.
+ */
+class KeyPrefixTransform : public rocksdb::SliceTransform {
+ public:
+  const char* Name() const override {
+    return "osquery.KeyPrefixTransform";
+  }
+
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override {
+    return rocksdb::Slice(key.data(), getPrefixSize(key));
+  }
+
+  bool InDomain(const rocksdb::Slice& key) const override {
+    return getPrefixSize(key) > 0;
+  }
+
+ private:
+  static size_t getPrefixSize(const rocksdb::Slice& key) {
+    auto delimiter =
+        static_cast<const char*>(std::memchr(key.data(), '.', key.size()));
+    return (delimiter == nullptr) ? 0 : (delimiter - key.data()) + 1;
+  }
+};
+
+const std::shared_ptr<const rocksdb::SliceTransform> kKeyPrefixTransform =
+    std::make_shared<KeyPrefixTransform>();
+
+} // namespace
+
 void GlogRocksDBLogger::Logv(const char* format, va_list ap) {
   // Convert RocksDB log to string and check if header or level-ed log.
   std::string log_line;
@@ -111,12 +235,15 @@ Status RocksDBDatabasePlugin::setUp() {
     }
     options_.info_log = logger_;
 
+    block_cache_ =
+        rocksdb::NewLRUCache(FLAGS_rocksdb_block_cache_size * 1024 * 1024);
+
     column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
         rocksdb::kDefaultColumnFamilyName, options_));
 
     for (const auto& cf_name : kDomains) {
-      column_families_.push_back(
-          rocksdb::ColumnFamilyDescriptor(cf_name, options_));
+      column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
+          cf_name, getColumnFamilyOptions(cf_name)));
     }
   }
 
@@ -158,8 +285,10 @@ Status RocksDBDatabasePlugin::setUp() {
     return Status(1, "Cannot set permissions on RocksDB path: " + path_);
   }
 
+  // FIFO domains keep every file in level 0 and never rewrite them.
   for (const auto& cf_name : kDomains) {
-    if (cf_name != kEvents) {
+    if (cf_name != kEvents &&
+        getCompactionProfile(cf_name) != CompactionProfile::FIFO) {
       auto compact_status = compactFiles(cf_name);
       if (!compact_status.ok()) {
         LOG(INFO) << "Cannot compact column family " << cf_name << ": "
@@ -171,6 +300,39 @@ Status RocksDBDatabasePlugin::setUp() {
   return Status(0);
 }
 
+rocksdb::ColumnFamilyOptions RocksDBDatabasePlugin::getColumnFamilyOptions(
+    const std::string& domain) const {
+  rocksdb::ColumnFamilyOptions cf_options(options_);
+
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.block_cache = block_cache_;
+  if (FLAGS_rocksdb_bloom_bits > 0) {
+    table_options.filter_policy.reset(
+        rocksdb::NewBloomFilterPolicy(FLAGS_rocksdb_bloom_bits, false));
+  }
+  cf_options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(table_options));
+
+  // Prefix scans only read the keys sharing the first key component.
+  cf_options.prefix_extractor = kKeyPrefixTransform;
+
+  switch (getCompactionProfile(domain)) {
+  case CompactionProfile::Level:
+    break;
+  case CompactionProfile::TTL:
+    cf_options.ttl = FLAGS_rocksdb_ttl;
+    break;
+  case CompactionProfile::FIFO:
+    cf_options.compaction_style = rocksdb::kCompactionStyleFIFO;
+    cf_options.compaction_options_fifo.max_table_files_size =
+        FLAGS_rocksdb_fifo_size * 1024 * 1024;
+    cf_options.ttl = FLAGS_rocksdb_ttl;
+    break;
+  }
+
+  return cf_options;
+}
+
 Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
   auto handle = getHandleForColumnFamily(domain);
   if (handle == nullptr) {
@@ -404,6 +566,22 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
                                    std::vector<std::string>& results,
                                    const std::string& prefix,
                                    uint64_t max) const {
+  DatabaseScanOptions options;
+  options.prefix = prefix;
+  options.max = max;
+  options.keys_only = true;
+
+  return scanValues(
+      domain, options, [&results](const std::string& key, const std::string&) {
+        results.push_back(key);
+        return true;
+      });
+}
+
+Status RocksDBDatabasePlugin::scanValues(
+    const std::string& domain,
+    const DatabaseScanOptions& scan_options,
+    const DatabaseScanVisitor& visitor) const {
   if (getDB() == nullptr) {
     return Status(1, "Database not opened");
   }
@@ -415,22 +593,86 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
   auto options = rocksdb::ReadOptions();
   options.verify_checksums = false;
   options.fill_cache = false;
-  auto it = getDB()->NewIterator(options, cfh);
+
+  // Keys are sorted, the scan stops at the first key without the prefix.
+  // Prefixes which span a whole key component may skip files using the
+  // prefix bloom filters, the others need a total order seek.
+  const auto& prefix = scan_options.prefix;
+  if (kKeyPrefixTransform->InDomain(prefix)) {
+    options.prefix_same_as_start = true;
+  } else {
+    options.total_order_seek = true;
+  }
+
+  // The visitor may throw, the iterator must be released.
+  std::unique_ptr<rocksdb::Iterator> it(getDB()->NewIterator(options, cfh));
   if (it == nullptr) {
     return Status(1, "Could not get iterator for " + domain);
   }
 
+  // The key and value buffers are reused for every visited key.
   size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+  std::string key;
+  std::string value;
+  for (it->Seek(std::max(prefix, scan_options.low)); it->Valid(); it->Next()) {
+    auto key_slice = it->key();
+    if (!key_slice.starts_with(prefix) ||
+        (!scan_options.high.empty() &&
+         key_slice.compare(scan_options.high) > 0)) {
+      break;
+    }
+
+    key.assign(key_slice.data(), key_slice.size());
+    if (!scan_options.keys_only) {
+      auto value_slice = it->value();
+      value.assign(value_slice.data(), value_slice.size());
+    }
+
+    if (!visitor(key, value)) {
+      break;
+    }
+
+    if (scan_options.max > 0 && ++count >= scan_options.max) {
+      break;
+    }
+  }
+
+  auto s = it->status();
+  return Status(s.code(), s.ToString());
+}
+
+Status RocksDBDatabasePlugin::stats(PluginResponse& response) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  const std::vector<std::pair<std::string, std::string>> properties = {
+      {"keys", rocksdb::DB::Properties::kEstimateNumKeys},
+      {"live_data_size", rocksdb::DB::Properties::kEstimateLiveDataSize},
+      {"sst_files_size", rocksdb::DB::Properties::kTotalSstFilesSize},
+      {"memtable_size", rocksdb::DB::Properties::kCurSizeAllMemTables},
+      {"pending_compaction_size",
+       rocksdb::DB::Properties::kEstimatePendingCompactionBytes},
+      {"block_cache_usage", rocksdb::DB::Properties::kBlockCacheUsage},
+  };
+
+  for (const auto& domain : kDomains) {
+    auto cfh = getHandleForColumnFamily(domain);
+    if (cfh == nullptr) {
+      return Status(1, "Could not get column family for " + domain);
     }
+
+    PluginRequest r;
+    r["domain"] = domain;
+    r["compaction"] = getCompactionProfileName(getCompactionProfile(domain));
+    for (const auto& property : properties) {
+      uint64_t value = 0;
+      getDB()->GetIntProperty(cfh, property.second, &value);
+      r[property.first] = std::to_string(value);
+    }
+    response.push_back(std::move(r));
   }
-  delete it;
+
   return Status::success();
 }
 } // namespace osquery
@@ -9,6 +9,7 @@
 
 #include <atomic>
 
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
 
 #include <osquery/core/core.h>
@@ -71,6 +72,14 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key/value iteration method, reading both from a single iterator.
+  Status scanValues(const std::string& domain,
+                    const DatabaseScanOptions& options,
+                    const DatabaseScanVisitor& visitor) const override;
+
+  /// Column family statistics, one row per domain.
+  Status stats(PluginResponse& response) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -105,6 +114,17 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Request RocksDB compact each domain and level to that same level.
   Status compactFiles(const std::string& domain);
 
+  /**
+   * @brief Build the column family options for a domain.
+   *
+   * Every domain shares the block cache and uses bloom filters and a key
+   * prefix extractor. The compaction style depends on the domain profile:
+   * events and logs are append-heavy with time-based expiry and may use TTL
+   * or FIFO compaction, the others use level compaction.
+   */
+  rocksdb::ColumnFamilyOptions getColumnFamilyOptions(
+      const std::string& domain) const;
+
   /**
    * @brief Helper method to repair a corrupted db. Best effort only.
    *
@@ -145,11 +165,15 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// The RocksDB connection options that are used to connect to RocksDB
   rocksdb::Options options_;
 
+  /// Block cache shared by all column families.
+  std::shared_ptr<rocksdb::Cache> block_cache_{nullptr};
+
   /// Deconstruction mutex.
   Mutex close_mutex_;
 
  private:
   friend class GlogRocksDBLogger;
   FRIEND_TEST(RocksDBDatabasePluginTests, test_corruption);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_column_family_options);
 };
 } // namespace osquery
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include <sqlite3.h>
@@ -115,20 +116,24 @@ static int getData(void* argument, int argc, char* argv[], char* column[]) {
 Status SQLiteDatabasePlugin::get(const std::string& domain,
                                  const std::string& key,
                                  std::string& value) const {
-  QueryData results;
-  char* err = nullptr;
-  std::string q = "select value from " + domain + " where key = '" + key + "';";
-  sqlite3_exec(db_, q.c_str(), getData, &results, &err);
-  if (err != nullptr) {
-    sqlite3_free(err);
+  sqlite3_stmt* stmt = nullptr;
+  std::string q = "select value from " + domain + " where key = ?1;";
+  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+
+  // Values may be binary, read them with an explicit size.
+  sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+  auto rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    const auto* data =
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    auto size = static_cast<size_t>(sqlite3_column_bytes(stmt, 0));
+    value = (data != nullptr) ? std::string(data, size) : "";
   }
 
+  sqlite3_finalize(stmt);
+
   // Only assign value if the query found a result.
-  if (results.size() > 0) {
-    value = std::move(results[0]["value"]);
-    return Status(0);
-  }
-  return Status(1);
+  return (rc == SQLITE_ROW) ? Status(0) : Status(1);
 }
 
 Status SQLiteDatabasePlugin::get(const std::string& domain,
@@ -205,7 +210,11 @@ Status SQLiteDatabasePlugin::putBatch(const std::string& domain,
       const auto& value = p.second;
 
       sqlite3_bind_text(stmt, i, key.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, i + 1, value.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_text(stmt,
+                        i + 1,
+                        value.c_str(),
+                        static_cast<int>(value.size()),
+                        SQLITE_STATIC);
 
       i += 2;
     }
@@ -292,4 +301,66 @@ Status SQLiteDatabasePlugin::scan(const std::string& domain,
 
   return Status::success();
 }
+
+Status SQLiteDatabasePlugin::scanValues(
+    const std::string& domain,
+    const DatabaseScanOptions& options,
+    const DatabaseScanVisitor& visitor) const {
+  // Keys use the binary collation, the primary key index walks them in the
+  // same order as the other backing stores.
+  std::string q = "select key, value from " + domain + " where key >= ?1";
+  if (!options.high.empty()) {
+    q += " and key <= ?2";
+  }
+  q += " order by key;";
+
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return Status(1, "Cannot scan domain: " + domain);
+  }
+
+  auto low = std::max(options.prefix, options.low);
+  sqlite3_bind_text(stmt, 1, low.c_str(), -1, SQLITE_STATIC);
+  if (!options.high.empty()) {
+    sqlite3_bind_text(stmt, 2, options.high.c_str(), -1, SQLITE_STATIC);
+  }
+
+  size_t count = 0;
+  std::string key;
+  std::string value;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const auto* key_data =
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    if (key_data == nullptr) {
+      continue;
+    }
+
+    key.assign(key_data, static_cast<size_t>(sqlite3_column_bytes(stmt, 0)));
+    if (key.compare(0, options.prefix.size(), options.prefix) != 0) {
+      break;
+    }
+
+    value.clear();
+    if (!options.keys_only) {
+      // Values may be binary, read them with an explicit size.
+      const auto* data =
+          reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+      if (data != nullptr) {
+        value.assign(data, static_cast<size_t>(sqlite3_column_bytes(stmt, 1)));
+      }
+    }
+
+    if (!visitor(key, value)) {
+      break;
+    }
+
+    if (options.max > 0 && ++count >= options.max) {
+      break;
+    }
+  }
+
+  sqlite3_finalize(stmt);
+  return Status::success();
+}
 } // namespace osquery
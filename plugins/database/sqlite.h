@@ -55,6 +55,11 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key/value iteration method.
+  Status scanValues(const std::string& domain,
+                    const DatabaseScanOptions& options,
+                    const DatabaseScanVisitor& visitor) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -14,6 +14,10 @@
 
 namespace osquery {
 
+DECLARE_string(rocksdb_events_profile);
+DECLARE_string(rocksdb_logs_profile);
+DECLARE_uint64(rocksdb_ttl);
+
 class RocksDBDatabasePluginTests : public DatabasePluginTests {
  protected:
   std::string name() override {
@@ -51,4 +55,82 @@ TEST_F(RocksDBDatabasePluginTests, test_corruption) {
   resetDatabase();
   EXPECT_FALSE(pathExists(path_ + ".backup"));
 }
+
+TEST_F(RocksDBDatabasePluginTests, test_column_family_options) {
+  auto events_profile = FLAGS_rocksdb_events_profile;
+  auto logs_profile = FLAGS_rocksdb_logs_profile;
+  FLAGS_rocksdb_events_profile = "ttl";
+  FLAGS_rocksdb_logs_profile = "fifo";
+
+  RocksDBDatabasePlugin plugin;
+  auto events_options = plugin.getColumnFamilyOptions(kEvents);
+  EXPECT_EQ(events_options.compaction_style, rocksdb::kCompactionStyleLevel);
+  EXPECT_EQ(events_options.ttl, FLAGS_rocksdb_ttl);
+
+  auto logs_options = plugin.getColumnFamilyOptions(kLogs);
+  EXPECT_EQ(logs_options.compaction_style, rocksdb::kCompactionStyleFIFO);
+  EXPECT_GT(logs_options.compaction_options_fifo.max_table_files_size, 0U);
+
+  auto queries_options = plugin.getColumnFamilyOptions(kQueries);
+  EXPECT_EQ(queries_options.compaction_style, rocksdb::kCompactionStyleLevel);
+  ASSERT_NE(queries_options.prefix_extractor, nullptr);
+  EXPECT_EQ(
+      queries_options.prefix_extractor->Transform("meta.query").ToString(),
+      "meta.");
+  EXPECT_FALSE(queries_options.prefix_extractor->InDomain("query"));
+
+  // Unknown profiles fall back to level compaction.
+  FLAGS_rocksdb_events_profile = "unknown";
+  events_options = plugin.getColumnFamilyOptions(kEvents);
+  EXPECT_EQ(events_options.compaction_style, rocksdb::kCompactionStyleLevel);
+
+  FLAGS_rocksdb_events_profile = events_profile;
+  FLAGS_rocksdb_logs_profile = logs_profile;
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_scan_prefix) {
+  setDatabaseValue(kEvents, "data.type.name.1", "1");
+  setDatabaseValue(kEvents, "data.type.name.2", "2");
+  setDatabaseValue(kEvents, "data.type.other.1", "3");
+  setDatabaseValue(kEvents, "database", "4");
+  setDatabaseValue(kEvents, "eid.type.name", "5");
+
+  // Prefixes within the first key component use a total order seek.
+  std::vector<std::string> keys;
+  ASSERT_TRUE(scanDatabaseKeys(kEvents, keys, "data", 0));
+  EXPECT_EQ(keys.size(), 4U);
+
+  keys.clear();
+  ASSERT_TRUE(scanDatabaseKeys(kEvents, keys, "data.", 0));
+  EXPECT_EQ(keys.size(), 3U);
+
+  keys.clear();
+  ASSERT_TRUE(scanDatabaseKeys(kEvents, keys, "data.type.name.", 0));
+  std::vector<std::string> expected = {"data.type.name.1", "data.type.name.2"};
+  EXPECT_EQ(keys, expected);
+
+  keys.clear();
+  ASSERT_TRUE(scanDatabaseKeys(kEvents, keys, "data.type.", 1));
+  EXPECT_EQ(keys.size(), 1U);
+
+  keys.clear();
+  ASSERT_TRUE(scanDatabaseKeys(kEvents, keys, "records.", 0));
+  EXPECT_TRUE(keys.empty());
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_stats) {
+  setDatabaseValue(kQueries, "stats", "1");
+
+  PluginResponse stats;
+  ASSERT_TRUE(getDatabaseStats(stats));
+  ASSERT_EQ(stats.size(), kDomains.size());
+
+  for (const auto& row : stats) {
+    EXPECT_EQ(row.count("keys"), 1U);
+    EXPECT_EQ(row.count("block_cache_usage"), 1U);
+    if (row.at("domain") == kQueries) {
+      EXPECT_EQ(row.at("compaction"), "level");
+    }
+  }
+}
 }
@@ -38,6 +38,11 @@ FLAG(string,
      "",
      "TLS/HTTPS endpoint for distributed query results");
 
+FLAG(bool,
+     distributed_tls_compress,
+     false,
+     "Compress TLS/HTTPS distributed query results");
+
 FLAG(uint64,
      distributed_tls_max_attempts,
      3,
@@ -79,6 +84,10 @@ Status TLSDistributedPlugin::writeResults(const std::string& json) {
     return s;
   }
 
+  if (FLAGS_distributed_tls_compress) {
+    params.add("_compress", true);
+  }
+
   // The response is ignored.
   std::string response;
   return TLSRequestHelper::go<JSONSerializer>(
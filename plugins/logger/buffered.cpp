@@ -11,25 +11,40 @@
 
 #include <algorithm>
 #include <chrono>
+#include <deque>
+#include <future>
 #include <thread>
 
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/property_tree/ptree.hpp>
-
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/system/time.h>
 #include <plugins/config/parsers/decorators.h>
 
-namespace pt = boost::property_tree;
+namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// Buffered log sequence numbers are padded so indexes order by age.
+const size_t kIndexSequenceWidth{20};
+
+/// Write a key and string value, status lines are written as strings.
+inline void writeString(rj::Writer<rj::StringBuffer>& writer,
+                        const char* key,
+                        const std::string& value) {
+  writer.Key(key);
+  writer.String(value.c_str(), static_cast<rj::SizeType>(value.size()));
+}
+
+} // namespace
+
 FLAG(uint64,
      buffered_log_max,
      1000000,
@@ -42,31 +57,95 @@ const uint64_t BufferedLogForwarder::kMaxLogLines{1024};
 Status BufferedLogForwarder::setUp() {
   // initialize buffer_count_ by scanning the DB
   std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, (uint64_t)0);
+  auto status = scanDatabaseKeys(kLogs, indexes, index_name_ + '_', 0);
 
   if (!status.ok()) {
     return Status(1, "Error scanning for buffered log count");
   }
 
+  // Continue the sequence of the logs buffered by a previous process.
+  std::vector<std::pair<std::pair<uint64_t, uint64_t>, std::string>> legacy;
+  for (const auto& index : indexes) {
+    uint64_t sequence = 0;
+    if (getIndexSequence(index, sequence)) {
+      log_index_ = std::max<uint64_t>(log_index_, sequence);
+      continue;
+    }
+
+    // Indexes written before sequences were padded are named by time.
+    auto parts = index.substr(genIndexPrefix(true).size());
+    auto separator = parts.find('_');
+    if (separator == std::string::npos) {
+      continue;
+    }
+    auto time = tryTo<uint64_t>(parts.substr(0, separator));
+    auto counter = tryTo<uint64_t>(parts.substr(separator + 1));
+    if (time.isValue() && counter.isValue()) {
+      legacy.push_back({{time.get(), counter.get()}, index});
+    }
+  }
+
+  if (!legacy.empty()) {
+    // Rename the logs, oldest first, so they are sent and purged in order.
+    std::sort(legacy.begin(), legacy.end());
+    DatabaseStringValueList renamed;
+    for (const auto& index : legacy) {
+      std::string value;
+      if (getDatabaseValue(kLogs, index.second, value)) {
+        renamed.emplace_back(genIndex(isResultIndex(index.second),
+                                      index.first.first),
+                             std::move(value));
+      }
+    }
+
+    status = setDatabaseBatch(kLogs, renamed);
+    if (!status.ok()) {
+      return Status(1, "Error renaming buffered logs");
+    }
+    for (const auto& index : legacy) {
+      deleteDatabaseValue(kLogs, index.second);
+    }
+  }
+
   RecursiveLock lock(count_mutex_);
   buffer_count_ = indexes.size();
   return Status(0);
 }
 
 void BufferedLogForwarder::check() {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+  if (max_in_flight_ > 1) {
+    sendBatches(true);
+    sendBatches(false);
+  } else {
+    sendBatch();
+  }
 
-  // For each index, accumulate the log line into the result or status set.
+  // Purge any logs exceeding the max after our send attempt
+  if (FLAGS_buffered_log_max > 0) {
+    purge();
+  }
+}
+
+void BufferedLogForwarder::sendBatch() {
+  // Read the buffered log items with their indexes, with a max of 1024 lines.
+  // Indexes are padded sequences, they are visited in ascending order.
+  DatabaseScanOptions options;
+  options.prefix = index_name_ + '_';
+  options.max = max_log_lines_;
+
+  // Accumulate each log line into the result or status set.
   std::vector<std::string> results, statuses;
-  iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.emplace_back(std::move(value));
-            }
-          }));
+  std::vector<std::string> result_indexes, status_indexes;
+  auto status = scanDatabaseValues(
+      kLogs,
+      options,
+      [&results, &statuses, &result_indexes, &status_indexes, this](
+          const std::string& index, const std::string& value) {
+        bool result = isResultIndex(index);
+        (result ? results : statuses).push_back(value);
+        (result ? result_indexes : status_indexes).push_back(index);
+        return true;
+      });
 
   // If any results/statuses were found in the flushed buffer, send.
   if (results.size() > 0) {
@@ -74,13 +153,8 @@ void BufferedLogForwarder::check() {
     if (!status.ok()) {
       VLOG(1) << "Error sending results to logger: " << status.getMessage();
     } else {
-      // Clear the results logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isResultIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+      // Clear the results logs once they were sent, they are the oldest.
+      deleteValuesWithCount(kLogs, result_indexes);
     }
   }
 
@@ -90,18 +164,115 @@ void BufferedLogForwarder::check() {
       VLOG(1) << "Error sending status to logger: " << status.getMessage();
     } else {
       // Clear the status logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isStatusIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+      deleteValuesWithCount(kLogs, status_indexes);
     }
   }
+}
 
-  // Purge any logs exceeding the max after our send attempt
-  if (FLAGS_buffered_log_max > 0) {
-    purge();
+void BufferedLogForwarder::sendBatches(bool results) {
+  const std::string log_type = (results) ? "result" : "status";
+
+  DatabaseScanOptions options;
+  options.prefix = genIndexPrefix(results);
+  options.max = max_log_lines_;
+
+  // The indexes of each batch in flight, in the order they were read.
+  std::deque<std::pair<std::vector<std::string>, std::future<Status>>>
+      batches;
+  bool failed = false;
+
+  auto acknowledge = [&batches, &failed, &log_type, this]() {
+    auto& batch = batches.front();
+    auto status = batch.second.get();
+    if (!status.ok()) {
+      if (!failed) {
+        VLOG(1) << "Error sending " << log_type
+                << " to logger: " << status.getMessage();
+      }
+      failed = true;
+    } else if (!failed) {
+      // Clear the logs once they and every earlier batch were sent.
+      deleteValuesWithCount(kLogs, batch.first);
+    }
+    batches.pop_front();
+  };
+
+  bool drained = false;
+  while (!failed && !drained && !interrupted()) {
+    std::vector<std::string> lines, indexes;
+    auto status = scanDatabaseValues(
+        kLogs,
+        options,
+        [&lines, &indexes](const std::string& index, const std::string& value) {
+          indexes.push_back(index);
+          lines.push_back(value);
+          return true;
+        });
+    if (!status.ok() || lines.empty()) {
+      break;
+    }
+
+    // The next batch starts after the last index of this one.
+    drained = lines.size() < max_log_lines_;
+    options.low = indexes.back() + '\0';
+
+    batches.emplace_back(std::move(indexes),
+                         sendAsync(std::move(lines), log_type));
+    if (batches.size() >= max_in_flight_) {
+      acknowledge();
+    }
+  }
+
+  while (!batches.empty()) {
+    acknowledge();
+  }
+}
+
+std::future<Status> BufferedLogForwarder::sendAsync(
+    std::vector<std::string> lines, const std::string& log_type) {
+  std::packaged_task<Status()> task(
+      [this, log_type, lines = std::move(lines)]() mutable {
+        return send(lines, log_type);
+      });
+  auto result = task.get_future();
+  {
+    WriteLock lock(senders_mutex_);
+    if (senders_.empty()) {
+      for (size_t i = 0; i < max_in_flight_; i++) {
+        senders_.emplace_back([this]() { runSender(); });
+      }
+    }
+    send_queue_.push_back(std::move(task));
+  }
+  senders_cv_.notify_one();
+  return result;
+}
+
+void BufferedLogForwarder::runSender() {
+  while (true) {
+    std::packaged_task<Status()> task;
+    {
+      WriteLock lock(senders_mutex_);
+      senders_cv_.wait(
+          lock, [this]() { return stopping_ || !send_queue_.empty(); });
+      if (send_queue_.empty()) {
+        return;
+      }
+      task = std::move(send_queue_.front());
+      send_queue_.pop_front();
+    }
+    task();
+  }
+}
+
+BufferedLogForwarder::~BufferedLogForwarder() {
+  {
+    WriteLock lock(senders_mutex_);
+    stopping_ = true;
+  }
+  senders_cv_.notify_all();
+  for (auto& sender : senders_) {
+    sender.join();
   }
 }
 
@@ -113,9 +284,8 @@ void BufferedLogForwarder::purge() {
 
   unsigned long long int purge_count = buffer_count_ - FLAGS_buffered_log_max;
 
-  // Collect purge_count indexes of each type (result/status) before
-  // partitioning to find the oldest. Note this assumes that the indexes are
-  // returned in ascending lexicographic order (true for RocksDB).
+  // Collect the purge_count oldest indexes of each type (result/status).
+  // Indexes are padded sequences, they are returned in ascending order.
   std::vector<std::string> indexes;
   auto status =
       scanDatabaseKeys(kLogs, indexes, genIndexPrefix(true), purge_count);
@@ -135,36 +305,42 @@ void BufferedLogForwarder::purge() {
     return;
   }
 
-  indexes.insert(indexes.end(), status_indexes.begin(), status_indexes.end());
-
-  if (indexes.size() < purge_count) {
+  if (indexes.size() + status_indexes.size() < purge_count) {
     LOG(ERROR) << "Trying to purge " << purge_count << " logs but only found "
-               << indexes.size();
+               << indexes.size() + status_indexes.size();
     return;
   }
 
+  std::sort(indexes.begin(), indexes.end());
+  std::sort(status_indexes.begin(), status_indexes.end());
+
+  // Merge the two ordered sets to count the oldest logs of each type.
   size_t prefix_size = genIndexPrefix(true).size();
-  // Partition the indexes so that the first purge_count elements are the
-  // oldest indexes (the ones to be purged)
-  std::nth_element(indexes.begin(),
-                   indexes.begin() + (unsigned int)purge_count - 1,
-                   indexes.end(),
-                   [&](const std::string& a, const std::string& b) {
-                     // Skip the prefix when doing comparisons
-                     return a.compare(prefix_size,
-                                      std::string::npos,
-                                      b,
-                                      prefix_size,
-                                      std::string::npos) < 0;
-                   });
-  indexes.erase(indexes.begin() + (unsigned int)purge_count, indexes.end());
-
-  // Now only indexes of logs to be deleted remain
-  iterate(indexes, [this](const std::string& index) {
-    if (!deleteValueWithCount(kLogs, index).ok()) {
-      LOG(ERROR) << "Error deleting value during buffered log purge";
+  size_t results = 0;
+  size_t statuses = 0;
+  while (results + statuses < purge_count) {
+    if (statuses == status_indexes.size() ||
+        (results < indexes.size() &&
+         indexes[results].compare(prefix_size,
+                                  std::string::npos,
+                                  status_indexes[statuses],
+                                  prefix_size,
+                                  std::string::npos) < 0)) {
+      results++;
+    } else {
+      statuses++;
     }
-  });
+  }
+
+  // Only the scanned logs are deleted, a log written since may be older.
+  indexes.resize(results);
+  status_indexes.resize(statuses);
+  if (!deleteValuesWithCount(kLogs, indexes).ok()) {
+    LOG(ERROR) << "Error deleting values during buffered log purge";
+  }
+  if (!deleteValuesWithCount(kLogs, status_indexes).ok()) {
+    LOG(ERROR) << "Error deleting values during buffered log purge";
+  }
 }
 
 void BufferedLogForwarder::start() {
@@ -184,53 +360,47 @@ Status BufferedLogForwarder::logString(const std::string& s, uint64_t time) {
 Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
                                        uint64_t time) {
   // Append decorations to status
-  // Assemble a decorations tree to append to each status buffer line.
-  pt::ptree dtree;
   std::map<std::string, std::string> decorations;
   getDecorations(decorations);
-  for (const auto& decoration : decorations) {
-    dtree.put(decoration.first, decoration.second);
-  }
 
+  // A single writer serializes every line, all lines are stored in one batch.
+  rj::StringBuffer buffer;
+  rj::Writer<rj::StringBuffer> writer(buffer);
+  DatabaseStringValueList batch;
+  batch.reserve(log.size());
   for (const auto& item : log) {
-    // Convert the StatusLogLine into ptree format, to convert to JSON.
-    pt::ptree buffer;
-    buffer.put("hostIdentifier", item.identifier);
-    buffer.put("calendarTime", item.calendar_time);
-    buffer.put("unixTime", item.time);
-    buffer.put("severity", (google::LogSeverity)item.severity);
-    buffer.put("filename", item.filename);
-    buffer.put("line", item.line);
-    buffer.put("message", item.message);
-    buffer.put("version", kVersion);
+    buffer.Clear();
+    writer.Reset(buffer);
+
+    writer.StartObject();
+    writeString(writer, "hostIdentifier", item.identifier);
+    writeString(writer, "calendarTime", item.calendar_time);
+    writeString(writer, "unixTime", std::to_string(item.time));
+    writeString(writer, "severity", std::to_string(item.severity));
+    writeString(writer, "filename", item.filename);
+    writeString(writer, "line", std::to_string(item.line));
+    writeString(writer, "message", item.message);
+    writeString(writer, "version", kVersion);
     if (decorations.size() > 0) {
-      buffer.put_child("decorations", dtree);
+      writer.Key("decorations");
+      writer.StartObject();
+      for (const auto& decoration : decorations) {
+        writeString(writer, decoration.first.c_str(), decoration.second);
+      }
+      writer.EndObject();
     }
+    writer.EndObject();
 
-    // Convert to JSON, for storing a string-representation in the database.
-    std::string json;
-    try {
-      std::stringstream json_output;
-      pt::write_json(json_output, buffer, false);
-      json = json_output.str();
-    } catch (const pt::json_parser::json_parser_error& e) {
-      // The log could not be represented as JSON.
-      return Status(1, e.what());
-    }
+    batch.emplace_back(genStatusIndex(time),
+                       std::string(buffer.GetString(), buffer.GetSize()));
+  }
 
-    // Store the status line in a backing store.
-    if (!json.empty()) {
-      json.pop_back();
-    }
-    std::string index = genStatusIndex(time);
-    Status status = addValueWithCount(kLogs, index, json);
-    if (!status.ok()) {
-      // Do not continue if any line fails.
-      return status;
-    }
+  if (batch.empty()) {
+    return Status(0);
   }
 
-  return Status(0);
+  // Store the status lines in a backing store.
+  return addValuesWithCount(kLogs, batch);
 }
 
 bool BufferedLogForwarder::isIndex(const std::string& index, bool results) {
@@ -262,8 +432,28 @@ std::string BufferedLogForwarder::genIndex(bool results, uint64_t time) {
   if (time == 0) {
     time = getUnixTime();
   }
-  return genIndexPrefix(results) + std::to_string(time) + '_' +
-         std::to_string(++log_index_);
+
+  auto sequence = std::to_string(++log_index_);
+  if (sequence.size() < kIndexSequenceWidth) {
+    sequence.insert(0, kIndexSequenceWidth - sequence.size(), '0');
+  }
+  return genIndexPrefix(results) + sequence + '_' + std::to_string(time);
+}
+
+bool BufferedLogForwarder::getIndexSequence(const std::string& index,
+                                            uint64_t& sequence) {
+  size_t offset = genIndexPrefix(true).size();
+  if (index.size() <= offset + kIndexSequenceWidth ||
+      index[offset + kIndexSequenceWidth] != '_') {
+    return false;
+  }
+
+  auto value = tryTo<uint64_t>(index.substr(offset, kIndexSequenceWidth));
+  if (value.isError()) {
+    return false;
+  }
+  sequence = value.take();
+  return true;
 }
 
 Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
@@ -277,15 +467,49 @@ Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
   return status;
 }
 
-Status BufferedLogForwarder::deleteValueWithCount(const std::string& domain,
-                                                  const std::string& key) {
-  Status status = deleteDatabaseValue(domain, key);
+Status BufferedLogForwarder::addValuesWithCount(
+    const std::string& domain, const DatabaseStringValueList& values) {
+  Status status = setDatabaseBatch(domain, values);
   if (status.ok()) {
     RecursiveLock lock(count_mutex_);
-    if (buffer_count_ > 0) {
-      buffer_count_--;
+    buffer_count_ += values.size();
+  }
+  return status;
+}
+
+Status BufferedLogForwarder::deleteValuesWithCount(
+    const std::string& domain, const std::vector<std::string>& indexes) {
+  // A sequence is only written once, but a log may be written after a later
+  // sequence was. Only runs of consecutive sequences are deleted as ranges,
+  // nothing else can be buffered between their first and last index.
+  Status status;
+  size_t deleted = 0;
+  size_t first = 0;
+  while (first < indexes.size() && status.ok()) {
+    uint64_t sequence = 0;
+    size_t last = first;
+    if (getIndexSequence(indexes[first], sequence)) {
+      uint64_t next = 0;
+      while (last + 1 < indexes.size() &&
+             getIndexSequence(indexes[last + 1], next) &&
+             next == sequence + (last + 1 - first)) {
+        last++;
+      }
+    }
+
+    if (last == first) {
+      status = deleteDatabaseValue(domain, indexes[first]);
+    } else {
+      status = deleteDatabaseRange(domain, indexes[first], indexes[last]);
+    }
+    if (status.ok()) {
+      deleted += last - first + 1;
     }
+    first = last + 1;
   }
+
+  RecursiveLock lock(count_mutex_);
+  buffer_count_ -= std::min<unsigned long long int>(buffer_count_, deleted);
   return status;
 }
 }
@@ -10,14 +10,18 @@
 #pragma once
 
 #include <chrono>
+#include <deque>
 #include <functional>
+#include <future>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include <osquery/core/plugins/logger.h>
+#include <osquery/database/database.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -78,14 +82,19 @@ class BufferedLogForwarder : public InternalRunnable {
       const std::string& service_name,
       const std::string& name,
       const std::chrono::duration<Rep, Period>& log_period,
-      uint64_t max_log_lines)
+      uint64_t max_log_lines,
+      size_t max_in_flight = 1)
       : InternalRunnable(service_name),
         log_period_(
             std::chrono::duration_cast<std::chrono::seconds>(log_period)),
         max_log_lines_(max_log_lines),
+        max_in_flight_(max_in_flight),
         index_name_(name) {}
 
  public:
+  /// Stop the sender threads, no send is in flight once check() returned.
+  ~BufferedLogForwarder() override;
+
   /// A simple wait lock, and flush based on settings.
   void start() override;
 
@@ -136,6 +145,8 @@ class BufferedLogForwarder : public InternalRunnable {
    * Scan the logs domain for up to max_log_lines_ log lines.
    * Sort those lines into status and request types then forward (send) each
    * set. On success, clear the data and indexes. Calls purge upon completion.
+   *
+   * If more than one send may be in flight, see sendBatches().
    */
   void check();
 
@@ -143,8 +154,7 @@ class BufferedLogForwarder : public InternalRunnable {
    * @brief Purge the oldest logs, if the max is exceeded
    *
    * Uses the buffered_log_max flag to determine the maximum number of buffered
-   * logs. If this number is exceeded, the logs with the oldest timestamp are
-   * purged. Order of purging for logs with the same timestamp is undefined.
+   * logs. If this number is exceeded, the logs buffered first are purged.
    */
   void purge();
 
@@ -159,6 +169,36 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Helper for isResultIndex/isStatusIndex
   bool isIndex(const std::string& index, bool results);
 
+  /// Send one batch of up to max_log_lines_ logs of each type.
+  void sendBatch();
+
+  /**
+   * @brief Send every buffered log of a type, pipelining the batches.
+   *
+   * Batches of up to max_log_lines_ logs are read in index order, and up to
+   * max_in_flight_ of them are sent concurrently. The next batch is read
+   * while the previous ones are in flight. Batches are acknowledged in the
+   * order they were read: logs are only deleted once every earlier batch was
+   * sent, so the buffer always holds the newest logs of each type.
+   *
+   * Each batch is sent as one request, batches are not split into chunked
+   * uploads. Its body is compressed while it is serialized.
+   */
+  void sendBatches(bool results);
+
+  /**
+   * @brief Queue a batch for the sender threads.
+   *
+   * The max_in_flight_ sender threads are started with the first batch and
+   * live as long as the forwarder, so a transport keeping a client per
+   * thread reuses its connections and sessions between checks.
+   */
+  std::future<Status> sendAsync(std::vector<std::string> lines,
+                                const std::string& log_type);
+
+  /// Run queued sends until the forwarder is destroyed.
+  void runSender();
+
  protected:
   /// Generate a result index string to use with the backing store
   std::string genResultIndex(uint64_t time = 0);
@@ -166,9 +206,17 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Generate a status index string to use with the backing store
   std::string genStatusIndex(uint64_t time = 0);
 
+  /// Read the sequence number of an index, false for a time-named index.
+  bool getIndexSequence(const std::string& index, uint64_t& sequence);
+
  private:
   std::string genIndexPrefix(bool results);
 
+  /**
+   * @brief Generate an index from the next log sequence number.
+   *
+   * Sequence numbers are padded, indexes of each type order by age.
+   */
   std::string genIndex(bool results, uint64_t time = 0);
 
   /**
@@ -179,12 +227,13 @@ class BufferedLogForwarder : public InternalRunnable {
                            const std::string& key,
                            const std::string& value);
 
-  /**
-   * @brief Delete a database value while maintaining count
-   *
-   */
-  Status deleteValueWithCount(const std::string& domain,
-                              const std::string& key);
+  /// Add a batch of database values while maintaining count.
+  Status addValuesWithCount(const std::string& domain,
+                            const DatabaseStringValueList& values);
+
+  /// Delete ascending log indexes while maintaining count.
+  Status deleteValuesWithCount(const std::string& domain,
+                               const std::vector<std::string>& indexes);
 
  protected:
   /// Seconds between flushing logs
@@ -193,6 +242,9 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Max number of logs to flush per check
   uint64_t max_log_lines_;
 
+  /// Max number of concurrent sends, batches are sent one by one if 1
+  size_t max_in_flight_{1};
+
   /**
    * @brief Name to use in index
    *
@@ -204,12 +256,27 @@ class BufferedLogForwarder : public InternalRunnable {
 
  private:
   /// Hold an incrementing index for buffering logs
-  std::atomic<size_t> log_index_{0};
+  std::atomic<uint64_t> log_index_{0};
 
   /// Stores the count of buffered logs
   unsigned long long int buffer_count_{0};
 
   /// Protects the count of buffered logs
   RecursiveMutex count_mutex_;
+
+  /// Threads sending pipelined batches.
+  std::vector<std::thread> senders_;
+
+  /// Batches waiting for a sender thread.
+  std::deque<std::packaged_task<Status()>> send_queue_;
+
+  /// Set when the sender threads must exit.
+  bool stopping_{false};
+
+  /// Protects the sender threads and their queue.
+  Mutex senders_mutex_;
+
+  /// Signals a queued batch or stopping to the sender threads.
+  ConditionVariable senders_cv_;
 };
 }
@@ -11,12 +11,20 @@
 #include "logrotate.h"
 
 #include <osquery/core/flags.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/config/default_paths.h>
 #include <osquery/utils/conversions/tryto.h>
 
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
 #include <exception>
 #include <iostream>
 
@@ -83,6 +91,19 @@ CLI_FLAG(string,
 
 DEFINE_validator(logger_mode, &validateLoggerMode);
 
+FLAG(uint64,
+     logger_flush_size,
+     0,
+     "Buffer results logs up to this many bytes, 0 writes each line");
+FLAG(uint64,
+     logger_flush_interval,
+     1000,
+     "Milliseconds a buffered results log line may wait to be written");
+FLAG(bool,
+     logger_fdatasync,
+     false,
+     "Sync buffered results logs to disk after each write");
+
 const std::string kFilesystemLoggerFilename = "osqueryd.results.log";
 const std::string kFilesystemLoggerSnapshots = "osqueryd.snapshots.log";
 
@@ -172,6 +193,186 @@ Status LogRotate::moveFiles(const std::vector<std::string>& moves,
   return Status::success();
 }
 
+/**
+ * @brief A results log file kept open between writes.
+ *
+ * Lines are appended to a write buffer, the buffer is written once it holds
+ * logger_flush_size bytes or its oldest line is logger_flush_interval old.
+ * The file is closed before it is rotated and opened again by the next write.
+ */
+class FilesystemLogFile : private boost::noncopyable {
+ public:
+  FilesystemLogFile(std::string path, int permissions)
+      : path_(std::move(path)), permissions_(permissions) {}
+
+  ~FilesystemLogFile() {
+    close();
+  }
+
+  /// Buffer a line, the buffer is written if it is full.
+  Status append(const std::string& line);
+
+  /// Write the buffer if its oldest line is due.
+  Status flushIfDue();
+
+  /// Write the buffer.
+  Status flush();
+
+  /// Write the buffer and close the file.
+  Status close();
+
+ private:
+  /// Open the file for appending, or reopen if the path was moved.
+  Status open();
+
+  /// Write and empty the buffer, the caller holds the mutex.
+  Status write();
+
+ private:
+  std::string path_;
+  int permissions_{0};
+
+  std::unique_ptr<PlatformFile> file_{nullptr};
+
+  /// Lines not yet written.
+  std::string buffer_;
+
+  /// When the oldest buffered line was appended.
+  std::chrono::steady_clock::time_point buffered_since_;
+
+  Mutex mutex_;
+};
+
+Status FilesystemLogFile::append(const std::string& line) {
+  WriteLock lock(mutex_);
+  if (buffer_.empty()) {
+    buffered_since_ = std::chrono::steady_clock::now();
+  }
+  buffer_ += line;
+  buffer_ += '\n';
+
+  if (buffer_.size() >= FLAGS_logger_flush_size) {
+    return write();
+  }
+  return Status::success();
+}
+
+Status FilesystemLogFile::flushIfDue() {
+  WriteLock lock(mutex_);
+  auto age = std::chrono::steady_clock::now() - buffered_since_;
+  if (buffer_.empty() ||
+      age < std::chrono::milliseconds(FLAGS_logger_flush_interval)) {
+    return Status::success();
+  }
+  return write();
+}
+
+Status FilesystemLogFile::flush() {
+  WriteLock lock(mutex_);
+  return write();
+}
+
+Status FilesystemLogFile::close() {
+  WriteLock lock(mutex_);
+  auto status = write();
+  file_.reset();
+  return status;
+}
+
+Status FilesystemLogFile::open() {
+#ifndef WIN32
+  if (file_ != nullptr) {
+    // The file may have been moved or removed by an external log rotation.
+    struct stat path_stat;
+    struct stat file_stat;
+    if (::stat(path_.c_str(), &path_stat) == 0 &&
+        ::fstat(file_->nativeHandle(), &file_stat) == 0 &&
+        path_stat.st_dev == file_stat.st_dev &&
+        path_stat.st_ino == file_stat.st_ino) {
+      return Status::success();
+    }
+    file_.reset();
+  }
+#endif
+
+  if (file_ != nullptr) {
+    return Status::success();
+  }
+
+  auto file = std::make_unique<PlatformFile>(
+      path_, PF_OPEN_ALWAYS | PF_WRITE | PF_APPEND, permissions_);
+  if (!file->isValid()) {
+    return Status::failure("Could not create file: " + path_);
+  }
+
+  // If the file existed with different permissions they must be restricted.
+  if (!platformChmod(path_, permissions_)) {
+    return Status::failure("Failed to change permissions for file: " + path_);
+  }
+
+  file_ = std::move(file);
+  return Status::success();
+}
+
+Status FilesystemLogFile::write() {
+  if (buffer_.empty()) {
+    return Status::success();
+  }
+
+  auto status = open();
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto bytes = file_->write(buffer_.data(), buffer_.size());
+  if (bytes < 0 || static_cast<size_t>(bytes) != buffer_.size()) {
+    // Reopen the file for the next write, the lines written are not repeated.
+    file_.reset();
+    if (bytes > 0) {
+      buffer_.erase(0, static_cast<size_t>(bytes));
+    }
+    return Status::failure("Failed to write contents to file: " + path_);
+  }
+  buffer_.clear();
+
+  if (FLAGS_logger_fdatasync) {
+#if defined(WIN32)
+    ::FlushFileBuffers(file_->nativeHandle());
+#elif defined(__APPLE__)
+    ::fsync(file_->nativeHandle());
+#else
+    ::fdatasync(file_->nativeHandle());
+#endif
+  }
+  return Status::success();
+}
+
+/// Write buffered results log lines that are due.
+class FilesystemLogFlusher : public InternalRunnable {
+ public:
+  explicit FilesystemLogFlusher(
+      std::vector<std::shared_ptr<FilesystemLogFile>> files)
+      : InternalRunnable("FilesystemLogFlusher"), files_(std::move(files)) {}
+
+ protected:
+  void start() override {
+    while (!interrupted()) {
+      pause(std::chrono::milliseconds(FLAGS_logger_flush_interval));
+      for (const auto& file : files_) {
+        file->flushIfDue();
+      }
+    }
+
+    // Write everything left buffered when the service stops.
+    for (const auto& file : files_) {
+      file->flush();
+    }
+  }
+
+ private:
+  std::vector<std::shared_ptr<FilesystemLogFile>> files_;
+};
+
 struct FilesystemLoggerPlugin::impl {
   impl() {
     const auto logger_mode_octal_exp =
@@ -194,6 +395,14 @@ struct FilesystemLoggerPlugin::impl {
   /// Snapshot log rotator.
   std::unique_ptr<LogRotate> snapshot_rotate{nullptr};
 
+  /// Buffered results log, if logger_flush_size is set.
+  std::shared_ptr<FilesystemLogFile> results_file{nullptr};
+  /// Buffered snapshot log, if logger_flush_size is set.
+  std::shared_ptr<FilesystemLogFile> snapshot_file{nullptr};
+
+  /// Service writing buffered lines that are due.
+  std::shared_ptr<FilesystemLogFlusher> flusher{nullptr};
+
   /// Filesystem results log writer mutex.
   Mutex snapshot_mutex;
   /// Filesystem snapshot log write mutex.
@@ -216,6 +425,29 @@ Status FilesystemLoggerPlugin::setUp() {
   pimpl_->snapshot_rotate = std::make_unique<LogRotate>(
       (pimpl_->log_path / kFilesystemLoggerSnapshots).string());
 
+  if (pimpl_->flusher != nullptr) {
+    // The previous service writes the logs it was given and stops.
+    pimpl_->flusher->interrupt();
+    pimpl_->flusher.reset();
+  }
+  pimpl_->results_file.reset();
+  pimpl_->snapshot_file.reset();
+
+  if (FLAGS_logger_flush_size > 0) {
+    // Keep the logs open and write buffered lines.
+    pimpl_->results_file = std::make_shared<FilesystemLogFile>(
+        (pimpl_->log_path / kFilesystemLoggerFilename).string(),
+        pimpl_->logger_mode_octal);
+    pimpl_->snapshot_file = std::make_shared<FilesystemLogFile>(
+        (pimpl_->log_path / kFilesystemLoggerSnapshots).string(),
+        pimpl_->logger_mode_octal);
+
+    pimpl_->flusher = std::make_shared<FilesystemLogFlusher>(
+        std::vector<std::shared_ptr<FilesystemLogFile>>{pimpl_->results_file,
+                                                        pimpl_->snapshot_file});
+    Dispatcher::addService(pimpl_->flusher);
+  }
+
   // Ensure that we create the results log here.
   WriteLock lock(pimpl_->results_mutex);
   return logStringToFile("", kFilesystemLoggerFilename, true);
@@ -224,6 +456,10 @@ Status FilesystemLoggerPlugin::setUp() {
 Status FilesystemLoggerPlugin::logString(const std::string& s) {
   WriteLock lock(pimpl_->results_mutex);
   if (FLAGS_logger_rotate && pimpl_->results_rotate->shouldRotate()) {
+    if (pimpl_->results_file != nullptr) {
+      // Buffered lines belong to the log being rotated.
+      pimpl_->results_file->close();
+    }
     auto s = pimpl_->results_rotate->rotate(FLAGS_logger_rotate_max_files);
     if (!s.ok()) {
       return s;
@@ -237,6 +473,9 @@ Status FilesystemLoggerPlugin::logSnapshot(const std::string& s) {
   // Send the snapshot data to a separate filename.
   WriteLock lock(pimpl_->snapshot_mutex);
   if (FLAGS_logger_rotate && pimpl_->snapshot_rotate->shouldRotate()) {
+    if (pimpl_->snapshot_file != nullptr) {
+      pimpl_->snapshot_file->close();
+    }
     auto s = pimpl_->snapshot_rotate->rotate(FLAGS_logger_rotate_max_files);
     if (!s.ok()) {
       return s;
@@ -246,9 +485,29 @@ Status FilesystemLoggerPlugin::logSnapshot(const std::string& s) {
   return logStringToFile(s, kFilesystemLoggerSnapshots);
 }
 
+Status FilesystemLoggerPlugin::flush() {
+  Status status;
+  for (const auto& file : {pimpl_->results_file, pimpl_->snapshot_file}) {
+    if (file != nullptr) {
+      auto s = file->flush();
+      if (!s.ok()) {
+        status = s;
+      }
+    }
+  }
+  return status;
+}
+
 Status FilesystemLoggerPlugin::logStringToFile(const std::string& s,
                                                const std::string& filename,
                                                bool empty) {
+  const auto& file = (filename == kFilesystemLoggerFilename)
+                         ? pimpl_->results_file
+                         : pimpl_->snapshot_file;
+  if (file != nullptr && !empty) {
+    return file->append(s);
+  }
+
   Status status;
   try {
     auto filepath = (pimpl_->log_path / filename).string();
@@ -44,6 +44,9 @@ class FilesystemLoggerPlugin : public LoggerPlugin {
   /// Write a status to Glog.
   Status logStatus(const std::vector<StatusLogLine>& log) override;
 
+  /// Write lines buffered for the results and snapshot logs.
+  Status flush();
+
  private:
   /// The plugin-internal filesystem writer method.
   Status logStringToFile(const std::string& s,
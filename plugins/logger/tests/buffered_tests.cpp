@@ -80,9 +80,13 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
       const std::string& name = "mock",
       const std::chrono::duration<long, std::ratio<1, 1000>> log_period =
           kLogPeriod,
-      size_t max_log_lines = kMaxLogLines)
-      : BufferedLogForwarder(
-            "MockBufferedLogForwarder", name, log_period, max_log_lines) {}
+      size_t max_log_lines = kMaxLogLines,
+      size_t max_in_flight = 1)
+      : BufferedLogForwarder("MockBufferedLogForwarder",
+                             name,
+                             log_period,
+                             max_log_lines,
+                             max_in_flight) {}
 
   bool interrupted() {
     // A small conditional to force-skip an interruption check, used in testing.
@@ -98,6 +102,7 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
                Status(std::vector<std::string>& log_data,
                       const std::string& log_type));
   FRIEND_TEST(BufferedLogForwarderTests, test_index);
+  FRIEND_TEST(BufferedLogForwarderTests, test_legacy_index);
   FRIEND_TEST(BufferedLogForwarderTests, test_basic);
   FRIEND_TEST(BufferedLogForwarderTests, test_retry);
   FRIEND_TEST(BufferedLogForwarderTests, test_multiple);
@@ -105,6 +110,8 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
   FRIEND_TEST(BufferedLogForwarderTests, test_split);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge_max);
+  FRIEND_TEST(BufferedLogForwarderTests, test_late_write);
+  FRIEND_TEST(BufferedLogForwarderTests, test_pipelined);
 
  private:
   bool checked_{false};
@@ -113,10 +120,10 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
 TEST_F(BufferedLogForwarderTests, test_index) {
   MockBufferedLogForwarder runner;
   if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_1"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_2"));
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_3"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_4"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_0{19}1_[0-9]+"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_0{19}2_[0-9]+"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_0{19}3_[0-9]+"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_0{19}4_[0-9]+"));
   }
 
   EXPECT_TRUE(runner.isResultIndex(runner.genResultIndex()));
@@ -128,6 +135,33 @@ TEST_F(BufferedLogForwarderTests, test_index) {
   EXPECT_FALSE(runner.isStatusIndex("foo"));
 }
 
+TEST_F(BufferedLogForwarderTests, test_legacy_index) {
+  // Logs buffered with time-named indexes are renamed in the order of age.
+  setDatabaseValue(kLogs, "mock_r_1600000001_1", "second");
+  setDatabaseValue(kLogs, "mock_r_1600000000_2", "first");
+  setDatabaseValue(kLogs, "mock_s_1600000000_3", "{}");
+
+  StrictMock<MockBufferedLogForwarder> runner;
+  ASSERT_TRUE(runner.setUp());
+
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "mock_");
+  ASSERT_EQ(indexes.size(), 3U);
+  for (const auto& index : indexes) {
+    uint64_t sequence = 0;
+    EXPECT_TRUE(runner.getIndexSequence(index, sequence));
+  }
+
+  // New logs are indexed after the renamed logs.
+  runner.logString("third");
+  EXPECT_CALL(runner, send(ElementsAre("first", "second", "third"), "result"))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre("{}"), "status"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  runner.check();
+}
+
 TEST_F(BufferedLogForwarderTests, test_basic) {
   StrictMock<MockBufferedLogForwarder> runner;
   runner.logString("foo");
@@ -370,4 +404,69 @@ TEST_F(BufferedLogForwarderTests, test_purge_max) {
 
   runner.check();
 }
+
+// Verify that a log written within the indexes of a sent batch is kept
+TEST_F(BufferedLogForwarderTests, test_late_write) {
+  StrictMock<MockBufferedLogForwarder> runner("late");
+  runner.logString("foo");
+  // A concurrent writer took the next sequence but writes it after the scan.
+  auto late = runner.genResultIndex();
+  runner.logString("bar");
+
+  EXPECT_CALL(runner, send(ElementsAre("foo", "bar"), "result"))
+      .WillOnce(DoAll(InvokeWithoutArgs([&late]() {
+                        setDatabaseValue(kLogs, late, "late");
+                      }),
+                      Return(Status(0))));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("late"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  runner.check();
+}
+
+// Verify that concurrent sends are acknowledged in the order they were read
+TEST_F(BufferedLogForwarderTests, test_pipelined) {
+  FLAGS_buffered_log_max = 100;
+
+  // Send one log per batch, with up to two batches in flight.
+  StrictMock<MockBufferedLogForwarder> runner("pipelined", kLogPeriod, 1, 2);
+  StatusLogLine log1 = makeStatusLogLine(O_INFO, "foo", 1, "foo status");
+  runner.logString("foo");
+  runner.logString("bar");
+  runner.logString("baz");
+  runner.logString("qux");
+  runner.logStatus({log1});
+
+  // The batch read after 'foo' was acknowledged is in flight when 'bar'
+  // fails, it is sent again with 'bar'. No other batch is read.
+  EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre("bar"), "result"))
+      .WillOnce(Return(Status(1, "fail")))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre("baz"), "result"))
+      .Times(2)
+      .WillRepeatedly(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre(MatchesStatus(log1)), "status"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "pipelined_");
+  EXPECT_EQ(3U, indexes.size());
+
+  EXPECT_CALL(runner, send(ElementsAre("qux"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  // Every batch was acknowledged.
+  indexes.clear();
+  scanDatabaseKeys(kLogs, indexes, "pipelined_");
+  EXPECT_TRUE(indexes.empty());
+
+  runner.check();
+}
 }
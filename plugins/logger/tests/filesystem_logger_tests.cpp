@@ -33,6 +33,10 @@ namespace osquery {
 DECLARE_string(logger_path);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_bool(logger_rotate);
+DECLARE_uint64(logger_rotate_size);
+DECLARE_uint64(logger_flush_size);
+DECLARE_uint64(logger_flush_interval);
 
 class FilesystemLoggerTests : public testing::Test {
  public:
@@ -85,6 +89,52 @@ TEST_F(FilesystemLoggerTests, test_log_string) {
   EXPECT_EQ(content, "{\"json\": true}\n");
 }
 
+TEST_F(FilesystemLoggerTests, test_log_string_buffered) {
+  FLAGS_logger_flush_size = 32;
+  FLAGS_logger_flush_interval = 60 * 1000;
+  auto plugin = std::dynamic_pointer_cast<FilesystemLoggerPlugin>(
+      Registry::get().plugin("logger", "filesystem"));
+  ASSERT_NE(plugin, nullptr);
+  ASSERT_TRUE(plugin->setUp());
+
+  // Lines are buffered until the buffer is full or flushed.
+  EXPECT_TRUE(logString("{\"json\": 1}", "event"));
+  std::string content;
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "");
+
+  EXPECT_TRUE(logString("{\"json\": 2}", "event"));
+  EXPECT_TRUE(logString("{\"json\": 3}", "event"));
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "{\"json\": 1}\n{\"json\": 2}\n{\"json\": 3}\n");
+
+  EXPECT_TRUE(logString("{\"json\": 4}", "event"));
+  EXPECT_TRUE(plugin->flush());
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content,
+            "{\"json\": 1}\n{\"json\": 2}\n{\"json\": 3}\n{\"json\": 4}\n");
+
+  // Buffered lines are written to the log before it is rotated.
+  FLAGS_logger_flush_size = 1024;
+  FLAGS_logger_rotate = true;
+  FLAGS_logger_rotate_size = 1;
+  EXPECT_TRUE(logString("{\"json\": 5}", "event"));
+  EXPECT_TRUE(plugin->flush());
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "{\"json\": 5}\n");
+
+  std::string rotated;
+  EXPECT_TRUE(readFile(results_path_ + ".1", rotated));
+  EXPECT_EQ(rotated,
+            "{\"json\": 1}\n{\"json\": 2}\n{\"json\": 3}\n{\"json\": 4}\n");
+
+  FLAGS_logger_rotate = false;
+  FLAGS_logger_rotate_size = 25 * 1024 * 1024;
+  FLAGS_logger_flush_size = 0;
+  FLAGS_logger_flush_interval = 1000;
+  EXPECT_TRUE(plugin->setUp());
+}
+
 class FilesystemTestLoggerPlugin : public LoggerPlugin {
  public:
   Status logString(const std::string& s) override {
@@ -19,6 +19,9 @@
 
 namespace osquery {
 DECLARE_bool(disable_database);
+DECLARE_bool(logger_tls_compress);
+DECLARE_uint64(logger_tls_max_lines);
+DECLARE_uint64(logger_tls_max_inflight);
 
 class TLSLoggerTests : public testing::Test {
  protected:
@@ -83,4 +86,38 @@ TEST_F(TLSLoggerTests, test_send) {
   TLSServerRunner::unsetClientConfig();
   TLSServerRunner::stop();
 }
+
+TEST_F(TLSLoggerTests, test_send_pipelined) {
+  // Start a server.
+  ASSERT_TRUE(TLSServerRunner::start());
+  TLSServerRunner::setClientConfig();
+
+  // Send compressed batches of 5 logs, with up to 3 batches in flight.
+  auto compress = FLAGS_logger_tls_compress;
+  auto max_lines = FLAGS_logger_tls_max_lines;
+  auto max_inflight = FLAGS_logger_tls_max_inflight;
+  FLAGS_logger_tls_compress = true;
+  FLAGS_logger_tls_max_lines = 5;
+  FLAGS_logger_tls_max_inflight = 3;
+
+  auto forwarder = std::make_shared<TLSLogForwarder>();
+  for (size_t i = 0; i < 20; i++) {
+    forwarder->logString("{\"pipelined_json\": " + std::to_string(i) + "}");
+  }
+
+  runCheck(forwarder);
+
+  FLAGS_logger_tls_compress = compress;
+  FLAGS_logger_tls_max_lines = max_lines;
+  FLAGS_logger_tls_max_inflight = max_inflight;
+
+  // Stop the server.
+  TLSServerRunner::unsetClientConfig();
+  TLSServerRunner::stop();
+
+  // Every batch was sent within a single check, and acknowledged.
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "tls_");
+  EXPECT_TRUE(indexes.empty());
+}
 } // namespace osquery
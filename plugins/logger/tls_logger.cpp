@@ -49,7 +49,12 @@ FLAG(uint64,
 // The flag name logger_tls_max is deprecated.
 FLAG_ALIAS(google::uint64, logger_tls_max, logger_tls_max_linesize);
 
-FLAG(bool, logger_tls_compress, false, "GZip compress TLS/HTTPS request body");
+FLAG(bool, logger_tls_compress, false, "Compress TLS/HTTPS request body");
+
+FLAG(uint64,
+     logger_tls_max_inflight,
+     1,
+     "Max number of log batches sent concurrently over TLS/HTTPS");
 
 REGISTER(TLSLoggerPlugin, "logger", "tls");
 
@@ -57,7 +62,8 @@ TLSLogForwarder::TLSLogForwarder()
     : BufferedLogForwarder("TLSLogForwarder",
                            "tls",
                            std::chrono::seconds(FLAGS_logger_tls_period),
-                           FLAGS_logger_tls_max_lines) {
+                           FLAGS_logger_tls_max_lines,
+                           FLAGS_logger_tls_max_inflight) {
   uri_ = TLSRequestHelper::makeURI(FLAGS_logger_tls_endpoint);
 }
 
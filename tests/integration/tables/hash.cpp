@@ -76,5 +76,34 @@ TEST_F(Hash, test_sanity) {
   }
 }
 
+TEST_F(Hash, test_column_pruning) {
+  const std::string predicate =
+      " from hash where path = '" + path.string() + "'";
+
+  // Only the selected digest is computed.
+  auto data = execute_query("select md5" + predicate);
+  ASSERT_EQ(data.size(), 1ul);
+  EXPECT_EQ(data[0].size(), 1ul);
+  EXPECT_EQ(data[0]["md5"], "35899082e51edf667f14477ac000cbba");
+
+  // A cached entry missing the requested digests is extended.
+  data = execute_query("select sha1, sha256" + predicate);
+  ASSERT_EQ(data.size(), 1ul);
+  EXPECT_EQ(data[0]["sha1"], "e7505beb754bed863e3885f73e3bb6866bdd7f8c");
+  EXPECT_EQ(data[0]["sha256"],
+            "a58dd8680234c1f8cc2ef2b325a43733605a7f16f288e072de8eae81fd8d6433");
+
+  data = execute_query("select md5, sha1" + predicate);
+  ASSERT_EQ(data.size(), 1ul);
+  EXPECT_EQ(data[0]["md5"], "35899082e51edf667f14477ac000cbba");
+  EXPECT_EQ(data[0]["sha1"], "e7505beb754bed863e3885f73e3bb6866bdd7f8c");
+
+  // Rows are still produced when no digest is selected.
+  data = execute_query("select path, directory" + predicate);
+  ASSERT_EQ(data.size(), 1ul);
+  EXPECT_EQ(data[0]["path"], path.string());
+  EXPECT_EQ(data[0]["directory"], path.parent_path().string());
+}
+
 } // namespace table_tests
 } // namespace osquery
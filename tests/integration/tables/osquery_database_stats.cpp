@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_database_stats
+// Spec file: specs/utility/osquery_database_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryDatabaseStats : public testing::Test {
+  protected:
+    void SetUp() override {
+      setUpEnvironment();
+    }
+};
+
+TEST_F(osqueryDatabaseStats, test_sanity) {
+  // The ephemeral database reports no statistics.
+  auto const data = execute_query("select * from osquery_database_stats");
+
+  ValidationMap row_map = {
+      {"domain", NonEmptyString},
+      {"compaction", SpecificValuesCheck{"level", "ttl", "fifo"}},
+      {"keys", NonNegativeInt},
+      {"live_data_size", NonNegativeInt},
+      {"sst_files_size", NonNegativeInt},
+      {"memtable_size", NonNegativeInt},
+      {"pending_compaction_size", NonNegativeInt},
+      {"block_cache_usage", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -39,6 +39,8 @@ TEST_F(osqueryEvents, test_sanity) {
   //      {"subscriptions", IntType}
   //      {"events", IntType}
   //      {"refreshes", IntType}
+  //      {"dropped", IntType}
+  //      {"backpressure", IntType}
   //      {"active", IntType}
   //}
   // 4. Perform validation
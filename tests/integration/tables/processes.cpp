@@ -107,5 +107,40 @@ TEST_F(ProcessesTest, test_sanity) {
   validate_rows(data, row_map);
 }
 
+TEST_F(ProcessesTest, test_column_pruning) {
+  // Selecting a subset of columns must not change the values of that subset.
+  const std::string self = " from processes where pid = "
+                           "(select pid from osquery_info)";
+  auto const all_columns = execute_query("select *" + self);
+  ASSERT_EQ(all_columns.size(), 1ul);
+
+  // Columns whose values are stable for the lifetime of the test process.
+  std::vector<std::string> columns = {"name",
+                                      "path",
+                                      "cmdline",
+                                      "cwd",
+                                      "root",
+                                      "uid",
+                                      "gid",
+                                      "euid",
+                                      "egid",
+                                      "on_disk",
+                                      "parent",
+                                      "pgroup",
+                                      "start_time"};
+  if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
+    columns.push_back("suid");
+    columns.push_back("sgid");
+  }
+
+  for (const auto& column : columns) {
+    auto const data = execute_query("select pid, " + column + self);
+    ASSERT_EQ(data.size(), 1ul) << column;
+    EXPECT_EQ(data[0].size(), 2ul) << column;
+    EXPECT_EQ(data[0].at("pid"), all_columns[0].at("pid")) << column;
+    EXPECT_EQ(data[0].at(column), all_columns[0].at(column)) << column;
+  }
+}
+
 } // namespace table_tests
 } // namespace osquery
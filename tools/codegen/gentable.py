@@ -213,6 +213,8 @@ class TableState(Singleton):
         self.has_column_aliases = False
         self.strongly_typed_rows = False
         self.generator = False
+        self.cardinality = 0
+        self.has_selectivity = False
 
     def columns(self):
         return [i for i in self.schema if isinstance(i, Column)]
@@ -225,6 +227,7 @@ class TableState(Singleton):
         logging.debug("TableState.generate")
 
         all_options = []
+        self.has_selectivity = False
         # Create a list of column options from the kwargs passed to the column.
         for column in self.columns():
             column_options = []
@@ -240,6 +243,13 @@ class TableState(Singleton):
             column.options_set = " | ".join(column_options)
             if len(column.aliases) > 0:
                 self.has_column_aliases = True
+            if column.selectivity is not None:
+                if not 0 < column.selectivity <= 1:
+                    print(lightred(
+                        "Table %s column %s selectivity must be within (0, 1]" % (
+                            self.table_name, column.name)))
+                    exit(1)
+                self.has_selectivity = True
         if len(all_options) > 0:
             self.has_options = True
         if "event_subscriber" in self.attributes:
@@ -247,9 +257,9 @@ class TableState(Singleton):
         if "strongly_typed_rows" in self.attributes:
             self.strongly_typed_rows = True
         if "cacheable" in self.attributes:
-            if self.generator:
+            if "event_subscriber" in self.attributes:
                 print(lightred(
-                    "Table cannot use a generator and be marked cacheable: %s" % (path)))
+                    "Event subscriber tables cannot be marked cacheable: %s" % (path)))
                 exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
@@ -289,6 +299,8 @@ class TableState(Singleton):
             aliases=self.aliases,
             has_options=self.has_options,
             has_column_aliases=self.has_column_aliases,
+            has_selectivity=self.has_selectivity,
+            cardinality=self.cardinality,
             generator=self.generator,
             strongly_typed_rows=self.strongly_typed_rows,
             attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes if attr in TABLE_ATTRIBUTES],
@@ -318,6 +330,7 @@ class Column(object):
         self.type = col_type
         self.description = description
         self.aliases = aliases
+        self.selectivity = kwargs.pop("selectivity", None)
         self.options = kwargs
 
 
@@ -342,6 +355,7 @@ def table_name(name, aliases=[]):
     table.attributes = {}
     table.examples = []
     table.aliases = aliases
+    table.cardinality = 0
 
 
 def schema(schema_list):
@@ -397,6 +411,14 @@ def fuzz_paths(paths):
     table.fuzz_paths = paths
 
 
+def cardinality(rows):
+    """
+    define the expected number of rows in a full scan of the table, a hint
+    for the SQLite planner together with each column's selectivity.
+    """
+    table.cardinality = rows
+
+
 def implementation(impl_string, generator=False):
     """
     define the path to the implementation file and the function which
@@ -404,6 +426,8 @@ def implementation(impl_string, generator=False):
       # the path is "osquery/table/implementations/foo.cpp"
       # the function is "QueryData genFoo();"
       implementation("foo@genFoo")
+    generator may be a platform predicate, such as LINUX, for tables that
+    yield rows on some platforms only.
     """
     logging.debug("- implementation")
     filename, function = impl_string.split("@")
@@ -417,7 +441,7 @@ def implementation(impl_string, generator=False):
     table.impl = impl
     table.function = function
     table.class_name = class_name
-    table.generator = generator
+    table.generator = generator() if callable(generator) else generator
 
     '''Check if the table has a subscriber attribute, if so, enforce time.'''
     if "event_subscriber" in table.attributes:
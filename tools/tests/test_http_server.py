@@ -9,6 +9,7 @@
 
 import argparse
 import base64
+import gzip
 import json
 import os
 import random
@@ -19,9 +20,15 @@ import _thread
 import threading
 
 # Create a simple TLS/HTTP server.
-from http.server import BaseHTTPRequestHandler, HTTPServer
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
 from urllib.parse import parse_qs
 
+# Zstandard request bodies are only decoded if the module is available.
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
 # Script run directory, used for default values
 SCRIPT_DIR = os.path.dirname(os.path.realpath(__file__))
 
@@ -175,8 +182,21 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
         debug("RealSimpleHandler::post %s" % self.path)
         self._set_headers()
         content_len = int(self.headers.get('content-length', 0))
+        content_encoding = self.headers.get('content-encoding', '')
 
         body = self.rfile.read(content_len)
+        if self.path == '/encoded':
+            # Echo the encoded body, used to test request compression.
+            self._reply({
+                "content_encoding": content_encoding,
+                "body": base64.standard_b64encode(body).decode(),
+            })
+            return
+
+        if content_encoding == 'gzip':
+            body = gzip.decompress(body)
+        elif content_encoding == 'zstd' and zstandard is not None:
+            body = zstandard.ZstdDecompressor().decompressobj().decompress(body)
         request = json.loads(body)
 
         # This contains a base64 encoded block of a file printing to the screen
@@ -383,7 +403,9 @@ def run_http_server(bind_port=80, **kwargs):
 
     reset_timeout()
 
-    httpd = HTTPServer(('localhost', bind_port), RealSimpleHandler)
+    # Clients may keep several connections open, e.g. pipelined log batches.
+    httpd = ThreadingHTTPServer(('localhost', bind_port), RealSimpleHandler)
+    httpd.daemon_threads = True
     if ARGS['tls']:
         httpd.socket = ssl.wrap_socket(
             httpd.socket,